@@ -147,7 +147,7 @@ To enabled set it to 1. Disabled by default.
         /* Some Windows display adapter driver cannot support VAO. */
         /* Some android devices cannot support VAO very well, so we disable it by default for android platform. */
         /* Blackberry also doesn't support this feature. */
-		#define FLAKOR_TEXTURE_ATLAS_USE_VAO 0
+		#define FK_TEXTURE_ATLAS_USE_VAO 0
     #endif
 #endif
 
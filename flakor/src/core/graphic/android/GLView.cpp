@@ -5,6 +5,8 @@
 #include "macros.h"
 #include "core/opengl/GLContext.h"
 #include "core/opengl/gl3stub.h"
+#include "core/opengl/GLUploader.h"
+#include "core/opengl/texture/TextureManager.h"
 
 #include <unistd.h>
 #include <string>
@@ -118,6 +120,11 @@ bool GLContext::initEGLContext()
     }
 
     _contextValid = true;
+
+    //Texture and buffer uploads on a thread of their own, sharing this context
+    GLUploader* uploader = GLUploader::getInstance();
+    if( uploader->isEnabled() )
+        uploader->start( _display, _config, _context );
     return true;
 }
 
@@ -156,18 +163,28 @@ EGLint GLView::swap()
         }
         else if( err == EGL_CONTEXT_LOST || err == EGL_BAD_CONTEXT )
         {
-            //Context has been lost!!
+            //Context has been lost!! The uploader's context shared it
             context_valid_ = false;
+            GLUploader::getInstance()->contextLost();
             terminate();
+            initEGLSurface();
             initEGLContext();
+            TextureManager::getInstance()->reloadTextures();
         }
         return err;
     }
+
+    //the frame is on screen, textures decoded in the background are
+    //uploaded for the next one, a few milliseconds' worth a frame
+    TextureManager::getInstance()->processUploads();
     return EGL_SUCCESS;
 }
 
 void GLView::terminate()
 {
+    //The uploads still queued are done while the context is current
+    GLUploader::getInstance()->stop();
+
     if( _display != EGL_NO_DISPLAY )
     {
         eglMakeCurrent( _display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
@@ -223,6 +240,7 @@ EGLint GLView::resume( ANativeWindow* window )
     {
         //Recreate context
         FKLOG( "Re-creating egl context" );
+        GLUploader::getInstance()->contextLost();
         initEGLContext();
     }
     else
@@ -232,6 +250,8 @@ EGLint GLView::resume( ANativeWindow* window )
         initEGLSurface();
         initEGLContext();
     }
+    //Either way the textures went with the old context
+    TextureManager::getInstance()->reloadTextures();
 
     return err;
 
@@ -11,6 +11,7 @@
 #include "platform/ios/GLContext.h"
 #include "core/resource/Scheduler.h"
 #include "core/resource/ResourceManager.h"
+#include "core/opengl/texture/TextureManager.h"
 #include "core/input/TouchPool.h"
 #include "base/update/UpdateThread.h"
 #include "math/GLMatrix.h"
@@ -128,6 +129,8 @@ void Engine::drawFrame()
     glClearColor(1.f, 1.f,1.f, 1.f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     
+    // textures decoded in the background, a few milliseconds' worth a frame
+    TextureManager::getInstance()->processUploads();
     
     if (this->game != NULL)
     {
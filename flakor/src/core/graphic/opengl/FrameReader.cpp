@@ -0,0 +1,331 @@
+/**********************************************************
+ * Copyright (c) 2013-2015 Steve Hsu  All Rights Reserved.
+ *********************************************************/
+
+#include "core/opengl/FrameReader.h"
+#include "base/lang/ThreadPool.h"
+#include "tool/utility/TexUtils.h"
+
+#include <algorithm>
+#include <mutex>
+#include <string.h>
+
+#if (FK_TARGET_PLATFORM == FK_PLATFORM_ANDROID)
+#include "core/opengl/gl3stub.h"
+#define FK_FRAMEREADER_USE_PBO 1
+#else
+#define FK_FRAMEREADER_USE_PBO 0
+#endif
+
+FLAKOR_NS_BEGIN
+
+namespace
+{
+	static const int DEFAULT_BUFFER_COUNT = 3;
+	static const int MAX_BUFFER_COUNT = 8;
+#if FK_FRAMEREADER_USE_PBO
+	// a blocking wait is done in steps of this many nanoseconds
+	static const GLuint64 WAIT_STEP = 100000000;
+#endif
+}
+
+FrameReader* FrameReader::s_sharedReader = nullptr;
+
+FrameReader* FrameReader::getInstance()
+{
+	static std::mutex instanceMutex;
+	std::lock_guard<std::mutex> lock(instanceMutex);
+	if (s_sharedReader == nullptr)
+	{
+		s_sharedReader = new FrameReader();
+	}
+	return s_sharedReader;
+}
+
+void FrameReader::destroyInstance()
+{
+	if (s_sharedReader != nullptr)
+	{
+		s_sharedReader->finish();
+		s_sharedReader->releaseGLObjects(false);
+		delete s_sharedReader;
+		s_sharedReader = nullptr;
+	}
+}
+
+FrameReader::FrameReader()
+: _bufferCount(DEFAULT_BUFFER_COUNT)
+, _nextFrameId(1)
+, _packBuffers(-1)
+, _pending(0)
+{
+}
+
+FrameReader::~FrameReader()
+{
+	//the worker tasks count down _pending when they are done
+	std::unique_lock<std::mutex> lock(_pendingMutex);
+	_pendingDone.wait(lock, [this]() { return _pending == 0; });
+}
+
+int FrameReader::getPendingCount() const
+{
+	std::lock_guard<std::mutex> lock(_pendingMutex);
+	return _pending;
+}
+
+void FrameReader::setBufferCount(int count)
+{
+	_bufferCount = count < 1 ? 1 : (count > MAX_BUFFER_COUNT ? MAX_BUFFER_COUNT : count);
+}
+
+bool FrameReader::usePackBuffers()
+{
+#if FK_FRAMEREADER_USE_PBO
+	if (_packBuffers < 0)
+	{
+		//gl3stub fills the ES 3 entry points when the context is 3.0 or later
+		const char* version = (const char*)glGetString(GL_VERSION);
+		_packBuffers = version != nullptr && strstr(version, "OpenGL ES 3.") != nullptr
+				&& glMapBufferRange != nullptr && glFenceSync != nullptr ? 1 : 0;
+		FKLOG("flakor: FrameReader reads back %s", _packBuffers ? "through pixel pack buffers" : "with glReadPixels");
+	}
+	return _packBuffers == 1;
+#else
+	return false;
+#endif
+}
+
+unsigned int FrameReader::capture(int x, int y, int width, int height, const Callback& callback)
+{
+	if (width <= 0 || height <= 0)
+	{
+		return 0;
+	}
+	unsigned int frameId = _nextFrameId++;
+	if (_nextFrameId == 0)
+	{
+		_nextFrameId = 1;
+	}
+	size_t size = (size_t)width * height * 4;
+
+#if FK_FRAMEREADER_USE_PBO
+	if (usePackBuffers())
+	{
+		if ((int)_slots.size() != _bufferCount && _inFlight.empty())
+		{
+			releaseGLObjects(false);
+			_slots.resize(_bufferCount);
+		}
+
+		int index = -1;
+		for (size_t i = 0; i < _slots.size() && index < 0; ++i)
+		{
+			if (_slots[i].fence == nullptr)
+			{
+				index = (int)i;
+			}
+		}
+		if (index < 0)
+		{
+			//every buffer is in flight, the oldest has to be done first
+			index = _inFlight.front();
+			retire(&_slots[index]);
+		}
+
+		Slot& slot = _slots[index];
+		if (slot.buffer == 0)
+		{
+			glGenBuffers(1, &slot.buffer);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		if (slot.bufferSize < (GLsizeiptr)size)
+		{
+			glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+			slot.bufferSize = size;
+		}
+		//with a pack buffer bound the pointer is an offset, this returns at once
+		glReadPixels(x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		slot.frameId = frameId;
+		slot.width = width;
+		slot.height = height;
+		slot.callback = callback;
+		_inFlight.push_back(index);
+		return frameId;
+	}
+#endif
+
+	unsigned char* pixels = TexUtils::allocPixels(size);
+	glReadPixels(x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	dispatch(frameId, pixels, width, height, callback);
+	return frameId;
+}
+
+unsigned int FrameReader::capture(const Callback& callback)
+{
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	return capture(viewport[0], viewport[1], viewport[2], viewport[3], callback);
+}
+
+#if (FK_TARGET_PLATFORM != FK_PLATFORM_IOS)
+unsigned int FrameReader::captureToFile(const std::string& filename, bool isToRGB, bool fast)
+{
+	return capture([filename, isToRGB, fast](unsigned int frameId, Image* image) {
+		if (!image->saveToFile(filename, isToRGB, fast))
+		{
+			FKLOG("flakor: FrameReader could not save frame %u to %s", frameId, filename.c_str());
+		}
+	});
+}
+#endif
+
+void FrameReader::poll()
+{
+#if FK_FRAMEREADER_USE_PBO
+	//fences pass in the order they were put in, stop at the first that hasn't
+	while (!_inFlight.empty())
+	{
+		Slot& slot = _slots[_inFlight.front()];
+		GLenum status = glClientWaitSync((GLsync)slot.fence, 0, 0);
+		if (status == GL_TIMEOUT_EXPIRED)
+		{
+			break;
+		}
+		retire(&slot);
+	}
+#endif
+}
+
+void FrameReader::finish()
+{
+#if FK_FRAMEREADER_USE_PBO
+	while (!_inFlight.empty())
+	{
+		retire(&_slots[_inFlight.front()]);
+	}
+#endif
+}
+
+void FrameReader::retire(Slot* slot)
+{
+#if FK_FRAMEREADER_USE_PBO
+	int index = (int)(slot - &_slots[0]);
+	_inFlight.erase(std::find(_inFlight.begin(), _inFlight.end(), index));
+
+	GLsync fence = (GLsync)slot->fence;
+	slot->fence = nullptr;
+	GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, WAIT_STEP);
+	while (status == GL_TIMEOUT_EXPIRED)
+	{
+		status = glClientWaitSync(fence, 0, WAIT_STEP);
+	}
+	glDeleteSync(fence);
+
+	Callback callback;
+	callback.swap(slot->callback);
+	if (status == GL_WAIT_FAILED)
+	{
+		FKLOG("flakor: FrameReader lost frame %u, waiting for the GPU failed", slot->frameId);
+		return;
+	}
+
+	//the mapping only lives on the GL thread, copy out and let the worker do the rest
+	size_t size = (size_t)slot->width * slot->height * 4;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->buffer);
+	void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+	unsigned char* pixels = nullptr;
+	if (mapped != nullptr)
+	{
+		pixels = TexUtils::allocPixels(size);
+		memcpy(pixels, mapped, size);
+		//GL_FALSE means the store was lost while mapped (mode switch and the like)
+		if (glUnmapBuffer(GL_PIXEL_PACK_BUFFER) == GL_FALSE)
+		{
+			TexUtils::freePixels(pixels);
+			pixels = nullptr;
+		}
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	if (pixels == nullptr)
+	{
+		FKLOG("flakor: FrameReader lost frame %u, the pack buffer could not be mapped", slot->frameId);
+		return;
+	}
+	dispatch(slot->frameId, pixels, slot->width, slot->height, callback);
+#endif
+}
+
+void FrameReader::dispatch(unsigned int frameId, unsigned char* pixels, int width, int height, const Callback& callback)
+{
+	{
+		std::lock_guard<std::mutex> lock(_pendingMutex);
+		_pending++;
+	}
+	ThreadPool::getInstance()->enqueue([this, frameId, pixels, width, height, callback]() {
+		//GL reads bottom row first
+		size_t rowBytes = (size_t)width * 4;
+		std::vector<unsigned char> row(rowBytes);
+		for (int y = 0; y < height / 2; ++y)
+		{
+			unsigned char* top = pixels + y * rowBytes;
+			unsigned char* bottom = pixels + (height - 1 - y) * rowBytes;
+			memcpy(&row[0], top, rowBytes);
+			memcpy(top, bottom, rowBytes);
+			memcpy(bottom, &row[0], rowBytes);
+		}
+
+		Image* image = new Image();
+		image->_width = width;
+		image->_height = height;
+		image->_renderFormat = PixelFormat::RGBA8888;
+		image->_hasPremultipliedAlpha = false;
+		image->_dataLen = rowBytes * height;
+		image->_data = pixels;
+		image->_pooledData = true;
+		if (callback)
+		{
+			callback(frameId, image);
+		}
+		delete image;
+
+		//notified under the lock, so the destructor can't return before this does
+		std::lock_guard<std::mutex> lock(_pendingMutex);
+		_pending--;
+		_pendingDone.notify_all();
+	});
+}
+
+void FrameReader::releaseGLObjects(bool contextLost)
+{
+#if FK_FRAMEREADER_USE_PBO
+	for (size_t i = 0; i < _slots.size(); ++i)
+	{
+		Slot& slot = _slots[i];
+		if (!contextLost)
+		{
+			if (slot.fence != nullptr)
+			{
+				glDeleteSync((GLsync)slot.fence);
+			}
+			if (slot.buffer != 0)
+			{
+				glDeleteBuffers(1, &slot.buffer);
+			}
+		}
+		slot.buffer = 0;
+		slot.bufferSize = 0;
+		slot.fence = nullptr;
+		slot.callback = nullptr;
+	}
+	_inFlight.clear();
+#endif
+	//a new context may not have the same version
+	_packBuffers = -1;
+}
+
+FLAKOR_NS_END
@@ -0,0 +1,139 @@
+/**********************************************************
+ * Copyright (c) 2013-2015 Steve Hsu  All Rights Reserved.
+ *********************************************************/
+
+#ifndef _FK_FRAMEREADER_H_
+#define _FK_FRAMEREADER_H_
+
+#include "targetMacros.h"
+#include "core/opengl/GL.h"
+#include "core/opengl/texture/Image.h"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+FLAKOR_NS_BEGIN
+
+/**
+ * Reads the framebuffer back without stalling the render loop.
+ *
+ * On OpenGL ES 3 (through gl3stub) capture() starts a glReadPixels into
+ * one of a ring of pixel pack buffers and puts a fence after it. poll()
+ * maps the buffers whose fence has passed, a frame or two later, when the
+ * copy has long finished. Only when every buffer is still in flight does
+ * capture() wait for the oldest. On ES 2 there are no pack buffers and
+ * capture() reads straight away, which waits for the GPU.
+ *
+ * Flipping the rows, the callback and encoding run on ThreadPool workers.
+ *
+ * capture(), poll(), finish() and releaseGLObjects() must be called on
+ * the GL thread.
+ */
+class FrameReader
+{
+public:
+	/**
+	 * gets a captured frame on a worker thread: RGBA8888, top row first,
+	 * as drawn (not premultiplied again). The image is deleted once the
+	 * callback returns.
+	 */
+	typedef std::function<void(unsigned int frameId, Image* image)> Callback;
+
+	/** returns the shared reader, created on first use */
+	static FrameReader* getInstance();
+
+	/** deletes the shared reader, call with the GL context still current */
+	static void destroyInstance();
+
+	/**
+	 * number of pack buffers, 3 by default: a frame is mapped two frames
+	 * after it was read when poll() runs every frame. Takes effect once
+	 * nothing is in flight.
+	 */
+	void setBufferCount(int count);
+
+	/**
+	 * reads x, y, width, height of the bound framebuffer, in GL window
+	 * coordinates. Call after drawing the frame and before swapping.
+	 * @return the id the callback gets, 0 if nothing could be read
+	 */
+	unsigned int capture(int x, int y, int width, int height, const Callback& callback);
+
+	/** reads the whole viewport */
+	unsigned int capture(const Callback& callback);
+
+#if (FK_TARGET_PLATFORM != FK_PLATFORM_IOS)
+	/**
+	 * captures the viewport to a .png or .jpg file, see Image::saveToFile.
+	 * fast is the way to go for video capture.
+	 */
+	unsigned int captureToFile(const std::string& filename, bool isToRGB = true, bool fast = false);
+#endif
+
+	/** hands finished readbacks to the workers, call once a frame */
+	void poll();
+
+	/** waits for every readback in flight and hands it over */
+	void finish();
+
+	/**
+	 * readbacks handed to the workers whose callback hasn't returned yet.
+	 * Capture jobs that outrun the encoder can skip frames while it's high.
+	 */
+	int getPendingCount() const;
+
+	/**
+	 * forgets the buffers and fences after the context went away, the
+	 * frames in flight are lost. With the context still current they are
+	 * deleted instead.
+	 */
+	void releaseGLObjects(bool contextLost);
+
+protected:
+	struct Slot
+	{
+		Slot() : buffer(0), bufferSize(0), fence(nullptr), frameId(0), width(0), height(0) {}
+
+		GLuint buffer;
+		GLsizeiptr bufferSize;
+		void* fence;
+		unsigned int frameId;
+		int width;
+		int height;
+		Callback callback;
+	};
+
+	FrameReader();
+	~FrameReader();
+
+	bool usePackBuffers();
+	// maps slot's buffer, copies it out and frees the slot
+	void retire(Slot* slot);
+	// flips rows and calls back on a worker, takes pixels
+	void dispatch(unsigned int frameId, unsigned char* pixels, int width, int height, const Callback& callback);
+
+	std::vector<Slot> _slots;
+	// slots in the order they were read, oldest first
+	std::vector<int> _inFlight;
+	int _bufferCount;
+	unsigned int _nextFrameId;
+	// -1 unknown until the first capture, then 0 or 1
+	int _packBuffers;
+	// readbacks the workers haven't finished, the destructor waits for 0
+	int _pending;
+	mutable std::mutex _pendingMutex;
+	std::condition_variable _pendingDone;
+
+private:
+	FrameReader(const FrameReader&);
+	FrameReader& operator=(const FrameReader&);
+
+	static FrameReader* s_sharedReader;
+};
+
+FLAKOR_NS_END
+
+#endif
@@ -23,6 +23,8 @@
 #include "macros.h"
 #include "core/opengl/GLContext.h"
 #include "core/opengl/gl3stub.h"
+#include "core/opengl/GLUploader.h"
+#include "core/opengl/texture/TextureManager.h"
 
 #include <unistd.h>
 #include <string>
@@ -160,6 +162,11 @@ bool GLContext::InitEGLContext()
     }
 
     context_valid_ = true;
+
+    //Texture and buffer uploads on a thread of their own, sharing this context
+    GLUploader* uploader = GLUploader::getInstance();
+    if( uploader->isEnabled() )
+        uploader->start( display_, config_, context_ );
     return true;
 }
 
@@ -177,18 +184,28 @@ EGLint GLContext::Swap()
         }
         else if( err == EGL_CONTEXT_LOST || err == EGL_BAD_CONTEXT )
         {
-            //Context has been lost!!
+            //Context has been lost!! The uploader's context shared it
             context_valid_ = false;
+            GLUploader::getInstance()->contextLost();
             Terminate();
+            InitEGLSurface();
             InitEGLContext();
+            TextureManager::getInstance()->reloadTextures();
         }
         return err;
     }
+
+    //the frame is on screen, textures decoded in the background are
+    //uploaded for the next one, a few milliseconds' worth a frame
+    TextureManager::getInstance()->processUploads();
     return EGL_SUCCESS;
 }
 
 void GLContext::Terminate()
 {
+    //The uploads still queued are done while the context is current
+    GLUploader::getInstance()->stop();
+
     if( display_ != EGL_NO_DISPLAY )
     {
         eglMakeCurrent( display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
@@ -244,6 +261,7 @@ EGLint GLContext::Resume( ANativeWindow* window )
     {
         //Recreate context
         FKLOG( "Re-creating egl context" );
+        GLUploader::getInstance()->contextLost();
         InitEGLContext();
     }
     else
@@ -253,6 +271,8 @@ EGLint GLContext::Resume( ANativeWindow* window )
         InitEGLSurface();
         InitEGLContext();
     }
+    //Either way the textures went with the old context
+    TextureManager::getInstance()->reloadTextures();
 
     return err;
 
@@ -0,0 +1,346 @@
+/**********************************************************
+ * Copyright (c) 2013-2015 Steve Hsu  All Rights Reserved.
+ *********************************************************/
+
+#include "core/opengl/GLUploader.h"
+#include "core/opengl/GL.h"
+
+#include <string.h>
+
+#if (FK_TARGET_PLATFORM == FK_PLATFORM_ANDROID)
+#include "core/opengl/gl3stub.h"
+#define FK_GLUPLOADER_USE_EGL 1
+#else
+#define FK_GLUPLOADER_USE_EGL 0
+#endif
+
+FLAKOR_NS_BEGIN
+
+namespace
+{
+#if FK_GLUPLOADER_USE_EGL
+	// a blocking wait is done in steps of this many nanoseconds
+	static const GLuint64 WAIT_STEP = 100000000;
+#endif
+}
+
+GLUploader* GLUploader::s_sharedUploader = nullptr;
+
+GLUploader* GLUploader::getInstance()
+{
+	static std::mutex instanceMutex;
+	std::lock_guard<std::mutex> lock(instanceMutex);
+	if (s_sharedUploader == nullptr)
+	{
+		s_sharedUploader = new GLUploader();
+	}
+	return s_sharedUploader;
+}
+
+void GLUploader::destroyInstance()
+{
+	if (s_sharedUploader != nullptr)
+	{
+		s_sharedUploader->stop();
+		delete s_sharedUploader;
+		s_sharedUploader = nullptr;
+	}
+}
+
+GLUploader::GLUploader()
+: _uploading(0)
+, _stopping(false)
+, _enabled(false)
+, _running(false)
+, _started(-1)
+, _fences(false)
+#if FK_GLUPLOADER_USE_EGL
+, _display(EGL_NO_DISPLAY)
+, _context(EGL_NO_CONTEXT)
+, _surface(EGL_NO_SURFACE)
+#endif
+{
+}
+
+GLUploader::~GLUploader()
+{
+}
+
+#if FK_GLUPLOADER_USE_EGL
+bool GLUploader::start(EGLDisplay display, EGLConfig config, EGLContext renderContext)
+{
+	if (_running)
+	{
+		return true;
+	}
+
+	const EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+	EGLContext context = eglCreateContext(display, config, renderContext, contextAttribs);
+	if (context == EGL_NO_CONTEXT)
+	{
+		FKLOG("flakor: GLUploader could not create a shared context, EGL error 0x%x", eglGetError());
+		return false;
+	}
+
+	//nothing is drawn, any surface will do, none if the driver allows
+	EGLSurface surface = EGL_NO_SURFACE;
+	const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+	if (extensions == nullptr || strstr(extensions, "EGL_KHR_surfaceless_context") == nullptr)
+	{
+		const EGLint surfaceAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+		surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+		if (surface == EGL_NO_SURFACE)
+		{
+			FKLOG("flakor: GLUploader could not create a pbuffer, EGL error 0x%x", eglGetError());
+			eglDestroyContext(display, context);
+			return false;
+		}
+	}
+
+	_display = display;
+	_context = context;
+	_surface = surface;
+	_stopping = false;
+	_started = -1;
+	_thread = std::thread(&GLUploader::run, this);
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	_condition.wait(lock, [this]() { return _started >= 0; });
+	lock.unlock();
+	if (_started == 0)
+	{
+		_thread.join();
+		join(true);
+		FKLOG("flakor: GLUploader could not make its context current, uploading on the render thread");
+		return false;
+	}
+
+	_running = true;
+	FKLOG("flakor: GLUploader uploads on its own thread, handing over with %s", _fences ? "fences" : "glFinish");
+	return true;
+}
+#endif
+
+void GLUploader::run()
+{
+#if FK_GLUPLOADER_USE_EGL
+	bool current = eglMakeCurrent(_display, _surface, _surface, _context) == EGL_TRUE;
+	bool fences = false;
+	if (current)
+	{
+		//gl3stub fills the ES 3 entry points when the context is 3.0 or later
+		const char* version = (const char*)glGetString(GL_VERSION);
+		fences = version != nullptr && strstr(version, "OpenGL ES 3.") != nullptr && glFenceSync != nullptr;
+	}
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	_fences = fences;
+	_started = current ? 1 : 0;
+	_condition.notify_all();
+	if (!current)
+	{
+		return;
+	}
+
+	while (true)
+	{
+		_condition.wait(lock, [this]() { return _stopping || !_queue.empty(); });
+		if (_queue.empty())
+		{
+			break;
+		}
+		Task task = _queue.front();
+		_queue.pop_front();
+		_uploading++;
+		lock.unlock();
+
+		task.upload();
+		Finished finished;
+		finished.done = task.done;
+		finished.fence = nullptr;
+		if (fences)
+		{
+			//the render thread can't flush this context, the fence has to go out now
+			finished.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			glFlush();
+		}
+		else
+		{
+			glFinish();
+		}
+
+		lock.lock();
+		_uploading--;
+		_finished.push_back(finished);
+		_condition.notify_all();
+	}
+	lock.unlock();
+	eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+#endif
+}
+
+void GLUploader::join(bool dropQueued)
+{
+	std::vector<Done> dropped;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (dropQueued)
+		{
+			for (size_t i = 0; i < _queue.size(); ++i)
+			{
+				dropped.push_back(_queue[i].done);
+			}
+			_queue.clear();
+		}
+		_stopping = true;
+	}
+	_condition.notify_all();
+	if (_thread.joinable())
+	{
+		_thread.join();
+	}
+	_running = false;
+
+#if FK_GLUPLOADER_USE_EGL
+	if (_display != EGL_NO_DISPLAY)
+	{
+		if (_surface != EGL_NO_SURFACE)
+		{
+			eglDestroySurface(_display, _surface);
+		}
+		eglDestroyContext(_display, _context);
+	}
+	_display = EGL_NO_DISPLAY;
+	_context = EGL_NO_CONTEXT;
+	_surface = EGL_NO_SURFACE;
+#endif
+
+	for (size_t i = 0; i < dropped.size(); ++i)
+	{
+		if (dropped[i])
+		{
+			dropped[i](false);
+		}
+	}
+}
+
+void GLUploader::stop()
+{
+	if (!_running)
+	{
+		return;
+	}
+	//the uploader finishes the queue before its context goes
+	join(false);
+	deliver(true);
+}
+
+void GLUploader::contextLost()
+{
+	if (!_running)
+	{
+		return;
+	}
+	join(true);
+
+	//the fences died with the context, there is nothing to delete
+	std::vector<Finished> finished;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		finished.swap(_finished);
+	}
+	for (size_t i = 0; i < finished.size(); ++i)
+	{
+		if (finished[i].done)
+		{
+			finished[i].done(false);
+		}
+	}
+}
+
+bool GLUploader::post(const Upload& upload, const Done& done)
+{
+	if (!_running)
+	{
+		return false;
+	}
+	Task task;
+	task.upload = upload;
+	task.done = done;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_queue.push_back(task);
+	}
+	_condition.notify_all();
+	return true;
+}
+
+void GLUploader::deliver(bool wait)
+{
+	std::vector<Finished> finished;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		finished.swap(_finished);
+	}
+
+	//fences pass in the order they were put in, stop at the first that hasn't
+	std::vector<bool> uploaded(finished.size(), true);
+	size_t count = 0;
+	for (; count < finished.size(); ++count)
+	{
+#if FK_GLUPLOADER_USE_EGL
+		GLsync fence = (GLsync)finished[count].fence;
+		if (fence == nullptr)
+		{
+			continue;
+		}
+		GLenum status = glClientWaitSync(fence, 0, wait ? WAIT_STEP : 0);
+		while (wait && status == GL_TIMEOUT_EXPIRED)
+		{
+			status = glClientWaitSync(fence, 0, WAIT_STEP);
+		}
+		if (status == GL_TIMEOUT_EXPIRED)
+		{
+			break;
+		}
+		glDeleteSync(fence);
+		uploaded[count] = status != GL_WAIT_FAILED;
+#endif
+	}
+
+	if (count < finished.size())
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_finished.insert(_finished.begin(), finished.begin() + count, finished.end());
+	}
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (finished[i].done)
+		{
+			finished[i].done(uploaded[i]);
+		}
+	}
+}
+
+void GLUploader::poll()
+{
+	deliver(false);
+}
+
+void GLUploader::finish()
+{
+	if (_running)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_condition.wait(lock, [this]() { return _queue.empty() && _uploading == 0; });
+	}
+	deliver(true);
+}
+
+int GLUploader::getPendingCount()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return (int)(_queue.size() + _uploading + _finished.size());
+}
+
+FLAKOR_NS_END
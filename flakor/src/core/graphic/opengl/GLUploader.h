@@ -0,0 +1,157 @@
+/**********************************************************
+ * Copyright (c) 2013-2015 Steve Hsu  All Rights Reserved.
+ *********************************************************/
+
+#ifndef _FK_GLUPLOADER_H_
+#define _FK_GLUPLOADER_H_
+
+#include "targetMacros.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if (FK_TARGET_PLATFORM == FK_PLATFORM_ANDROID)
+#include <EGL/egl.h>
+#endif
+
+FLAKOR_NS_BEGIN
+
+/**
+ * Uploads textures and buffers on a thread of its own, so glTexImage2D
+ * and glBufferData don't hold up the render thread.
+ *
+ * The thread has an EGL context in the render context's share group.
+ * After each upload it puts a fence in (ES 3), or waits with glFinish
+ * (ES 2), and poll() on the render thread calls the upload's done
+ * callback once the fence has passed: from then on the render thread can
+ * bind what was uploaded. An object must not be used on the render
+ * thread before its done callback. TextureManager::processUploads polls
+ * it; on Android the GL view calls that after each swap.
+ *
+ * Optional: off until setEnabled(true), and only on Android. When it
+ * isn't running post() returns false and callers upload on the render
+ * thread as before. The GL view starts it with the render context and
+ * restarts it when the context is lost.
+ *
+ * Everything but the uploads runs on the render thread.
+ */
+class GLUploader
+{
+public:
+	/** runs on the uploader thread with its context current */
+	typedef std::function<void()> Upload;
+
+	/**
+	 * runs on the render thread once the upload is done on the GPU. false if
+	 * the context was lost first, what was uploaded is gone with it.
+	 */
+	typedef std::function<void(bool uploaded)> Done;
+
+	/** returns the shared uploader, created on first use */
+	static GLUploader* getInstance();
+
+	/** stops the thread and deletes the shared uploader */
+	static void destroyInstance();
+
+	/** whether the shared uploader was created, without creating it */
+	static bool hasInstance() { return s_sharedUploader != nullptr; }
+
+	/** whether the GL view should start the uploader, false by default */
+	void setEnabled(bool enabled) { _enabled = enabled; }
+	bool isEnabled() const { return _enabled; }
+
+#if (FK_TARGET_PLATFORM == FK_PLATFORM_ANDROID)
+	/**
+	 * starts the thread with a context sharing renderContext's objects,
+	 * called by the GL view with renderContext current.
+	 * @return false if EGL can't make the context or its surface
+	 */
+	bool start(EGLDisplay display, EGLConfig config, EGLContext renderContext);
+#endif
+
+	/** does the uploads posted, then ends the thread and its context */
+	void stop();
+
+	/**
+	 * the render context went away and the share group with it: the
+	 * uploads not done are called back with false and the thread ends.
+	 * Call before the render context is destroyed.
+	 */
+	void contextLost();
+
+	bool isRunning() const { return _running; }
+
+	/**
+	 * queues upload for the uploader thread, done follows on the render
+	 * thread from poll().
+	 * @return false if the uploader isn't running, nothing was queued
+	 */
+	bool post(const Upload& upload, const Done& done);
+
+	/** calls back the uploads the GPU has finished, once a frame */
+	void poll();
+
+	/** waits for every upload posted and calls them back */
+	void finish();
+
+	/** uploads posted and not called back yet */
+	int getPendingCount();
+
+protected:
+	struct Task
+	{
+		Upload upload;
+		Done done;
+	};
+
+	struct Finished
+	{
+		Done done;
+		// GLsync, nullptr when the uploader waited with glFinish
+		void* fence;
+	};
+
+	GLUploader();
+	~GLUploader();
+
+	// the thread: makes the context current and uploads until stopped
+	void run();
+	// ends the thread; the queued uploads are done first unless dropping
+	void join(bool dropQueued);
+	// calls back what has finished, waiting for the fences if wait
+	void deliver(bool wait);
+
+	std::thread _thread;
+	std::mutex _mutex;
+	std::condition_variable _condition;
+	std::deque<Task> _queue;
+	std::vector<Finished> _finished;
+	// uploads taken by the thread and not in _finished yet
+	int _uploading;
+	bool _stopping;
+	bool _enabled;
+	bool _running;
+	// -1 while the thread starts, then 1 if its context is current, 0 if not
+	int _started;
+	bool _fences;
+
+#if (FK_TARGET_PLATFORM == FK_PLATFORM_ANDROID)
+	EGLDisplay _display;
+	EGLContext _context;
+	EGLSurface _surface;
+#endif
+
+private:
+	GLUploader(const GLUploader&);
+	GLUploader& operator=(const GLUploader&);
+
+	static GLUploader* s_sharedUploader;
+};
+
+FLAKOR_NS_END
+
+#endif
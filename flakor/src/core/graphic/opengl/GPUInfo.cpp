@@ -23,6 +23,7 @@ THE SOFTWARE.
 ****************************************************************************/
 #include "targetMacros.h"
 #include "core/opengl/GL.h"
+#include "Config.h"
 #include "core/opengl/GPUInfo.h"
 
 FLAKOR_NS_BEGIN
@@ -36,8 +37,10 @@ GPUInfo::GPUInfo()
 , _maxModelviewStackDepth(0)
 , _supportsPVRTC(false)
 , _supportsETC1(false)
+, _supportsETC2(false)
 , _supportsS3TC(false)
 , _supportsATITC(false)
+, _supportsASTC(false)
 , _supportsNPOT(false)
 , _supportsBGRA8888(false)
 , _supportsDiscardFramebuffer(false)
@@ -119,12 +122,19 @@ void GPUInfo::gatherGPUInfo()
     
     _supportsETC1 = checkForGLExtension("GL_OES_compressed_ETC1_RGB8_texture");
     //_valueDict["gl.supports_ETC1"] = Value(_supportsETC1);
+
+    // ETC2 is part of OpenGL ES 3.0, desktop GL gets it with ES3 compatibility
+    const char* glVersion = (const char*)glGetString(GL_VERSION);
+    _supportsETC2 = (glVersion && strstr(glVersion, "OpenGL ES 3.") != nullptr)
+                    || checkForGLExtension("GL_ARB_ES3_compatibility");
     
     _supportsS3TC = checkForGLExtension("GL_EXT_texture_compression_s3tc");
     //_valueDict["gl.supports_S3TC"] = Value(_supportsS3TC);
     
     _supportsATITC = checkForGLExtension("GL_AMD_compressed_ATC_texture");
     //_valueDict["gl.supports_ATITC"] = Value(_supportsATITC);
+
+    _supportsASTC = checkForGLExtension("GL_KHR_texture_compression_astc_ldr");
     
     _supportsPVRTC = checkForGLExtension("GL_IMG_texture_compression_pvrtc");
 	//_valueDict["gl.supports_PVRTC"] = Value(_supportsPVRTC);
@@ -205,6 +215,15 @@ bool GPUInfo::supportsETC() const
 #endif
 }
 
+bool GPUInfo::supportsETC2() const
+{
+#ifdef GL_COMPRESSED_RGB8_ETC2
+    return _supportsETC2;
+#else
+    return false;
+#endif
+}
+
 bool GPUInfo::supportsS3TC() const
 {
     return _supportsS3TC;
@@ -215,6 +234,16 @@ bool GPUInfo::supportsATITC() const
     return _supportsATITC;
 }
 
+bool GPUInfo::supportsASTC() const
+{
+    //GL_COMPRESSED_RGBA_ASTC_4x4_KHR is not defined in old opengl headers
+#ifdef GL_COMPRESSED_RGBA_ASTC_4x4_KHR
+    return _supportsASTC;
+#else
+    return false;
+#endif
+}
+
 bool GPUInfo::supportsBGRA8888() const
 {
 	return _supportsBGRA8888;
@@ -227,7 +256,7 @@ bool GPUInfo::supportsDiscardFramebuffer() const
 
 bool GPUInfo::supportsShareableVAO() const
 {
-#if CC_TEXTURE_ATLAS_USE_VAO
+#if FK_TEXTURE_ATLAS_USE_VAO
     return _supportsShareableVAO;
 #else
     return false;
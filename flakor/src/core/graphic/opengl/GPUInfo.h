@@ -26,7 +26,11 @@ class  GPUInfo : public Object
 {
 public:
     
-    /** returns a shared instance of GPUInfo */
+    /**
+     * returns a shared instance of GPUInfo. The first call queries GL, so
+     * it must be made on the GL thread; other threads (the image decoders
+     * on ThreadPool workers) only read the values it cached.
+     */
     static GPUInfo *getInstance();
 
     /** purge the shared instance of GPUInfo */
@@ -59,12 +63,18 @@ public:
     
      /** Whether or not ETC Texture Compressed is supported */
     bool supportsETC() const;
+
+    /** Whether or not ETC2 / EAC Texture Compressed is supported (core in OpenGL ES 3.0) */
+    bool supportsETC2() const;
     
     /** Whether or  not S3TC Texture Compressed is supported */
     bool supportsS3TC() const;
     
     /** Whether or  not ATITC Texture Compressed is supported */
     bool supportsATITC() const;
+
+    /** Whether or not ASTC (LDR profile) Texture Compressed is supported */
+    bool supportsASTC() const;
     
     /** Whether or not BGRA8888 textures are supported.
      @since v0.99.2
@@ -121,8 +131,10 @@ protected:
     GLint           _maxModelviewStackDepth;
     bool            _supportsPVRTC;
     bool            _supportsETC1;
+    bool            _supportsETC2;
     bool            _supportsS3TC;
     bool            _supportsATITC;
+    bool            _supportsASTC;
     bool            _supportsNPOT;
     bool            _supportsBGRA8888;
     bool            _supportsDiscardFramebuffer;
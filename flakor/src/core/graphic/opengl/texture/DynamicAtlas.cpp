@@ -0,0 +1,364 @@
+/**********************************************************
+ * Copyright (c) 2013-2015 Steve Hsu  All Rights Reserved.
+ *********************************************************/
+
+#include "macros.h"
+#include "core/opengl/texture/DynamicAtlas.h"
+#include "core/opengl/texture/Image.h"
+#include "core/opengl/texture/TextureRegion.h"
+#include "tool/utility/TexUtils.h"
+
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+FLAKOR_NS_BEGIN
+
+DynamicAtlas::DynamicAtlas(int pageSize, PixelFormat format, int padding)
+: _pageSize(pageSize)
+, _format(format)
+, _padding(std::max(padding, 0))
+, _bytesPerPixel(TexUtils::getBytesPerPixel(format))
+{
+	FKAssert(_bytesPerPixel > 0, "DynamicAtlas pages need an uncompressed format");
+}
+
+DynamicAtlas::~DynamicAtlas()
+{
+	for (auto it = _entries.begin(); it != _entries.end(); ++it)
+	{
+		it->second.region->release();
+	}
+	for (size_t i = 0; i < _pages.size(); ++i)
+	{
+		_pages[i].texture->release();
+	}
+}
+
+TextureRegion* DynamicAtlas::addImage(const std::string& key, Image* image)
+{
+	if (image == nullptr)
+	{
+		return nullptr;
+	}
+	PixelFormat format = image->getRenderFormat();
+	if (TexUtils::getBytesPerPixel(format) == 0)
+	{
+		FKLOG("flakor: DynamicAtlas can't pack %s, its format is compressed", key.c_str());
+		return nullptr;
+	}
+
+	unsigned char* data = nullptr;
+	ssize_t dataLen = 0;
+	PixelFormat converted = TexUtils::convertDataToFormat(image->getData(), image->getDataLen(), format, _format,
+			&data, &dataLen, image->getWidth());
+	TextureRegion* region = nullptr;
+	if (converted == _format)
+	{
+		region = addData(key, data, _format, image->getWidth(), image->getHeight());
+	}
+	else
+	{
+		FKLOG("flakor: DynamicAtlas can't convert %s to the format of its pages", key.c_str());
+	}
+	if (data != image->getData())
+	{
+		free(data);
+	}
+	return region;
+}
+
+TextureRegion* DynamicAtlas::addData(const std::string& key, const void* data, PixelFormat format, int width, int height)
+{
+	auto found = _entries.find(key);
+	if (found != _entries.end())
+	{
+		return found->second.region;
+	}
+	if (data == nullptr || width <= 0 || height <= 0 || format != _format)
+	{
+		return nullptr;
+	}
+	if (std::min(width, height) + 2 * _padding > _pageSize || std::max(width, height) + 2 * _padding > _pageSize)
+	{
+		FKLOG("flakor: DynamicAtlas can't pack %s, %dx%d is larger than a page", key.c_str(), width, height);
+		return nullptr;
+	}
+
+	Entry entry;
+	entry.region = nullptr;
+	entry.page = -1;
+	entry.width = width;
+	entry.height = height;
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	entry.pixels.assign(bytes, bytes + (size_t)width * height * _bytesPerPixel);
+	if (!place(entry))
+	{
+		return nullptr;
+	}
+
+	Entry& stored = _entries[key];
+	stored.region = nullptr;
+	stored.page = entry.page;
+	stored.slot = entry.slot;
+	stored.width = width;
+	stored.height = height;
+	stored.pixels.swap(entry.pixels);
+	uploadGL(stored);
+	updateRegion(stored);
+	return stored.region;
+}
+
+TextureRegion* DynamicAtlas::findRegion(const std::string& key)
+{
+	auto found = _entries.find(key);
+	return found != _entries.end() ? found->second.region : nullptr;
+}
+
+bool DynamicAtlas::removeRegion(const std::string& key)
+{
+	auto found = _entries.find(key);
+	if (found == _entries.end())
+	{
+		return false;
+	}
+	Entry& entry = found->second;
+	Page& page = _pages[entry.page];
+	page.packer.remove(entry.slot);
+	page.regions--;
+	entry.region->release();
+	_entries.erase(found);
+	return true;
+}
+
+int DynamicAtlas::defragment()
+{
+	// the longer side first packs tightest
+	std::vector<Entry*> order;
+	order.reserve(_entries.size());
+	for (auto it = _entries.begin(); it != _entries.end(); ++it)
+	{
+		order.push_back(&it->second);
+	}
+	std::sort(order.begin(), order.end(), [](const Entry* a, const Entry* b) {
+		int la = std::max(a->width, a->height);
+		int lb = std::max(b->width, b->height);
+		return la != lb ? la > lb : a->width * a->height > b->width * b->height;
+	});
+
+	// packed into fresh packers first; the atlas changes only if every
+	// image fits, so no region is left pointing at space given away
+	std::vector<RectPacker> packers;
+	std::vector<int> pages(order.size());
+	std::vector<RectPacker::Slot> slots(order.size());
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		const Entry& entry = *order[i];
+		int width = entry.width + 2 * _padding;
+		int height = entry.height + 2 * _padding;
+		size_t page = 0;
+		for (; page < packers.size(); ++page)
+		{
+			if (packers[page].insert(width, height, &slots[i]))
+			{
+				break;
+			}
+		}
+		if (page == packers.size())
+		{
+			packers.push_back(RectPacker(_pageSize, _pageSize));
+			if (!packers.back().insert(width, height, &slots[i]))
+			{
+				return 0;
+			}
+		}
+		pages[i] = (int)page;
+	}
+	while (_pages.size() < packers.size())
+	{
+		if (addPage() < 0)
+		{
+			FKLOG("flakor: DynamicAtlas can't make a page, not defragmenting");
+			return 0;
+		}
+	}
+
+	for (size_t i = 0; i < _pages.size(); ++i)
+	{
+		_pages[i].packer = i < packers.size() ? packers[i] : RectPacker(_pageSize, _pageSize);
+		_pages[i].regions = 0;
+	}
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		Entry& entry = *order[i];
+		entry.page = pages[i];
+		entry.slot = slots[i];
+		_pages[entry.page].regions++;
+		uploadGL(entry);
+		updateRegion(entry);
+	}
+
+	// the pages left empty are the last ones, packing fills from the first
+	int released = 0;
+	while (!_pages.empty() && _pages.back().regions == 0)
+	{
+		_pages.back().texture->release();
+		_pages.pop_back();
+		released++;
+	}
+	return released;
+}
+
+void DynamicAtlas::reloadGL()
+{
+	for (size_t i = 0; i < _pages.size(); ++i)
+	{
+		_pages[i].texture->invalidateGL();
+		initPageGL(_pages[i]);
+	}
+	for (auto it = _entries.begin(); it != _entries.end(); ++it)
+	{
+		uploadGL(it->second);
+	}
+}
+
+Texture2D* DynamicAtlas::getPageTexture(int page) const
+{
+	if (page < 0 || page >= (int)_pages.size())
+	{
+		return nullptr;
+	}
+	return _pages[page].texture;
+}
+
+std::vector<AtlasPageStats> DynamicAtlas::getPageStats() const
+{
+	std::vector<AtlasPageStats> stats(_pages.size());
+	for (size_t i = 0; i < _pages.size(); ++i)
+	{
+		stats[i].width = _pages[i].packer.getWidth();
+		stats[i].height = _pages[i].packer.getHeight();
+		stats[i].regions = _pages[i].regions;
+		stats[i].occupancy = _pages[i].packer.getOccupancy();
+		stats[i].freeRects = _pages[i].packer.getFreeRectCount();
+	}
+	return stats;
+}
+
+float DynamicAtlas::getOccupancy() const
+{
+	if (_pages.empty())
+	{
+		return 0.0f;
+	}
+	double used = 0.0;
+	for (size_t i = 0; i < _pages.size(); ++i)
+	{
+		used += (double)_pages[i].packer.getUsedArea();
+	}
+	return (float)(used / ((double)_pageSize * _pageSize * _pages.size()));
+}
+
+void DynamicAtlas::logStats() const
+{
+	FKLOG("flakor: DynamicAtlas %d regions in %d pages of %dx%d, %.1f%% occupied",
+			(int)_entries.size(), (int)_pages.size(), _pageSize, _pageSize, getOccupancy() * 100.0f);
+	std::vector<AtlasPageStats> stats = getPageStats();
+	for (size_t i = 0; i < stats.size(); ++i)
+	{
+		FKLOG("flakor:   page %d: %d regions, %.1f%% occupied, %d free rects",
+				(int)i, stats[i].regions, stats[i].occupancy * 100.0f, stats[i].freeRects);
+	}
+}
+
+int DynamicAtlas::addPage()
+{
+	Page page;
+	page.texture = new Texture2D();
+	page.packer.reset(_pageSize, _pageSize);
+	page.regions = 0;
+	if (!initPageGL(page))
+	{
+		page.texture->release();
+		return -1;
+	}
+	_pages.push_back(page);
+	return (int)_pages.size() - 1;
+}
+
+bool DynamicAtlas::initPageGL(Page& page)
+{
+	// the texture copies the zeros when it uploads, they can go after loadGL
+	std::vector<unsigned char> zeros((size_t)_pageSize * _pageSize * _bytesPerPixel, 0);
+	Size size((float)_pageSize, (float)_pageSize);
+	if (!page.texture->initWithData(&zeros[0], (ssize_t)zeros.size(), _format, _pageSize, _pageSize, size))
+	{
+		return false;
+	}
+	page.texture->loadGL();
+	return page.texture->getTextureID() != 0;
+}
+
+bool DynamicAtlas::place(Entry& entry)
+{
+	int width = entry.width + 2 * _padding;
+	int height = entry.height + 2 * _padding;
+	for (size_t i = 0; i <= _pages.size(); ++i)
+	{
+		if (i == _pages.size() && addPage() < 0)
+		{
+			return false;
+		}
+		if (_pages[i].packer.insert(width, height, &entry.slot))
+		{
+			entry.page = (int)i;
+			_pages[i].regions++;
+			return true;
+		}
+	}
+	return false;
+}
+
+void DynamicAtlas::uploadGL(const Entry& entry)
+{
+	// the whole slot, so the padding is cleared of whatever was there before
+	const RectPacker::Slot& slot = entry.slot;
+	int bpp = _bytesPerPixel;
+	std::vector<unsigned char> block((size_t)slot.width * slot.height * bpp, 0);
+	int w = entry.width;
+	int h = entry.height;
+	for (int y = 0; y < (slot.rotated ? w : h); ++y)
+	{
+		unsigned char* row = &block[((size_t)(y + _padding) * slot.width + _padding) * bpp];
+		if (!slot.rotated)
+		{
+			memcpy(row, &entry.pixels[(size_t)y * w * bpp], (size_t)w * bpp);
+			continue;
+		}
+		// turned clockwise: row y is column y of the image, bottom to top
+		for (int x = 0; x < h; ++x)
+		{
+			memcpy(row + (size_t)x * bpp, &entry.pixels[((size_t)(h - 1 - x) * w + y) * bpp], bpp);
+		}
+	}
+	_pages[entry.page].texture->updateWithDataGL(&block[0], slot.x, slot.y, slot.width, slot.height);
+}
+
+void DynamicAtlas::updateRegion(Entry& entry)
+{
+	Texture2D* texture = _pages[entry.page].texture;
+	// the size of the image as it is, turned or not, like TexturePacker frames
+	Rect rect((float)(entry.slot.x + _padding), (float)(entry.slot.y + _padding), (float)entry.width, (float)entry.height);
+	if (entry.region == nullptr)
+	{
+		entry.region = TextureRegion::createWithTexture(texture, rect, entry.slot.rotated, PointZero,
+				Size((float)entry.width, (float)entry.height));
+		entry.region->retain();
+		return;
+	}
+	entry.region->setTexture(texture);
+	entry.region->setRectInPixels(rect);
+	entry.region->setRotated(entry.slot.rotated);
+}
+
+FLAKOR_NS_END
@@ -0,0 +1,149 @@
+/**********************************************************
+ * Copyright (c) 2013-2015 Steve Hsu  All Rights Reserved.
+ *********************************************************/
+
+#ifndef _FK_DYNAMICATLAS_H_
+#define _FK_DYNAMICATLAS_H_
+
+#include "targetMacros.h"
+#include "base/lang/Object.h"
+#include "core/opengl/texture/Texture2D.h"
+#include "tool/utility/RectPacker.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+FLAKOR_NS_BEGIN
+
+class Image;
+class TextureRegion;
+
+/** one page of a DynamicAtlas */
+struct AtlasPageStats
+{
+	int width;
+	int height;
+	int regions;
+	/** area of the regions and their padding over the page area, 0 to 1 */
+	float occupancy;
+	/** free rectangles the packer keeps, more means more split up */
+	int freeRects;
+};
+
+/**
+ * Packs small images into shared pages at run time, so sprites drawing
+ * many small textures draw from a few and batch into fewer draw calls.
+ *
+ * Each image added is copied into a page with Texture2D::updateWithDataGL
+ * where RectPacker finds room, turned by 90 degrees if that fits better,
+ * and comes back as a TextureRegion: the rect in pixels of the page and
+ * whether it is rotated (clockwise, as in TexturePacker sheets). A page
+ * is added when no page has room. Images are kept padding pixels apart,
+ * transparent, so filtering doesn't bleed one into the next.
+ *
+ * Removed images leave holes the packer fills when it can; defragment
+ * packs every image again, largest first, and frees the pages that end
+ * up empty. The regions handed out are moved in place, so sprites holding
+ * them follow. The atlas keeps a copy of every image for this and for
+ * reloadGL.
+ *
+ * Runs on the GL thread.
+ */
+class DynamicAtlas : public Object
+{
+public:
+	static const int DEFAULT_PAGE_SIZE = 1024;
+
+	/**
+	 * @param pageSize  width and height of the pages, at most the GPU's
+	 *                  maximum texture size
+	 * @param format    format of the pages, an uncompressed one. Images in
+	 *                  other formats are converted to it.
+	 * @param padding   transparent pixels around each image
+	 */
+	DynamicAtlas(int pageSize = DEFAULT_PAGE_SIZE, PixelFormat format = PixelFormat::RGBA8888, int padding = 1);
+	virtual ~DynamicAtlas();
+
+	/**
+	 * packs a decoded image under key. The atlas holds the region, retain
+	 * it to keep it past removeRegion.
+	 * @return the region already packed under key if there is one, nullptr
+	 *         if the image is compressed, can't be converted or is larger
+	 *         than a page
+	 */
+	TextureRegion* addImage(const std::string& key, Image* image);
+
+	/** packs width x height pixels in format, rows packed, see addImage */
+	TextureRegion* addData(const std::string& key, const void* data, PixelFormat format, int width, int height);
+
+	/** the region packed under key, nullptr if none */
+	TextureRegion* findRegion(const std::string& key);
+
+	/** frees the room of key's image, false if there was none */
+	bool removeRegion(const std::string& key);
+
+	/**
+	 * packs every image again, largest first, into as few pages as it takes,
+	 * and releases the rest. Nothing moves if a page it needs can't be made.
+	 * @return pages released
+	 */
+	int defragment();
+
+	/** makes the pages again and copies every image back, after the GL context was lost */
+	void reloadGL();
+
+	int getPageCount() const { return (int)_pages.size(); }
+	Texture2D* getPageTexture(int page) const;
+	int getPageSize() const { return _pageSize; }
+	PixelFormat getPixelFormat() const { return _format; }
+	int getRegionCount() const { return (int)_entries.size(); }
+
+	std::vector<AtlasPageStats> getPageStats() const;
+
+	/** used area over the area of every page, 0 to 1 */
+	float getOccupancy() const;
+
+	void logStats() const;
+
+protected:
+	struct Page
+	{
+		Texture2D* texture;
+		RectPacker packer;
+		int regions;
+	};
+
+	struct Entry
+	{
+		TextureRegion* region;
+		int page;
+		RectPacker::Slot slot;
+		int width;
+		int height;
+		// the image in the atlas format, unrotated, rows packed
+		std::vector<unsigned char> pixels;
+	};
+
+	// a new empty page, -1 if its texture can't be made
+	int addPage();
+	// makes the page's texture, cleared
+	bool initPageGL(Page& page);
+	// finds room for the entry, adding a page if none has it
+	bool place(Entry& entry);
+	// copies the entry into its slot, padding cleared
+	void uploadGL(const Entry& entry);
+	// points the region at the entry's page and slot
+	void updateRegion(Entry& entry);
+
+	int _pageSize;
+	PixelFormat _format;
+	int _padding;
+	int _bytesPerPixel;
+	std::vector<Page> _pages;
+	std::unordered_map<std::string, Entry> _entries;
+};
+
+FLAKOR_NS_END
+
+#endif
@@ -0,0 +1,195 @@
+/**********************************************************
+ * Copyright (c) 2013-2015 Steve Hsu  All Rights Reserved.
+ *********************************************************/
+
+#include "core/opengl/texture/ImageCodec.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+
+FLAKOR_NS_BEGIN
+
+ImageCodecRegistry* ImageCodecRegistry::s_sharedRegistry = nullptr;
+
+ImageCodecRegistry* ImageCodecRegistry::getInstance()
+{
+	static std::mutex instanceMutex;
+	std::lock_guard<std::mutex> lock(instanceMutex);
+	if (s_sharedRegistry == nullptr)
+	{
+		s_sharedRegistry = new ImageCodecRegistry();
+		Image::registerCodecs(s_sharedRegistry);
+	}
+	return s_sharedRegistry;
+}
+
+ImageCodecRegistry::ImageCodecRegistry()
+: _fallback(nullptr)
+{
+}
+
+void ImageCodecRegistry::registerCodec(const ImageCodec& codec)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	Entry* entry = new Entry();
+	static_cast<ImageCodec&>(*entry) = codec;
+	entry->decodes = 0;
+	entry->failures = 0;
+	entry->bytes = 0;
+	entry->nanoseconds = 0;
+	_entries.push_back(std::unique_ptr<Entry>(entry));
+
+	if (codec.signatures.empty())
+	{
+		_fallback = entry;
+		return;
+	}
+	for (size_t i = 0; i < codec.signatures.size(); ++i)
+	{
+		const ImageSignature& signature = codec.signatures[i];
+		std::vector<Entry*>& list = signature.offset == 0 && !signature.bytes.empty()
+				? _byFirstByte[(unsigned char)signature.bytes[0]] : _byOffset;
+		//a codec claiming the same first byte twice is tried once
+		if (std::find(list.begin(), list.end(), entry) == list.end())
+		{
+			list.push_back(entry);
+		}
+	}
+}
+
+bool ImageCodecRegistry::matches(const Entry* entry, const unsigned char* data, ssize_t dataLen)
+{
+	for (size_t i = 0; i < entry->signatures.size(); ++i)
+	{
+		const ImageSignature& signature = entry->signatures[i];
+		if ((size_t)dataLen >= signature.offset + signature.bytes.size()
+				&& memcmp(data + signature.offset, signature.bytes.data(), signature.bytes.size()) == 0)
+		{
+			return entry->probe == nullptr || entry->probe(data, dataLen);
+		}
+	}
+	return false;
+}
+
+const ImageCodec* ImageCodecRegistry::findCodec(const unsigned char* data, ssize_t dataLen)
+{
+	if (data == nullptr || dataLen <= 0)
+	{
+		return nullptr;
+	}
+	std::lock_guard<std::mutex> lock(_mutex);
+	const std::vector<Entry*>& candidates = _byFirstByte[data[0]];
+	for (size_t i = 0; i < candidates.size(); ++i)
+	{
+		if (matches(candidates[i], data, dataLen))
+		{
+			return candidates[i];
+		}
+	}
+	for (size_t i = 0; i < _byOffset.size(); ++i)
+	{
+		if (matches(_byOffset[i], data, dataLen))
+		{
+			return _byOffset[i];
+		}
+	}
+	return nullptr;
+}
+
+const ImageCodec* ImageCodecRegistry::findCodec(Image::Format format)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (size_t i = 0; i < _entries.size(); ++i)
+	{
+		if (_entries[i]->format == format)
+		{
+			return _entries[i].get();
+		}
+	}
+	return nullptr;
+}
+
+const ImageCodec* ImageCodecRegistry::getFallback()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _fallback;
+}
+
+bool ImageCodecRegistry::decode(const ImageCodec* codec, Image* image, const unsigned char* data, ssize_t dataLen)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	bool ok = codec->decode(image, data, dataLen);
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	record(codec, ok, dataLen, elapsed.count());
+	return ok;
+}
+
+void ImageCodecRegistry::record(const ImageCodec* codec, bool ok, size_t bytes, double seconds)
+{
+	//entries are never removed, the counters need no lock
+	Entry* entry = const_cast<Entry*>(static_cast<const Entry*>(codec));
+	entry->decodes++;
+	if (!ok)
+	{
+		entry->failures++;
+	}
+	entry->bytes += bytes;
+	entry->nanoseconds += (uint64_t)(seconds * 1e9);
+}
+
+std::vector<ImageCodecStats> ImageCodecRegistry::getStats()
+{
+	std::vector<ImageCodecStats> stats;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		for (size_t i = 0; i < _entries.size(); ++i)
+		{
+			const Entry* entry = _entries[i].get();
+			ImageCodecStats codecStats;
+			codecStats.name = entry->name;
+			codecStats.decodes = entry->decodes;
+			codecStats.failures = entry->failures;
+			codecStats.bytes = entry->bytes;
+			codecStats.seconds = entry->nanoseconds / 1e9;
+			stats.push_back(codecStats);
+		}
+	}
+	std::stable_sort(stats.begin(), stats.end(), [](const ImageCodecStats& a, const ImageCodecStats& b) {
+		return a.seconds > b.seconds;
+	});
+	return stats;
+}
+
+void ImageCodecRegistry::resetStats()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (size_t i = 0; i < _entries.size(); ++i)
+	{
+		Entry* entry = _entries[i].get();
+		entry->decodes = 0;
+		entry->failures = 0;
+		entry->bytes = 0;
+		entry->nanoseconds = 0;
+	}
+}
+
+void ImageCodecRegistry::logStats()
+{
+	std::vector<ImageCodecStats> stats = getStats();
+	for (size_t i = 0; i < stats.size(); ++i)
+	{
+		const ImageCodecStats& codecStats = stats[i];
+		if (codecStats.decodes == 0)
+		{
+			continue;
+		}
+		FKLOG("flakor: %-6s %6llu decodes (%llu failed), %8.1f ms, %6.2f ms each, %7.1f MB/s",
+				codecStats.name.c_str(), (unsigned long long)codecStats.decodes,
+				(unsigned long long)codecStats.failures, codecStats.seconds * 1e3,
+				codecStats.seconds * 1e3 / codecStats.decodes,
+				codecStats.seconds > 0 ? codecStats.bytes / codecStats.seconds / 1e6 : 0.0);
+	}
+}
+
+FLAKOR_NS_END
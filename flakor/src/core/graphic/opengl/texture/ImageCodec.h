@@ -0,0 +1,133 @@
+/**********************************************************
+ * Copyright (c) 2013-2015 Steve Hsu  All Rights Reserved.
+ *********************************************************/
+
+#ifndef _FK_IMAGECODEC_H_
+#define _FK_IMAGECODEC_H_
+
+#include "targetMacros.h"
+#include "core/opengl/texture/Image.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+FLAKOR_NS_BEGIN
+
+/** bytes a file has at offset, such as "\x89PNG" at 0 */
+struct ImageSignature
+{
+	size_t offset;
+	std::string bytes;
+};
+
+/**
+ * How Image recognizes and decodes one file format.
+ *
+ * decode fills the image the way the Image::initWith*Data functions do,
+ * an outside codec can go through Image::initWithRawData.
+ */
+struct ImageCodec
+{
+	typedef bool (*Probe)(const unsigned char* data, ssize_t dataLen);
+	typedef bool (*Decode)(Image* image, const unsigned char* data, ssize_t dataLen);
+
+	/** short name for logs and stats, such as "png" */
+	std::string name;
+	Image::Format format;
+	/** any of them marks the format, most codecs have one */
+	std::vector<ImageSignature> signatures;
+	/** optional, checks the header once a signature matched */
+	Probe probe;
+	Decode decode;
+	/** optional, takes the next piece of a file for Image::appendImageData */
+	Decode appendStream;
+};
+
+/** what one codec has cost since start or resetStats */
+struct ImageCodecStats
+{
+	std::string name;
+	uint64_t decodes;
+	uint64_t failures;
+	uint64_t bytes;
+	double seconds;
+};
+
+/**
+ * The codecs Image can load, found by file signature.
+ *
+ * Signatures at offset 0 are indexed by their first byte, so detecting a
+ * format is one table lookup and a memcmp or two instead of asking every
+ * decoder in turn. A codec without signatures is the fallback for data
+ * nothing else matches (TGA has no magic number).
+ *
+ * Decodes are counted and timed per codec, see getStats. Thread safe.
+ */
+class ImageCodecRegistry
+{
+public:
+	/** returns the shared registry with the built in codecs, created on first use */
+	static ImageCodecRegistry* getInstance();
+
+	/**
+	 * adds a codec. Signatures a codec registered earlier also claims are
+	 * tried in registration order, their probe picks between them.
+	 */
+	void registerCodec(const ImageCodec& codec);
+
+	/** the codec for data, nullptr if no signature matches */
+	const ImageCodec* findCodec(const unsigned char* data, ssize_t dataLen);
+
+	/** the codec registered for format, nullptr if there is none */
+	const ImageCodec* findCodec(Image::Format format);
+
+	/** codec for data that no signature matches, nullptr if there is none */
+	const ImageCodec* getFallback();
+
+	/** decode through codec, counted and timed */
+	bool decode(const ImageCodec* codec, Image* image, const unsigned char* data, ssize_t dataLen);
+
+	/** adds one decode to codec's stats, for decodes that run in pieces */
+	void record(const ImageCodec* codec, bool ok, size_t bytes, double seconds);
+
+	/** the stats of every codec, most time spent first */
+	std::vector<ImageCodecStats> getStats();
+	void resetStats();
+
+	/** logs getStats(), one line per codec that has decoded anything */
+	void logStats();
+
+protected:
+	struct Entry : public ImageCodec
+	{
+		std::atomic<uint64_t> decodes;
+		std::atomic<uint64_t> failures;
+		std::atomic<uint64_t> bytes;
+		std::atomic<uint64_t> nanoseconds;
+	};
+
+	ImageCodecRegistry();
+
+	bool matches(const Entry* entry, const unsigned char* data, ssize_t dataLen);
+
+	std::vector<std::unique_ptr<Entry> > _entries;
+	// entries with a signature at offset 0 starting with each byte
+	std::vector<Entry*> _byFirstByte[256];
+	// entries with a signature further in
+	std::vector<Entry*> _byOffset;
+	Entry* _fallback;
+	std::mutex _mutex;
+
+private:
+	ImageCodecRegistry(const ImageCodecRegistry&);
+	ImageCodecRegistry& operator=(const ImageCodecRegistry&);
+
+	static ImageCodecRegistry* s_sharedRegistry;
+};
+
+FLAKOR_NS_END
+
+#endif
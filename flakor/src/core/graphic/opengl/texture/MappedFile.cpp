@@ -0,0 +1,87 @@
+/**********************************************************
+ * Copyright (c) 2013-2015 Steve Hsu  All Rights Reserved.
+ *********************************************************/
+
+#include "core/opengl/texture/MappedFile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if FK_TARGET_PLATFORM == FK_PLATFORM_WIN32 || FK_TARGET_PLATFORM == FK_PLATFORM_WINRT || FK_TARGET_PLATFORM == FK_PLATFORM_WP8
+#define FK_MAPPEDFILE_USE_READ 1
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+FLAKOR_NS_BEGIN
+
+std::shared_ptr<MappedFile> MappedFile::create(const std::string& path)
+{
+#ifdef FK_MAPPEDFILE_USE_READ
+	//no mmap, read the file into the heap instead
+	FILE* fp = fopen(path.c_str(), "rb");
+	if (fp == nullptr)
+	{
+		return std::shared_ptr<MappedFile>();
+	}
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	unsigned char* data = size > 0 ? static_cast<unsigned char*>(malloc(size)) : nullptr;
+	if (data == nullptr || fread(data, 1, size, fp) != (size_t) size)
+	{
+		free(data);
+		fclose(fp);
+		return std::shared_ptr<MappedFile>();
+	}
+	fclose(fp);
+	return std::shared_ptr<MappedFile>(new MappedFile(data, size));
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return std::shared_ptr<MappedFile>();
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0)
+	{
+		close(fd);
+		return std::shared_ptr<MappedFile>();
+	}
+	void* address = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	//the mapping stays valid after the descriptor is closed
+	close(fd);
+	if (address == MAP_FAILED)
+	{
+		return std::shared_ptr<MappedFile>();
+	}
+	return std::shared_ptr<MappedFile>(new MappedFile(static_cast<unsigned char*>(address), st.st_size));
+#endif
+}
+
+void MappedFile::adviseSequential()
+{
+#ifndef FK_MAPPEDFILE_USE_READ
+	madvise(_data, _size, MADV_SEQUENTIAL);
+#endif
+}
+
+MappedFile::MappedFile(unsigned char* data, size_t size)
+: _data(data)
+, _size(size)
+{
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef FK_MAPPEDFILE_USE_READ
+	free(_data);
+#else
+	munmap(_data, _size);
+#endif
+}
+
+FLAKOR_NS_END
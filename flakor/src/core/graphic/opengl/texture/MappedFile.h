@@ -0,0 +1,53 @@
+/**********************************************************
+ * Copyright (c) 2013-2015 Steve Hsu  All Rights Reserved.
+ *********************************************************/
+
+#ifndef _FK_MAPPEDFILE_H_
+#define _FK_MAPPEDFILE_H_
+
+#include "targetMacros.h"
+
+#include <memory>
+#include <string>
+
+FLAKOR_NS_BEGIN
+
+/**
+ * Read only view of a whole file, memory mapped where the platform can.
+ *
+ * Image keeps one alive while its MipmapInfo entries point into the file,
+ * and Texture2D holds another reference until the levels are uploaded, so
+ * the pages are released as soon as both are done with them.
+ */
+class MappedFile
+{
+public:
+	/** maps path, returns an empty pointer if it can't be opened */
+	static std::shared_ptr<MappedFile> create(const std::string& path);
+
+	~MappedFile();
+
+	inline const unsigned char* getData() const { return _data; }
+	inline size_t getSize() const { return _size; }
+
+	/**
+	 * tells the system the file will be read front to back, so it reads
+	 * ahead of the reader instead of faulting page by page. Nothing to do
+	 * where the file was read whole.
+	 */
+	void adviseSequential();
+
+private:
+	MappedFile(unsigned char* data, size_t size);
+
+	// noncopyable
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	unsigned char* _data;
+	size_t _size;
+};
+
+FLAKOR_NS_END
+
+#endif
@@ -32,7 +32,50 @@ THE SOFTWARE.
 FLAKOR_NS_BEGIN
 
 static bool tgaLoadRLEImageData(unsigned char* Buffer, unsigned long bufSize, tImageTGA *info);
-void tgaFlipImage( tImageTGA *info );
+
+// Row y of the file in imageData. Images with the flipped bit stored top
+// down are written bottom up, so rows land in place and nothing is flipped
+// after decoding.
+static inline unsigned char* tgaRow(tImageTGA *info, int y)
+{
+    int mode = info->pixelDepth / 8;
+    int row = info->flipped ? info->height - 1 - y : y;
+    return info->imageData + (size_t)row * info->width * mode;
+}
+
+// TGA stores BGR(A), swap R and B of count pixels for mode 3 and 4
+static inline void tgaSwapRB(unsigned char* pixels, unsigned int count, unsigned int mode)
+{
+    if (mode < 3)
+    {
+        return;
+    }
+    for (unsigned char* end = pixels + count * mode; pixels < end; pixels += mode)
+    {
+        unsigned char aux = pixels[0];
+        pixels[0] = pixels[2];
+        pixels[2] = aux;
+    }
+}
+
+// repeats one pixel count times, doubling the filled part with each memcpy
+static inline void tgaFillRun(unsigned char* out, const unsigned char* pixel, unsigned int count, unsigned int mode)
+{
+    size_t total = (size_t)count * mode;
+    if (mode == 1)
+    {
+        memset(out, pixel[0], total);
+        return;
+    }
+    memcpy(out, pixel, mode);
+    size_t filled = mode;
+    while (filled < total)
+    {
+        size_t n = filled < total - filled ? filled : total - filled;
+        memcpy(out + filled, out, n);
+        filled += n;
+    }
+}
 
 // load the image header field from stream
 bool tgaLoadHeader(unsigned char* buffer, unsigned long bufSize, tImageTGA *info)
@@ -75,29 +118,19 @@ bool tgaLoadImageData(unsigned char *Buffer, unsigned long bufSize, tImageTGA *i
 
     do 
     {
-        int mode,total,i;
-        unsigned char aux;
         size_t step = (sizeof(unsigned char) + sizeof(signed short)) * 6;
 
         // mode equal the number of components for each pixel
-        mode = info->pixelDepth / 8;
-        // total is the number of unsigned chars we'll have to read
-        total = info->height * info->width * mode;
+        int mode = info->pixelDepth / 8;
+        size_t rowbytes = (size_t)info->width * mode;
 
-        size_t dataSize = sizeof(unsigned char) * total;
-        FK_BREAK_IF((step + dataSize) > bufSize);
-        memcpy(info->imageData, Buffer + step, dataSize);
-
-        // mode=3 or 4 implies that the image is RGB(A). However TGA
-        // stores it as BGR(A) so we'll have to swap R and B.
-        if (mode >= 3)
+        FK_BREAK_IF((step + rowbytes * info->height) > bufSize);
+        for (int y = 0; y < info->height; y++)
         {
-            for (i=0; i < total; i+= mode)
-            {
-                aux = info->imageData[i];
-                info->imageData[i] = info->imageData[i+2];
-                info->imageData[i+2] = aux;
-            }
+            unsigned char* row = tgaRow(info, y);
+            memcpy(row, Buffer + step, rowbytes);
+            tgaSwapRB(row, info->width, mode);
+            step += rowbytes;
         }
 
         ret = true;
@@ -108,90 +141,75 @@ bool tgaLoadImageData(unsigned char *Buffer, unsigned long bufSize, tImageTGA *i
 
 static bool tgaLoadRLEImageData(unsigned char* buffer, unsigned long bufSize, tImageTGA *info)
 {
-    unsigned int mode,total,i, index = 0;
-    unsigned char aux[4], runlength = 0;
-    unsigned int skip = 0, flag = 0;
     size_t step = (sizeof(unsigned char) + sizeof(signed short)) * 6;
 
     // mode equal the number of components for each pixel
-    mode = info->pixelDepth / 8;
-    // total is the number of unsigned chars we'll have to read
-    total = info->height * info->width;
+    unsigned int mode = info->pixelDepth / 8;
+    if (info->width <= 0 || info->height <= 0 || mode == 0 || mode > 4)
+    {
+        return false;
+    }
+    unsigned int width = info->width;
+    int y = 0;
+    unsigned int x = 0;
+    unsigned char* row = tgaRow(info, 0);
 
-    for( i = 0; i < total; i++ )
+    // packets may run on into the next row, each one is cut at the row ends
+    while (y < info->height)
     {
-        // if we have a run length pending, run it
-        if ( runlength != 0 )
+        // read in the packet header, the low 7 bits are the pixel count - 1
+        if (step >= bufSize)
         {
-            // we do, update the run length count
-            runlength--;
-            skip = (flag != 0);
+            return false;
         }
-        else
+        unsigned char header = buffer[step++];
+        unsigned int count = (header & 0x7f) + 1;
+        bool run = (header & 0x80) != 0;
+
+        // a run is one pixel repeated, a raw packet count pixels
+        size_t packetBytes = run ? mode : (size_t)count * mode;
+        if (step + packetBytes > bufSize)
         {
-            // otherwise, read in the run length token
-            FK_BREAK_IF((step + sizeof(unsigned char)) > bufSize);
-            memcpy(&runlength, buffer + step, sizeof(unsigned char));
-            step += sizeof(unsigned char);
-
-            // see if it's a RLE encoded sequence
-            flag = runlength & 0x80;
-            if ( flag )
-            {
-                runlength -= 128;
-            }
-            skip = 0;
+            return false;
         }
-
-        // do we need to skip reading this pixel?
-        if ( !skip )
+        unsigned char pixel[4];
+        if (run)
         {
-            // no, read in the pixel data
-            FK_BREAK_IF((step + sizeof(unsigned char) * mode) > bufSize);
-
-            memcpy(aux, buffer + step, sizeof(unsigned char) * mode);
-            step += sizeof(unsigned char) * mode;
+            memcpy(pixel, buffer + step, mode);
+            tgaSwapRB(pixel, 1, mode);
+        }
+        const unsigned char* src = buffer + step;
+        step += packetBytes;
 
-            // mode=3 or 4 implies that the image is RGB(A). However TGA
-            // stores it as BGR(A) so we'll have to swap R and B.
-            if ( mode >= 3 )
+        while (count > 0 && y < info->height)
+        {
+            unsigned int n = width - x < count ? width - x : count;
+            unsigned char* out = row + x * mode;
+            if (run)
             {
-                unsigned char tmp;
-
-                tmp = aux[0];
-                aux[0] = aux[2];
-                aux[2] = tmp;
+                tgaFillRun(out, pixel, n, mode);
+            }
+            else
+            {
+                memcpy(out, src, n * mode);
+                tgaSwapRB(out, n, mode);
+                src += n * mode;
+            }
+            count -= n;
+            x += n;
+            if (x == width)
+            {
+                x = 0;
+                if (++y < info->height)
+                {
+                    row = tgaRow(info, y);
+                }
             }
         }
-
-        // add the pixel to our image
-        memcpy(&info->imageData[index], aux, mode);
-        index += mode;
     }
     
     return true;
 }
-
-void tgaFlipImage( tImageTGA *info )
-{
-    // mode equal the number of components for each pixel
-    int mode = info->pixelDepth / 8;
-    int rowbytes = info->width*mode;
-    unsigned char *row = (unsigned char *)malloc(rowbytes);
-    int y;
-    
-    if (row == nullptr) return;
-    
-    for( y = 0; y < (info->height/2); y++ )
-    {
-        memcpy(row, &info->imageData[y*rowbytes],rowbytes);
-        memcpy(&info->imageData[y*rowbytes], &info->imageData[(info->height-(y+1))*rowbytes], rowbytes);
-        memcpy(&info->imageData[(info->height-(y+1))*rowbytes], row, rowbytes);
-    }
-    
-    free(row);
-    info->flipped = 0;
-}
     
 tImageTGA* tgaLoadBuffer(unsigned char* buffer, long size)
 {
@@ -256,15 +274,8 @@ tImageTGA* tgaLoadBuffer(unsigned char* buffer, long size)
             break;
         }
         info->status = TGA_OK;
-
-        if ( info->flipped )
-        {
-            tgaFlipImage( info );
-            if ( info->flipped )
-            {
-                info->status = TGA_ERROR_MEMORY;
-            }
-        }
+        // the rows were written in place
+        info->flipped = 0;
     } while(0);
 
     return info;
@@ -50,6 +50,8 @@ typedef struct sImageTGA {
     
     /** raw data */
     unsigned char *imageData;
+
+    /** top down origin bit of the header, the loader writes the rows in place and clears it */
     int flipped;
 } tImageTGA;
 
@@ -6,6 +6,9 @@
 #include "core/resource/Image.h"
 #include "tool/utility/TexUtils.h"
 
+#include <algorithm>
+#include <string.h>
+
 FLAKOR_NS_BEGIN
 
 namespace {
@@ -32,6 +35,12 @@ namespace {
 #ifdef GL_ETC1_RGB8_OES
         PixelFormatInfoMapValue(PixelFormat::ETC, PixelFormatInfo(GL_ETC1_RGB8_OES, 0xFFFFFFFF, 0xFFFFFFFF, 4, true, false)),
 #endif
+
+#ifdef GL_COMPRESSED_RGB8_ETC2
+        PixelFormatInfoMapValue(PixelFormat::ETC2_RGB, PixelFormatInfo(GL_COMPRESSED_RGB8_ETC2, 0xFFFFFFFF, 0xFFFFFFFF, 4, true, false)),
+        PixelFormatInfoMapValue(PixelFormat::ETC2_RGBA, PixelFormatInfo(GL_COMPRESSED_RGBA8_ETC2_EAC, 0xFFFFFFFF, 0xFFFFFFFF, 8, true, true)),
+        PixelFormatInfoMapValue(PixelFormat::ETC2_RGB_A1, PixelFormatInfo(GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2, 0xFFFFFFFF, 0xFFFFFFFF, 4, true, true)),
+#endif
         
 #ifdef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
         PixelFormatInfoMapValue(PixelFormat::S3TC_DXT1, PixelFormatInfo(GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 0xFFFFFFFF, 0xFFFFFFFF, 4, true, false)),
@@ -59,6 +68,24 @@ namespace {
         PixelFormatInfoMapValue(PixelFormat::ATC_INTERPOLATED_ALPHA, PixelFormatInfo(GL_ATC_RGBA_INTERPOLATED_ALPHA_AMD,
             0xFFFFFFFF, 0xFFFFFFFF, 8, true, false)),
 #endif
+
+        //bpp of ASTC is 128 bits per block rounded to an integer, at least 1
+#ifdef GL_COMPRESSED_RGBA_ASTC_4x4_KHR
+        PixelFormatInfoMapValue(PixelFormat::ASTC_4x4, PixelFormatInfo(GL_COMPRESSED_RGBA_ASTC_4x4_KHR, 0xFFFFFFFF, 0xFFFFFFFF, 8, true, true)),
+        PixelFormatInfoMapValue(PixelFormat::ASTC_5x4, PixelFormatInfo(GL_COMPRESSED_RGBA_ASTC_5x4_KHR, 0xFFFFFFFF, 0xFFFFFFFF, 6, true, true)),
+        PixelFormatInfoMapValue(PixelFormat::ASTC_5x5, PixelFormatInfo(GL_COMPRESSED_RGBA_ASTC_5x5_KHR, 0xFFFFFFFF, 0xFFFFFFFF, 5, true, true)),
+        PixelFormatInfoMapValue(PixelFormat::ASTC_6x5, PixelFormatInfo(GL_COMPRESSED_RGBA_ASTC_6x5_KHR, 0xFFFFFFFF, 0xFFFFFFFF, 4, true, true)),
+        PixelFormatInfoMapValue(PixelFormat::ASTC_6x6, PixelFormatInfo(GL_COMPRESSED_RGBA_ASTC_6x6_KHR, 0xFFFFFFFF, 0xFFFFFFFF, 4, true, true)),
+        PixelFormatInfoMapValue(PixelFormat::ASTC_8x5, PixelFormatInfo(GL_COMPRESSED_RGBA_ASTC_8x5_KHR, 0xFFFFFFFF, 0xFFFFFFFF, 3, true, true)),
+        PixelFormatInfoMapValue(PixelFormat::ASTC_8x6, PixelFormatInfo(GL_COMPRESSED_RGBA_ASTC_8x6_KHR, 0xFFFFFFFF, 0xFFFFFFFF, 3, true, true)),
+        PixelFormatInfoMapValue(PixelFormat::ASTC_8x8, PixelFormatInfo(GL_COMPRESSED_RGBA_ASTC_8x8_KHR, 0xFFFFFFFF, 0xFFFFFFFF, 2, true, true)),
+        PixelFormatInfoMapValue(PixelFormat::ASTC_10x5, PixelFormatInfo(GL_COMPRESSED_RGBA_ASTC_10x5_KHR, 0xFFFFFFFF, 0xFFFFFFFF, 3, true, true)),
+        PixelFormatInfoMapValue(PixelFormat::ASTC_10x6, PixelFormatInfo(GL_COMPRESSED_RGBA_ASTC_10x6_KHR, 0xFFFFFFFF, 0xFFFFFFFF, 2, true, true)),
+        PixelFormatInfoMapValue(PixelFormat::ASTC_10x8, PixelFormatInfo(GL_COMPRESSED_RGBA_ASTC_10x8_KHR, 0xFFFFFFFF, 0xFFFFFFFF, 2, true, true)),
+        PixelFormatInfoMapValue(PixelFormat::ASTC_10x10, PixelFormatInfo(GL_COMPRESSED_RGBA_ASTC_10x10_KHR, 0xFFFFFFFF, 0xFFFFFFFF, 1, true, true)),
+        PixelFormatInfoMapValue(PixelFormat::ASTC_12x10, PixelFormatInfo(GL_COMPRESSED_RGBA_ASTC_12x10_KHR, 0xFFFFFFFF, 0xFFFFFFFF, 1, true, true)),
+        PixelFormatInfoMapValue(PixelFormat::ASTC_12x12, PixelFormatInfo(GL_COMPRESSED_RGBA_ASTC_12x12_KHR, 0xFFFFFFFF, 0xFFFFFFFF, 1, true, true)),
+#endif
     };
 }
 
@@ -66,6 +93,12 @@ namespace {
 const PixelFormatInfoMap Texture2D::_pixelFormatInfoTables(TexturePixelFormatInfoTablesValue,
                                                                      TexturePixelFormatInfoTablesValue + sizeof(TexturePixelFormatInfoTablesValue) / sizeof(TexturePixelFormatInfoTablesValue[0]));
 
+// a block at the edge is stored whole, however little of it is used
+static size_t getBlockDataSize(int width, int height, int blockWidth, int blockHeight, int blockBytes)
+{
+    return (size_t)((width + blockWidth - 1) / blockWidth) * ((height + blockHeight - 1) / blockHeight) * blockBytes;
+}
+
 // If the image has alpha, you can create RGBA8 (32-bit) or RGBA4 (16-bit) or RGB5A1 (16-bit)
 // Default is: RGBA8888 (32-bit textures)
 static PixelFormat g_defaultAlphaPixelFormat = PixelFormat::DEFAULT;
@@ -84,6 +117,10 @@ Texture2D::Texture2D()
 , _paramDirty(false)
 , _dataDirty(false)
 , _clearDataAfterLoad(false)
+, _streamed(false)
+, _residentLevel(0)
+, _drawnWidth(0.0f)
+, _drawnHeight(0.0f)
 {
 	_texParams.minFilter = GL_LINEAR;
     _texParams.magFilter = GL_LINEAR;
@@ -104,6 +141,9 @@ bool Texture2D::initWithData(const void *data,ssize_t dataLen, PixelFormat pixel
 	FKAssert(dataLen>0 && width>0 && height>0, "Invalid size");
 
     //if data has no mipmaps, we will consider it has only one mipmap
+    _streamLevels.reset();
+    _streamData.clear();
+    _residentLevel = 0;
     _info = new MipmapInfo();
     _info->address = (unsigned char*)data;
     _info->len = static_cast<int>(dataLen);
@@ -149,6 +189,8 @@ bool Texture2D::initWithImage(Image *image, PixelFormat format)
     PixelFormat      renderFormat = image->getRenderFormat();
     size_t	         tempDataLen = image->getDataLen();
     _mipmapsNum = image->getNumberOfMipmaps();
+    // mapped KTX levels are uploaded straight from the file
+    _mappedFile = image->getMappedFile();
     
     if (_mipmapsNum > 1)
     {
@@ -159,6 +201,9 @@ bool Texture2D::initWithImage(Image *image, PixelFormat format)
         
         _pixelFormat = image->getRenderFormat();
         _info = image->getMipmaps();
+        _streamLevels.reset();
+        _streamData.clear();
+        _residentLevel = 0;
         _pixelsWidth = imageWidth;
         _pixelsHeight = imageHeight;
         _dataDirty = true;
@@ -180,7 +225,7 @@ bool Texture2D::initWithImage(Image *image, PixelFormat format)
         unsigned char* outTempData = nullptr;
         ssize_t outTempDataLen = 0;
         
-        pixelFormat = TexUtils::convertDataToFormat(tempData, tempDataLen, renderFormat, pixelFormat, &outTempData, &outTempDataLen);
+        pixelFormat = TexUtils::convertDataToFormat(tempData, tempDataLen, renderFormat, pixelFormat, &outTempData, &outTempDataLen, imageWidth);
         
         initWithData(outTempData, outTempDataLen, pixelFormat, imageWidth, imageHeight, imageSize);
         
@@ -275,6 +320,92 @@ bool Texture2D::hasMipmaps() const
     return _mipmapsNum != 1;
 }
 
+int Texture2D::getMipmapCount() const
+{
+    if (_mipmapsNum > 0)
+    {
+        return _mipmapsNum;
+    }
+    // generateMipmapGL made the full chain
+    int count = 1;
+    for (int size = MAX(_pixelsWidth, _pixelsHeight); size > 1; size >>= 1)
+    {
+        count++;
+    }
+    return count;
+}
+
+void Texture2D::setStreamed(bool streamed)
+{
+    _streamed = streamed;
+}
+
+int Texture2D::getInitialStreamLevel() const
+{
+    int level = 0;
+    int count = getMipmapCount();
+    while (level < count - 1 && MAX(_pixelsWidth >> level, _pixelsHeight >> level) > STREAM_INITIAL_SIZE)
+    {
+        level++;
+    }
+    return level;
+}
+
+size_t Texture2D::getLevelBytes(int firstLevel) const
+{
+    // the levels' own sizes where they are still known, a streamed texture
+    // keeps them; _info is the image's and goes with it once uploaded
+    const MipmapInfo* levels = _streamLevels ? _streamLevels.get() : (_dataDirty ? _info : NULL);
+    size_t bytes = 0;
+    for (int i = firstLevel; i < getMipmapCount(); ++i)
+    {
+        if (levels != NULL && i < _mipmapsNum)
+        {
+            bytes += levels[i].len;
+        }
+        else
+        {
+            bytes += getDataSize(_pixelFormat, MAX(_pixelsWidth >> i, 1), MAX(_pixelsHeight >> i, 1));
+        }
+    }
+    return bytes;
+}
+
+size_t Texture2D::getResidentBytes() const
+{
+    return getLevelBytes(_residentLevel);
+}
+
+size_t Texture2D::getFullBytes() const
+{
+    return getLevelBytes(0);
+}
+
+void Texture2D::reportDrawnSize(float width, float height)
+{
+    _drawnWidth = MAX(_drawnWidth, width);
+    _drawnHeight = MAX(_drawnHeight, height);
+}
+
+int Texture2D::takeWantedLevel()
+{
+    if (_drawnWidth <= 0 || _drawnHeight <= 0)
+    {
+        return -1;
+    }
+    // the smallest level still at least as large as drawn
+    int level = 0;
+    int count = getMipmapCount();
+    while (level < count - 1 && (_pixelsWidth >> (level + 1)) >= _drawnWidth
+           && (_pixelsHeight >> (level + 1)) >= _drawnHeight)
+    {
+        level++;
+    }
+    _drawnWidth = 0.0f;
+    _drawnHeight = 0.0f;
+    return level;
+}
+
 /*********************************
  * GL METHOD
  ********************************/
@@ -303,8 +434,10 @@ bool Texture2D::loadWithMipmapsGL(MipmapInfo* mipmaps, int mipmapsNum, PixelForm
 
     if (info.compressed && !GPUInfo::getInstance()->supportsPVRTC()
                         && !GPUInfo::getInstance()->supportsETC()
+                        && !GPUInfo::getInstance()->supportsETC2()
                         && !GPUInfo::getInstance()->supportsS3TC()
-                        && !GPUInfo::getInstance()->supportsATITC())
+                        && !GPUInfo::getInstance()->supportsATITC()
+                        && !GPUInfo::getInstance()->supportsASTC())
     {
         FKLOG("Flakor: WARNING: PVRTC/ETC images are not supported");
         return false;
@@ -391,9 +524,10 @@ bool Texture2D::loadWithMipmapsGL(MipmapInfo* mipmaps, int mipmapsNum, PixelForm
             glTexImage2D(GL_TEXTURE_2D, i, info.internalFormat, (GLsizei)width, (GLsizei)height, 0, info.format, info.type, data);
         }
 
-        if (i > 0 && (width != height || FK_NextPOT(width) != width ))
+        // NPOT levels (Image::generateMipmaps builds them) need NPOT mipmap support
+        if (i > 0 && (FK_NextPOT(width) != width || FK_NextPOT(height) != height) && !GPUInfo::getInstance()->supportsNPOT())
         {
-            FKLOG("Flakor: Texture2D. WARNING. Mipmap level %u is not squared. Texture won't render correctly. width=%d != height=%d", i, width, height);
+            FKLOG("Flakor: Texture2D. WARNING. Mipmap level %u is NPOT (%d x %d) and the GPU does not support NPOT. Texture won't render correctly.", i, width, height);
         }
 
         GLenum err = glGetError();
@@ -425,6 +559,8 @@ bool Texture2D::updateWithDataGL(const void *data,int offsetX,int offsetY,int wi
     {
         glBindTexture(GL_TEXTURE_2D,_textureID);
         const PixelFormatInfo& info = _pixelFormatInfoTables.at(_pixelFormat);
+        // rows are packed, whatever width and format the update has
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
         glTexSubImage2D(GL_TEXTURE_2D,0,offsetX,offsetY,width,height,info.format, info.type,data);
 
         return true;
@@ -454,8 +590,60 @@ void Texture2D::loadGL()
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, _texParams.wrapT );
     }
     
-    if (_dataDirty) {
-        loadWithMipmapsGL(_info, _mipmapsNum, _pixelFormat, _pixelsWidth, _pixelsHeight);
+    if (_dataDirty && _streamed && _mipmapsNum > 1 && _info != NULL)
+    {
+        // keep every level for setResidentLevelGL
+        _streamLevels.reset(new MipmapInfo[_mipmapsNum]);
+        if (_mappedFile)
+        {
+            // the levels stay in the mapping, paged in when they are uploaded
+            for (int i = 0; i < _mipmapsNum; ++i)
+            {
+                _streamLevels[i] = _info[i];
+            }
+        }
+        else
+        {
+            size_t total = 0;
+            for (int i = 0; i < _mipmapsNum; ++i)
+            {
+                total += _info[i].len;
+            }
+            _streamData.resize(total);
+            size_t offset = 0;
+            for (int i = 0; i < _mipmapsNum; ++i)
+            {
+                memcpy(&_streamData[offset], _info[i].address, _info[i].len);
+                _streamLevels[i].address = &_streamData[offset];
+                _streamLevels[i].len = _info[i].len;
+                offset += _info[i].len;
+            }
+        }
+
+        // the small levels first, drawing asks for more. -1 uploads even
+        // when a texture initialized again starts at the level it had
+        _residentLevel = -1;
+        if (setResidentLevelGL(getInitialStreamLevel()))
+        {
+            _dataDirty = false;
+            _info = NULL;
+        }
+        else
+        {
+            _residentLevel = 0;
+        }
+    }
+    else if (_dataDirty) {
+        if (loadWithMipmapsGL(_info, _mipmapsNum, _pixelFormat, _pixelsWidth, _pixelsHeight))
+        {
+            // the GL owns a copy now, the image can go
+            _dataDirty = false;
+            if (_mappedFile)
+            {
+                _mappedFile.reset();
+                _info = NULL;
+            }
+        }
     }
 }
 
@@ -469,6 +657,45 @@ void Texture2D::deleteGL()
 	_textureID = 0;
 }
 
+void Texture2D::invalidateGL()
+{
+	_textureID = 0;
+}
+
+bool Texture2D::setResidentLevelGL(int level)
+{
+    if (!_streamLevels)
+    {
+        return false;
+    }
+    level = std::max(0, std::min(level, _mipmapsNum - 1));
+    if (level == _residentLevel && _textureID != 0)
+    {
+        return true;
+    }
+
+    // loadWithMipmapsGL resets these for the size it uploads
+    bool premultipliedAlpha = _hasPremultipliedAlpha;
+    if (!loadWithMipmapsGL(&_streamLevels[level], _mipmapsNum - level, _pixelFormat,
+                           MAX(_pixelsWidth >> level, 1), MAX(_pixelsHeight >> level, 1)))
+    {
+        return false;
+    }
+    _contentSize = Size((float)_pixelsWidth, (float)_pixelsHeight);
+    _hasPremultipliedAlpha = premultipliedAlpha;
+    _residentLevel = level;
+
+    // the new name has the default parameters, the texture is still bound
+    if (_paramDirty)
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, _texParams.minFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, _texParams.magFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, _texParams.wrapS);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, _texParams.wrapT);
+    }
+    return true;
+}
+
 void Texture2D::bindGL()
 {
 	glActiveTexture(GL_TEXTURE0);
@@ -480,6 +707,67 @@ const PixelFormatInfoMap& Texture2D::getPixelFormatInfoMap()
     return _pixelFormatInfoTables;
 }
 
+size_t Texture2D::getDataSize(PixelFormat format, int width, int height)
+{
+    switch (format)
+    {
+        // PVRTC levels are never smaller than 2 x 2 blocks
+        case PixelFormat::PVRTC2:
+        case PixelFormat::PVRTC2A:
+            return (size_t)MAX(2, (width + 7) / 8) * MAX(2, (height + 3) / 4) * 8;
+        case PixelFormat::PVRTC4:
+        case PixelFormat::PVRTC4A:
+            return (size_t)MAX(2, (width + 3) / 4) * MAX(2, (height + 3) / 4) * 8;
+        case PixelFormat::ETC:
+        case PixelFormat::ETC2_RGB:
+        case PixelFormat::ETC2_RGB_A1:
+        case PixelFormat::S3TC_DXT1:
+        case PixelFormat::ATC_RGB:
+            return getBlockDataSize(width, height, 4, 4, 8);
+        case PixelFormat::ETC2_RGBA:
+        case PixelFormat::S3TC_DXT3:
+        case PixelFormat::S3TC_DXT5:
+        case PixelFormat::ATC_EXPLICIT_ALPHA:
+        case PixelFormat::ATC_INTERPOLATED_ALPHA:
+            return getBlockDataSize(width, height, 4, 4, 16);
+        // the bpp of the table is rounded, the blocks are 16 bytes
+        case PixelFormat::ASTC_4x4:
+            return getBlockDataSize(width, height, 4, 4, 16);
+        case PixelFormat::ASTC_5x4:
+            return getBlockDataSize(width, height, 5, 4, 16);
+        case PixelFormat::ASTC_5x5:
+            return getBlockDataSize(width, height, 5, 5, 16);
+        case PixelFormat::ASTC_6x5:
+            return getBlockDataSize(width, height, 6, 5, 16);
+        case PixelFormat::ASTC_6x6:
+            return getBlockDataSize(width, height, 6, 6, 16);
+        case PixelFormat::ASTC_8x5:
+            return getBlockDataSize(width, height, 8, 5, 16);
+        case PixelFormat::ASTC_8x6:
+            return getBlockDataSize(width, height, 8, 6, 16);
+        case PixelFormat::ASTC_8x8:
+            return getBlockDataSize(width, height, 8, 8, 16);
+        case PixelFormat::ASTC_10x5:
+            return getBlockDataSize(width, height, 10, 5, 16);
+        case PixelFormat::ASTC_10x6:
+            return getBlockDataSize(width, height, 10, 6, 16);
+        case PixelFormat::ASTC_10x8:
+            return getBlockDataSize(width, height, 10, 8, 16);
+        case PixelFormat::ASTC_10x10:
+            return getBlockDataSize(width, height, 10, 10, 16);
+        case PixelFormat::ASTC_12x10:
+            return getBlockDataSize(width, height, 12, 10, 16);
+        case PixelFormat::ASTC_12x12:
+            return getBlockDataSize(width, height, 12, 12, 16);
+        default:
+            break;
+    }
+
+    PixelFormatInfoMap::const_iterator info = _pixelFormatInfoTables.find(format);
+    int bpp = info != _pixelFormatInfoTables.end() ? info->second.bpp : 32;
+    return ((size_t)width * bpp + 7) / 8 * height;
+}
+
 
 FLAKOR_NS_END
 
@@ -2,6 +2,8 @@
 #define _FK_TEXTURE2D_H_
 
 #include <map>
+#include <memory>
+#include <vector>
 
 #include "base/lang/Object.h"
 #include "base/element/Element.h"
@@ -11,6 +13,7 @@ FLAKOR_NS_BEGIN
 
 class GLProgram;
 class Image;
+class MappedFile;
 
 
 /** @typedef Texture2D PixelFormat
@@ -47,6 +50,12 @@ typedef enum {
 	PVRTC2A,
 	//! ETC-compressed texture: ETC
 	ETC,
+	//! ETC2-compressed texture: ETC2_RGB
+	ETC2_RGB,
+	//! ETC2-compressed texture with EAC alpha: ETC2_RGBA
+	ETC2_RGBA,
+	//! ETC2-compressed texture with punch-through alpha: ETC2_RGB_A1
+	ETC2_RGB_A1,
 	//! S3TC-compressed texture: S3TC_Dxt1
 	S3TC_DXT1,
 	//! S3TC-compressed texture: S3TC_Dxt3
@@ -59,6 +68,34 @@ typedef enum {
 	ATC_EXPLICIT_ALPHA,
 	//! ATITC-compresed texture: ATC_INTERPOLATED_ALPHA
 	ATC_INTERPOLATED_ALPHA,
+	//! ASTC-compressed texture, 4x4 blocks: ASTC_4x4
+	ASTC_4x4,
+	//! ASTC-compressed texture, 5x4 blocks: ASTC_5x4
+	ASTC_5x4,
+	//! ASTC-compressed texture, 5x5 blocks: ASTC_5x5
+	ASTC_5x5,
+	//! ASTC-compressed texture, 6x5 blocks: ASTC_6x5
+	ASTC_6x5,
+	//! ASTC-compressed texture, 6x6 blocks: ASTC_6x6
+	ASTC_6x6,
+	//! ASTC-compressed texture, 8x5 blocks: ASTC_8x5
+	ASTC_8x5,
+	//! ASTC-compressed texture, 8x6 blocks: ASTC_8x6
+	ASTC_8x6,
+	//! ASTC-compressed texture, 8x8 blocks: ASTC_8x8
+	ASTC_8x8,
+	//! ASTC-compressed texture, 10x5 blocks: ASTC_10x5
+	ASTC_10x5,
+	//! ASTC-compressed texture, 10x6 blocks: ASTC_10x6
+	ASTC_10x6,
+	//! ASTC-compressed texture, 10x8 blocks: ASTC_10x8
+	ASTC_10x8,
+	//! ASTC-compressed texture, 10x10 blocks: ASTC_10x10
+	ASTC_10x10,
+	//! ASTC-compressed texture, 12x10 blocks: ASTC_12x10
+	ASTC_12x10,
+	//! ASTC-compressed texture, 12x12 blocks: ASTC_12x12
+	ASTC_12x12,
 	//! Default texture format: AUTO
 	DEFAULT = AUTO,
 
@@ -110,6 +147,18 @@ class Texture2D : public Object
     
         MipmapInfo *_info;
         int _mipmapsNum;
+        /** file _info points into, released once the levels are uploaded */
+        std::shared_ptr<MappedFile> _mappedFile;
+
+        /** every level of a streamed texture, pointing into _mappedFile or _streamData */
+        std::unique_ptr<MipmapInfo[]> _streamLevels;
+        std::vector<unsigned char> _streamData;
+        bool _streamed;
+        /** largest level in GPU memory, 0 is the full size */
+        int _residentLevel;
+        /** largest on-screen size reported since takeWantedLevel */
+        float _drawnWidth;
+        float _drawnHeight;
 
 		/** width in pixels */
 		int _pixelsWidth;
@@ -196,6 +245,47 @@ class Texture2D : public Object
         bool hasPremultipliedAlpha();
     
         bool hasMipmaps() const;
+
+        /** levels in the chain, 1 without mipmaps */
+        int getMipmapCount() const;
+
+        /**
+         Streams the levels of a mipmapped texture: loadGL keeps every level
+         (a KTX file stays mapped, other chains are copied) and uploads only
+         the levels up to STREAM_INITIAL_SIZE, setResidentLevelGL uploads more
+         or drops some later. Set before loadGL.
+         */
+        void setStreamed(bool streamed);
+        bool isStreamed() const { return _streamed; }
+
+        /** largest level in GPU memory, 0 is the full size */
+        int getResidentLevel() const { return _residentLevel; }
+
+        /** the largest level no bigger than STREAM_INITIAL_SIZE, where streaming starts */
+        int getInitialStreamLevel() const;
+
+        /** GPU memory of the resident levels */
+        size_t getResidentBytes() const;
+
+        /** GPU memory with every level resident */
+        size_t getFullBytes() const;
+
+        /** GPU memory of the levels from firstLevel down */
+        size_t getLevelBytes(int firstLevel) const;
+
+        /**
+         For the renderer: the texture was drawn width x height pixels on
+         screen. The largest size since takeWantedLevel counts.
+         */
+        void reportDrawnSize(float width, float height);
+
+        /**
+         the largest level that is sharp at the reported sizes, -1 if nothing
+         was reported. Clears the reports.
+         */
+        int takeWantedLevel();
+
+        static const int STREAM_INITIAL_SIZE = 128;
     
     GL_METHOD:
 
@@ -205,13 +295,23 @@ class Texture2D : public Object
 		void bindGL();
         void loadGL();
         /** Generates mipmap images for the texture.
-    	It only works if the texture size is POT (power of 2).
+    	It only works if the texture size is POT (power of 2). NPOT textures
+    	get their chain from Image::generateMipmaps before initWithImage.
     	*/
         void generateMipmapGL();
 		void deleteGL();
+		/** forgets the texture name after the GL context was lost, there is nothing to delete */
+		void invalidateGL();
+		/**
+		 uploads the levels from level down of a streamed texture and frees
+		 the larger ones, in a new texture name (ES2 has no base level)
+		 */
+		bool setResidentLevelGL(int level);
 
 	public:
 		static const PixelFormatInfoMap& getPixelFormatInfoMap();
+		/** bytes of a width x height level, block formats in whole blocks */
+		static size_t getDataSize(PixelFormat format, int width, int height);
 
 };
 
@@ -6,4 +6,317 @@
 //  Copyright (c) 2015 Saint Hsu. All rights reserved.
 //
 
+#include "macros.h"
 #include "TextureAtlas.h"
+#include "core/opengl/GLProgram.h"
+#include "core/opengl/GPUInfo.h"
+#include "core/opengl/texture/Texture2D.h"
+
+#include <algorithm>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+FLAKOR_NS_BEGIN
+
+const size_t TextureAtlas::DEFAULT_CAPACITY;
+const size_t TextureAtlas::MAX_QUADS;
+
+GLuint TextureAtlas::s_indexBuffer = 0;
+size_t TextureAtlas::s_indexQuads = 0;
+
+TextureAtlas* TextureAtlas::create(Texture2D* texture, size_t capacity)
+{
+    TextureAtlas* atlas = new TextureAtlas();
+    if (atlas != NULL && !atlas->initWithTexture(texture, capacity))
+    {
+        atlas->release();
+        return NULL;
+    }
+    return atlas;
+}
+
+TextureAtlas::TextureAtlas()
+: _totalQuads(0)
+, _capacity(0)
+, _texture(NULL)
+, _quads(NULL)
+, _dirty(false)
+, _vertexBuffer(0)
+, _vertexArray(0)
+{
+}
+
+TextureAtlas::~TextureAtlas()
+{
+    free(_quads);
+    if (_texture)
+    {
+        _texture->release();
+    }
+    deleteGL();
+}
+
+bool TextureAtlas::initWithTexture(Texture2D* texture, size_t capacity)
+{
+    setTexture(texture);
+    _totalQuads = 0;
+    return resizeCapacity(std::max(capacity, (size_t)1));
+}
+
+bool TextureAtlas::appendQuad(const V3F_C4B_T2F_Quad& quad)
+{
+    return appendQuads(&quad, 1);
+}
+
+bool TextureAtlas::appendQuads(const V3F_C4B_T2F_Quad* quads, size_t count)
+{
+    size_t total = _totalQuads + count;
+    if (total > MAX_QUADS)
+    {
+        FKLOG("flakor: TextureAtlas can't hold %d quads, %d at most", (int)total, (int)MAX_QUADS);
+        return false;
+    }
+    if (total > _capacity)
+    {
+        // twice the size, so a growing batch reallocates a few times
+        size_t capacity = std::max(_capacity, (size_t)1);
+        while (capacity < total)
+        {
+            capacity *= 2;
+        }
+        if (!resizeCapacity(std::min(capacity, MAX_QUADS)))
+        {
+            return false;
+        }
+    }
+    memcpy(&_quads[_totalQuads], quads, count * sizeof(V3F_C4B_T2F_Quad));
+    _totalQuads = total;
+    _dirty = true;
+    return true;
+}
+
+void TextureAtlas::updateQuad(const V3F_C4B_T2F_Quad& quad, size_t index)
+{
+    FKAssert(index < _totalQuads, "updateQuad: index out of range");
+    _quads[index] = quad;
+    _dirty = true;
+}
+
+void TextureAtlas::removeAllQuads()
+{
+    _totalQuads = 0;
+}
+
+bool TextureAtlas::resizeCapacity(size_t capacity)
+{
+    if (capacity > MAX_QUADS)
+    {
+        return false;
+    }
+    if (capacity == _capacity)
+    {
+        return true;
+    }
+    V3F_C4B_T2F_Quad* quads = (V3F_C4B_T2F_Quad*)realloc(_quads, std::max(capacity, (size_t)1) * sizeof(V3F_C4B_T2F_Quad));
+    if (quads == NULL)
+    {
+        FKLOG("flakor: TextureAtlas out of memory for %d quads", (int)capacity);
+        return false;
+    }
+    _quads = quads;
+    _capacity = capacity;
+    _totalQuads = std::min(_totalQuads, _capacity);
+    _dirty = true;
+    return true;
+}
+
+V3F_C4B_T2F_Quad* TextureAtlas::getQuads()
+{
+    _dirty = true;
+    return _quads;
+}
+
+void TextureAtlas::setTexture(Texture2D* texture)
+{
+    if (texture != _texture)
+    {
+        if (texture)
+        {
+            texture->retain();
+        }
+        if (_texture)
+        {
+            _texture->release();
+        }
+        _texture = texture;
+    }
+}
+
+void TextureAtlas::drawQuadsGL()
+{
+    drawNumberOfQuadsGL(_totalQuads, 0);
+}
+
+void TextureAtlas::drawNumberOfQuadsGL(size_t count, size_t start)
+{
+    if (count == 0 || start >= _totalQuads || _texture == NULL)
+    {
+        return;
+    }
+    count = std::min(count, _totalQuads - start);
+
+    if (_vertexBuffer == 0)
+    {
+        setupGL();
+    }
+    _texture->bindGL();
+
+#if FK_TEXTURE_ATLAS_USE_VAO
+    if (_vertexArray != 0)
+    {
+        glBindVertexArray(_vertexArray);
+    }
+#endif
+
+    glBindBuffer(GL_ARRAY_BUFFER, _vertexBuffer);
+    if (_dirty)
+    {
+        // a new store for the whole capacity, so the draw still reading the
+        // last frame's doesn't stall the upload
+        glBufferData(GL_ARRAY_BUFFER, sizeof(V3F_C4B_T2F_Quad) * _capacity, NULL, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(V3F_C4B_T2F_Quad) * _totalQuads, _quads);
+        _dirty = false;
+    }
+    if (_vertexArray == 0)
+    {
+        setupAttributesGL();
+    }
+    bindIndicesGL(start + count);
+
+#if FK_TEXTURE_ATLAS_USE_TRIANGLE_STRIP
+    glDrawElements(GL_TRIANGLE_STRIP, (GLsizei)count * 6, GL_UNSIGNED_SHORT, (GLvoid*)(start * 6 * sizeof(GLushort)));
+#else
+    glDrawElements(GL_TRIANGLES, (GLsizei)count * 6, GL_UNSIGNED_SHORT, (GLvoid*)(start * 6 * sizeof(GLushort)));
+#endif
+
+#if FK_TEXTURE_ATLAS_USE_VAO
+    if (_vertexArray != 0)
+    {
+        // later element buffer binds must not land in this array
+        glBindVertexArray(0);
+    }
+#endif
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void TextureAtlas::deleteGL()
+{
+    if (_vertexBuffer)
+    {
+        glDeleteBuffers(1, &_vertexBuffer);
+    }
+#if FK_TEXTURE_ATLAS_USE_VAO
+    if (_vertexArray)
+    {
+        glDeleteVertexArrays(1, &_vertexArray);
+    }
+#endif
+    _vertexBuffer = 0;
+    _vertexArray = 0;
+    _dirty = true;
+}
+
+void TextureAtlas::invalidateGL()
+{
+    _vertexBuffer = 0;
+    _vertexArray = 0;
+    _dirty = true;
+    s_indexBuffer = 0;
+    s_indexQuads = 0;
+}
+
+void TextureAtlas::setupGL()
+{
+    glGenBuffers(1, &_vertexBuffer);
+    _dirty = true;
+
+#if FK_TEXTURE_ATLAS_USE_VAO
+    if (GPUInfo::getInstance()->supportsShareableVAO())
+    {
+        // the array keeps the attributes and the index buffer binding
+        glGenVertexArrays(1, &_vertexArray);
+        glBindVertexArray(_vertexArray);
+        glBindBuffer(GL_ARRAY_BUFFER, _vertexBuffer);
+        setupAttributesGL();
+        bindIndicesGL(std::max(_capacity, DEFAULT_CAPACITY));
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+#endif
+}
+
+void TextureAtlas::setupAttributesGL()
+{
+    const GLsizei stride = sizeof(V3F_C4B_T2F);
+    glEnableVertexAttribArray(GLProgram::VERTEX_ATTRIB_POSITION);
+    glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, stride,
+                          (GLvoid*)offsetof(V3F_C4B_T2F, vertices));
+    glEnableVertexAttribArray(GLProgram::VERTEX_ATTRIB_COLOR);
+    glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                          (GLvoid*)offsetof(V3F_C4B_T2F, colors));
+    glEnableVertexAttribArray(GLProgram::VERTEX_ATTRIB_TEX_COORD);
+    glVertexAttribPointer(GLProgram::VERTEX_ATTRIB_TEX_COORD, 2, GL_FLOAT, GL_FALSE, stride,
+                          (GLvoid*)offsetof(V3F_C4B_T2F, texCoords));
+}
+
+void TextureAtlas::bindIndicesGL(size_t quads)
+{
+    if (s_indexBuffer == 0)
+    {
+        glGenBuffers(1, &s_indexBuffer);
+        s_indexQuads = 0;
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, s_indexBuffer);
+    if (quads <= s_indexQuads)
+    {
+        return;
+    }
+
+    // grown in powers of two and kept, the same name so vertex arrays
+    // holding it see the new store
+    size_t count = DEFAULT_CAPACITY;
+    while (count < quads)
+    {
+        count *= 2;
+    }
+    count = std::min(count, MAX_QUADS);
+
+    std::vector<GLushort> indices(count * 6);
+    for (size_t i = 0; i < count; ++i)
+    {
+        GLushort vertex = (GLushort)(i * 4);
+#if FK_TEXTURE_ATLAS_USE_TRIANGLE_STRIP
+        // tl tl tr bl br br: the doubled ends join the quads with degenerate triangles
+        indices[i * 6 + 0] = vertex;
+        indices[i * 6 + 1] = vertex;
+        indices[i * 6 + 2] = vertex + 2;
+        indices[i * 6 + 3] = vertex + 1;
+        indices[i * 6 + 4] = vertex + 3;
+        indices[i * 6 + 5] = vertex + 3;
+#else
+        // tl bl tr, br tr bl
+        indices[i * 6 + 0] = vertex;
+        indices[i * 6 + 1] = vertex + 1;
+        indices[i * 6 + 2] = vertex + 2;
+        indices[i * 6 + 3] = vertex + 3;
+        indices[i * 6 + 4] = vertex + 2;
+        indices[i * 6 + 5] = vertex + 1;
+#endif
+    }
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * indices.size(), &indices[0], GL_STATIC_DRAW);
+    s_indexQuads = count;
+}
+
+FLAKOR_NS_END
@@ -10,18 +10,103 @@
 #define _FK_TEXTUREATLATS_
 
 #include "base/lang/Object.h"
+#include "base/element/Element.h"
+#include "core/opengl/GL.h"
+#include "Config.h"
 
 FLAKOR_NS_BEGIN
 
 class Texture2D;
 
+/**
+ * Quads of one texture, drawn in a single call.
+ *
+ * Quads are appended each frame (or kept and updated), the array grows to
+ * twice its capacity when full. drawQuadsGL uploads the quads if they
+ * changed and draws them with one glDrawElements.
+ *
+ * The indices are the same for every atlas, quad i is vertices 4i to
+ * 4i + 3, so all atlases share one static GLushort index buffer, grown to
+ * the largest atlas drawn. GLushort indices reach 65536 vertices, which
+ * caps an atlas at MAX_QUADS.
+ *
+ * FK_TEXTURE_ATLAS_USE_VAO (Config.h) keeps the vertex layout in a vertex
+ * array object where the GPU has them, FK_TEXTURE_ATLAS_USE_TRIANGLE_STRIP
+ * draws one strip joined by degenerate triangles instead of triangles.
+ *
+ * The caller uses the shader (position, color and texture coordinates)
+ * before drawing.
+ */
 class TextureAtlas : public Object
 {
 public:
+    /** quads a new atlas has room for */
+    static const size_t DEFAULT_CAPACITY = 64;
+    /** quads GLushort indices can address */
+    static const size_t MAX_QUADS = 65536 / 4;
+
+    static TextureAtlas* create(Texture2D* texture, size_t capacity = DEFAULT_CAPACITY);
+
     TextureAtlas();
     ~TextureAtlas();
-    
+
+    bool initWithTexture(Texture2D* texture, size_t capacity = DEFAULT_CAPACITY);
+
+    /**
+     * adds a quad after the others, growing the capacity when full.
+     * @return false past MAX_QUADS, the quad isn't added
+     */
+    bool appendQuad(const V3F_C4B_T2F_Quad& quad);
+
+    /** adds count quads, false if they don't all fit under MAX_QUADS */
+    bool appendQuads(const V3F_C4B_T2F_Quad* quads, size_t count);
+
+    /** replaces the quad at index, which must be below getTotalQuads */
+    void updateQuad(const V3F_C4B_T2F_Quad& quad, size_t index);
+
+    /** empties the atlas, keeping its capacity, at the start of a frame */
+    void removeAllQuads();
+
+    /**
+     * room for capacity quads, at most MAX_QUADS. Quads past a smaller
+     * capacity are dropped.
+     */
+    bool resizeCapacity(size_t capacity);
+
+    size_t getTotalQuads() const { return _totalQuads; }
+    size_t getCapacity() const { return _capacity; }
+
+    /** the quads, to change in place; marks them for upload */
+    V3F_C4B_T2F_Quad* getQuads();
+
+    Texture2D* getTexture() const { return _texture; }
+    /** the texture is retained */
+    void setTexture(Texture2D* texture);
+
+GL_METHOD:
+    /** draws every quad in one call */
+    void drawQuadsGL();
+
+    /** draws count quads from start in one call */
+    void drawNumberOfQuadsGL(size_t count, size_t start = 0);
+
+    /** deletes the vertex buffer and array */
+    void deleteGL();
+
+    /**
+     * forgets the GL objects after the GL context was lost, there is
+     * nothing to delete. The shared index buffer is forgotten too.
+     */
+    void invalidateGL();
+
 protected:
+    // makes the vertex buffer, and the vertex array if used
+    void setupGL();
+    // points the attributes at the vertex buffer, which is bound
+    void setupAttributesGL();
+    // binds the shared index buffer, growing it to quads
+    static void bindIndicesGL(size_t quads);
+
     /** quantity of quads that are going to be drawn */
     size_t _totalQuads;
     /** quantity of quads that can be stored with the current texture atlas size */
@@ -30,7 +115,16 @@ protected:
     Texture2D* _texture;
     /** Quads that are going to be rendered */
     V3F_C4B_T2F_Quad* _quads;
-    
+
+    /** the quads changed since they were uploaded */
+    bool _dirty;
+    GLuint _vertexBuffer;
+    /** 0 when the vertex layout is set on each draw */
+    GLuint _vertexArray;
+
+    static GLuint s_indexBuffer;
+    /** quads s_indexBuffer has indices for */
+    static size_t s_indexQuads;
 };
 
 
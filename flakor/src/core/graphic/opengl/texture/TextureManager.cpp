@@ -0,0 +1,899 @@
+/**********************************************************
+ * Copyright (c) 2013-2015 Steve Hsu  All Rights Reserved.
+ *********************************************************/
+
+#include "core/opengl/texture/TextureManager.h"
+#include "core/opengl/texture/Image.h"
+#include "core/opengl/GLUploader.h"
+#include "core/opengl/GPUInfo.h"
+#include "base/lang/ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+
+FLAKOR_NS_BEGIN
+
+namespace
+{
+	static const char ASSET_SCHEME[] = "asset://";
+	static const size_t ASSET_SCHEME_LENGTH = sizeof(ASSET_SCHEME) - 1;
+	static const float DEFAULT_UPLOAD_BUDGET = 4.0f;
+	// a texture drawn smaller than resident for this many frames drops levels
+	static const int SMALLER_FRAMES = 30;
+	// one not drawn for this many frames goes back to its initial level
+	static const int IDLE_FRAMES = 300;
+}
+
+TextureManager* TextureManager::s_sharedManager = nullptr;
+
+TextureManager* TextureManager::getInstance()
+{
+	static std::mutex instanceMutex;
+	std::lock_guard<std::mutex> lock(instanceMutex);
+	if (s_sharedManager == nullptr)
+	{
+		s_sharedManager = new TextureManager();
+	}
+	return s_sharedManager;
+}
+
+void TextureManager::destroyInstance()
+{
+	delete s_sharedManager;
+	s_sharedManager = nullptr;
+}
+
+TextureManager::TextureManager()
+: _budget(DEFAULT_BUDGET)
+, _bytes(0)
+, _peakBytes(0)
+, _hits(0)
+, _misses(0)
+, _evictions(0)
+, _failures(0)
+, _decodeJobs(0)
+, _nextLoadId(1)
+, _uploadBudget(DEFAULT_UPLOAD_BUDGET)
+, _streaming(false)
+, _levelsRaised(0)
+, _levelsDropped(0)
+{
+}
+
+TextureManager::~TextureManager()
+{
+	cancelAllLoads();
+	//the uploads in flight call back into the cache, there are none if
+	//the uploader was never made
+	if (GLUploader::hasInstance())
+	{
+		GLUploader::getInstance()->finish();
+	}
+	//the jobs still queued run, find nothing and return
+	{
+		std::unique_lock<std::mutex> lock(_loadMutex);
+		_decodeDone.wait(lock, [this]() { return _decodeJobs == 0; });
+	}
+
+	for (auto it = _textures.begin(); it != _textures.end(); ++it)
+	{
+		if (it->second.references > 0)
+		{
+			FKLOG("flakor: TextureManager releases %s, still referenced %d times", it->first.c_str(),
+					it->second.references);
+		}
+		it->second.texture->release();
+	}
+}
+
+std::string TextureManager::resolvePath(const std::string& path) const
+{
+	std::string full = path.compare(0, ASSET_SCHEME_LENGTH, ASSET_SCHEME) == 0
+			? _assetRoot + path.substr(ASSET_SCHEME_LENGTH) : path;
+	//other schemes ("bundle://") are kept as they are
+	std::string scheme;
+	size_t schemeEnd = full.find("://");
+	if (schemeEnd != std::string::npos && full.find('/') > schemeEnd)
+	{
+		scheme = full.substr(0, schemeEnd + 3);
+		full.erase(0, schemeEnd + 3);
+	}
+
+	std::vector<std::string> parts;
+	size_t begin = 0;
+	while (begin <= full.size())
+	{
+		size_t end = full.find('/', begin);
+		if (end == std::string::npos)
+		{
+			end = full.size();
+		}
+		std::string part = full.substr(begin, end - begin);
+		if (part == ".." && !parts.empty() && parts.back() != "..")
+		{
+			parts.pop_back();
+		}
+		else if (!part.empty() && part != ".")
+		{
+			parts.push_back(part);
+		}
+		begin = end + 1;
+	}
+
+	std::string resolved = scheme + (!full.empty() && full[0] == '/' ? "/" : "");
+	for (size_t i = 0; i < parts.size(); ++i)
+	{
+		if (i > 0)
+		{
+			resolved += '/';
+		}
+		resolved += parts[i];
+	}
+	return resolved;
+}
+
+void TextureManager::setAssetRoot(const std::string& root)
+{
+	_assetRoot = root;
+	if (!_assetRoot.empty() && _assetRoot[_assetRoot.size() - 1] != '/')
+	{
+		_assetRoot += '/';
+	}
+}
+
+Texture2D* TextureManager::loadFromFile(const std::string& path, PixelFormat format)
+{
+	Image* image = new Image();
+	Texture2D* texture = nullptr;
+	if (image->initWithImageFile(path, format))
+	{
+		texture = new Texture2D();
+		texture->setStreamed(_streaming);
+		if (texture->initWithImage(image, format))
+		{
+			//uploads now, the texture doesn't need the image afterwards
+			texture->loadGL();
+		}
+		else
+		{
+			texture->release();
+			texture = nullptr;
+		}
+	}
+	delete image;
+	return texture;
+}
+
+Texture2D* TextureManager::loadTexture(const std::string& path, PixelFormat format)
+{
+	std::string key = resolvePath(path);
+	auto it = _textures.find(key);
+	if (it != _textures.end())
+	{
+		_hits++;
+		reference(it->second);
+		return it->second.texture;
+	}
+
+	_misses++;
+	Texture2D* texture = loadFromFile(key, format);
+	if (texture == nullptr)
+	{
+		_failures++;
+		FKLOG("flakor: TextureManager could not load %s", key.c_str());
+		return nullptr;
+	}
+	//the cache keeps the reference new gave
+	insert(key, texture, false);
+	return texture;
+}
+
+unsigned int TextureManager::loadTextureAsync(const std::string& path, const LoadCallback& callback, int priority,
+		PixelFormat format)
+{
+	Waiter waiter;
+	waiter.id = _nextLoadId++;
+	if (_nextLoadId == 0)
+	{
+		_nextLoadId = 1;
+	}
+	waiter.priority = priority;
+	waiter.callback = callback;
+	std::string key = resolvePath(path);
+
+	std::lock_guard<std::mutex> lock(_loadMutex);
+	for (size_t i = 0; i < _loads.size(); ++i)
+	{
+		LoadRequest* request = _loads[i].get();
+		if (request->key == key)
+		{
+			request->waiters.push_back(waiter);
+			request->priority = std::max(request->priority, priority);
+			return waiter.id;
+		}
+	}
+
+	std::shared_ptr<LoadRequest> request = std::make_shared<LoadRequest>();
+	request->key = key;
+	request->format = format;
+	request->priority = priority;
+	request->waiters.push_back(waiter);
+	request->cancelled = false;
+	request->image = nullptr;
+	request->cached = nullptr;
+	_loads.push_back(request);
+	auto cached = _textures.find(key);
+	if (cached != _textures.end())
+	{
+		//nothing to decode, hand it over with the next uploads; the reference
+		//keeps it from being evicted until then
+		reference(cached->second);
+		request->cached = cached->second.texture;
+		request->state = LoadRequest::DECODED;
+		return waiter.id;
+	}
+
+	//the decoders ask GPUInfo what the GPU takes, it has to be made here,
+	//on the GL thread: made on a worker it would query GL without a context
+	GPUInfo::getInstance();
+
+	//one job for each queued load, a job takes whichever is most urgent when it runs
+	request->state = LoadRequest::QUEUED;
+	_decodeJobs++;
+	ThreadPool::getInstance()->enqueue([this]() {
+		decodeNext();
+		//notified under the lock, so the destructor can't return before this does
+		std::lock_guard<std::mutex> lock(_loadMutex);
+		_decodeJobs--;
+		_decodeDone.notify_all();
+	});
+	return waiter.id;
+}
+
+void TextureManager::decodeNext()
+{
+	std::shared_ptr<LoadRequest> request;
+	{
+		std::lock_guard<std::mutex> lock(_loadMutex);
+		for (size_t i = 0; i < _loads.size(); ++i)
+		{
+			if (_loads[i]->state == LoadRequest::QUEUED && (!request || _loads[i]->priority > request->priority))
+			{
+				request = _loads[i];
+			}
+		}
+		if (!request)
+		{
+			//cancelled, or taken by an earlier job
+			return;
+		}
+		request->state = LoadRequest::DECODING;
+	}
+
+	//the file read happens here too, Image maps it
+	Image* image = new Image();
+	if (!image->initWithImageFile(request->key, request->format))
+	{
+		delete image;
+		image = nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(_loadMutex);
+	if (request->cancelled)
+	{
+		delete image;
+		return;
+	}
+	request->image = image;
+	request->state = LoadRequest::DECODED;
+}
+
+std::shared_ptr<TextureManager::LoadRequest> TextureManager::findLoad(unsigned int id)
+{
+	for (size_t i = 0; i < _loads.size(); ++i)
+	{
+		std::vector<Waiter>& waiters = _loads[i]->waiters;
+		for (size_t j = 0; j < waiters.size(); ++j)
+		{
+			if (waiters[j].id == id)
+			{
+				return _loads[i];
+			}
+		}
+	}
+	return nullptr;
+}
+
+void TextureManager::dropLoad(const std::shared_ptr<LoadRequest>& request)
+{
+	_loads.erase(std::find(_loads.begin(), _loads.end(), request));
+	//a decoding load deletes its own image when the worker is done, an
+	//uploading one when the uploader is
+	request->cancelled = true;
+	if (request->state != LoadRequest::UPLOADING)
+	{
+		delete request->image;
+		request->image = nullptr;
+	}
+	if (request->cached != nullptr)
+	{
+		unloadTexture(request->cached);
+		request->cached = nullptr;
+	}
+}
+
+void TextureManager::setLoadPriority(unsigned int id, int priority)
+{
+	std::lock_guard<std::mutex> lock(_loadMutex);
+	std::shared_ptr<LoadRequest> request = findLoad(id);
+	if (!request)
+	{
+		return;
+	}
+	request->priority = priority;
+	for (size_t i = 0; i < request->waiters.size(); ++i)
+	{
+		Waiter& waiter = request->waiters[i];
+		if (waiter.id == id)
+		{
+			waiter.priority = priority;
+		}
+		request->priority = std::max(request->priority, waiter.priority);
+	}
+}
+
+bool TextureManager::cancelLoad(unsigned int id)
+{
+	std::lock_guard<std::mutex> lock(_loadMutex);
+	std::shared_ptr<LoadRequest> request = findLoad(id);
+	if (!request)
+	{
+		return false;
+	}
+	std::vector<Waiter>& waiters = request->waiters;
+	request->priority = INT_MIN;
+	for (size_t i = waiters.size(); i-- > 0;)
+	{
+		if (waiters[i].id == id)
+		{
+			waiters.erase(waiters.begin() + i);
+		}
+		else
+		{
+			request->priority = std::max(request->priority, waiters[i].priority);
+		}
+	}
+	if (waiters.empty())
+	{
+		dropLoad(request);
+	}
+	return true;
+}
+
+void TextureManager::cancelAllLoads()
+{
+	std::lock_guard<std::mutex> lock(_loadMutex);
+	while (!_loads.empty())
+	{
+		dropLoad(_loads.back());
+	}
+}
+
+int TextureManager::getPendingLoadCount()
+{
+	std::lock_guard<std::mutex> lock(_loadMutex);
+	return (int)_loads.size();
+}
+
+void TextureManager::processUploads()
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	//uploads done in the background are handed over first
+	if (GLUploader::hasInstance())
+	{
+		GLUploader::getInstance()->poll();
+	}
+	while (true)
+	{
+		std::shared_ptr<LoadRequest> request;
+		{
+			std::lock_guard<std::mutex> lock(_loadMutex);
+			for (size_t i = 0; i < _loads.size(); ++i)
+			{
+				if (_loads[i]->state == LoadRequest::DECODED && (!request || _loads[i]->priority > request->priority))
+				{
+					request = _loads[i];
+				}
+			}
+		}
+		if (!request)
+		{
+			break;
+		}
+
+		finishLoad(request);
+
+		std::chrono::duration<float, std::milli> spent = std::chrono::steady_clock::now() - start;
+		if (spent.count() >= _uploadBudget)
+		{
+			break;
+		}
+	}
+
+	//levels are streamed with what is left of the budget
+	updateResidency(start);
+}
+
+void TextureManager::finishLoad(const std::shared_ptr<LoadRequest>& request)
+{
+	Texture2D* texture = nullptr;
+	if (request->image != nullptr && _textures.find(request->key) == _textures.end())
+	{
+		texture = new Texture2D();
+		texture->setStreamed(_streaming);
+		if (!texture->initWithImage(request->image, request->format))
+		{
+			texture->release();
+			texture = nullptr;
+		}
+	}
+
+	if (texture != nullptr)
+	{
+		//the image has to live until the upload ran, the uploader's done deletes it
+		{
+			std::lock_guard<std::mutex> lock(_loadMutex);
+			request->state = LoadRequest::UPLOADING;
+		}
+		bool posted = GLUploader::getInstance()->post([texture]() {
+			texture->loadGL();
+		}, [this, request, texture](bool uploaded) {
+			finishUpload(request, texture, uploaded);
+		});
+		if (posted)
+		{
+			return;
+		}
+		texture->loadGL();
+	}
+
+	delete request->image;
+	request->image = nullptr;
+	handOver(request, texture);
+}
+
+void TextureManager::finishUpload(const std::shared_ptr<LoadRequest>& request, Texture2D* texture, bool uploaded)
+{
+	if (!uploaded)
+	{
+		//the context went away with the upload, the image is still there for the next one
+		texture->invalidateGL();
+		texture->release();
+		std::lock_guard<std::mutex> lock(_loadMutex);
+		if (request->cancelled)
+		{
+			delete request->image;
+			request->image = nullptr;
+		}
+		else
+		{
+			request->state = LoadRequest::DECODED;
+		}
+		return;
+	}
+
+	delete request->image;
+	request->image = nullptr;
+	handOver(request, texture);
+}
+
+void TextureManager::handOver(const std::shared_ptr<LoadRequest>& request, Texture2D* texture)
+{
+	{
+		std::lock_guard<std::mutex> lock(_loadMutex);
+		auto it = std::find(_loads.begin(), _loads.end(), request);
+		if (it != _loads.end())
+		{
+			_loads.erase(it);
+		}
+	}
+
+	//a load cancelled while uploading still caches its texture
+	int callbacks = 0;
+	for (size_t i = 0; i < request->waiters.size() && !request->cancelled; ++i)
+	{
+		callbacks += request->waiters[i].callback ? 1 : 0;
+	}
+
+	auto cached = _textures.find(request->key);
+	if (cached != _textures.end())
+	{
+		//a load made while cached, or loadTexture got there first
+		if (texture != nullptr)
+		{
+			texture->release();
+		}
+		_hits += callbacks;
+		texture = cached->second.texture;
+		for (int i = 0; i < callbacks; ++i)
+		{
+			reference(cached->second);
+		}
+		if (request->cached != nullptr)
+		{
+			//the waiters hold their own references now
+			unloadTexture(request->cached);
+			request->cached = nullptr;
+		}
+	}
+	else
+	{
+		_misses++;
+		_hits += callbacks > 1 ? callbacks - 1 : 0;
+		if (texture != nullptr)
+		{
+			insert(request->key, texture, false);
+			Entry& entry = _textures[request->key];
+			for (int i = 1; i < callbacks; ++i)
+			{
+				reference(entry);
+			}
+			if (callbacks == 0)
+			{
+				//preloaded, cached unreferenced
+				unloadTexture(texture);
+			}
+		}
+		else
+		{
+			_failures++;
+			FKLOG("flakor: TextureManager could not load %s", request->key.c_str());
+		}
+	}
+
+	for (size_t i = 0; i < request->waiters.size() && !request->cancelled; ++i)
+	{
+		if (request->waiters[i].callback)
+		{
+			request->waiters[i].callback(texture);
+		}
+	}
+}
+
+bool TextureManager::addTexture(const std::string& key, Texture2D* texture)
+{
+	if (texture == nullptr || _textures.find(key) != _textures.end() || _keys.find(texture) != _keys.end())
+	{
+		return false;
+	}
+	texture->retain();
+	insert(key, texture, true);
+	return true;
+}
+
+Texture2D* TextureManager::findTexture(const std::string& path)
+{
+	auto it = _textures.find(resolvePath(path));
+	return it != _textures.end() ? it->second.texture : nullptr;
+}
+
+void TextureManager::insert(const std::string& key, Texture2D* texture, bool added)
+{
+	Entry& entry = _textures[key];
+	entry.texture = texture;
+	entry.bytes = texture->getResidentBytes();
+	entry.references = 1;
+	entry.added = added;
+	entry.lruPosition = _unreferenced.end();
+	entry.wantedLevel = -1;
+	entry.idleFrames = 0;
+	entry.smallerFrames = 0;
+	_keys[texture] = key;
+
+	_bytes += entry.bytes;
+	trim();
+	if (_bytes > _peakBytes)
+	{
+		_peakBytes = _bytes;
+	}
+}
+
+void TextureManager::reference(Entry& entry)
+{
+	if (entry.references++ == 0)
+	{
+		_unreferenced.erase(entry.lruPosition);
+		entry.lruPosition = _unreferenced.end();
+	}
+}
+
+void TextureManager::unloadTexture(Texture2D* texture)
+{
+	auto key = _keys.find(texture);
+	if (key == _keys.end())
+	{
+		FKLOG("flakor: TextureManager can't unload a texture it doesn't hold");
+		return;
+	}
+	Entry& entry = _textures[key->second];
+	FKAssert(entry.references > 0, "TextureManager: texture unloaded more often than loaded");
+	if (--entry.references == 0)
+	{
+		_unreferenced.push_front(key->second);
+		entry.lruPosition = _unreferenced.begin();
+		trim();
+	}
+}
+
+void TextureManager::evict(const std::string& key)
+{
+	auto it = _textures.find(key);
+	Entry& entry = it->second;
+	_unreferenced.erase(entry.lruPosition);
+	_keys.erase(entry.texture);
+	_bytes -= entry.bytes;
+	//the GL texture goes with the last reference, whoever else retained it
+	entry.texture->release();
+	_textures.erase(it);
+	_evictions++;
+}
+
+void TextureManager::trim()
+{
+	while (_bytes > _budget && !_unreferenced.empty())
+	{
+		evict(_unreferenced.back());
+	}
+	//what is left is in use, it can still do with smaller levels
+	while (_bytes > _budget && dropLevel())
+	{
+	}
+}
+
+void TextureManager::updateBytes(Entry& entry)
+{
+	size_t bytes = entry.texture->getResidentBytes();
+	_bytes = _bytes - entry.bytes + bytes;
+	entry.bytes = bytes;
+	if (_bytes > _peakBytes)
+	{
+		_peakBytes = _bytes;
+	}
+}
+
+bool TextureManager::dropLevel()
+{
+	//the one not drawn the longest, then the largest
+	Entry* victim = nullptr;
+	for (auto it = _textures.begin(); it != _textures.end(); ++it)
+	{
+		Entry& entry = it->second;
+		Texture2D* texture = entry.texture;
+		if (!texture->isStreamed() || texture->getResidentLevel() >= texture->getMipmapCount() - 1)
+		{
+			continue;
+		}
+		if (victim == nullptr || entry.idleFrames > victim->idleFrames
+				|| (entry.idleFrames == victim->idleFrames && entry.bytes > victim->bytes))
+		{
+			victim = &entry;
+		}
+	}
+	if (victim == nullptr || !victim->texture->setResidentLevelGL(victim->texture->getResidentLevel() + 1))
+	{
+		return false;
+	}
+	updateBytes(*victim);
+	_levelsDropped++;
+	return true;
+}
+
+void TextureManager::updateResidency(const std::chrono::steady_clock::time_point& start)
+{
+	std::vector<Entry*> raises;
+	for (auto it = _textures.begin(); it != _textures.end(); ++it)
+	{
+		Entry& entry = it->second;
+		Texture2D* texture = entry.texture;
+		if (!texture->isStreamed() || texture->getMipmapCount() < 2)
+		{
+			continue;
+		}
+
+		int wanted = texture->takeWantedLevel();
+		if (wanted >= 0)
+		{
+			entry.wantedLevel = wanted;
+			entry.idleFrames = 0;
+		}
+		else if (++entry.idleFrames >= IDLE_FRAMES)
+		{
+			entry.wantedLevel = std::max(entry.wantedLevel, texture->getInitialStreamLevel());
+		}
+
+		int resident = texture->getResidentLevel();
+		if (entry.wantedLevel > resident)
+		{
+			//shrinking sprites come back often, wait before dropping
+			if (++entry.smallerFrames >= SMALLER_FRAMES && texture->setResidentLevelGL(entry.wantedLevel))
+			{
+				_levelsDropped += entry.wantedLevel - resident;
+				updateBytes(entry);
+				entry.smallerFrames = 0;
+			}
+		}
+		else
+		{
+			entry.smallerFrames = 0;
+			if (entry.wantedLevel >= 0 && entry.wantedLevel < resident)
+			{
+				raises.push_back(&entry);
+			}
+		}
+	}
+
+	//the blurriest first, one level a texture a frame
+	std::sort(raises.begin(), raises.end(), [](const Entry* a, const Entry* b) {
+		return a->texture->getResidentLevel() - a->wantedLevel > b->texture->getResidentLevel() - b->wantedLevel;
+	});
+	for (size_t i = 0; i < raises.size(); ++i)
+	{
+		std::chrono::duration<float, std::milli> spent = std::chrono::steady_clock::now() - start;
+		if (spent.count() >= _uploadBudget)
+		{
+			return;
+		}
+
+		Entry& entry = *raises[i];
+		Texture2D* texture = entry.texture;
+		int level = texture->getResidentLevel() - 1;
+		size_t needed = texture->getLevelBytes(level) - entry.bytes;
+		while (_bytes + needed > _budget && !_unreferenced.empty())
+		{
+			evict(_unreferenced.back());
+		}
+		if (_bytes + needed > _budget)
+		{
+			continue;
+		}
+		if (texture->setResidentLevelGL(level))
+		{
+			_levelsRaised++;
+			updateBytes(entry);
+		}
+	}
+}
+
+void TextureManager::purgeUnreferenced()
+{
+	while (!_unreferenced.empty())
+	{
+		evict(_unreferenced.back());
+	}
+}
+
+void TextureManager::setBudget(size_t bytes)
+{
+	_budget = bytes;
+	trim();
+}
+
+void TextureManager::reloadTextures()
+{
+	//the names died with the context, deleting them now could hit new textures
+	for (auto it = _textures.begin(); it != _textures.end(); ++it)
+	{
+		it->second.texture->invalidateGL();
+	}
+
+	for (auto it = _textures.begin(); it != _textures.end(); ++it)
+	{
+		Entry& entry = it->second;
+		if (entry.added)
+		{
+			continue;
+		}
+		Image* image = new Image();
+		bool ok = image->initWithImageFile(it->first, entry.texture->getPixelFormat())
+				&& entry.texture->initWithImage(image, entry.texture->getPixelFormat());
+		if (ok)
+		{
+			//streamed ones start over from their small levels
+			entry.texture->loadGL();
+			updateBytes(entry);
+		}
+		else
+		{
+			_failures++;
+			FKLOG("flakor: TextureManager could not reload %s", it->first.c_str());
+		}
+		delete image;
+	}
+}
+
+TextureCacheStats TextureManager::getStats() const
+{
+	TextureCacheStats stats;
+	stats.hits = _hits;
+	stats.misses = _misses;
+	stats.evictions = _evictions;
+	stats.failures = _failures;
+	stats.bytes = _bytes;
+	stats.peakBytes = _peakBytes;
+	stats.budget = _budget;
+	stats.textures = (int)_textures.size();
+	stats.unreferenced = (int)_unreferenced.size();
+	stats.streamed = 0;
+	for (auto it = _textures.begin(); it != _textures.end(); ++it)
+	{
+		stats.streamed += it->second.texture->isStreamed() && it->second.texture->getMipmapCount() > 1 ? 1 : 0;
+	}
+	stats.levelsRaised = _levelsRaised;
+	stats.levelsDropped = _levelsDropped;
+	return stats;
+}
+
+std::vector<TextureResidency> TextureManager::getResidency() const
+{
+	std::vector<TextureResidency> residency;
+	residency.reserve(_textures.size());
+	for (auto it = _textures.begin(); it != _textures.end(); ++it)
+	{
+		const Entry& entry = it->second;
+		TextureResidency texture;
+		texture.key = it->first;
+		texture.mipmapCount = entry.texture->getMipmapCount();
+		texture.residentLevel = entry.texture->getResidentLevel();
+		texture.wantedLevel = entry.idleFrames < IDLE_FRAMES ? entry.wantedLevel : -1;
+		texture.residentBytes = entry.bytes;
+		texture.fullBytes = entry.texture->getFullBytes();
+		texture.references = entry.references;
+		residency.push_back(texture);
+	}
+	std::sort(residency.begin(), residency.end(), [](const TextureResidency& a, const TextureResidency& b) {
+		return a.residentBytes > b.residentBytes;
+	});
+	return residency;
+}
+
+void TextureManager::logResidency() const
+{
+	std::vector<TextureResidency> residency = getResidency();
+	for (size_t i = 0; i < residency.size(); ++i)
+	{
+		const TextureResidency& texture = residency[i];
+		FKLOG("flakor: %8.1f of %8.1f KB, level %2d of %2d (wants %2d), %2d refs  %s",
+				texture.residentBytes / 1024.0, texture.fullBytes / 1024.0, texture.residentLevel,
+				texture.mipmapCount, texture.wantedLevel, texture.references, texture.key.c_str());
+	}
+}
+
+void TextureManager::resetStats()
+{
+	_hits = 0;
+	_misses = 0;
+	_evictions = 0;
+	_failures = 0;
+	_levelsRaised = 0;
+	_levelsDropped = 0;
+	_peakBytes = _bytes;
+}
+
+void TextureManager::logStats() const
+{
+	uint64_t lookups = _hits + _misses;
+	FKLOG("flakor: TextureManager %d textures (%d unreferenced), %.1f of %.1f MB, peak %.1f MB",
+			(int)_textures.size(), (int)_unreferenced.size(), _bytes / 1048576.0, _budget / 1048576.0,
+			_peakBytes / 1048576.0);
+	FKLOG("flakor: TextureManager %llu hits, %llu misses (%.1f%% hit), %llu evictions, %llu failed loads",
+			(unsigned long long)_hits, (unsigned long long)_misses, lookups > 0 ? _hits * 100.0 / lookups : 0.0,
+			(unsigned long long)_evictions, (unsigned long long)_failures);
+	if (_levelsRaised > 0 || _levelsDropped > 0)
+	{
+		FKLOG("flakor: TextureManager streamed %llu levels in, dropped %llu",
+				(unsigned long long)_levelsRaised, (unsigned long long)_levelsDropped);
+	}
+}
+
+FLAKOR_NS_END
@@ -1,25 +1,321 @@
+/**********************************************************
+ * Copyright (c) 2013-2015 Steve Hsu  All Rights Reserved.
+ *********************************************************/
+
 #ifndef _FK_TEXUREMANAGER_H_
 #define _FK_TEXUREMANAGER_H_
 
-#include <set>
+#include "targetMacros.h"
+#include "core/opengl/texture/Texture2D.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 FLAKOR_NS_BEGIN
 
+class Image;
+
+/** what the texture cache has done since start or resetStats */
+struct TextureCacheStats
+{
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	uint64_t failures;
+	/** GPU memory of the cached textures, estimated from their format */
+	size_t bytes;
+	size_t peakBytes;
+	size_t budget;
+	int textures;
+	/** cached textures nobody holds, the ones eviction can take */
+	int unreferenced;
+	/** textures whose levels are streamed */
+	int streamed;
+	/** mip levels uploaded and dropped by streaming */
+	uint64_t levelsRaised;
+	uint64_t levelsDropped;
+};
+
+/** the GPU memory of one cached texture */
+struct TextureResidency
+{
+	std::string key;
+	int mipmapCount;
+	/** largest level in GPU memory, 0 is the full size */
+	int residentLevel;
+	/** the level drawing asked for lately, -1 if not drawn */
+	int wantedLevel;
+	size_t residentBytes;
+	size_t fullBytes;
+	int references;
+};
+
+/**
+ * Cache of the textures loaded from files, one per resolved path.
+ *
+ * loadTexture returns the cached texture when the file was loaded
+ * before, so every sprite drawing "asset://hero.png" shares one GL
+ * texture. Each loadTexture (and addTexture) is a reference, given back
+ * with unloadTexture. A texture nobody references stays cached, in least
+ * recently used order, until the cache needs its memory: whenever the
+ * GPU memory of the resident levels (Texture2D::getResidentBytes)
+ * passes the budget, unreferenced textures are released oldest first.
+ * Referenced ones are never evicted, so the budget can be exceeded while
+ * they are all in use.
+ *
+ * loadTexture loads and uploads on the calling thread. loadTextureAsync
+ * reads and decodes on ThreadPool workers instead, and processUploads
+ * uploads a few milliseconds' worth each frame, so loading the next
+ * scene doesn't drop frames in this one.
+ *
+ * With setStreaming, textures with mipmaps upload their small levels
+ * first. Each frame processUploads uploads larger levels of the textures
+ * the renderer reported (Texture2D::reportDrawnSize) larger than they
+ * are resident, and drops levels of the ones drawn smaller for a while.
+ * Over budget with nothing left to evict, the top levels of streamed
+ * textures go, the ones not drawn lately first.
+ *
+ * When the GLUploader runs, processUploads hands the uploads of decoded
+ * textures to it and calls the loads back once they are done.
+ *
+ * Everything but the decoding and the GLUploader's uploads runs on the GL
+ * thread.
+ */
 class TextureManager
 {
 	public:
+		static const size_t DEFAULT_BUDGET = 64 * 1024 * 1024;
+
+		/**
+		 * gets the texture of an async load on the GL thread, with a
+		 * reference, or nullptr if the file can't be loaded
+		 */
+		typedef std::function<void(Texture2D* texture)> LoadCallback;
+
+		/** returns the shared cache, created on first use */
+		static TextureManager* getInstance();
+
+		/** releases every texture and deletes the shared cache */
+		static void destroyInstance();
+
+		/**
+		 * the texture of the file at path, loaded and uploaded on a miss.
+		 * Takes a reference, see unloadTexture.
+		 * @param format  texture format to convert to on a miss, AUTO keeps
+		 *                the image's own. A cached texture is returned as it is.
+		 * @return nullptr if the file can't be loaded
+		 */
+		Texture2D* loadTexture(const std::string& path, PixelFormat format = PixelFormat::AUTO);
+
+		/**
+		 * loads the texture of the file at path in the background: read and
+		 * decoded on a worker, uploaded and handed to callback by
+		 * processUploads. Higher priorities are decoded and uploaded first.
+		 * Loads of one file are done once. A cached texture is handed over at
+		 * the next processUploads. Without a callback the texture is only
+		 * cached, unreferenced, to preload it.
+		 * @return the id to cancel the load with
+		 */
+		unsigned int loadTextureAsync(const std::string& path, const LoadCallback& callback, int priority = 0,
+				PixelFormat format = PixelFormat::AUTO);
+
+		/** changes the priority of a load that hasn't been handed over */
+		void setLoadPriority(unsigned int id, int priority);
+
+		/**
+		 * drops a load, its callback won't be called. A decode already running
+		 * is thrown away when it's done.
+		 * @return false if the callback already ran or id is unknown
+		 */
+		bool cancelLoad(unsigned int id);
+
+		/** cancels every load, on scene changes */
+		void cancelAllLoads();
+
+		/**
+		 * uploads decoded textures and calls back their loads, highest
+		 * priority first, until the upload budget is spent. One texture is
+		 * uploaded in any case, so a large one can go over. Polls the
+		 * GLUploader too. Call once a frame.
+		 */
+		void processUploads();
+
+		/** milliseconds processUploads may take, 4 by default */
+		void setUploadBudget(float milliseconds) { _uploadBudget = milliseconds; }
+		float getUploadBudget() const { return _uploadBudget; }
+
+		/** loads not handed over yet */
+		int getPendingLoadCount();
+
+		/**
+		 * streams the levels of textures with mipmaps loaded from now on, off
+		 * by default. The renderer has to report drawn sizes, or they stay at
+		 * Texture2D::STREAM_INITIAL_SIZE.
+		 */
+		void setStreaming(bool streaming) { _streaming = streaming; }
+		bool isStreaming() const { return _streaming; }
+
+		/** every cached texture, the most GPU memory first */
+		std::vector<TextureResidency> getResidency() const;
+		void logResidency() const;
+
+		/**
+		 * caches a texture made in code under key, with a reference. It is
+		 * retained, and released when evicted. Fails if key is taken.
+		 */
+		bool addTexture(const std::string& key, Texture2D* texture);
+
+		/** the cached texture for path, without loading or taking a reference */
+		Texture2D* findTexture(const std::string& path);
+
+		/**
+		 * gives back a reference from loadTexture / addTexture. The texture
+		 * stays cached until its memory is needed.
+		 */
+		void unloadTexture(Texture2D* texture);
+
+		/**
+		 * loads every cached file again and uploads it, after the GL context
+		 * was lost. Textures from addTexture can't be reloaded, their owners
+		 * have to fill them again.
+		 */
+		void reloadTextures();
+
+		/** evicts every unreferenced texture, for memory warnings */
+		void purgeUnreferenced();
+
+		/** GPU memory budget in bytes, trims the cache at once if it is lower now */
+		void setBudget(size_t bytes);
+		size_t getBudget() const { return _budget; }
+		size_t getBytes() const { return _bytes; }
+
+		/**
+		 * where "asset://" paths point, "" by default (the asset manager's
+		 * own paths on Android)
+		 */
+		void setAssetRoot(const std::string& root);
+
+		/**
+		 * the cache key of path: "asset://" replaced by the asset root, then
+		 * "//", "./" and "dir/../" after any other scheme collapsed, so one
+		 * file has one key
+		 */
+		std::string resolvePath(const std::string& path) const;
+
+		TextureCacheStats getStats() const;
+		void resetStats();
+		void logStats() const;
 
-		loadTexture(Texture2D* texture);
-		reloadTexture();
-		unloadTexture(Texture2D* texture);
 	protected:
+		struct Entry
+		{
+			Texture2D* texture;
+			size_t bytes;
+			int references;
+			// added in code, there is no file to reload
+			bool added;
+			// position in _unreferenced while references is 0
+			std::list<std::string>::iterator lruPosition;
+			// streaming: the level drawing asked for, frames since it was
+			// drawn, frames it was drawn smaller than resident
+			int wantedLevel;
+			int idleFrames;
+			int smallerFrames;
+		};
+
+		struct Waiter
+		{
+			unsigned int id;
+			int priority;
+			LoadCallback callback;
+		};
+
+		// the loads of one file
+		struct LoadRequest
+		{
+			enum State { QUEUED, DECODING, DECODED, UPLOADING };
+
+			std::string key;
+			PixelFormat format;
+			// the highest of the waiters
+			int priority;
+			std::vector<Waiter> waiters;
+			// guarded by _loadMutex from here on
+			State state;
+			bool cancelled;
+			Image* image;
+			// a load made while its key was cached holds a reference on the
+			// texture until the handover, so it can't be evicted meanwhile
+			Texture2D* cached;
+		};
+
+		TextureManager();
+		~TextureManager();
+
+		Texture2D* loadFromFile(const std::string& path, PixelFormat format);
+		void insert(const std::string& key, Texture2D* texture, bool added);
+		void reference(Entry& entry);
+		void evict(const std::string& key);
+		// evicts the least recently used unreferenced textures until under budget
+		void trim();
+		// the texture's resident bytes changed
+		void updateBytes(Entry& entry);
+		// drops the top level of a streamed texture, false if none has one to drop
+		bool dropLevel();
+		// raises and lowers streamed levels, raising until the upload budget from start is spent
+		void updateResidency(const std::chrono::steady_clock::time_point& start);
+		std::shared_ptr<LoadRequest> findLoad(unsigned int id);
+		// takes the load out of _loads, deletes its image if it has one
+		void dropLoad(const std::shared_ptr<LoadRequest>& request);
+		// runs on a worker, decodes the highest priority queued load
+		void decodeNext();
+		// makes the texture and uploads it, on the GLUploader if it runs
+		void finishLoad(const std::shared_ptr<LoadRequest>& request);
+		void finishUpload(const std::shared_ptr<LoadRequest>& request, Texture2D* texture, bool uploaded);
+		// caches texture (nullptr if the load failed) and calls back
+		void handOver(const std::shared_ptr<LoadRequest>& request, Texture2D* texture);
+
+		std::unordered_map<std::string, Entry> _textures;
+		std::unordered_map<Texture2D*, std::string> _keys;
+		// keys of the unreferenced textures, most recently unloaded first
+		std::list<std::string> _unreferenced;
+		std::string _assetRoot;
+		size_t _budget;
+		size_t _bytes;
+		size_t _peakBytes;
+		uint64_t _hits;
+		uint64_t _misses;
+		uint64_t _evictions;
+		uint64_t _failures;
+
+		// loads not handed over, in the order they were made
+		std::vector<std::shared_ptr<LoadRequest>> _loads;
+		std::mutex _loadMutex;
+		// decode jobs in the ThreadPool, guarded by _loadMutex, they must finish
+		// before the cache goes
+		int _decodeJobs;
+		std::condition_variable _decodeDone;
+		unsigned int _nextLoadId;
+		float _uploadBudget;
+
+		bool _streaming;
+		uint64_t _levelsRaised;
+		uint64_t _levelsDropped;
 
-		std::unordered_map<std::string, Texture2D*> _textures;
+	private:
+		TextureManager(const TextureManager&);
+		TextureManager& operator=(const TextureManager&);
 
-		std::set<Texture2D> texturesLoaded;
-		std::set<Texture2D> texturesToBeLoaded;
-		std::set<Texture2D> texturesToUnloaded;
-}
+		static TextureManager* s_sharedManager;
+};
 
 FLAKOR_NS_END
 
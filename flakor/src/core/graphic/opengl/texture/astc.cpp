@@ -0,0 +1,903 @@
+/**********************************************************
+ * Copyright (c) 2013-2015 Steve Hsu  All Rights Reserved.
+ *********************************************************/
+
+#include "core/opengl/texture/astc.h"
+#include "base/lang/ThreadPool.h"
+
+#include <string.h>
+
+/* Block layout, see the KHR_texture_compression_astc_ldr specification.
+
+ The 128 bit block is read as a little endian number. Bits 10..0 are the
+ block mode, which gives the size of the weight grid, whether there are
+ two weight planes and the quantization of the weights. 0x1fc in bits
+ 8..0 marks a void extent block, one constant color in bits 127..64.
+
+ Bits 12..11 are the partition count minus one. With one partition the
+ color endpoint mode (CEM) is in bits 16..13 and the color data starts at
+ bit 17. Otherwise bits 22..13 are the partition pattern seed, bits 28..23
+ the CEM field and color data starts at bit 29; when the CEM field does
+ not give one mode for all partitions, its remaining 3 * partitions - 4
+ bits are stored just below the weights.
+
+ The weights are packed from bit 127 downwards. Below them (and the extra
+ CEM bits) dual plane blocks store which component uses the second plane.
+ The color data fills the space between, at the highest quantization that
+ fits.
+
+ Colors and weights are packed with integer sequence encoding (ISE): each
+ value is a number of plain bits plus, for some ranges, one trit (base 3)
+ or quint (base 5) digit. 5 trits share 8 bits and 3 quints share 7 bits,
+ interleaved with the plain bits.
+ */
+
+namespace {
+
+struct QuantMode
+{
+    uint8_t trits;
+    uint8_t quints;
+    uint8_t bits;
+};
+
+// ISE ranges 2, 3, 4, 5, 6, 8, 10, 12, 16, 20, 24, 32, 40, 48, 64, 80, 96,
+// 128, 160, 192, 256. Weights use the first 12.
+const QuantMode kQuantModes[21] = {
+    { 0, 0, 1 }, { 1, 0, 0 }, { 0, 0, 2 }, { 0, 1, 0 }, { 1, 0, 1 },
+    { 0, 0, 3 }, { 0, 1, 1 }, { 1, 0, 2 }, { 0, 0, 4 }, { 0, 1, 2 },
+    { 1, 0, 3 }, { 0, 0, 5 }, { 0, 1, 3 }, { 1, 0, 4 }, { 0, 0, 6 },
+    { 0, 1, 4 }, { 1, 0, 5 }, { 0, 0, 7 }, { 0, 1, 5 }, { 1, 0, 6 },
+    { 0, 0, 8 } };
+
+const int kWeightQuantModes = 12;
+const int kColorQuantModes = 21;
+const int kMinColorQuantMode = 4; // range 6
+
+const int kMaxWeights = 64;
+const int kMinWeightBits = 24;
+const int kMaxWeightBits = 96;
+const int kMaxColorValues = 18;
+
+int iseBitCount(int count, int quant)
+{
+    const QuantMode& mode = kQuantModes[quant];
+    return count * mode.bits
+            + (mode.trits ? (8 * count + 4) / 5 : 0)
+            + (mode.quints ? (7 * count + 2) / 3 : 0);
+}
+
+// Per value unquantization of a trit / quint range. D is the trit or quint,
+// the plain bits are in v. B and C follow the tables of the specification,
+// B is the bit pattern made of the plain bits above the lowest one.
+int unquantizeColor(int quant, int v)
+{
+    const QuantMode& mode = kQuantModes[quant];
+    if (!mode.trits && !mode.quints)
+    {
+        // replicate the bits up to 8
+        int result = 0;
+        for (int shift = 8 - mode.bits; shift > -mode.bits; shift -= mode.bits)
+            result |= shift >= 0 ? v << shift : v >> -shift;
+        return result & 0xff;
+    }
+
+    int D = v >> mode.bits;
+    int A = (v & 1) ? 0x1ff : 0;
+    int b = (v >> 1) & 1, c = (v >> 2) & 1, d = (v >> 3) & 1;
+    int e = (v >> 4) & 1, f = (v >> 5) & 1;
+    int B = 0, C = 0;
+    if (mode.trits)
+    {
+        switch (mode.bits)
+        {
+            case 1: C = 204; break;
+            case 2: C = 93; B = b * 0x116; break;
+            case 3: C = 44; B = c * 0x10a + b * 0x85; break;
+            case 4: C = 22; B = d * 0x104 + c * 0x82 + b * 0x41; break;
+            case 5: C = 11; B = e * 0x102 + d * 0x81 + c * 0x40 + b * 0x20; break;
+            case 6: C = 5; B = f * 0x101 + e * 0x80 + d * 0x40 + c * 0x20 + b * 0x10; break;
+        }
+    }
+    else
+    {
+        switch (mode.bits)
+        {
+            case 1: C = 113; break;
+            case 2: C = 54; B = b * 0x10c; break;
+            case 3: C = 26; B = c * 0x105 + b * 0x82; break;
+            case 4: C = 13; B = d * 0x102 + c * 0x81 + b * 0x40; break;
+            case 5: C = 6; B = e * 0x101 + d * 0x80 + c * 0x40 + b * 0x20; break;
+        }
+    }
+    int T = (D * C + B) ^ A;
+    return (A & 0x80) | (T >> 2);
+}
+
+// Weights unquantize to 0..64.
+int unquantizeWeight(int quant, int v)
+{
+    const QuantMode& mode = kQuantModes[quant];
+    int result;
+    if (!mode.trits && !mode.quints)
+    {
+        // replicate the bits up to 6
+        result = 0;
+        for (int shift = 6 - mode.bits; shift > -mode.bits; shift -= mode.bits)
+            result |= shift >= 0 ? v << shift : v >> -shift;
+        result &= 0x3f;
+    }
+    else if (mode.bits == 0)
+    {
+        return mode.trits ? v * 32 : v * 16;
+    }
+    else
+    {
+        int D = v >> mode.bits;
+        int A = (v & 1) ? 0x7f : 0;
+        int b = (v >> 1) & 1, c = (v >> 2) & 1;
+        int B = 0, C = 0;
+        if (mode.trits)
+        {
+            switch (mode.bits)
+            {
+                case 1: C = 50; break;
+                case 2: C = 23; B = b * 0x45; break;
+                case 3: C = 11; B = c * 0x42 + b * 0x21; break;
+            }
+        }
+        else
+        {
+            switch (mode.bits)
+            {
+                case 1: C = 28; break;
+                case 2: C = 13; B = b * 0x42; break;
+            }
+        }
+        int T = (D * C + B) ^ A;
+        result = (A & 0x20) | (T >> 2);
+    }
+    return result > 32 ? result + 1 : result;
+}
+
+// Decode tables, built once on first use.
+struct Tables
+{
+    uint8_t trits[256][5];
+    uint8_t quints[128][3];
+    uint8_t colorUnquant[kColorQuantModes][256];
+    uint8_t weightUnquant[kWeightQuantModes][32];
+
+    Tables()
+    {
+        for (int T = 0; T < 256; T++)
+        {
+            int C, t4, t3, t2, t1, t0;
+            if (((T >> 2) & 7) == 7)
+            {
+                C = ((T >> 3) & 0x1c) | (T & 3);
+                t4 = 2;
+                t3 = 2;
+            }
+            else
+            {
+                C = T & 0x1f;
+                if (((T >> 5) & 3) == 3)
+                {
+                    t4 = 2;
+                    t3 = (T >> 7) & 1;
+                }
+                else
+                {
+                    t4 = (T >> 7) & 1;
+                    t3 = (T >> 5) & 3;
+                }
+            }
+            if ((C & 3) == 3)
+            {
+                t2 = 2;
+                t1 = (C >> 4) & 1;
+                t0 = (((C >> 3) & 1) << 1) | (((C >> 2) & 1) & ~((C >> 3) & 1));
+            }
+            else if (((C >> 2) & 3) == 3)
+            {
+                t2 = 2;
+                t1 = 2;
+                t0 = C & 3;
+            }
+            else
+            {
+                t2 = (C >> 4) & 1;
+                t1 = (C >> 2) & 3;
+                t0 = (((C >> 1) & 1) << 1) | ((C & 1) & ~((C >> 1) & 1));
+            }
+            trits[T][0] = (uint8_t) t0;
+            trits[T][1] = (uint8_t) t1;
+            trits[T][2] = (uint8_t) t2;
+            trits[T][3] = (uint8_t) t3;
+            trits[T][4] = (uint8_t) t4;
+        }
+
+        for (int Q = 0; Q < 128; Q++)
+        {
+            int q2, q1, q0;
+            if (((Q >> 1) & 3) == 3 && ((Q >> 5) & 3) == 0)
+            {
+                int bit0 = Q & 1;
+                q2 = (bit0 << 2) | ((((Q >> 4) & 1) & ~bit0) << 1) | (((Q >> 3) & 1) & ~bit0);
+                q1 = 4;
+                q0 = 4;
+            }
+            else
+            {
+                int C;
+                if (((Q >> 1) & 3) == 3)
+                {
+                    q2 = 4;
+                    C = (((Q >> 3) & 3) << 3) | ((~(Q >> 5) & 3) << 1) | (Q & 1);
+                }
+                else
+                {
+                    q2 = (Q >> 5) & 3;
+                    C = Q & 0x1f;
+                }
+                if ((C & 7) == 5)
+                {
+                    q1 = 4;
+                    q0 = (C >> 3) & 3;
+                }
+                else
+                {
+                    q1 = (C >> 3) & 3;
+                    q0 = C & 7;
+                }
+            }
+            quints[Q][0] = (uint8_t) q0;
+            quints[Q][1] = (uint8_t) q1;
+            quints[Q][2] = (uint8_t) q2;
+        }
+
+        memset(colorUnquant, 0, sizeof(colorUnquant));
+        memset(weightUnquant, 0, sizeof(weightUnquant));
+        for (int quant = 0; quant < kColorQuantModes; quant++)
+        {
+            const QuantMode& mode = kQuantModes[quant];
+            int range = (1 << mode.bits) * (mode.trits ? 3 : mode.quints ? 5 : 1);
+            for (int v = 0; v < range; v++)
+            {
+                colorUnquant[quant][v] = (uint8_t) unquantizeColor(quant, v);
+                if (quant < kWeightQuantModes)
+                    weightUnquant[quant][v] = (uint8_t) unquantizeWeight(quant, v);
+            }
+        }
+    }
+};
+
+const Tables& getTables()
+{
+    static const Tables tables;
+    return tables;
+}
+
+// 128 bit block, bit i of the block is bit i of lo for i < 64, else of hi.
+struct Bits
+{
+    uint64_t lo;
+    uint64_t hi;
+
+    uint32_t read(int pos, int count) const
+    {
+        uint64_t v;
+        if (count == 0 || pos >= 128)
+            return 0;
+        if (pos >= 64)
+            v = hi >> (pos - 64);
+        else if (pos == 0)
+            v = lo;
+        else
+            v = (lo >> pos) | (hi << (64 - pos));
+        return (uint32_t) (v & ((1ull << count) - 1));
+    }
+
+    // read, treating everything from end on as zero
+    uint32_t read(int pos, int count, int end) const
+    {
+        if (pos + count > end)
+            count = end > pos ? end - pos : 0;
+        return read(pos, count);
+    }
+};
+
+uint64_t reverse64(uint64_t v)
+{
+    v = ((v >> 1) & 0x5555555555555555ull) | ((v & 0x5555555555555555ull) << 1);
+    v = ((v >> 2) & 0x3333333333333333ull) | ((v & 0x3333333333333333ull) << 2);
+    v = ((v >> 4) & 0x0f0f0f0f0f0f0f0full) | ((v & 0x0f0f0f0f0f0f0f0full) << 4);
+    v = ((v >> 8) & 0x00ff00ff00ff00ffull) | ((v & 0x00ff00ff00ff00ffull) << 8);
+    v = ((v >> 16) & 0x0000ffff0000ffffull) | ((v & 0x0000ffff0000ffffull) << 16);
+    return (v >> 32) | (v << 32);
+}
+
+// Decodes count ISE values from bits [start, end) of the block. end is where
+// the sequence itself ends, the bits a partial last group leaves out read
+// as zero.
+void decodeIse(const Bits& block, int start, int end, int quant, int count, uint8_t* out)
+{
+    const Tables& tables = getTables();
+    const QuantMode& mode = kQuantModes[quant];
+    const int bits = mode.bits;
+    int pos = start;
+
+    if (mode.trits)
+    {
+        for (int i = 0; i < count; i += 5)
+        {
+            uint32_t m[5];
+            uint32_t T;
+            m[0] = block.read(pos, bits, end); pos += bits;
+            T = block.read(pos, 2, end); pos += 2;
+            m[1] = block.read(pos, bits, end); pos += bits;
+            T |= block.read(pos, 2, end) << 2; pos += 2;
+            m[2] = block.read(pos, bits, end); pos += bits;
+            T |= block.read(pos, 1, end) << 4; pos += 1;
+            m[3] = block.read(pos, bits, end); pos += bits;
+            T |= block.read(pos, 2, end) << 5; pos += 2;
+            m[4] = block.read(pos, bits, end); pos += bits;
+            T |= block.read(pos, 1, end) << 7; pos += 1;
+            for (int j = 0; j < 5 && i + j < count; j++)
+                out[i + j] = (uint8_t) ((tables.trits[T][j] << bits) | m[j]);
+        }
+    }
+    else if (mode.quints)
+    {
+        for (int i = 0; i < count; i += 3)
+        {
+            uint32_t m[3];
+            uint32_t Q;
+            m[0] = block.read(pos, bits, end); pos += bits;
+            Q = block.read(pos, 3, end); pos += 3;
+            m[1] = block.read(pos, bits, end); pos += bits;
+            Q |= block.read(pos, 2, end) << 3; pos += 2;
+            m[2] = block.read(pos, bits, end); pos += bits;
+            Q |= block.read(pos, 2, end) << 5; pos += 2;
+            for (int j = 0; j < 3 && i + j < count; j++)
+                out[i + j] = (uint8_t) ((tables.quints[Q][j] << bits) | m[j]);
+        }
+    }
+    else
+    {
+        for (int i = 0; i < count; i++, pos += bits)
+            out[i] = (uint8_t) block.read(pos, bits, end);
+    }
+}
+
+// Block mode to weight grid size, plane count and weight quantization.
+// Returns false for the reserved encodings.
+bool decodeBlockMode(uint32_t mode, int* weightsX, int* weightsY, bool* dualPlane, int* quant)
+{
+    int base = (mode >> 4) & 1;
+    int H = (mode >> 9) & 1;
+    int D = (mode >> 10) & 1;
+    int A = (mode >> 5) & 3;
+    int B;
+
+    if ((mode & 3) != 0)
+    {
+        base |= (mode & 3) << 1;
+        B = (mode >> 7) & 3;
+        switch ((mode >> 2) & 3)
+        {
+            case 0: *weightsX = B + 4; *weightsY = A + 2; break;
+            case 1: *weightsX = B + 8; *weightsY = A + 2; break;
+            case 2: *weightsX = A + 2; *weightsY = B + 8; break;
+            default:
+                B &= 1;
+                if (mode & 0x100)
+                {
+                    *weightsX = B + 2;
+                    *weightsY = A + 2;
+                }
+                else
+                {
+                    *weightsX = A + 2;
+                    *weightsY = B + 6;
+                }
+                break;
+        }
+    }
+    else
+    {
+        base |= ((mode >> 2) & 3) << 1;
+        if (((mode >> 2) & 3) == 0)
+            return false;
+        B = (mode >> 9) & 3;
+        switch ((mode >> 7) & 3)
+        {
+            case 0: *weightsX = 12; *weightsY = A + 2; break;
+            case 1: *weightsX = A + 2; *weightsY = 12; break;
+            case 2:
+                *weightsX = A + 6;
+                *weightsY = B + 6;
+                D = 0;
+                H = 0;
+                break;
+            default:
+                if (A == 0)
+                {
+                    *weightsX = 6;
+                    *weightsY = 10;
+                }
+                else if (A == 1)
+                {
+                    *weightsX = 10;
+                    *weightsY = 6;
+                }
+                else
+                {
+                    return false;
+                }
+                break;
+        }
+    }
+
+    *dualPlane = D != 0;
+    *quant = base - 2 + 6 * H;
+    return true;
+}
+
+uint32_t hash52(uint32_t p)
+{
+    p ^= p >> 15;
+    p *= 0xeede0891;
+    p ^= p >> 5;
+    p += p << 16;
+    p ^= p >> 7;
+    p ^= p >> 3;
+    p ^= p << 6;
+    p ^= p >> 17;
+    return p;
+}
+
+// Partition of texel (x, y), straight from the specification.
+int selectPartition(int seed, int x, int y, int partitionCount, bool smallBlock)
+{
+    if (smallBlock)
+    {
+        x <<= 1;
+        y <<= 1;
+    }
+    seed += (partitionCount - 1) * 1024;
+    uint32_t rnum = hash52((uint32_t) seed);
+
+    uint8_t seeds[8];
+    for (int i = 0; i < 8; i++)
+    {
+        uint8_t s = (uint8_t) ((rnum >> (4 * i)) & 0xf);
+        seeds[i] = (uint8_t) (s * s);
+    }
+
+    int sh1, sh2;
+    if (seed & 1)
+    {
+        sh1 = (seed & 2) ? 4 : 5;
+        sh2 = (partitionCount == 3) ? 6 : 5;
+    }
+    else
+    {
+        sh1 = (partitionCount == 3) ? 6 : 5;
+        sh2 = (seed & 2) ? 4 : 5;
+    }
+
+    int a = ((seeds[0] >> sh1) * x + (seeds[1] >> sh2) * y + (rnum >> 14)) & 0x3f;
+    int b = ((seeds[2] >> sh1) * x + (seeds[3] >> sh2) * y + (rnum >> 10)) & 0x3f;
+    int c = ((seeds[4] >> sh1) * x + (seeds[5] >> sh2) * y + (rnum >> 6)) & 0x3f;
+    int d = ((seeds[6] >> sh1) * x + (seeds[7] >> sh2) * y + (rnum >> 2)) & 0x3f;
+
+    if (partitionCount < 4)
+        d = 0;
+    if (partitionCount < 3)
+        c = 0;
+
+    if (a >= b && a >= c && a >= d)
+        return 0;
+    if (b >= c && b >= d)
+        return 1;
+    if (c >= d)
+        return 2;
+    return 3;
+}
+
+int clamp255(int v)
+{
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+void bitTransferSigned(int* a, int* b)
+{
+    *b = (*b >> 1) | (*a & 0x80);
+    *a = (*a >> 1) & 0x3f;
+    if (*a & 0x20)
+        *a -= 0x40;
+}
+
+void setColor(int* e, int r, int g, int b, int a)
+{
+    e[0] = clamp255(r);
+    e[1] = clamp255(g);
+    e[2] = clamp255(b);
+    e[3] = clamp255(a);
+}
+
+void setBlueContracted(int* e, int r, int g, int b, int a)
+{
+    setColor(e, (r + b) >> 1, (g + b) >> 1, b, a);
+}
+
+// Unpacks the LDR endpoint modes. Returns false for the HDR ones.
+bool decodeEndpoints(int cem, const uint8_t* values, int* e0, int* e1)
+{
+    int v[8];
+    for (int i = 0; i < 8; i++)
+        v[i] = values[i];
+
+    switch (cem)
+    {
+        case 0: // luminance, direct
+            setColor(e0, v[0], v[0], v[0], 255);
+            setColor(e1, v[1], v[1], v[1], 255);
+            return true;
+        case 1: // luminance, base + offset
+        {
+            int l0 = (v[0] >> 2) | (v[1] & 0xc0);
+            int l1 = l0 + (v[1] & 0x3f);
+            setColor(e0, l0, l0, l0, 255);
+            setColor(e1, l1, l1, l1, 255);
+            return true;
+        }
+        case 4: // luminance + alpha, direct
+            setColor(e0, v[0], v[0], v[0], v[2]);
+            setColor(e1, v[1], v[1], v[1], v[3]);
+            return true;
+        case 5: // luminance + alpha, base + offset
+            bitTransferSigned(&v[1], &v[0]);
+            bitTransferSigned(&v[3], &v[2]);
+            setColor(e0, v[0], v[0], v[0], v[2]);
+            setColor(e1, v[0] + v[1], v[0] + v[1], v[0] + v[1], v[2] + v[3]);
+            return true;
+        case 6: // RGB, base + scale
+            setColor(e0, (v[0] * v[3]) >> 8, (v[1] * v[3]) >> 8, (v[2] * v[3]) >> 8, 255);
+            setColor(e1, v[0], v[1], v[2], 255);
+            return true;
+        case 8: // RGB, direct
+        case 12: // RGBA, direct
+        {
+            int a0 = cem == 12 ? v[6] : 255;
+            int a1 = cem == 12 ? v[7] : 255;
+            if (v[1] + v[3] + v[5] >= v[0] + v[2] + v[4])
+            {
+                setColor(e0, v[0], v[2], v[4], a0);
+                setColor(e1, v[1], v[3], v[5], a1);
+            }
+            else
+            {
+                setBlueContracted(e0, v[1], v[3], v[5], a1);
+                setBlueContracted(e1, v[0], v[2], v[4], a0);
+            }
+            return true;
+        }
+        case 9: // RGB, base + offset
+        case 13: // RGBA, base + offset
+        {
+            bitTransferSigned(&v[1], &v[0]);
+            bitTransferSigned(&v[3], &v[2]);
+            bitTransferSigned(&v[5], &v[4]);
+            int a0 = 255, a1 = 255;
+            if (cem == 13)
+            {
+                bitTransferSigned(&v[7], &v[6]);
+                a0 = v[6];
+                a1 = v[6] + v[7];
+            }
+            if (v[1] + v[3] + v[5] >= 0)
+            {
+                setColor(e0, v[0], v[2], v[4], a0);
+                setColor(e1, v[0] + v[1], v[2] + v[3], v[4] + v[5], a1);
+            }
+            else
+            {
+                setBlueContracted(e0, v[0] + v[1], v[2] + v[3], v[4] + v[5], a1);
+                setBlueContracted(e1, v[0], v[2], v[4], a0);
+            }
+            return true;
+        }
+        case 10: // RGB, base + scale, plus two alphas
+            setColor(e0, (v[0] * v[3]) >> 8, (v[1] * v[3]) >> 8, (v[2] * v[3]) >> 8, v[4]);
+            setColor(e1, v[0], v[1], v[2], v[5]);
+            return true;
+        default:
+            return false;
+    }
+}
+
+int fillError(int blockWidth, int blockHeight, uint8_t* pOut)
+{
+    for (int i = 0; i < blockWidth * blockHeight; i++, pOut += 4)
+    {
+        pOut[0] = 0xff;
+        pOut[1] = 0;
+        pOut[2] = 0xff;
+        pOut[3] = 0xff;
+    }
+    return 1;
+}
+
+int decodeVoidExtent(const Bits& block, int blockWidth, int blockHeight, uint8_t* pOut)
+{
+    // HDR void extent, or reserved bits not set
+    if ((block.lo & 0x200) || (block.lo & 0xc00) != 0xc00)
+        return fillError(blockWidth, blockHeight, pOut);
+
+    uint32_t sLow = block.read(12, 13), sHigh = block.read(25, 13);
+    uint32_t tLow = block.read(38, 13), tHigh = block.read(51, 13);
+    bool allOnes = sLow == 0x1fff && sHigh == 0x1fff && tLow == 0x1fff && tHigh == 0x1fff;
+    if (!allOnes && (sLow >= sHigh || tLow >= tHigh))
+        return fillError(blockWidth, blockHeight, pOut);
+
+    uint8_t color[4];
+    for (int i = 0; i < 4; i++)
+        color[i] = (uint8_t) (block.read(64 + 16 * i, 16) >> 8);
+    for (int i = 0; i < blockWidth * blockHeight; i++, pOut += 4)
+        memcpy(pOut, color, 4);
+    return 0;
+}
+
+} // namespace
+
+int astc_is_valid_block_size(int blockWidth, int blockHeight)
+{
+    switch (blockWidth)
+    {
+        case 4: return blockHeight == 4;
+        case 5: return blockHeight == 4 || blockHeight == 5;
+        case 6: return blockHeight == 5 || blockHeight == 6;
+        case 8: return blockHeight == 5 || blockHeight == 6 || blockHeight == 8;
+        case 10: return blockHeight == 5 || blockHeight == 6 || blockHeight == 8 || blockHeight == 10;
+        case 12: return blockHeight == 10 || blockHeight == 12;
+        default: return 0;
+    }
+}
+
+uint32_t astc_get_encoded_data_size(int blockWidth, int blockHeight, uint32_t width, uint32_t height)
+{
+    return ((width + blockWidth - 1) / blockWidth) * ((height + blockHeight - 1) / blockHeight)
+            * ASTC_ENCODED_BLOCK_SIZE;
+}
+
+int astc_decode_block(const uint8_t* pIn, int blockWidth, int blockHeight, uint8_t* pOut)
+{
+    const Tables& tables = getTables();
+    Bits block = { 0, 0 };
+    for (int i = 7; i >= 0; i--)
+    {
+        block.lo = (block.lo << 8) | pIn[i];
+        block.hi = (block.hi << 8) | pIn[i + 8];
+    }
+
+    uint32_t blockMode = block.read(0, 11);
+    if ((blockMode & 0x1ff) == 0x1fc)
+        return decodeVoidExtent(block, blockWidth, blockHeight, pOut);
+
+    int weightsX, weightsY, weightQuant;
+    bool dualPlane;
+    if (!decodeBlockMode(blockMode, &weightsX, &weightsY, &dualPlane, &weightQuant)
+            || weightsX > blockWidth || weightsY > blockHeight)
+        return fillError(blockWidth, blockHeight, pOut);
+
+    const int planes = dualPlane ? 2 : 1;
+    const int weightCount = weightsX * weightsY * planes;
+    const int weightBits = iseBitCount(weightCount, weightQuant);
+    if (weightCount > kMaxWeights || weightBits < kMinWeightBits || weightBits > kMaxWeightBits)
+        return fillError(blockWidth, blockHeight, pOut);
+
+    const int partitionCount = (int) block.read(11, 2) + 1;
+    if (dualPlane && partitionCount == 4)
+        return fillError(blockWidth, blockHeight, pOut);
+
+    int belowWeights = 128 - weightBits;
+    int cem[4];
+    int colorStart;
+    int seed = 0;
+    if (partitionCount == 1)
+    {
+        cem[0] = (int) block.read(13, 4);
+        colorStart = 17;
+    }
+    else
+    {
+        seed = (int) block.read(13, 10);
+        uint32_t encoded = block.read(23, 6);
+        colorStart = 29;
+        if ((encoded & 3) == 0)
+        {
+            for (int i = 0; i < partitionCount; i++)
+                cem[i] = (int) (encoded >> 2);
+        }
+        else
+        {
+            int extraBits = 3 * partitionCount - 4;
+            belowWeights -= extraBits;
+            encoded |= block.read(belowWeights, extraBits) << 6;
+            int baseClass = (int) (encoded & 3) - 1;
+            for (int i = 0; i < partitionCount; i++)
+            {
+                int cls = baseClass + (int) ((encoded >> (2 + i)) & 1);
+                int m = (int) ((encoded >> (2 + partitionCount + 2 * i)) & 3);
+                cem[i] = (cls << 2) | m;
+            }
+        }
+    }
+
+    int ccs = -1;
+    if (dualPlane)
+    {
+        belowWeights -= 2;
+        ccs = (int) block.read(belowWeights, 2);
+    }
+
+    int colorValues = 0;
+    for (int i = 0; i < partitionCount; i++)
+        colorValues += ((cem[i] >> 2) + 1) * 2;
+    if (colorValues > kMaxColorValues)
+        return fillError(blockWidth, blockHeight, pOut);
+
+    const int colorBits = belowWeights - colorStart;
+    int colorQuant = kColorQuantModes - 1;
+    while (colorQuant >= kMinColorQuantMode && iseBitCount(colorValues, colorQuant) > colorBits)
+        colorQuant--;
+    if (colorQuant < kMinColorQuantMode)
+        return fillError(blockWidth, blockHeight, pOut);
+
+    // endpoints
+    uint8_t values[kMaxColorValues];
+    decodeIse(block, colorStart, colorStart + iseBitCount(colorValues, colorQuant),
+              colorQuant, colorValues, values);
+    for (int i = 0; i < colorValues; i++)
+        values[i] = tables.colorUnquant[colorQuant][values[i]];
+
+    // a partition with an HDR mode decodes to the error color on its own,
+    // the other partitions are still valid
+    int endpoints[4][2][4];
+    bool hdr[4] = { false, false, false, false };
+    const uint8_t* v = values;
+    for (int i = 0; i < partitionCount; i++)
+    {
+        hdr[i] = !decodeEndpoints(cem[i], v, endpoints[i][0], endpoints[i][1]);
+        v += ((cem[i] >> 2) + 1) * 2;
+    }
+
+    // weights are read from the top of the block down
+    Bits reversed = { reverse64(block.hi), reverse64(block.lo) };
+    uint8_t weights[kMaxWeights];
+    decodeIse(reversed, 0, weightBits, weightQuant, weightCount, weights);
+    for (int i = 0; i < weightCount; i++)
+        weights[i] = tables.weightUnquant[weightQuant][weights[i]];
+
+    // split the planes, padded so the infill may read one past the grid
+    uint8_t plane[2][kMaxWeights + ASTC_MAX_BLOCK_DIM + 1];
+    memset(plane, 0, sizeof(plane));
+    for (int i = 0; i < weightsX * weightsY; i++)
+    {
+        plane[0][i] = weights[i * planes];
+        if (dualPlane)
+            plane[1][i] = weights[i * planes + 1];
+    }
+
+    const bool smallBlock = blockWidth * blockHeight < 31;
+    const int Ds = (1024 + blockWidth / 2) / (blockWidth - 1);
+    const int Dt = (1024 + blockHeight / 2) / (blockHeight - 1);
+
+    for (int t = 0; t < blockHeight; t++)
+    {
+        const int gt = (Dt * t * (weightsY - 1) + 32) >> 6;
+        const int jt = gt >> 4, ft = gt & 0xf;
+        for (int s = 0; s < blockWidth; s++, pOut += 4)
+        {
+            const int gs = (Ds * s * (weightsX - 1) + 32) >> 6;
+            const int js = gs >> 4, fs = gs & 0xf;
+            const int w11 = (fs * ft + 8) >> 4;
+            const int w10 = ft - w11;
+            const int w01 = fs - w11;
+            const int w00 = 16 - fs - ft + w11;
+            const int index = js + jt * weightsX;
+
+            int w[2] = { 0, 0 };
+            for (int p = 0; p < planes; p++)
+            {
+                const uint8_t* g = plane[p] + index;
+                w[p] = (g[0] * w00 + g[1] * w01 + g[weightsX] * w10 + g[weightsX + 1] * w11 + 8) >> 4;
+            }
+
+            const int part = partitionCount > 1
+                    ? selectPartition(seed, s, t, partitionCount, smallBlock) : 0;
+            if (hdr[part])
+            {
+                fillError(1, 1, pOut);
+                continue;
+            }
+            const int* c0 = endpoints[part][0];
+            const int* c1 = endpoints[part][1];
+            for (int c = 0; c < 4; c++)
+            {
+                const int weight = (c == ccs) ? w[1] : w[0];
+                const int color = (c0[c] * 257 * (64 - weight) + c1[c] * 257 * weight + 32) >> 6;
+                pOut[c] = (uint8_t) (color >> 8);
+            }
+        }
+    }
+    return 0;
+}
+
+int astc_decode_image(const uint8_t* pIn, uint8_t* pOut,
+        uint32_t width, uint32_t height,
+        int blockWidth, int blockHeight, uint32_t stride)
+{
+    if (!astc_is_valid_block_size(blockWidth, blockHeight))
+    {
+        return -1;
+    }
+    const uint32_t blocksPerRow = (width + blockWidth - 1) / blockWidth;
+    const int blockRows = (int) ((height + blockHeight - 1) / blockHeight);
+
+    flakor::ThreadPool::getInstance()->parallelFor(0, blockRows, [=](int row) {
+        uint8_t block[ASTC_MAX_BLOCK_DIM * ASTC_MAX_BLOCK_DIM * 4];
+        uint32_t y = row * blockHeight;
+        uint32_t yEnd = height - y < (uint32_t) blockHeight ? height - y : blockHeight;
+        const uint8_t* q = pIn + row * blocksPerRow * ASTC_ENCODED_BLOCK_SIZE;
+        for (uint32_t x = 0; x < width; x += blockWidth, q += ASTC_ENCODED_BLOCK_SIZE) {
+            uint32_t xEnd = width - x < (uint32_t) blockWidth ? width - x : blockWidth;
+            astc_decode_block(q, blockWidth, blockHeight, block);
+            for (uint32_t cy = 0; cy < yEnd; cy++) {
+                memcpy(pOut + 4 * x + stride * (y + cy), block + 4 * blockWidth * cy, 4 * xEnd);
+            }
+        }
+    });
+    return 0;
+}
+
+static const uint8_t kMagic[] = { 0x13, 0xab, 0xa1, 0x5c };
+
+static uint32_t readUInt24(const uint8_t* pIn)
+{
+    return pIn[0] | (pIn[1] << 8) | (pIn[2] << 16);
+}
+
+int astc_header_is_valid(const uint8_t* pHeader)
+{
+    if (memcmp(pHeader, kMagic, sizeof(kMagic)) != 0)
+    {
+        return 0;
+    }
+    return pHeader[6] == 1 && readUInt24(pHeader + 13) == 1
+            && astc_is_valid_block_size(pHeader[4], pHeader[5])
+            && readUInt24(pHeader + 7) > 0 && readUInt24(pHeader + 10) > 0;
+}
+
+int astc_header_get_block_width(const uint8_t* pHeader)
+{
+    return pHeader[4];
+}
+
+int astc_header_get_block_height(const uint8_t* pHeader)
+{
+    return pHeader[5];
+}
+
+uint32_t astc_header_get_width(const uint8_t* pHeader)
+{
+    return readUInt24(pHeader + 7);
+}
+
+uint32_t astc_header_get_height(const uint8_t* pHeader)
+{
+    return readUInt24(pHeader + 10);
+}
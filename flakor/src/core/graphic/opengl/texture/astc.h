@@ -0,0 +1,70 @@
+/**********************************************************
+ * Copyright (c) 2013-2015 Steve Hsu  All Rights Reserved.
+ *********************************************************/
+
+// ASTC (Adaptive Scalable Texture Compression) LDR decoder for 2D block
+// footprints, as defined by KHR_texture_compression_astc_ldr. HDR blocks
+// and HDR endpoint modes decode to the error color (magenta), which is
+// what LDR hardware does as well.
+
+#ifndef __astc_h__
+#define __astc_h__
+
+#include <stdint.h>
+
+// Every ASTC block is 128 bits, whatever its footprint.
+#define ASTC_ENCODED_BLOCK_SIZE 16
+
+// Size of the header of a .astc file.
+#define ASTC_HEADER_SIZE 16
+
+// Largest footprint is 12 x 12.
+#define ASTC_MAX_BLOCK_DIM 12
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Returns non-zero if blockWidth x blockHeight is one of the 14 footprints
+// of the 2D LDR profile (4x4 up to 12x12).
+
+int astc_is_valid_block_size(int blockWidth, int blockHeight);
+
+// Return the size of the encoded image data (does not include the header).
+
+uint32_t astc_get_encoded_data_size(int blockWidth, int blockHeight, uint32_t width, uint32_t height);
+
+// Decode a block of pixels.
+//
+// pIn is ASTC_ENCODED_BLOCK_SIZE bytes. pOut receives blockWidth x blockHeight
+// RGBA 8888 pixels, pixel (x, y) at pOut + 4 * (x + y * blockWidth).
+// Returns non-zero if the block was invalid and decoded to the error color.
+
+int astc_decode_block(const uint8_t* pIn, int blockWidth, int blockHeight, uint8_t* pOut);
+
+// Decode an entire image to RGBA 8888.
+// pOut - pixel (x,y) is written at pOut + 4 * x + stride * y.
+// Rows of blocks are decoded in parallel on the shared thread pool.
+// returns non-zero if there is an error.
+
+int astc_decode_image(const uint8_t* pIn, uint8_t* pOut,
+        uint32_t width, uint32_t height,
+        int blockWidth, int blockHeight, uint32_t stride);
+
+// Check if a .astc file header is correctly formatted and describes a 2D
+// image with a supported footprint.
+
+int astc_header_is_valid(const uint8_t* pHeader);
+
+// Read the footprint and the image size from a valid header.
+
+int astc_header_get_block_width(const uint8_t* pHeader);
+int astc_header_get_block_height(const uint8_t* pHeader);
+uint32_t astc_header_get_width(const uint8_t* pHeader);
+uint32_t astc_header_get_height(const uint8_t* pHeader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
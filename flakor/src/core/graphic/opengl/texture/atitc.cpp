@@ -24,14 +24,20 @@
 
 #include "core/opengl/texture/atitc.h"
 
-//Decode ATITC encode block to 4x4 RGB32 pixels
-static void atitc_decode_block(uint8_t **blockData,
+//Decode ATITC encode block to 4x4 RGB32 pixels, stride in pixels
+static void atitc_decode_block(const uint8_t *blockData,
                               uint32_t *decodeBlockData,
                               unsigned int stride,
-                              bool oneBitAlphaFlag,
-                              uint64_t alpha,
                               ATITCDecodeFlag decodeFlag)
 {
+    bool oneBitAlphaFlag = ATITCDecodeFlag::ATC_RGB != decodeFlag;
+    uint64_t alpha = 0;
+    if (oneBitAlphaFlag)
+    {
+        memcpy((void *)&alpha, blockData, 8);
+        blockData += 8;
+    }
+
     unsigned int colorValue0 = 0 , colorValue1 = 0, initAlpha = (!oneBitAlphaFlag * 255u) << 24;
     unsigned int rb0 = 0, rb1 = 0, rb2 = 0, rb3 = 0, g0 = 0, g1 = 0, g2 = 0, g3 = 0;
     bool msb = 0;
@@ -39,11 +45,11 @@ static void atitc_decode_block(uint8_t **blockData,
     uint32_t colors[4], pixelsIndex = 0;
     
     /* load the two color values*/
-    memcpy((void *)&colorValue0, *blockData, 2);
-    (*blockData) += 2;
+    memcpy((void *)&colorValue0, blockData, 2);
+    blockData += 2;
     
-    memcpy((void *)&colorValue1, *blockData, 2);
-    (*blockData) += 2;
+    memcpy((void *)&colorValue1, blockData, 2);
+    blockData += 2;
     
     //extract the msb flag
     msb = (colorValue0 & 0x8000) != 0;
@@ -83,8 +89,7 @@ static void atitc_decode_block(uint8_t **blockData,
     }
    
     /*read the pixelsIndex , 2bits per pixel, 4 bytes */
-    memcpy((void*)&pixelsIndex, *blockData, 4);
-    (*blockData) += 4;
+    memcpy((void*)&pixelsIndex, blockData, 4);
     
     if (ATITCDecodeFlag::ATC_INTERPOLATED_ALPHA == decodeFlag)
     {
@@ -123,7 +128,7 @@ static void atitc_decode_block(uint8_t **blockData,
         {
             for (int x = 0; x < 4; ++x)
             {
-                decodeBlockData[x] = (alphaArray[alpha & 5] << 24) + colors[pixelsIndex & 3];
+                decodeBlockData[x] = (alphaArray[alpha & 7] << 24) + colors[pixelsIndex & 3];
                 pixelsIndex >>= 2;
                 alpha >>= 3;
             }
@@ -149,6 +154,50 @@ static void atitc_decode_block(uint8_t **blockData,
     }
 }
 
+int atitc_encoded_size(const int pixelsWidth, const int pixelsHeight, ATITCDecodeFlag decodeFlag)
+{
+    const int blockSize = (ATITCDecodeFlag::ATC_RGB == decodeFlag) ? 8 : 16;
+    return ((pixelsWidth + 3) / 4) * ((pixelsHeight + 3) / 4) * blockSize;
+}
+
+//Decode block rows [blockRowBegin, blockRowEnd) of one mip level
+void atitc_decode_rows(const uint8_t *encodeData,
+                       uint8_t *decodeData,
+                       const int stride,
+                       const int pixelsWidth,
+                       const int pixelsHeight,
+                       const int blockRowBegin,
+                       const int blockRowEnd,
+                       ATITCDecodeFlag decodeFlag)
+{
+    const int blockSize = (ATITCDecodeFlag::ATC_RGB == decodeFlag) ? 8 : 16;
+    const int blocksPerRow = (pixelsWidth + 3) / 4;
+    uint32_t edgeBlock[16];
+
+    for (int block_y = blockRowBegin; block_y < blockRowEnd; ++block_y)
+    {
+        const uint8_t *blockData = encodeData + block_y * blocksPerRow * blockSize;
+        uint8_t *rowData = decodeData + (block_y - blockRowBegin) * 4 * stride;
+        const int rows = MIN(4, pixelsHeight - block_y * 4);
+        for (int block_x = 0; block_x < blocksPerRow; ++block_x, blockData += blockSize)
+        {
+            const int x = block_x * 4;
+            uint32_t *out = (uint32_t *)(rowData + x * 4);
+            if (rows == 4 && x + 4 <= pixelsWidth && stride % 4 == 0)
+            {
+                atitc_decode_block(blockData, out, stride / 4, decodeFlag);
+                continue;
+            }
+
+            //partial block at the edges of small mipmaps, or unaligned rows
+            atitc_decode_block(blockData, edgeBlock, 4, decodeFlag);
+            const int columns = MIN(4, pixelsWidth - x);
+            for (int row = 0; row < rows; ++row)
+                memcpy(rowData + row * stride + x * 4, edgeBlock + row * 4, columns * sizeof(uint32_t));
+        }
+    }
+}
+
 //Decode ATITC encode data to RGB32
 void atitc_decode(uint8_t *encodeData,             //in_data
                  uint8_t *decodeData,              //out_data
@@ -156,40 +205,6 @@ void atitc_decode(uint8_t *encodeData,             //in_data
                  const int pixelsHeight,
                  ATITCDecodeFlag decodeFlag)
 {
-    uint32_t *decodeBlockData = (uint32_t *)decodeData;
-    
-    for (int block_y = 0; block_y < pixelsHeight / 4; ++block_y, decodeBlockData += 3 * pixelsWidth)   //stride = 3*width
-    {
-        for (int block_x = 0; block_x < pixelsWidth / 4; ++block_x, decodeBlockData += 4)            //skip 4 pixels
-        {
-            uint64_t blockAlpha = 0;
-            
-            switch (decodeFlag)
-            {
-                case ATITCDecodeFlag::ATC_RGB:
-                {
-                    atitc_decode_block(&encodeData, decodeBlockData, pixelsWidth, 0, 0LL, ATITCDecodeFlag::ATC_RGB);
-                }
-                    break;
-                case ATITCDecodeFlag::ATC_EXPLICIT_ALPHA:
-                {
-                    memcpy((void *)&blockAlpha, encodeData, 8);
-                    encodeData += 8;
-                    atitc_decode_block(&encodeData, decodeBlockData, pixelsWidth, 1, blockAlpha, ATITCDecodeFlag::ATC_EXPLICIT_ALPHA);
-                }
-                    break;
-                case ATITCDecodeFlag::ATC_INTERPOLATED_ALPHA:
-                {
-                    memcpy((void *)&blockAlpha, encodeData, 8);
-                    encodeData += 8;
-                    atitc_decode_block(&encodeData, decodeBlockData, pixelsWidth, 1, blockAlpha, ATITCDecodeFlag::ATC_INTERPOLATED_ALPHA);
-                }
-                    break;
-                default:
-                    break;
-            }//switch
-        }//for block_x
-    }//for block_y
+    atitc_decode_rows(encodeData, decodeData, pixelsWidth * 4, pixelsWidth, pixelsHeight,
+                      0, (pixelsHeight + 3) / 4, decodeFlag);
 }
-
-
@@ -43,6 +43,28 @@ void atitc_decode(uint8_t *encode_data,
                   ATITCDecodeFlag decodeFlag
                   );
 
+//Size in bytes of the encoded data of one pixelsWidth x pixelsHeight level
+int atitc_encoded_size(const int pixelsWidth,
+                       const int pixelsHeight,
+                       ATITCDecodeFlag decodeFlag
+                       );
+
+//Streaming decode of one mip level. Decodes the block rows
+//[blockRowBegin, blockRowEnd) of the level starting at encode_data into
+//caller owned memory: decode_data receives pixel row 4 * blockRowBegin,
+//each following row stride bytes further. Only the rows that exist in the
+//level are written, so a band buffer of 4 * (blockRowEnd - blockRowBegin)
+//rows or the final texture memory can both be used directly.
+void atitc_decode_rows(const uint8_t *encode_data,
+                       uint8_t *decode_data,
+                       const int stride,
+                       const int pixelsWidth,
+                       const int pixelsHeight,
+                       const int blockRowBegin,
+                       const int blockRowEnd,
+                       ATITCDecodeFlag decodeFlag
+                       );
+
 
 #endif /* defined(COCOS2DX_PLATFORM_THIRDPARTY_ATITC_) */
 
@@ -2,19 +2,32 @@
 #include "core/opengl/GL.h"
 #include "core/opengl/GPUInfo.h"
 #include "core/opengl/texture/Image.h"
+#include "core/opengl/texture/ImageCodec.h"
 
+#include <atomic>
+#include <chrono>
 #include <vector>
 #include <string>
 #include <ctype.h>
 #include <jpeglib.h>
 #include <png.h>
 #include <zlib.h>
+#if FK_USE_WEBP && (FK_TARGET_PLATFORM != FK_PLATFORM_WP8) && (FK_TARGET_PLATFORM != FK_PLATFORM_WINRT)
+#define FK_IMAGE_USE_WEBP 1
+#include <webp/decode.h>
+#endif
 
+#include "core/opengl/texture/astc.h"
 #include "core/opengl/texture/atitc.h"
 #include "core/opengl/texture/etc1.h"
+#include "core/opengl/texture/etc2.h"
 #include "core/opengl/texture/pvr.h"
 #include "core/opengl/texture/s3tc.h"
 #include "core/opengl/texture/TGAlib.h"
+#include "core/opengl/texture/utex.h"
+#include "base/lang/ThreadPool.h"
+#include "tool/utility/PngWriter.h"
+#include "tool/utility/TexUtils.h"
 
 #define FK_GL_ATC_RGB_AMD                                          0x8C92
 #define FK_GL_ATC_RGBA_EXPLICIT_ALPHA_AMD                          0x8C93
@@ -41,6 +54,14 @@ namespace
     static const int PVR_TEXTURE_FLAG_TYPE_MASK = 0xff;
     
     static bool _PVRHaveAlphaPremultiplied = false;
+
+    static bool _premultiplyInLinearLight = false;
+
+    // bytes handed to the webp decoder at a time by initWithWebpData
+    static const ssize_t WEBP_CHUNK_SIZE = 64 * 1024;
+
+    // bytes appendImageData collects before it gives up finding the format
+    static const size_t STREAM_DETECT_SIZE = 64;
     
     // Values taken from PVRTexture.h from http://www.imgtec.com
     enum class PVR2TextureFlag
@@ -340,6 +361,106 @@ namespace
 }
 //atittc struct end
 
+//////////////////////////////////////////////////////////////////////////
+
+//struct and data for astc
+namespace
+{
+    struct ASTCBlockFormat
+    {
+        int blockWidth;
+        int blockHeight;
+        PixelFormat format;
+    };
+
+    static const ASTCBlockFormat ASTCBlockFormats[] =
+    {
+        { 4, 4, PixelFormat::ASTC_4x4 },
+        { 5, 4, PixelFormat::ASTC_5x4 },
+        { 5, 5, PixelFormat::ASTC_5x5 },
+        { 6, 5, PixelFormat::ASTC_6x5 },
+        { 6, 6, PixelFormat::ASTC_6x6 },
+        { 8, 5, PixelFormat::ASTC_8x5 },
+        { 8, 6, PixelFormat::ASTC_8x6 },
+        { 8, 8, PixelFormat::ASTC_8x8 },
+        { 10, 5, PixelFormat::ASTC_10x5 },
+        { 10, 6, PixelFormat::ASTC_10x6 },
+        { 10, 8, PixelFormat::ASTC_10x8 },
+        { 10, 10, PixelFormat::ASTC_10x10 },
+        { 12, 10, PixelFormat::ASTC_12x10 },
+        { 12, 12, PixelFormat::ASTC_12x12 },
+    };
+
+    static PixelFormat getASTCPixelFormat(int blockWidth, int blockHeight)
+    {
+        for (size_t i = 0; i < sizeof(ASTCBlockFormats) / sizeof(ASTCBlockFormats[0]); ++i)
+        {
+            if (ASTCBlockFormats[i].blockWidth == blockWidth && ASTCBlockFormats[i].blockHeight == blockHeight)
+                return ASTCBlockFormats[i].format;
+        }
+        return PixelFormat::NONE;
+    }
+}
+//astc struct end
+
+//utex struct
+namespace
+{
+    // Block format a .utex file is transcoded to. ETC keeps the ETC1S color
+    // blocks as they are, so it comes first, then S3TC and ATITC. PVRTC and
+    // ASTC only GPUs get uncompressed pixels.
+    static utex_target getUTEXTarget(bool hasAlpha, PixelFormat& format)
+    {
+        GPUInfo* info = GPUInfo::getInstance();
+        if (hasAlpha)
+        {
+            if (info->supportsETC2())
+            {
+                format = PixelFormat::ETC2_RGBA;
+                return UTEX_TARGET_ETC2_RGBA8;
+            }
+            if (info->supportsS3TC())
+            {
+                format = PixelFormat::S3TC_DXT5;
+                return UTEX_TARGET_DXT5;
+            }
+            if (info->supportsATITC())
+            {
+                format = PixelFormat::ATC_INTERPOLATED_ALPHA;
+                return UTEX_TARGET_ATC_RGBA_INTERPOLATED;
+            }
+            format = PixelFormat::RGBA8888;
+            return UTEX_TARGET_RGBA8888;
+        }
+
+#ifdef GL_ETC1_RGB8_OES
+        if (info->supportsETC())
+        {
+            format = PixelFormat::ETC;
+            return UTEX_TARGET_ETC1;
+        }
+#endif
+        if (info->supportsETC2())
+        {
+            format = PixelFormat::ETC2_RGB;
+            return UTEX_TARGET_ETC1;
+        }
+        if (info->supportsS3TC())
+        {
+            format = PixelFormat::S3TC_DXT1;
+            return UTEX_TARGET_DXT1;
+        }
+        if (info->supportsATITC())
+        {
+            format = PixelFormat::ATC_RGB;
+            return UTEX_TARGET_ATC_RGB;
+        }
+        format = PixelFormat::RGB565;
+        return UTEX_TARGET_RGB565;
+    }
+}
+//utex struct end
+
 
 namespace
 {
@@ -364,6 +485,33 @@ namespace
             png_error(png_ptr, "pngReaderCallback failed!");
         }
     }
+
+    // Where decoded png and webp rows go: premultiplied in place, then
+    // converted to the render format straight into the image while the row
+    // is in cache.
+    struct RowSink
+    {
+        PixelFormat originFormat;
+        PixelFormat format;
+        bool premultiply;
+        int width;
+        unsigned char* out;
+        size_t outRowBytes;
+    };
+
+    static void writeRow(const RowSink& sink, unsigned char* row, int y)
+    {
+        if (sink.premultiply)
+        {
+            TexUtils::premultiplyRow(row, sink.width, _premultiplyInLinearLight);
+        }
+        unsigned char* dst = sink.out + y * sink.outRowBytes;
+        //rows read straight into the image are done
+        if (row != dst)
+        {
+            TexUtils::convertRow(row, dst, sink.width, sink.originFormat, sink.format, y);
+        }
+    }
 }
 
 PixelFormat getDevicePixelFormat(PixelFormat format)
@@ -382,11 +530,293 @@ PixelFormat getDevicePixelFormat(PixelFormat format)
                 return format;
             else
                 return PixelFormat::RGB888;
+        case PixelFormat::ETC2_RGB:
+            if(GPUInfo::getInstance()->supportsETC2())
+                return format;
+            else
+                return PixelFormat::RGB888;
+        case PixelFormat::ETC2_RGBA:
+        case PixelFormat::ETC2_RGB_A1:
+            if(GPUInfo::getInstance()->supportsETC2())
+                return format;
+            else
+                return PixelFormat::RGBA8888;
+        case PixelFormat::ASTC_4x4:
+        case PixelFormat::ASTC_5x4:
+        case PixelFormat::ASTC_5x5:
+        case PixelFormat::ASTC_6x5:
+        case PixelFormat::ASTC_6x6:
+        case PixelFormat::ASTC_8x5:
+        case PixelFormat::ASTC_8x6:
+        case PixelFormat::ASTC_8x8:
+        case PixelFormat::ASTC_10x5:
+        case PixelFormat::ASTC_10x6:
+        case PixelFormat::ASTC_10x8:
+        case PixelFormat::ASTC_10x10:
+        case PixelFormat::ASTC_12x10:
+        case PixelFormat::ASTC_12x12:
+            if(GPUInfo::getInstance()->supportsASTC())
+                return format;
+            else
+                return PixelFormat::RGBA8888;
         default:
             return format;
     }
 }
 
+//////////////////////////////////////////////////////////////////////////
+
+//struct and data for ktx / ktx2
+namespace
+{
+    static const unsigned char gKTX1Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+    static const unsigned char gKTX2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+    // same as Image::MIPMAP_MAX
+    static const int KTX_MAX_LEVELS = 16;
+    static const uint32_t KTX_ENDIANNESS = 0x04030201;
+
+#pragma pack(push,1)
+
+    // the KTX 1.1 header is ATITCTexHeader
+    struct KTX2TexHeader
+    {
+        char identifier[12];
+        uint32_t vkFormat;
+        uint32_t typeSize;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t layerCount;
+        uint32_t faceCount;
+        uint32_t levelCount;
+        uint32_t supercompressionScheme;
+        uint32_t dfdByteOffset;
+        uint32_t dfdByteLength;
+        uint32_t kvdByteOffset;
+        uint32_t kvdByteLength;
+        uint64_t sgdByteOffset;
+        uint64_t sgdByteLength;
+    };
+
+    struct KTX2LevelIndex
+    {
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint64_t uncompressedByteLength;
+    };
+
+#pragma pack(pop)
+
+    // VkFormat values of the formats Texture2D knows, sRGB variants are not mapped
+    struct KTX2Format
+    {
+        uint32_t vkFormat;
+        PixelFormat format;
+    };
+
+    static const KTX2Format KTX2Formats[] =
+    {
+        { 2, PixelFormat::RGBA4444 },           // R4G4B4A4_UNORM_PACK16
+        { 4, PixelFormat::RGB565 },             // R5G6B5_UNORM_PACK16
+        { 6, PixelFormat::RGB5A1 },             // R5G5B5A1_UNORM_PACK16
+        { 23, PixelFormat::RGB888 },            // R8G8B8_UNORM
+        { 37, PixelFormat::RGBA8888 },          // R8G8B8A8_UNORM
+        { 44, PixelFormat::BGRA8888 },          // B8G8R8A8_UNORM
+        { 131, PixelFormat::S3TC_DXT1 },        // BC1_RGB_UNORM_BLOCK
+        { 133, PixelFormat::S3TC_DXT1 },        // BC1_RGBA_UNORM_BLOCK
+        { 135, PixelFormat::S3TC_DXT3 },        // BC2_UNORM_BLOCK
+        { 137, PixelFormat::S3TC_DXT5 },        // BC3_UNORM_BLOCK
+        { 147, PixelFormat::ETC2_RGB },         // ETC2_R8G8B8_UNORM_BLOCK
+        { 149, PixelFormat::ETC2_RGB_A1 },      // ETC2_R8G8B8A1_UNORM_BLOCK
+        { 151, PixelFormat::ETC2_RGBA },        // ETC2_R8G8B8A8_UNORM_BLOCK
+        { 157, PixelFormat::ASTC_4x4 },         // ASTC_*_UNORM_BLOCK
+        { 159, PixelFormat::ASTC_5x4 },
+        { 161, PixelFormat::ASTC_5x5 },
+        { 163, PixelFormat::ASTC_6x5 },
+        { 165, PixelFormat::ASTC_6x6 },
+        { 167, PixelFormat::ASTC_8x5 },
+        { 169, PixelFormat::ASTC_8x6 },
+        { 171, PixelFormat::ASTC_8x8 },
+        { 173, PixelFormat::ASTC_10x5 },
+        { 175, PixelFormat::ASTC_10x6 },
+        { 177, PixelFormat::ASTC_10x8 },
+        { 179, PixelFormat::ASTC_10x10 },
+        { 181, PixelFormat::ASTC_12x10 },
+        { 183, PixelFormat::ASTC_12x12 },
+        { 1000054000, PixelFormat::PVRTC2A },   // PVRTC1_2BPP_UNORM_BLOCK_IMG
+        { 1000054001, PixelFormat::PVRTC4A },   // PVRTC1_4BPP_UNORM_BLOCK_IMG
+    };
+
+    static PixelFormat getKTX2PixelFormat(uint32_t vkFormat)
+    {
+        for (size_t i = 0; i < sizeof(KTX2Formats) / sizeof(KTX2Formats[0]); ++i)
+        {
+            if (KTX2Formats[i].vkFormat == vkFormat)
+                return KTX2Formats[i].format;
+        }
+        return PixelFormat::NONE;
+    }
+
+    static PixelFormat getKTX1PixelFormat(const ATITCTexHeader* header)
+    {
+        //the GL headers may not define ATC
+        switch (header->glInternalFormat)
+        {
+            case FK_GL_ATC_RGB_AMD:
+                return PixelFormat::ATC_RGB;
+            case FK_GL_ATC_RGBA_EXPLICIT_ALPHA_AMD:
+                return PixelFormat::ATC_EXPLICIT_ALPHA;
+            case FK_GL_ATC_RGBA_INTERPOLATED_ALPHA_AMD:
+                return PixelFormat::ATC_INTERPOLATED_ALPHA;
+            default:
+                break;
+        }
+
+        //glType 0 means compressed, matched by internal format, otherwise by format and type
+        for (auto& entry : Texture2D::getPixelFormatInfoMap())
+        {
+            const PixelFormatInfo& info = entry.second;
+            if (header->glType == 0
+                ? (info.compressed && info.internalFormat == header->glInternalFormat)
+                : (!info.compressed && info.format == header->glFormat && info.type == header->glType))
+            {
+                return entry.first;
+            }
+        }
+        return PixelFormat::NONE;
+    }
+
+    static bool isBlockPixelFormat(PixelFormat format)
+    {
+        return format >= PixelFormat::PVRTC4 && format <= PixelFormat::ASTC_12x12;
+    }
+
+    static bool isKTXFormatSupported(PixelFormat format)
+    {
+        if (Texture2D::getPixelFormatInfoMap().find(format) == Texture2D::getPixelFormatInfoMap().end())
+        {
+            return false;
+        }
+        switch (format)
+        {
+            case PixelFormat::S3TC_DXT1:
+            case PixelFormat::S3TC_DXT3:
+            case PixelFormat::S3TC_DXT5:
+                return GPUInfo::getInstance()->supportsS3TC();
+            case PixelFormat::ATC_RGB:
+            case PixelFormat::ATC_EXPLICIT_ALPHA:
+            case PixelFormat::ATC_INTERPOLATED_ALPHA:
+                return GPUInfo::getInstance()->supportsATITC();
+            case PixelFormat::BGRA8888:
+                return GPUInfo::getInstance()->supportsBGRA8888();
+            default:
+                return getDevicePixelFormat(format) == format;
+        }
+    }
+
+    // bytes a level of width x height needs, rows padded to 4 bytes if paddedRows, 0 if the format is unknown
+    static uint64_t getKTXLevelSize(PixelFormat format, int width, int height, bool paddedRows)
+    {
+        uint64_t blocksWide = (width + 3) / 4;
+        uint64_t blocksHigh = (height + 3) / 4;
+        switch (format)
+        {
+            //PVRTC levels are never smaller than 2 x 2 blocks
+            case PixelFormat::PVRTC2:
+            case PixelFormat::PVRTC2A:
+                return (uint64_t)MAX(2, (width + 7) / 8) * MAX(2, (height + 3) / 4) * 8;
+            case PixelFormat::PVRTC4:
+            case PixelFormat::PVRTC4A:
+                return (uint64_t)MAX(2, (width + 3) / 4) * MAX(2, (height + 3) / 4) * 8;
+            case PixelFormat::ETC:
+            case PixelFormat::ETC2_RGB:
+            case PixelFormat::ETC2_RGB_A1:
+            case PixelFormat::S3TC_DXT1:
+            case PixelFormat::ATC_RGB:
+                return blocksWide * blocksHigh * 8;
+            case PixelFormat::ETC2_RGBA:
+            case PixelFormat::S3TC_DXT3:
+            case PixelFormat::S3TC_DXT5:
+            case PixelFormat::ATC_EXPLICIT_ALPHA:
+            case PixelFormat::ATC_INTERPOLATED_ALPHA:
+                return blocksWide * blocksHigh * 16;
+            default:
+                break;
+        }
+        for (size_t i = 0; i < sizeof(ASTCBlockFormats) / sizeof(ASTCBlockFormats[0]); ++i)
+        {
+            if (ASTCBlockFormats[i].format == format)
+            {
+                int blockWidth = ASTCBlockFormats[i].blockWidth;
+                int blockHeight = ASTCBlockFormats[i].blockHeight;
+                return (uint64_t)((width + blockWidth - 1) / blockWidth) * ((height + blockHeight - 1) / blockHeight) * 16;
+            }
+        }
+
+        auto info = Texture2D::getPixelFormatInfoMap().find(format);
+        if (info == Texture2D::getPixelFormatInfoMap().end() || info->second.compressed)
+        {
+            return 0;
+        }
+        //the last row needs no padding
+        uint64_t rowBytes = ((uint64_t)width * info->second.bpp + 7) / 8;
+        uint64_t stride = paddedRows ? (rowBytes + 3) & ~(uint64_t)3 : rowBytes;
+        return stride * (height - 1) + rowBytes;
+    }
+
+    // software fallback for one level of a block format, writes RGBA8888
+    static bool decodeKTXLevel(PixelFormat format, const unsigned char* in, unsigned char* out, int width, int height)
+    {
+        int stride = width * 4;
+        switch (format)
+        {
+            //ETC1 data is valid ETC2 RGB8 data
+            case PixelFormat::ETC:
+            case PixelFormat::ETC2_RGB:
+                return etc2_decode_image(ETC2_FORMAT_RGB8, in, out, width, height, 4, stride) == 0;
+            case PixelFormat::ETC2_RGBA:
+                return etc2_decode_image(ETC2_FORMAT_RGBA8, in, out, width, height, 4, stride) == 0;
+            case PixelFormat::ETC2_RGB_A1:
+                return etc2_decode_image(ETC2_FORMAT_RGB8A1, in, out, width, height, 4, stride) == 0;
+            case PixelFormat::S3TC_DXT1:
+                s3tc_decode(const_cast<unsigned char*>(in), out, width, height, S3TCDecodeFlag::DXT1);
+                return true;
+            case PixelFormat::S3TC_DXT3:
+                s3tc_decode(const_cast<unsigned char*>(in), out, width, height, S3TCDecodeFlag::DXT3);
+                return true;
+            case PixelFormat::S3TC_DXT5:
+                s3tc_decode(const_cast<unsigned char*>(in), out, width, height, S3TCDecodeFlag::DXT5);
+                return true;
+            case PixelFormat::ATC_RGB:
+                atitc_decode_rows(in, out, stride, width, height, 0, (height + 3) / 4, ATITCDecodeFlag::ATC_RGB);
+                return true;
+            case PixelFormat::ATC_EXPLICIT_ALPHA:
+                atitc_decode_rows(in, out, stride, width, height, 0, (height + 3) / 4, ATITCDecodeFlag::ATC_EXPLICIT_ALPHA);
+                return true;
+            case PixelFormat::ATC_INTERPOLATED_ALPHA:
+                atitc_decode_rows(in, out, stride, width, height, 0, (height + 3) / 4, ATITCDecodeFlag::ATC_INTERPOLATED_ALPHA);
+                return true;
+            case PixelFormat::PVRTC2:
+            case PixelFormat::PVRTC2A:
+                PVRTDecompressPVRTC(in, width, height, out, true);
+                return true;
+            case PixelFormat::PVRTC4:
+            case PixelFormat::PVRTC4A:
+                PVRTDecompressPVRTC(in, width, height, out, false);
+                return true;
+            default:
+                for (size_t i = 0; i < sizeof(ASTCBlockFormats) / sizeof(ASTCBlockFormats[0]); ++i)
+                {
+                    if (ASTCBlockFormats[i].format == format)
+                        return astc_decode_image(in, out, width, height, ASTCBlockFormats[i].blockWidth, ASTCBlockFormats[i].blockHeight, stride) == 0;
+                }
+                return false;
+        }
+    }
+}
+//ktx struct end
+
 //////////////////////////////////////////////////////////////////////////
 // Implement Image
 //////////////////////////////////////////////////////////////////////////
@@ -401,48 +831,148 @@ Image::Image()
 , _renderFormat(PixelFormat::NONE)
 , _numberOfMipmaps(0)
 , _hasPremultipliedAlpha(true)
+, _decodeFormat(PixelFormat::AUTO)
+, _pooledData(false)
+, _decodeScale(1)
+, _decodeTargetWidth(0)
+, _decodeTargetHeight(0)
+, _incremental(nullptr)
+, _mipmapData(nullptr)
 {
 
 }
 
 Image::~Image()
 {
+    //an unfinished stream, its pooled data goes below
+    endIncremental(true);
     if(_unpack)
     {
         for (unsigned int i = 0; i < _numberOfMipmaps; ++i)
             FK_SAFE_DELETE_ARRAY(_mipmaps[i].address);
     }
-    else
+    else if (_pooledData)
+        TexUtils::freePixels(_data);
+    else if (!_mappedFile)
         FK_SAFE_FREE(_data);
+    //else _data points into the mapped file, which goes with its last reference
+    FK_SAFE_FREE(_mipmapData);
 }
 
-bool Image::initWithImageFile(const std::string& path)
+bool Image::generateMipmaps(TexUtils::MipmapFilter filter, bool gammaCorrect)
 {
-    bool ret = false;
+    if (_data == nullptr || isCompressed() || _numberOfMipmaps > 1)
+    {
+        FKLOG("flakor: Image: generateMipmaps needs uncompressed data without mipmaps");
+        return false;
+    }
 
-    /*_filePath = FileUtils::getInstance()->fullPathForFilename(path);
-    Data data = FileUtils::getInstance()->getDataFromFile(_filePath);
+    int count = TexUtils::getMipmapCount(_width, _height);
+    if (count > MIPMAP_MAX)
+    {
+        count = MIPMAP_MAX;
+    }
+    if (count == 1)
+    {
+        //1x1, the image is its own chain
+        return true;
+    }
+    size_t size = TexUtils::getMipmapChainSize(_width, _height, _renderFormat, count);
+    if (size == 0)
+    {
+        FKLOG("flakor: Image: generateMipmaps does not support pixel format %d", (int)_renderFormat);
+        return false;
+    }
 
-    if (!data.isNull())
+    unsigned char* chain = static_cast<unsigned char*>(malloc(size));
+    if (chain == nullptr
+        || !TexUtils::buildMipmaps(_data, _width, _height, _renderFormat, count, filter, gammaCorrect, chain))
     {
-        ret = initWithImageData(data.getBytes(), data.getSize());
+        free(chain);
+        return false;
     }
-	*/
 
-    return ret;
+    int bytesPerPixel = TexUtils::getBytesPerPixel(_renderFormat);
+    int width = _width;
+    int height = _height;
+    _mipmaps[0].address = _data;
+    _mipmaps[0].len = static_cast<int>(_dataLen);
+    unsigned char* level = chain;
+    for (int i = 1; i < count; ++i)
+    {
+        width = width > 1 ? width >> 1 : 1;
+        height = height > 1 ? height >> 1 : 1;
+        _mipmaps[i].address = level;
+        _mipmaps[i].len = width * height * bytesPerPixel;
+        level += _mipmaps[i].len;
+    }
+    _mipmapData = chain;
+    _numberOfMipmaps = count;
+    return true;
+}
+
+std::shared_future<bool> Image::generateMipmapsAsync(TexUtils::MipmapFilter filter, bool gammaCorrect)
+{
+    std::shared_ptr<std::promise<bool> > promise = std::make_shared<std::promise<bool> >();
+    std::shared_future<bool> result = promise->get_future().share();
+    ThreadPool::getInstance()->enqueue([this, filter, gammaCorrect, promise]() {
+        promise->set_value(generateMipmaps(filter, gammaCorrect));
+    });
+    return result;
+}
+
+void Image::setDecodeScale(int scale)
+{
+    //the DCT only scales by 1/2, 1/4 and 1/8, round down to one of those
+    _decodeScale = scale >= 8 ? 8 : scale >= 4 ? 4 : scale >= 2 ? 2 : 1;
+    _decodeTargetWidth = 0;
+    _decodeTargetHeight = 0;
+}
+
+void Image::setDecodeTargetSize(int width, int height)
+{
+    _decodeScale = 0;
+    _decodeTargetWidth = width;
+    _decodeTargetHeight = height;
+}
+
+bool Image::initWithImageFile(const std::string& path, PixelFormat format)
+{
+    //_filePath = FileUtils::getInstance()->fullPathForFilename(path);
+    _decodeFormat = format;
+    return initWithImageFileThreadSafe(path);
 }
 
 bool Image::initWithImageFileThreadSafe(const std::string& fullpath)
 {
-    bool ret = false;
     _filePath = fullpath;
 
-    return ret;
+    std::shared_ptr<MappedFile> file = MappedFile::create(fullpath);
+    if (!file)
+    {
+        FKLOG("flakor: can't open %s", fullpath.c_str());
+        return false;
+    }
+
+    if (isKTX(file->getData(), file->getSize()))
+    {
+        //keep the mapping, the mipmaps point straight into it
+        _mappedFile = file;
+        _fileType = Format::KTX;
+        ImageCodecRegistry* codecs = ImageCodecRegistry::getInstance();
+        return codecs->decode(codecs->findCodec(Format::KTX), this, file->getData(), file->getSize());
+    }
+
+    //every other format decodes or copies out of the file front to back,
+    //the kernel can read ahead while the decoder works
+    file->adviseSequential();
+    return initWithImageData(file->getData(), file->getSize(), _decodeFormat);
 }
 
-bool Image::initWithImageData(const unsigned char * data, ssize_t dataLen)
+bool Image::initWithImageData(const unsigned char * data, ssize_t dataLen, PixelFormat format)
 {
     bool ret = false;
+    _decodeFormat = format;
     
     do
     {
@@ -466,51 +996,21 @@ bool Image::initWithImageData(const unsigned char * data, ssize_t dataLen)
             unpackedLen = dataLen;
         //}
 
-        _fileType = detectFormat(unpackedData, unpackedLen);
-
-        switch (_fileType)
+        ImageCodecRegistry* codecs = ImageCodecRegistry::getInstance();
+        const ImageCodec* codec = codecs->findCodec(unpackedData, unpackedLen);
+        _fileType = codec ? codec->format : Format::UNKOWN;
+        if (codec == nullptr)
         {
-        case Format::PNG:
-            ret = initWithPngData(unpackedData, unpackedLen);
-            break;
-        case Format::JPG:
-            ret = initWithJpgData(unpackedData, unpackedLen);
-            break;
-        case Format::TIFF:
-            ret = initWithTiffData(unpackedData, unpackedLen);
-            break;
-        case Format::WEBP:
-            ret = initWithWebpData(unpackedData, unpackedLen);
-            break;
-        case Format::PVR:
-            ret = initWithPVRData(unpackedData, unpackedLen);
-            break;
-        case Format::ETC:
-            ret = initWithETCData(unpackedData, unpackedLen);
-            break;
-        case Format::S3TC:
-            ret = initWithS3TCData(unpackedData, unpackedLen);
-            break;
-        case Format::ATITC:
-            ret = initWithATITCData(unpackedData, unpackedLen);
-            break;
-        default:
-            {
-                // load and detect image format
-                tImageTGA* tgaData = tgaLoadBuffer(unpackedData, unpackedLen);
-                
-                if (tgaData != nullptr && tgaData->status == TGA_OK)
-                {
-                    ret = initWithTGAData(tgaData);
-                }
-                else
-                {
-                    FKAssert(false, "unsupport image format!");
-                }
-                
-                free(tgaData);
-                break;
-            }
+            // no signature matched, try the format that has none
+            codec = codecs->getFallback();
+        }
+        if (codec != nullptr)
+        {
+            ret = codecs->decode(codec, this, unpackedData, unpackedLen);
+        }
+        else
+        {
+            FKAssert(false, "unsupport image format!");
         }
         
         if(unpackedData != data)
@@ -537,7 +1037,11 @@ bool Image::isPng(const unsigned char * data, ssize_t dataLen)
 
 bool Image::isEtc(const unsigned char * data, ssize_t dataLen)
 {
-    return etc1_pkm_is_valid((etc1_byte*)data) ? true : false;
+    if (dataLen < ETC_PKM_HEADER_SIZE)
+    {
+        return false;
+    }
+    return (etc1_pkm_is_valid((etc1_byte*)data) || etc2_pkm_is_valid((etc1_byte*)data)) ? true : false;
 }
 
 
@@ -556,7 +1060,12 @@ bool Image::isS3TC(const unsigned char * data, ssize_t dataLen)
 
 bool Image::isATITC(const unsigned char *data, ssize_t dataLen)
 {
-    ATITCTexHeader *header = (ATITCTexHeader *)data;
+    if (dataLen < static_cast<ssize_t>(sizeof(ATITCTexHeader)))
+    {
+        return false;
+    }
+
+    const ATITCTexHeader *header = reinterpret_cast<const ATITCTexHeader*>(data);
     
     if (strncmp(&header->identifier[1], "KTX", 3) != 0)
     {
@@ -566,6 +1075,33 @@ bool Image::isATITC(const unsigned char *data, ssize_t dataLen)
     return true;
 }
 
+bool Image::isASTC(const unsigned char *data, ssize_t dataLen)
+{
+    if (dataLen < ASTC_HEADER_SIZE)
+    {
+        return false;
+    }
+    return astc_header_is_valid(data) ? true : false;
+}
+
+bool Image::isUTEX(const unsigned char *data, ssize_t dataLen)
+{
+    if (dataLen < UTEX_HEADER_SIZE)
+    {
+        return false;
+    }
+    return utex_header_is_valid(data, static_cast<uint32_t>(dataLen)) ? true : false;
+}
+
+bool Image::isKTX(const unsigned char *data, ssize_t dataLen)
+{
+    if (dataLen >= static_cast<ssize_t>(sizeof(KTX2TexHeader)) && memcmp(data, gKTX2Identifier, sizeof(gKTX2Identifier)) == 0)
+    {
+        return true;
+    }
+    return dataLen >= static_cast<ssize_t>(sizeof(ATITCTexHeader)) && memcmp(data, gKTX1Identifier, sizeof(gKTX1Identifier)) == 0;
+}
+
 bool Image::isJpg(const unsigned char * data, ssize_t dataLen)
 {
     if (dataLen <= 4)
@@ -621,44 +1157,109 @@ bool Image::isPvr(const unsigned char * data, ssize_t dataLen)
 
 Image::Format Image::detectFormat(const unsigned char * data, ssize_t dataLen)
 {
-    if (isPng(data, dataLen))
-    {
-        return Format::PNG;
-    }
-    else if (isJpg(data, dataLen))
-    {
-        return Format::JPG;
-    }
-    else if (isTiff(data, dataLen))
-    {
-        return Format::TIFF;
-    }
-    else if (isWebp(data, dataLen))
-    {
-        return Format::WEBP;
+    const ImageCodec* codec = ImageCodecRegistry::getInstance()->findCodec(data, dataLen);
+    return codec ? codec->format : Format::UNKOWN;
+}
+
+namespace
+{
+    ImageCodec makeCodec(const char* name, Image::Format format, ImageCodec::Probe probe, ImageCodec::Decode decode)
+    {
+        ImageCodec codec;
+        codec.name = name;
+        codec.format = format;
+        codec.probe = probe;
+        codec.decode = decode;
+        codec.appendStream = nullptr;
+        return codec;
     }
-    else if (isPvr(data, dataLen))
+
+    void addSignature(ImageCodec& codec, size_t offset, const char* bytes, size_t length)
     {
-        return Format::PVR;
-    }
-    else if (isEtc(data, dataLen))
-    {
-        return Format::ETC;
-    }
-    else if (isS3TC(data, dataLen))
-    {
-        return Format::S3TC;
-    }
-    else if (isATITC(data, dataLen))
-    {
-        return Format::ATITC;
-    }
-    else
-    {
-        return Format::UNKOWN;
+        ImageSignature signature;
+        signature.offset = offset;
+        signature.bytes.assign(bytes, length);
+        codec.signatures.push_back(signature);
     }
 }
 
+void Image::registerCodecs(ImageCodecRegistry* registry)
+{
+    // in the order formats used to be tried. ATITC files are KTX files, the
+    // ktx codec decodes ATC, so ATITC has no codec of its own
+    ImageCodec png = makeCodec("png", Format::PNG, &Image::isPng,
+            [](Image* image, const unsigned char* data, ssize_t dataLen) { return image->initWithPngData(data, dataLen); });
+    addSignature(png, 0, "\x89PNG\r\n\x1a\n", 8);
+    registry->registerCodec(png);
+
+    ImageCodec jpg = makeCodec("jpg", Format::JPG, &Image::isJpg,
+            [](Image* image, const unsigned char* data, ssize_t dataLen) { return image->initWithJpgData(data, dataLen); });
+    addSignature(jpg, 0, "\xff\xd8", 2);
+    registry->registerCodec(jpg);
+
+    ImageCodec tiff = makeCodec("tiff", Format::TIFF, &Image::isTiff,
+            [](Image* image, const unsigned char* data, ssize_t dataLen) { return image->initWithTiffData(data, dataLen); });
+    addSignature(tiff, 0, "II*\0", 4);
+    addSignature(tiff, 0, "MM\0*", 4);
+    registry->registerCodec(tiff);
+
+    ImageCodec webp = makeCodec("webp", Format::WEBP, &Image::isWebp,
+            [](Image* image, const unsigned char* data, ssize_t dataLen) { return image->initWithWebpData(data, dataLen); });
+    webp.appendStream = [](Image* image, const unsigned char* data, ssize_t dataLen) { return image->updateWebpData(data, dataLen, true); };
+    addSignature(webp, 0, "RIFF", 4);
+    registry->registerCodec(webp);
+
+    ImageCodec pvr = makeCodec("pvr", Format::PVR, &Image::isPvr,
+            [](Image* image, const unsigned char* data, ssize_t dataLen) { return image->initWithPVRData(data, dataLen); });
+    addSignature(pvr, 0, "PVR\3", 4);
+    // v2 keeps its tag in the header, after the sizes
+    addSignature(pvr, offsetof(PVRv2TexHeader, pvrTag), gPVRTexIdentifier, 4);
+    registry->registerCodec(pvr);
+
+    ImageCodec etc = makeCodec("etc", Format::ETC, &Image::isEtc,
+            [](Image* image, const unsigned char* data, ssize_t dataLen) { return image->initWithETCData(data, dataLen); });
+    addSignature(etc, 0, "PKM ", 4);
+    registry->registerCodec(etc);
+
+    ImageCodec astc = makeCodec("astc", Format::ASTC, &Image::isASTC,
+            [](Image* image, const unsigned char* data, ssize_t dataLen) { return image->initWithASTCData(data, dataLen); });
+    addSignature(astc, 0, "\x13\xab\xa1\x5c", 4);
+    registry->registerCodec(astc);
+
+    ImageCodec utex = makeCodec("utex", Format::UTEX, &Image::isUTEX,
+            [](Image* image, const unsigned char* data, ssize_t dataLen) { return image->initWithUTEXData(data, dataLen); });
+    addSignature(utex, 0, "UTEX", 4);
+    registry->registerCodec(utex);
+
+    ImageCodec s3tc = makeCodec("s3tc", Format::S3TC, &Image::isS3TC,
+            [](Image* image, const unsigned char* data, ssize_t dataLen) { return image->initWithS3TCData(data, dataLen); });
+    addSignature(s3tc, 0, "DDS ", 4);
+    registry->registerCodec(s3tc);
+
+    ImageCodec ktx = makeCodec("ktx", Format::KTX, &Image::isKTX,
+            [](Image* image, const unsigned char* data, ssize_t dataLen) { return image->initWithKTXData(data, dataLen); });
+    addSignature(ktx, 0, "\xabKTX", 4);
+    registry->registerCodec(ktx);
+
+    // no magic number, the loader is the probe
+    ImageCodec tga = makeCodec("tga", Format::TGA, nullptr,
+            [](Image* image, const unsigned char* data, ssize_t dataLen) {
+                bool ret = false;
+                tImageTGA* tgaData = tgaLoadBuffer(const_cast<unsigned char*>(data), dataLen);
+                if (tgaData != nullptr && tgaData->status == TGA_OK)
+                {
+                    ret = image->initWithTGAData(tgaData);
+                }
+                else
+                {
+                    FKAssert(false, "unsupport image format!");
+                }
+                free(tgaData);
+                return ret;
+            });
+    registry->registerCodec(tga);
+}
+
 int Image::getBitPerPixel()
 {
     return Texture2D::getPixelFormatInfoMap().at(_renderFormat).bpp;
@@ -730,6 +1331,33 @@ namespace
         /* Return control to the setjmp point */
         longjmp(myerr->setjmp_buffer, 1);
     }
+
+    /*
+     * Denominator of the DCT scale for a width x height image: scale if it
+     * is set, otherwise the largest one whose output still covers the target.
+     * Then raised until the output fits in maxSize, as far as 1/8 goes.
+     */
+    int getJpgScaleDenom(int width, int height, int scale, int targetWidth, int targetHeight, int maxSize)
+    {
+        int denom = scale;
+        if (denom == 0)
+        {
+            denom = 1;
+            /* libjpeg rounds the scaled size up */
+            while (denom < 8 && (targetWidth > 0 || targetHeight > 0)
+                   && (targetWidth <= 0 || (width + denom * 2 - 1) / (denom * 2) >= targetWidth)
+                   && (targetHeight <= 0 || (height + denom * 2 - 1) / (denom * 2) >= targetHeight))
+            {
+                denom *= 2;
+            }
+        }
+        while (maxSize > 0 && denom < 8
+               && ((width + denom - 1) / denom > maxSize || (height + denom - 1) / denom > maxSize))
+        {
+            denom *= 2;
+        }
+        return denom;
+    }
 #endif // FK_USE_JPEG
 }
 
@@ -788,6 +1416,12 @@ bool Image::initWithJpgData(const unsigned char * data, ssize_t dataLen)
             _renderFormat = PixelFormat::RGB888;
         }
 
+        /* scale down in the IDCT, the full size image is never produced */
+        cinfo.scale_num = 1;
+        cinfo.scale_denom = getJpgScaleDenom(cinfo.image_width, cinfo.image_height, _decodeScale,
+                                             _decodeTargetWidth, _decodeTargetHeight,
+                                             GPUInfo::getInstance()->getMaxTextureSize());
+
         /* Start decompression jpeg here */
         jpeg_start_decompress( &cinfo );
 
@@ -834,6 +1468,9 @@ bool Image::initWithPngData(const unsigned char * data, ssize_t dataLen)
     png_byte        header[PNGSIGSIZE]   = {0}; 
     png_structp     png_ptr     =   0;
     png_infop       info_ptr    = 0;
+    // freed after the loop, png errors longjmp past the normal path
+    unsigned char* volatile scratch = nullptr;
+    png_bytep* volatile row_pointers = nullptr;
 
     do 
     {
@@ -903,6 +1540,9 @@ bool Image::initWithPngData(const unsigned char * data, ssize_t dataLen)
         {
             png_set_packing(png_ptr);
         }
+        // let libpng put interlaced rows together, rows only come out whole after the last pass
+        int passes = png_set_interlace_handling(png_ptr);
+
         // update info
         png_read_update_info(png_ptr, info_ptr);
         bit_depth = png_get_bit_depth(png_ptr, info_ptr);
@@ -926,49 +1566,72 @@ bool Image::initWithPngData(const unsigned char * data, ssize_t dataLen)
             break;
         }
 
-        // read png data
-        png_size_t rowbytes;
-        png_bytep* row_pointers = (png_bytep*)malloc( sizeof(png_bytep) * _height );
-
-        rowbytes = png_get_rowbytes(png_ptr, info_ptr);
-
-        _dataLen = rowbytes * _height;
-        _data = static_cast<unsigned char*>(malloc(_dataLen * sizeof(unsigned char)));
-        if (!_data)
+        // read png data, one pass into the render format
+        PixelFormat sourceFormat = _renderFormat;
+        PixelFormat format = TexUtils::getConvertedFormat(sourceFormat, _decodeFormat);
+        png_size_t rowbytes = png_get_rowbytes(png_ptr, info_ptr);
+
+        RowSink sink;
+        sink.originFormat = sourceFormat;
+        sink.format = format;
+        sink.premultiply = color_type == PNG_COLOR_TYPE_RGB_ALPHA;
+        sink.width = _width;
+        sink.outRowBytes = (size_t)_width * TexUtils::getBytesPerPixel(format);
+
+        _dataLen = sink.outRowBytes * _height;
+        _data = TexUtils::allocPixels(_dataLen);
+        FK_BREAK_IF(!_data);
+        _pooledData = true;
+        sink.out = _data;
+
+        if (passes == 1)
         {
-            if (row_pointers != nullptr)
+            // rows come in order, each one goes straight into the image when the
+            // format stays or through a scratch row otherwise
+            if (format != sourceFormat)
             {
-                free(row_pointers);
+                scratch = TexUtils::allocPixels(rowbytes);
+                FK_BREAK_IF(!scratch);
+            }
+            for (int y = 0; y < _height; ++y)
+            {
+                unsigned char* row = scratch ? scratch : _data + y * rowbytes;
+                png_read_row(png_ptr, row, nullptr);
+                writeRow(sink, row, y);
             }
-            break;
         }
-
-        for (unsigned short i = 0; i < _height; ++i)
+        else
         {
-            row_pointers[i] = _data + i*rowbytes;
+            unsigned char* image = _data;
+            if (format != sourceFormat)
+            {
+                scratch = TexUtils::allocPixels(rowbytes * _height);
+                FK_BREAK_IF(!scratch);
+                image = scratch;
+            }
+            row_pointers = (png_bytep*)malloc( sizeof(png_bytep) * _height );
+            FK_BREAK_IF(!row_pointers);
+            for (int y = 0; y < _height; ++y)
+            {
+                row_pointers[y] = image + y * rowbytes;
+            }
+            png_read_image(png_ptr, row_pointers);
+            for (int y = 0; y < _height; ++y)
+            {
+                writeRow(sink, row_pointers[y], y);
+            }
         }
-        png_read_image(png_ptr, row_pointers);
 
         png_read_end(png_ptr, nullptr);
 
-        // premultiplied alpha for RGBA8888
-        if (color_type == PNG_COLOR_TYPE_RGB_ALPHA)
-        {
-            premultipliedAlpha();
-        }
-        else
-        {
-            _hasPremultipliedAlpha = false;
-        }
-
-        if (row_pointers != nullptr)
-        {
-            free(row_pointers);
-        }
+        _renderFormat = format;
+        _hasPremultipliedAlpha = sink.premultiply;
 
         ret = true;
     } while (0);
 
+    TexUtils::freePixels(scratch);
+    free(row_pointers);
     if (png_ptr)
     {
         png_destroy_read_struct(&png_ptr, (info_ptr) ? &info_ptr : 0, 0);
@@ -1526,6 +2189,12 @@ bool Image::initWithETCData(const unsigned char * data, ssize_t dataLen)
 {
     const etc1_byte* header = static_cast<const etc1_byte*>(data);
     
+    //version 2.0 PKM holds ETC2 / EAC data
+    if (etc2_pkm_is_valid(header))
+    {
+        return initWithETC2Data(data, dataLen);
+    }
+
     //check the data
     if (! etc1_pkm_is_valid(header))
     {
@@ -1578,6 +2247,69 @@ bool Image::initWithETCData(const unsigned char * data, ssize_t dataLen)
     return false;
 }
 
+bool Image::initWithETC2Data(const unsigned char * data, ssize_t dataLen)
+{
+    const etc1_byte* header = static_cast<const etc1_byte*>(data);
+    etc2_format format = etc2_pkm_get_format(header);
+
+    _width = etc1_pkm_get_width(header);
+    _height = etc1_pkm_get_height(header);
+
+    if (0 == _width || 0 == _height)
+    {
+        return false;
+    }
+
+    ssize_t encodedLen = etc2_get_encoded_data_size(format, _width, _height);
+    if (dataLen - ETC_PKM_HEADER_SIZE < encodedLen)
+    {
+        FKLOG("flakor: ETC2 data is truncated");
+        return false;
+    }
+
+    //ETC2 data is not premultiplied, alpha formats are blended as such
+    _hasPremultipliedAlpha = false;
+
+    if (GPUInfo::getInstance()->supportsETC2())
+    {
+        switch (format)
+        {
+            case ETC2_FORMAT_RGBA8:
+                _renderFormat = PixelFormat::ETC2_RGBA;
+                break;
+            case ETC2_FORMAT_RGB8A1:
+                _renderFormat = PixelFormat::ETC2_RGB_A1;
+                break;
+            default:
+                _renderFormat = PixelFormat::ETC2_RGB;
+                break;
+        }
+        _dataLen = encodedLen;
+        _data = static_cast<unsigned char*>(malloc(_dataLen * sizeof(unsigned char)));
+        memcpy(_data, static_cast<const unsigned char*>(data) + ETC_PKM_HEADER_SIZE, _dataLen);
+        return true;
+    }
+
+    FKLOG("flakor: Hardware ETC2 decoder not present. Using software decoder");
+
+    //decode by software, keep alpha only when the format has it
+    int bytePerPixel = (format == ETC2_FORMAT_RGB8) ? 3 : 4;
+    unsigned int stride = _width * bytePerPixel;
+    _renderFormat = (bytePerPixel == 3) ? PixelFormat::RGB888 : PixelFormat::RGBA8888;
+
+    _dataLen = _width * _height * bytePerPixel;
+    _data = static_cast<unsigned char*>(malloc(_dataLen * sizeof(unsigned char)));
+
+    if (etc2_decode_image(format, static_cast<const unsigned char*>(data) + ETC_PKM_HEADER_SIZE, static_cast<etc1_byte*>(_data), _width, _height, bytePerPixel, stride) != 0)
+    {
+        _dataLen = 0;
+        FK_SAFE_FREE(_data);
+        return false;
+    }
+
+    return true;
+}
+
 bool Image::initWithTGAData(tImageTGA* tgaData)
 {
     bool ret = false;
@@ -1896,25 +2628,24 @@ bool Image::initWithATITCData(const unsigned char *data, ssize_t dataLen)
             unsigned int stride = width * bytePerPixel;
             _renderFormat = PixelFormat::RGBA8888;
             
-            std::vector<unsigned char> decodeImageData(stride * height);
+            ATITCDecodeFlag decodeFlag = ATITCDecodeFlag::ATC_RGB;
             switch (header->glInternalFormat)
             {
-                case FK_GL_ATC_RGB_AMD:
-                    atitc_decode(pixelData + encodeOffset, &decodeImageData[0], width, height, ATITCDecodeFlag::ATC_RGB);
-                    break;
                 case FK_GL_ATC_RGBA_EXPLICIT_ALPHA_AMD:
-                    atitc_decode(pixelData + encodeOffset, &decodeImageData[0], width, height, ATITCDecodeFlag::ATC_EXPLICIT_ALPHA);
+                    decodeFlag = ATITCDecodeFlag::ATC_EXPLICIT_ALPHA;
                     break;
                 case FK_GL_ATC_RGBA_INTERPOLATED_ALPHA_AMD:
-                    atitc_decode(pixelData + encodeOffset, &decodeImageData[0], width, height, ATITCDecodeFlag::ATC_INTERPOLATED_ALPHA);
+                    decodeFlag = ATITCDecodeFlag::ATC_INTERPOLATED_ALPHA;
                     break;
                 default:
                     break;
             }
 
+            //decode straight into this level's slot of _data, no staging copy
             _mipmaps[i].address = (unsigned char *)_data + decodeOffset;
             _mipmaps[i].len = (stride * height);
-            memcpy((void *)_mipmaps[i].address, (void *)&decodeImageData[0], _mipmaps[i].len);
+            atitc_decode_rows(pixelData + encodeOffset, _mipmaps[i].address, stride, width, height,
+                              0, (height + 3) / 4, decodeFlag);
             decodeOffset += stride * height;
         }
 
@@ -1927,56 +2658,622 @@ bool Image::initWithATITCData(const unsigned char *data, ssize_t dataLen)
     return true;
 }
 
+bool Image::initWithASTCData(const unsigned char *data, ssize_t dataLen)
+{
+    /* load the .astc file, one 2D level */
+    int blockWidth = astc_header_get_block_width(data);
+    int blockHeight = astc_header_get_block_height(data);
+    _width = astc_header_get_width(data);
+    _height = astc_header_get_height(data);
+
+    ssize_t encodedLen = astc_get_encoded_data_size(blockWidth, blockHeight, _width, _height);
+    if (dataLen - ASTC_HEADER_SIZE < encodedLen)
+    {
+        FKLOG("flakor: ASTC data is truncated");
+        return false;
+    }
+
+    //ASTC data is not premultiplied
+    _hasPremultipliedAlpha = false;
+
+    if (GPUInfo::getInstance()->supportsASTC())
+    {
+        _renderFormat = getASTCPixelFormat(blockWidth, blockHeight);
+        _dataLen = encodedLen;
+        _data = static_cast<unsigned char*>(malloc(_dataLen * sizeof(unsigned char)));
+        memcpy(_data, data + ASTC_HEADER_SIZE, _dataLen);
+        return true;
+    }
+
+    FKLOG("flakor: Hardware ASTC decoder not present. Using software decoder");
+
+    //decode by software, block rows are spread over the thread pool
+    int bytePerPixel = 4;
+    unsigned int stride = _width * bytePerPixel;
+    _renderFormat = PixelFormat::RGBA8888;
+
+    _dataLen = _width * _height * bytePerPixel;
+    _data = static_cast<unsigned char*>(malloc(_dataLen * sizeof(unsigned char)));
+
+    if (astc_decode_image(data + ASTC_HEADER_SIZE, _data, _width, _height, blockWidth, blockHeight, stride) != 0)
+    {
+        _dataLen = 0;
+        FK_SAFE_FREE(_data);
+        return false;
+    }
+
+    return true;
+}
+
+bool Image::initWithUTEXData(const unsigned char *data, ssize_t dataLen)
+{
+    /* load the .utex file, every level is inflated and transcoded to a format the GPU takes */
+    bool hasAlpha = (utex_header_get_flags(data) & UTEX_FLAG_ALPHA) != 0;
+    _width = utex_header_get_width(data);
+    _height = utex_header_get_height(data);
+    _numberOfMipmaps = utex_header_get_levels(data);
+
+    //utex data is not premultiplied
+    _hasPremultipliedAlpha = false;
+
+    utex_target target = getUTEXTarget(hasAlpha, _renderFormat);
+    if (target == UTEX_TARGET_RGBA8888 || target == UTEX_TARGET_RGB565)
+    {
+        FKLOG("flakor: No hardware block format for universal texture. Transcoding to uncompressed");
+    }
+
+    /* levels are stored back to back in _data */
+    int width = _width;
+    int height = _height;
+    _dataLen = 0;
+    for (int i = 0; i < _numberOfMipmaps; ++i)
+    {
+        _mipmaps[i].len = utex_get_transcoded_size(target, width, height);
+        _dataLen += _mipmaps[i].len;
+        width = MAX(1, width >> 1);
+        height = MAX(1, height >> 1);
+    }
+    _data = static_cast<unsigned char*>(malloc(_dataLen * sizeof(unsigned char)));
+
+    ssize_t offset = 0;
+    for (int i = 0; i < _numberOfMipmaps; ++i)
+    {
+        _mipmaps[i].address = _data + offset;
+        offset += _mipmaps[i].len;
+    }
+
+    /* levels are independent, inflate and transcode them on the thread pool */
+    std::atomic<bool> failed(false);
+    ThreadPool::getInstance()->parallelFor(0, _numberOfMipmaps, [&](int level) {
+        uint32_t levelWidth = MAX(1, _width >> level);
+        uint32_t levelHeight = MAX(1, _height >> level);
+        uint32_t stride = levelWidth * (target == UTEX_TARGET_RGB565 ? 2 : 4);
+        std::vector<unsigned char> slice(utex_get_slice_size(levelWidth, levelHeight, hasAlpha));
+        if (utex_inflate_level(data, static_cast<uint32_t>(dataLen), level, &slice[0]) != 0
+            || utex_transcode_level(&slice[0], hasAlpha, levelWidth, levelHeight, target, _mipmaps[level].address, stride) != 0)
+        {
+            failed = true;
+        }
+    });
+
+    if (failed)
+    {
+        FKLOG("flakor: universal texture data is corrupt");
+        _dataLen = 0;
+        _numberOfMipmaps = 0;
+        FK_SAFE_FREE(_data);
+        return false;
+    }
+
+    return true;
+}
+
+bool Image::initWithKTXData(const unsigned char *data, ssize_t dataLen)
+{
+    /* find the format and where each level is in the file */
+    PixelFormat format = PixelFormat::NONE;
+    ssize_t offsets[KTX_MAX_LEVELS];
+    ssize_t sizes[KTX_MAX_LEVELS];
+    bool paddedRows = false;
+
+    if (memcmp(data, gKTX2Identifier, sizeof(gKTX2Identifier)) == 0)
+    {
+        const KTX2TexHeader *header = reinterpret_cast<const KTX2TexHeader*>(data);
+        if (header->supercompressionScheme != 0 || header->pixelDepth > 1 || header->layerCount > 1 || header->faceCount != 1)
+        {
+            FKLOG("flakor: only plain 2D KTX2 textures are supported");
+            return false;
+        }
+        _numberOfMipmaps = MAX(1, header->levelCount);
+        if (_numberOfMipmaps > KTX_MAX_LEVELS
+            || dataLen < static_cast<ssize_t>(sizeof(KTX2TexHeader) + _numberOfMipmaps * sizeof(KTX2LevelIndex)))
+        {
+            return false;
+        }
+        format = getKTX2PixelFormat(header->vkFormat);
+        _width = header->pixelWidth;
+        _height = header->pixelHeight;
+
+        const KTX2LevelIndex *index = reinterpret_cast<const KTX2LevelIndex*>(data + sizeof(KTX2TexHeader));
+        for (int i = 0; i < _numberOfMipmaps; ++i)
+        {
+            if (index[i].byteOffset > static_cast<uint64_t>(dataLen) || index[i].byteLength > dataLen - index[i].byteOffset)
+            {
+                FKLOG("flakor: KTX2 data is truncated");
+                return false;
+            }
+            offsets[i] = static_cast<ssize_t>(index[i].byteOffset);
+            sizes[i] = static_cast<ssize_t>(index[i].byteLength);
+        }
+    }
+    else
+    {
+        const ATITCTexHeader *header = reinterpret_cast<const ATITCTexHeader*>(data);
+        if (header->endianness != KTX_ENDIANNESS)
+        {
+            FKLOG("flakor: big endian KTX files are not supported");
+            return false;
+        }
+        if (header->pixelDepth > 1 || header->numberOfArrayElements > 1 || header->numberOfFaces != 1)
+        {
+            FKLOG("flakor: only plain 2D KTX textures are supported");
+            return false;
+        }
+        _numberOfMipmaps = MAX(1, header->numberOfMipmapLevels);
+        if (_numberOfMipmaps > KTX_MAX_LEVELS)
+        {
+            return false;
+        }
+        format = getKTX1PixelFormat(header);
+        paddedRows = header->glType != 0;
+        _width = header->pixelWidth;
+        _height = header->pixelHeight;
+
+        //each level is a 4 byte size followed by the data, padded to 4 bytes
+        ssize_t offset = sizeof(ATITCTexHeader) + header->bytesOfKeyValueData;
+        for (int i = 0; i < _numberOfMipmaps; ++i)
+        {
+            uint32_t imageSize = 0;
+            if (offset + 4 > dataLen)
+            {
+                FKLOG("flakor: KTX data is truncated");
+                return false;
+            }
+            memcpy(&imageSize, data + offset, 4);
+            offset += 4;
+            if (imageSize > dataLen - offset)
+            {
+                FKLOG("flakor: KTX data is truncated");
+                return false;
+            }
+            offsets[i] = offset;
+            sizes[i] = imageSize;
+            offset += (imageSize + 3) & ~3;
+        }
+    }
+
+    if (PixelFormat::NONE == format || _width <= 0 || _height <= 0)
+    {
+        FKLOG("flakor: unsupported KTX texture format");
+        _numberOfMipmaps = 0;
+        return false;
+    }
+
+    //the decoders and glTexImage2D read as much as the size of the level asks for, whatever the file says
+    bool unalignedRows = false;
+    for (int i = 0; i < _numberOfMipmaps; ++i)
+    {
+        int width = MAX(1, _width >> i);
+        int height = MAX(1, _height >> i);
+        uint64_t levelSize = getKTXLevelSize(format, width, height, paddedRows);
+        if (levelSize == 0 || static_cast<uint64_t>(sizes[i]) < levelSize)
+        {
+            FKLOG("flakor: KTX level %d is too short for %dx%d", i, width, height);
+            _numberOfMipmaps = 0;
+            return false;
+        }
+        if (paddedRows && height > 1 && getKTXLevelSize(format, width, 1, false) % 4 != 0)
+        {
+            unalignedRows = true;
+        }
+    }
+
+    //no way to tell from the header, KTX tools write straight alpha
+    _hasPremultipliedAlpha = false;
+
+    if (isKTXFormatSupported(format))
+    {
+        _renderFormat = format;
+        if (_mappedFile && !unalignedRows)
+        {
+            //zero copy, the levels are read from the mapping when Texture2D uploads them
+            for (int i = 0; i < _numberOfMipmaps; ++i)
+            {
+                _mipmaps[i].address = const_cast<unsigned char*>(data) + offsets[i];
+                _mipmaps[i].len = static_cast<int>(sizes[i]);
+            }
+            _data = _mipmaps[0].address;
+            _dataLen = _mipmaps[0].len;
+            return true;
+        }
+
+        //keep one copy of the levels. KTX 1 pads uncompressed rows to 4 bytes,
+        //Texture2D reads them packed, so rows that aren't aligned are packed here
+        ssize_t levelSizes[KTX_MAX_LEVELS];
+        _dataLen = 0;
+        for (int i = 0; i < _numberOfMipmaps; ++i)
+        {
+            int width = MAX(1, _width >> i);
+            int height = MAX(1, _height >> i);
+            levelSizes[i] = unalignedRows ? static_cast<ssize_t>(getKTXLevelSize(format, width, height, false)) : sizes[i];
+            _dataLen += levelSizes[i];
+        }
+        _data = static_cast<unsigned char*>(malloc(_dataLen * sizeof(unsigned char)));
+        ssize_t offset = 0;
+        for (int i = 0; i < _numberOfMipmaps; ++i)
+        {
+            _mipmaps[i].address = _data + offset;
+            _mipmaps[i].len = static_cast<int>(levelSizes[i]);
+            if (unalignedRows)
+            {
+                int height = MAX(1, _height >> i);
+                size_t rowBytes = static_cast<size_t>(getKTXLevelSize(format, MAX(1, _width >> i), 1, false));
+                size_t stride = (rowBytes + 3) & ~static_cast<size_t>(3);
+                for (int y = 0; y < height; ++y)
+                {
+                    memcpy(_mipmaps[i].address + y * rowBytes, data + offsets[i] + y * stride, rowBytes);
+                }
+            }
+            else
+            {
+                memcpy(_mipmaps[i].address, data + offsets[i], levelSizes[i]);
+            }
+            offset += levelSizes[i];
+        }
+        //nothing points into the file any more
+        _mappedFile.reset();
+        return true;
+    }
+
+    if (!isBlockPixelFormat(format))
+    {
+        FKLOG("flakor: KTX pixel format is not supported by the GPU");
+        _numberOfMipmaps = 0;
+        return false;
+    }
+
+    FKLOG("flakor: Hardware decoder for the KTX format not present. Using software decoder");
+
+    _renderFormat = PixelFormat::RGBA8888;
+    _dataLen = 0;
+    for (int i = 0; i < _numberOfMipmaps; ++i)
+    {
+        _dataLen += MAX(1, _width >> i) * MAX(1, _height >> i) * 4;
+    }
+    _data = static_cast<unsigned char*>(malloc(_dataLen * sizeof(unsigned char)));
+
+    ssize_t decodeOffset = 0;
+    for (int i = 0; i < _numberOfMipmaps; ++i)
+    {
+        int width = MAX(1, _width >> i);
+        int height = MAX(1, _height >> i);
+        _mipmaps[i].address = _data + decodeOffset;
+        _mipmaps[i].len = width * height * 4;
+        if (!decodeKTXLevel(format, data + offsets[i], _mipmaps[i].address, width, height))
+        {
+            _dataLen = 0;
+            _numberOfMipmaps = 0;
+            FK_SAFE_FREE(_data);
+            return false;
+        }
+        decodeOffset += _mipmaps[i].len;
+    }
+
+    //nothing points into the file any more
+    _mappedFile.reset();
+    return true;
+}
+
 bool Image::initWithPVRData(const unsigned char * data, ssize_t dataLen)
 {
     return initWithPVRv2Data(data, dataLen) || initWithPVRv3Data(data, dataLen);
 }
 
+// Decoder state between beginImageData and the last row.
+struct Image::IncrementalDecoder
+{
+#if FK_IMAGE_USE_WEBP
+    WebPDecoderConfig config;
+    WebPIDecoder* decoder;
+#endif
+    // found from the first bytes appended, they are held until then
+    const ImageCodec* codec;
+    std::vector<unsigned char> pending;
+    // what the stream has cost so far, for the codec stats
+    size_t bytes;
+    double seconds;
+    // appended bytes held back until the header gives the size
+    std::vector<unsigned char> header;
+    RowSink sink;
+    // what the decoder writes to when rows change format, else it is _data
+    unsigned char* scratch;
+    size_t sourceRowBytes;
+    int rowsDone;
+};
+
 bool Image::initWithWebpData(const unsigned char * data, ssize_t dataLen)
 {
 #if FK_USE_WEBP
-	bool ret = false;
-
 #if (FK_TARGET_PLATFORM == FK_PLATFORM_WP8) || (FK_TARGET_PLATFORM == FK_PLATFORM_WINRT)
     FKLOG("WEBP image format not supported on WinRT or WP8");
+    return false;
 #else
-	do
-	{
-        WebPDecoderConfig config;
-        if (WebPInitDecoderConfig(&config) == 0) break;
-        if (WebPGetFeatures(static_cast<const uint8_t*>(data), dataLen, &config.input) != VP8_STATUS_OK) break;
-        if (config.input.width == 0 || config.input.height == 0) break;
-        
-        config.output.colorspace = MODE_RGBA;
-        _renderFormat = Texture2D::PixelFormat::RGBA8888;
-        _width    = config.input.width;
-        _height   = config.input.height;
-        
-        _dataLen = _width * _height * 4;
-        _data = static_cast<unsigned char*>(malloc(_dataLen * sizeof(unsigned char)));
-        
-        config.output.u.RGBA.rgba = static_cast<uint8_t*>(_data);
-        config.output.u.RGBA.stride = _width * 4;
-        config.output.u.RGBA.size = _dataLen;
-        config.output.is_external_memory = 1;
-        
-        if (WebPDecode(static_cast<const uint8_t*>(data), dataLen, &config) != VP8_STATUS_OK)
+    if (!beginImageData(_decodeFormat))
+    {
+        return false;
+    }
+    // fed in growing pieces like a stream: each piece decodes the rows its
+    // bytes complete, those are premultiplied and converted while in cache,
+    // and a mapped file reads ahead meanwhile
+    ssize_t fed = 0;
+    while (_incremental && fed < dataLen)
+    {
+        fed = dataLen - fed > WEBP_CHUNK_SIZE ? fed + WEBP_CHUNK_SIZE : dataLen;
+        if (!updateWebpData(data, fed, false))
         {
-            free(_data);
-            _data = nullptr;
-            break;
+            endIncremental(false);
+            return false;
         }
-        
-        ret = true;
-	} while (0);
+    }
+    if (_incremental)
+    {
+        FKLOG("flakor: webp data is truncated");
+        endIncremental(false);
+        return false;
+    }
+    return true;
 #endif // (FK_TARGET_PLATFORM == FK_PLATFORM_WP8) || (FK_TARGET_PLATFORM == FK_PLATFORM_WINRT)
-	return ret;
 #else 
     FKLOG("webp is not enabled, please enable it in ccConfig.h");
     return false;
 #endif // FK_USE_WEBP
 }
 
+bool Image::beginImageData(PixelFormat format)
+{
+#if FK_IMAGE_USE_WEBP
+    endIncremental(false);
+    _decodeFormat = format;
+
+    IncrementalDecoder* state = new IncrementalDecoder();
+    if (WebPInitDecoderConfig(&state->config) == 0)
+    {
+        delete state;
+        return false;
+    }
+    // lossy files filter on a second thread, lossless ones have nothing to split
+    state->config.options.use_threads = 1;
+    state->codec = nullptr;
+    state->bytes = 0;
+    state->seconds = 0;
+    state->decoder = nullptr;
+    state->scratch = nullptr;
+    state->sourceRowBytes = 0;
+    state->rowsDone = 0;
+    _incremental = state;
+    return true;
+#else
+    FKLOG("flakor: incremental decoding needs webp, please enable it in Config.h");
+    return false;
+#endif // FK_IMAGE_USE_WEBP
+}
+
+bool Image::appendImageData(const unsigned char * data, ssize_t dataLen)
+{
+    if (!_incremental)
+    {
+        return false;
+    }
+    if (!data || dataLen <= 0)
+    {
+        return true;
+    }
+
+    IncrementalDecoder* state = _incremental;
+    ImageCodecRegistry* codecs = ImageCodecRegistry::getInstance();
+    std::vector<unsigned char> pending;
+    if (!state->codec)
+    {
+        state->pending.insert(state->pending.end(), data, data + dataLen);
+        state->codec = codecs->findCodec(state->pending.data(), state->pending.size());
+        if (!state->codec)
+        {
+            if (state->pending.size() < STREAM_DETECT_SIZE)
+            {
+                return true;
+            }
+            FKLOG("flakor: unknown image format");
+            endIncremental(false);
+            return false;
+        }
+        if (!state->codec->appendStream)
+        {
+            FKLOG("flakor: %s images can't be decoded incrementally", state->codec->name.c_str());
+            endIncremental(false);
+            return false;
+        }
+        _fileType = state->codec->format;
+        pending.swap(state->pending);
+        data = pending.data();
+        dataLen = pending.size();
+    }
+
+    // the codec ends the stream itself once the last row is in
+    const ImageCodec* codec = state->codec;
+    size_t bytes = state->bytes + dataLen;
+    double seconds = state->seconds;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool ok = codec->appendStream(this, data, dataLen);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    seconds += elapsed.count();
+
+    if (!ok)
+    {
+        codecs->record(codec, false, bytes, seconds);
+        endIncremental(false);
+        return false;
+    }
+    if (_incremental)
+    {
+        _incremental->bytes = bytes;
+        _incremental->seconds = seconds;
+    }
+    else
+    {
+        codecs->record(codec, true, bytes, seconds);
+    }
+    return true;
+}
+
+// Decodes what data holds so far. append passes a new piece that the decoder
+// copies, otherwise data is the whole buffer so far and must stay put.
+bool Image::updateWebpData(const unsigned char *data, ssize_t dataLen, bool append)
+{
+#if FK_IMAGE_USE_WEBP
+    IncrementalDecoder* state = _incremental;
+    if (!state->decoder)
+    {
+        if (append)
+        {
+            state->header.insert(state->header.end(), data, data + dataLen);
+            data = state->header.data();
+            dataLen = state->header.size();
+        }
+        // RIFF size WEBP
+        if (dataLen < 12)
+        {
+            return true;
+        }
+        if (!isWebp(data, dataLen))
+        {
+            FKLOG("flakor: only webp can be decoded incrementally");
+            return false;
+        }
+        VP8StatusCode status = WebPGetFeatures(data, dataLen, &state->config.input);
+        if (status == VP8_STATUS_NOT_ENOUGH_DATA)
+        {
+            return true;
+        }
+        if (status != VP8_STATUS_OK || state->config.input.width <= 0 || state->config.input.height <= 0)
+        {
+            return false;
+        }
+
+        _width = state->config.input.width;
+        _height = state->config.input.height;
+        bool alpha = state->config.input.has_alpha != 0;
+        PixelFormat sourceFormat = alpha ? PixelFormat::RGBA8888 : PixelFormat::RGB888;
+        PixelFormat format = TexUtils::getConvertedFormat(sourceFormat, _decodeFormat);
+
+        RowSink& sink = state->sink;
+        sink.originFormat = sourceFormat;
+        sink.format = format;
+        sink.premultiply = alpha;
+        sink.width = _width;
+        sink.outRowBytes = (size_t)_width * TexUtils::getBytesPerPixel(format);
+        state->sourceRowBytes = (size_t)_width * TexUtils::getBytesPerPixel(sourceFormat);
+
+        _dataLen = sink.outRowBytes * _height;
+        _data = TexUtils::allocPixels(_dataLen);
+        if (!_data)
+        {
+            return false;
+        }
+        _pooledData = true;
+        sink.out = _data;
+
+        // the decoder wants one buffer for the whole image, so a format
+        // change decodes to a whole scratch image
+        unsigned char* output = _data;
+        if (format != sourceFormat)
+        {
+            state->scratch = TexUtils::allocPixels(state->sourceRowBytes * _height);
+            if (!state->scratch)
+            {
+                return false;
+            }
+            output = state->scratch;
+        }
+        WebPDecBuffer& buffer = state->config.output;
+        buffer.colorspace = alpha ? MODE_RGBA : MODE_RGB;
+        buffer.is_external_memory = 1;
+        buffer.u.RGBA.rgba = output;
+        buffer.u.RGBA.stride = (int)state->sourceRowBytes;
+        buffer.u.RGBA.size = state->sourceRowBytes * _height;
+
+        state->decoder = WebPIDecode(nullptr, 0, &state->config);
+        if (!state->decoder)
+        {
+            return false;
+        }
+    }
+
+    VP8StatusCode status = append ? WebPIAppend(state->decoder, data, dataLen)
+                                  : WebPIUpdate(state->decoder, data, dataLen);
+    // the held back bytes are the decoder's now
+    std::vector<unsigned char>().swap(state->header);
+    if (status != VP8_STATUS_OK && status != VP8_STATUS_SUSPENDED)
+    {
+        return false;
+    }
+
+    int lastY = 0;
+    if (WebPIDecGetRGB(state->decoder, &lastY, nullptr, nullptr, nullptr))
+    {
+        unsigned char* rows = state->scratch ? state->scratch : _data;
+        for (; state->rowsDone < lastY; ++state->rowsDone)
+        {
+            writeRow(state->sink, rows + state->rowsDone * state->sourceRowBytes, state->rowsDone);
+        }
+    }
+
+    if (status == VP8_STATUS_OK)
+    {
+        _renderFormat = state->sink.format;
+        _hasPremultipliedAlpha = state->sink.premultiply;
+        endIncremental(true);
+    }
+    return true;
+#else
+    return false;
+#endif // FK_IMAGE_USE_WEBP
+}
+
+void Image::endIncremental(bool complete)
+{
+    if (!_incremental)
+    {
+        return;
+    }
+#if FK_IMAGE_USE_WEBP
+    if (_incremental->decoder)
+    {
+        WebPIDelete(_incremental->decoder);
+    }
+#endif
+    TexUtils::freePixels(_incremental->scratch);
+    delete _incremental;
+    _incremental = nullptr;
+
+    if (!complete && _pooledData)
+    {
+        TexUtils::freePixels(_data);
+        _data = nullptr;
+        _dataLen = 0;
+        _pooledData = false;
+    }
+}
+
 
 bool Image::initWithRawData(const unsigned char * data, ssize_t dataLen, int width, int height, int bitsPerComponent, bool preMulti)
 {
@@ -2005,7 +3302,7 @@ bool Image::initWithRawData(const unsigned char * data, ssize_t dataLen, int wid
 
 
 #if (FK_TARGET_PLATFORM != FK_PLATFORM_IOS)
-bool Image::saveToFile(const std::string& filename, bool isToRGB)
+bool Image::saveToFile(const std::string& filename, bool isToRGB, bool fast)
 {
     //only support for Texture2D::PixelFormat::RGB888 or Texture2D::PixelFormat::RGBA8888 uncompressed data
     if (isCompressed() || (_renderFormat != PixelFormat::RGB888 && _renderFormat != PixelFormat::RGBA8888))
@@ -2029,11 +3326,11 @@ bool Image::saveToFile(const std::string& filename, bool isToRGB)
 
         if (std::string::npos != strLowerCasePath.find(".png"))
         {
-            FK_BREAK_IF(!saveImageToPNG(filename, isToRGB));
+            FK_BREAK_IF(!saveImageToPNG(filename, isToRGB, fast));
         }
         else if (std::string::npos != strLowerCasePath.find(".jpg"))
         {
-            FK_BREAK_IF(!saveImageToJPG(filename));
+            FK_BREAK_IF(!saveImageToJPG(filename, fast));
         }
         else
         {
@@ -2045,154 +3342,49 @@ bool Image::saveToFile(const std::string& filename, bool isToRGB)
 
     return ret;
 }
-#endif
 
-bool Image::saveImageToPNG(const std::string& filePath, bool isToRGB)
+std::shared_future<bool> Image::saveToFileAsync(const std::string& filename, bool isToRGB, bool fast)
 {
-    bool ret = false;
-    do 
-    {
-        FILE *fp;
-        png_structp png_ptr;
-        png_infop info_ptr;
-        png_colorp palette;
-        png_bytep *row_pointers;
-
-        fp = fopen(filePath.c_str(), "wb");
-        FK_BREAK_IF(nullptr == fp);
-
-        png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
-
-        if (nullptr == png_ptr)
-        {
-            fclose(fp);
-            break;
-        }
+    std::shared_ptr<std::promise<bool> > promise = std::make_shared<std::promise<bool> >();
+    std::shared_future<bool> result = promise->get_future().share();
+    if (_data == nullptr || isCompressed()
+        || (_renderFormat != PixelFormat::RGB888 && _renderFormat != PixelFormat::RGBA8888))
+    {
+        FKLOG("flakor: Image: saveToFileAsync is only support for PixelFormat::RGB888 or PixelFormat::RGBA8888 uncompressed data for now");
+        promise->set_value(false);
+        return result;
+    }
 
-        info_ptr = png_create_info_struct(png_ptr);
-        if (nullptr == info_ptr)
-        {
-            fclose(fp);
-            png_destroy_write_struct(&png_ptr, nullptr);
-            break;
-        }
-#if (FK_TARGET_PLATFORM != FK_PLATFORM_BADA && FK_TARGET_PLATFORM != FK_PLATFORM_NACL)
-        if (setjmp(png_jmpbuf(png_ptr)))
-        {
-            fclose(fp);
-            png_destroy_write_struct(&png_ptr, &info_ptr);
-            break;
-        }
+    //the caller may change or free this image right away, the task saves a copy
+    Image* copy = new Image();
+    copy->_width = _width;
+    copy->_height = _height;
+    copy->_renderFormat = _renderFormat;
+    copy->_hasPremultipliedAlpha = _hasPremultipliedAlpha;
+    copy->_fileType = _fileType;
+    copy->_dataLen = _dataLen;
+    copy->_data = TexUtils::allocPixels(_dataLen);
+    copy->_pooledData = true;
+    memcpy(copy->_data, _data, _dataLen);
+
+    ThreadPool::getInstance()->enqueue([copy, filename, isToRGB, fast, promise]() {
+        bool ok = copy->saveToFile(filename, isToRGB, fast);
+        delete copy;
+        promise->set_value(ok);
+    });
+    return result;
+}
 #endif
-        png_init_io(png_ptr, fp);
-
-        if (!isToRGB && hasAlpha())
-        {
-            png_set_IHDR(png_ptr, info_ptr, _width, _height, 8, PNG_COLOR_TYPE_RGB_ALPHA,
-                PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
-        } 
-        else
-        {
-            png_set_IHDR(png_ptr, info_ptr, _width, _height, 8, PNG_COLOR_TYPE_RGB,
-                PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
-        }
 
-        palette = (png_colorp)png_malloc(png_ptr, PNG_MAX_PALETTE_LENGTH * sizeof (png_color));
-        png_set_PLTE(png_ptr, info_ptr, palette, PNG_MAX_PALETTE_LENGTH);
-
-        png_write_info(png_ptr, info_ptr);
-
-        png_set_packing(png_ptr);
-
-        row_pointers = (png_bytep *)malloc(_height * sizeof(png_bytep));
-        if(row_pointers == nullptr)
-        {
-            fclose(fp);
-            png_destroy_write_struct(&png_ptr, &info_ptr);
-            break;
-        }
-
-        if (!hasAlpha())
-        {
-            for (int i = 0; i < (int)_height; i++)
-            {
-                row_pointers[i] = (png_bytep)_data + i * _width * 3;
-            }
-
-            png_write_image(png_ptr, row_pointers);
-
-            free(row_pointers);
-            row_pointers = nullptr;
-        }
-        else
-        {
-            if (isToRGB)
-            {
-                unsigned char *tempData = static_cast<unsigned char*>(malloc(_width * _height * 3 * sizeof(unsigned char)));
-                if (nullptr == tempData)
-                {
-                    fclose(fp);
-                    png_destroy_write_struct(&png_ptr, &info_ptr);
-                    
-                    free(row_pointers);
-                    row_pointers = nullptr;
-                    break;
-                }
-
-                for (int i = 0; i < _height; ++i)
-                {
-                    for (int j = 0; j < _width; ++j)
-                    {
-                        tempData[(i * _width + j) * 3] = _data[(i * _width + j) * 4];
-                        tempData[(i * _width + j) * 3 + 1] = _data[(i * _width + j) * 4 + 1];
-                        tempData[(i * _width + j) * 3 + 2] = _data[(i * _width + j) * 4 + 2];
-                    }
-                }
-
-                for (int i = 0; i < (int)_height; i++)
-                {
-                    row_pointers[i] = (png_bytep)tempData + i * _width * 3;
-                }
-
-                png_write_image(png_ptr, row_pointers);
-
-                free(row_pointers);
-                row_pointers = nullptr;
-
-                if (tempData != nullptr)
-                {
-                    free(tempData);
-                }
-            } 
-            else
-            {
-                for (int i = 0; i < (int)_height; i++)
-                {
-                    row_pointers[i] = (png_bytep)_data + i * _width * 4;
-                }
-
-                png_write_image(png_ptr, row_pointers);
-
-                free(row_pointers);
-                row_pointers = nullptr;
-            }
-        }
-
-        png_write_end(png_ptr, info_ptr);
-
-        png_free(png_ptr, palette);
-        palette = nullptr;
-
-        png_destroy_write_struct(&png_ptr, &info_ptr);
-
-        fclose(fp);
-
-        ret = true;
-    } while (0);
-    return ret;
+bool Image::saveImageToPNG(const std::string& filePath, bool isToRGB, bool fast)
+{
+    //row groups are deflated on the ThreadPool, see PngWriter
+    int components = hasAlpha() ? 4 : 3;
+    int outComponents = (!isToRGB && hasAlpha()) ? 4 : 3;
+    return PngWriter::writeFile(filePath, _data, _width, _height, components, outComponents, fast);
 }
 
-bool Image::saveImageToJPG(const std::string& filePath)
+bool Image::saveImageToJPG(const std::string& filePath, bool fast)
 {
 #if FK_USE_JPEG
     bool ret = false;
@@ -2219,6 +3411,12 @@ bool Image::saveImageToJPG(const std::string& filePath)
 
         jpeg_set_defaults(&cinfo);
         jpeg_set_quality(&cinfo, 90, TRUE);
+        if (fast)
+        {
+            //integer DCT without the optimized huffman pass
+            cinfo.dct_method = JDCT_IFAST;
+            cinfo.optimize_coding = FALSE;
+        }
         
         jpeg_start_compress(&cinfo, TRUE);
 
@@ -2282,12 +3480,7 @@ void Image::premultipliedAlpha()
 {
     FKAssert(_renderFormat == PixelFormat::RGBA8888, "The pixel format should be RGBA8888!");
     
-    unsigned int* fourBytes = (unsigned int*)_data;
-    for(int i = 0; i < _width * _height; i++)
-    {
-        unsigned char* p = _data + i * 4;
-        fourBytes[i] = FK_RGB_PREMULTIPLY_ALPHA(p[0], p[1], p[2], p[3]);
-    }
+    TexUtils::premultiplyRow(_data, _width * _height, _premultiplyInLinearLight);
     
     _hasPremultipliedAlpha = true;
 }
@@ -2298,5 +3491,10 @@ void Image::setPVRImagesHavePremultipliedAlpha(bool haveAlphaPremultiplied)
     _PVRHaveAlphaPremultiplied = haveAlphaPremultiplied;
 }
 
+void Image::setPremultiplyInLinearLight(bool linear)
+{
+    _premultiplyInLinearLight = linear;
+}
+
 FLAKOR_NS_END
 
@@ -1,4 +1,8 @@
 #include "core/opengl/texture/Texture2D.h"
+#include "core/opengl/texture/MappedFile.h"
+#include "tool/utility/TexUtils.h"
+
+#include <future>
 
 // premultiply alpha, or the effect will wrong when want to use other pixel format in Texture2D,
 // such as RGB888, RGB5A1
@@ -10,6 +14,9 @@
 
 FLAKOR_NS_BEGIN
 
+class FrameReader;
+class ImageCodecRegistry;
+
 typedef struct _MipmapInfo
 {
     unsigned char* address;
@@ -21,6 +28,8 @@ class Image
 {
 public:
     //friend class TextureManager;
+    friend class FrameReader;
+    friend class ImageCodecRegistry;
     /**
      * @js ctor
      */
@@ -50,6 +59,12 @@ public:
         S3TC,
         //! ATITC
         ATITC,
+        //! ASTC
+        ASTC,
+        //! Universal texture, transcoded to a GPU format at load
+        UTEX,
+        //! KTX / KTX2 container
+        KTX,
         //! TGA
         TGA,
         //! Raw Data
@@ -60,20 +75,83 @@ public:
 
     /**
     @brief Load the image from the specified path.
+    KTX / KTX2 files are memory mapped and their mipmaps point straight
+    into the mapping, see getMappedFile().
     @param path   the absolute file path.
+    @param format  render format to decode to, see initWithImageData.
     @return true if loaded correctly.
     */
-    bool initWithImageFile(const std::string& path);
+    bool initWithImageFile(const std::string& path, PixelFormat format = PixelFormat::AUTO);
 
     /**
     @brief Load image from stream buffer.
     @param data  stream buffer which holds the image data.
     @param dataLen  data length expressed in (number of) bytes.
+    @param format  render format to decode to. PNG rows are premultiplied and
+    converted to it as they are decoded, so Texture2D can use the data as it
+    is; other formats ignore it. AUTO keeps the file's own format.
     @return true if loaded correctly.
     * @js NA
     * @lua NA
     */
-    bool initWithImageData(const unsigned char * data, ssize_t dataLen);
+    bool initWithImageData(const unsigned char * data, ssize_t dataLen, PixelFormat format = PixelFormat::AUTO);
+
+    /**
+    @brief Start an image whose bytes arrive in pieces, from a file read in
+    chunks or a download, so reading and decoding overlap. Rows are decoded,
+    premultiplied and converted to format as soon as their bytes are in,
+    straight into the buffer Texture2D uploads. The format is found from the
+    first bytes, it needs a codec with a streaming decoder, which is only
+    WebP for now; lossy files decode on two threads.
+    @param format  render format to decode to, see initWithImageData.
+    */
+    bool beginImageData(PixelFormat format = PixelFormat::AUTO);
+
+    /**
+    @brief Decode as far as the bytes given so far allow.
+    @return false if the data is broken or can't be streamed, the image is
+    then left empty. See isImageDataComplete() for the end of the image.
+    */
+    bool appendImageData(const unsigned char * data, ssize_t dataLen);
+
+    /** true once appendImageData has decoded the last row */
+    inline bool isImageDataComplete() { return _data != nullptr && _incremental == nullptr; }
+
+    /**
+    @brief Decode at 1/scale of the stored size, scale being 1, 2, 4 or 8.
+    JPEG scales inside the DCT, so the full size image is never decoded or
+    allocated; other formats ignore it. Set before initWithImageFile /
+    initWithImageData, replaces any target size. A JPEG bigger than
+    GPUInfo::getMaxTextureSize() is scaled down until it fits either way,
+    where 1/8 is enough.
+    */
+    void setDecodeScale(int scale);
+
+    /**
+    @brief Decode at the cheapest scale that still covers width x height,
+    for images that are drawn smaller than they are stored. The result can
+    be up to twice the target on a side, it is not resized to fit. 0 leaves
+    that side free. Replaces any decode scale.
+    */
+    void setDecodeTargetSize(int width, int height);
+
+    /**
+    @brief Build the whole mipmap chain on the CPU. Works at any size, so NPOT
+    textures get mipmaps too, which glGenerateMipmap can't give them.
+    Texture2D::initWithImage then uploads every level through
+    loadWithMipmapsGL. Call it after loading, on the loading thread. The rows
+    are spread over the ThreadPool. Only for uncompressed 8 bit per channel
+    data that has no mipmaps yet.
+    @param gammaCorrect  filter in linear light, see TexUtils::buildMipmaps.
+    */
+    bool generateMipmaps(TexUtils::MipmapFilter filter = TexUtils::MipmapFilter::BOX, bool gammaCorrect = false);
+
+    /**
+    @brief generateMipmaps on a ThreadPool worker, for images loaded on the
+    GL thread. Leave the image alone until the future is ready.
+    */
+    std::shared_future<bool> generateMipmapsAsync(TexUtils::MipmapFilter filter = TexUtils::MipmapFilter::BOX,
+                                                  bool gammaCorrect = false);
 
     // @warning kFmtRawData only support RGBA8888
     bool initWithRawData(const unsigned char * data, ssize_t dataLen, int width, int height, int bitsPerComponent, bool preMulti = false);
@@ -88,6 +166,8 @@ public:
     inline int               getNumberOfMipmaps()    { return _numberOfMipmaps; }
     inline MipmapInfo*       getMipmaps()            { return _mipmaps; }
     inline bool              hasPremultipliedAlpha() { return _hasPremultipliedAlpha; }
+    /** the file the data and mipmaps point into, empty if the image owns its data */
+    inline const std::shared_ptr<MappedFile>& getMappedFile() { return _mappedFile; }
 
     int                      getBitPerPixel();
     bool                     hasAlpha();
@@ -98,8 +178,17 @@ public:
      @brief    Save Image data to the specified file, with specified format.
      @param    filePath        the file's absolute path, including file suffix.
      @param    isToRGB        whether the image is saved as RGB format.
+     @param    fast           trade file size for speed: zlib level 1 and the Up filter for PNG,
+                              the fast integer DCT for JPG. For captures saved every frame.
+     */
+    bool saveToFile(const std::string &filename, bool isToRGB = true, bool fast = false);
+
+    /**
+     @brief    saveToFile on a ThreadPool worker.
+     The pixels are copied first, the image can be changed or released as soon as this returns.
+     The future turns true once the file is written.
      */
-    bool saveToFile(const std::string &filename, bool isToRGB = true);
+    std::shared_future<bool> saveToFileAsync(const std::string &filename, bool isToRGB = true, bool fast = false);
     
     
     /** treats (or not) PVR files as if they have alpha premultiplied.
@@ -110,6 +199,15 @@ public:
      */
     static void setPVRImagesHavePremultipliedAlpha(bool haveAlphaPremultiplied);
 
+    /** premultiplies alpha in linear light instead of on the sRGB values.
+     Semi transparent edges keep their brightness when blended, at the cost of a
+     table lookup per channel instead of the vectorized multiply. Applies to images
+     loaded afterwards.
+     
+     By default it is disabled.
+     */
+    static void setPremultiplyInLinearLight(bool linear);
+
 protected:
 
     bool initWithJpgData(const unsigned char *  data, ssize_t dataLen);
@@ -120,14 +218,20 @@ protected:
     bool initWithPVRv2Data(const unsigned char * data, ssize_t dataLen);
     bool initWithPVRv3Data(const unsigned char * data, ssize_t dataLen);
     bool initWithETCData(const unsigned char * data, ssize_t dataLen);
+    bool initWithETC2Data(const unsigned char * data, ssize_t dataLen);
     bool initWithS3TCData(const unsigned char * data, ssize_t dataLen);
     bool initWithATITCData(const unsigned char *data, ssize_t dataLen);
+    bool initWithASTCData(const unsigned char *data, ssize_t dataLen);
+    bool initWithUTEXData(const unsigned char *data, ssize_t dataLen);
+    bool initWithKTXData(const unsigned char *data, ssize_t dataLen);
+    bool updateWebpData(const unsigned char *data, ssize_t dataLen, bool append);
+    void endIncremental(bool complete);
 	
     typedef struct sImageTGA tImageTGA;
     bool initWithTGAData(tImageTGA* tgaData);
 
-    bool saveImageToPNG(const std::string& filePath, bool isToRGB = true);
-    bool saveImageToJPG(const std::string& filePath);
+    bool saveImageToPNG(const std::string& filePath, bool isToRGB = true, bool fast = false);
+    bool saveImageToJPG(const std::string& filePath, bool fast = false);
     
     void premultipliedAlpha();
     
@@ -149,6 +253,21 @@ protected:
     // false if we cann't auto detect the image is premultiplied or not.
     bool _hasPremultipliedAlpha;
     std::string _filePath;
+    // set when _data and _mipmaps point into a mapped file instead of the heap
+    std::shared_ptr<MappedFile> _mappedFile;
+    // format initWithImageData was asked to decode to
+    PixelFormat _decodeFormat;
+    // _data came from TexUtils::allocPixels
+    bool _pooledData;
+    // setDecodeScale / setDecodeTargetSize, a scale of 0 means pick it from the target
+    int _decodeScale;
+    int _decodeTargetWidth;
+    int _decodeTargetHeight;
+    // decoder between beginImageData and the last row
+    struct IncrementalDecoder;
+    IncrementalDecoder* _incremental;
+    // levels 1 and down that generateMipmaps built, level 0 is _data
+    unsigned char* _mipmapData;
 
 protected:
     // noncopyable
@@ -165,14 +284,20 @@ protected:
     bool initWithImageFileThreadSafe(const std::string& fullpath);
     
     Format detectFormat(const unsigned char * data, ssize_t dataLen);
-    bool isPng(const unsigned char * data, ssize_t dataLen);
-    bool isJpg(const unsigned char * data, ssize_t dataLen);
-    bool isTiff(const unsigned char * data, ssize_t dataLen);
-    bool isWebp(const unsigned char * data, ssize_t dataLen);
-    bool isPvr(const unsigned char * data, ssize_t dataLen);
-    bool isEtc(const unsigned char * data, ssize_t dataLen);
-    bool isS3TC(const unsigned char * data,ssize_t dataLen);
-    bool isATITC(const unsigned char *data, ssize_t dataLen);
+    static bool isPng(const unsigned char * data, ssize_t dataLen);
+    static bool isJpg(const unsigned char * data, ssize_t dataLen);
+    static bool isTiff(const unsigned char * data, ssize_t dataLen);
+    static bool isWebp(const unsigned char * data, ssize_t dataLen);
+    static bool isPvr(const unsigned char * data, ssize_t dataLen);
+    static bool isEtc(const unsigned char * data, ssize_t dataLen);
+    static bool isS3TC(const unsigned char * data,ssize_t dataLen);
+    static bool isATITC(const unsigned char *data, ssize_t dataLen);
+    static bool isASTC(const unsigned char *data, ssize_t dataLen);
+    static bool isUTEX(const unsigned char *data, ssize_t dataLen);
+    static bool isKTX(const unsigned char *data, ssize_t dataLen);
+
+    /** adds the formats above to registry, called when it is created */
+    static void registerCodecs(ImageCodecRegistry* registry);
 
 };
 
@@ -13,9 +13,18 @@
 // limitations under the License.
 
 #include "core/opengl/texture/etc1.h"
+#include "base/lang/ThreadPool.h"
 
 #include <string.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ETC1_USE_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define ETC1_USE_NEON 1
+#include <arm_neon.h>
+#endif
+
 /* From http://www.khronos.org/registry/gles/extensions/OES/OES_compressed_ETC1_RGB8_texture.txt
 
  The number of bits that represent a 4x4 texel block is 64 bits if
@@ -194,40 +203,167 @@ void decode_subblock(etc1_byte* pOut, int r, int g, int b, const int* table,
     }
 }
 
-// Input is an ETC1 compressed version of the data.
-// Output is a 4 x 4 square of 3-byte pixels in form R, G, B
+// Decoded form of one block: the 8 colors it can produce (4 modifiers for
+// each of the 2 sub-blocks) stored as R, G, B, pad, plus the per-pixel
+// palette index. Pixel (x, y) uses palette entry
+// ((subMask >> k) & 1) << 2 | ((low >> k) & 1) | ((low >> (k + 15)) & 2)
+// with k = y + 4 * x, which is exactly what decode_subblock computes.
 
-void etc1_decode_block(const etc1_byte* pIn, etc1_byte* pOut) {
+typedef struct {
+    etc1_byte palette[32];
+    etc1_uint32 low;
+    etc1_uint32 subMask;
+} etc1_decoded_palette;
+
+static
+inline void read_block_colors(const etc1_byte* pIn, etc1_uint32* pLow,
+        int* pColors, const int** pTableA, const int** pTableB, bool* pFlipped) {
     etc1_uint32 high = (pIn[0] << 24) | (pIn[1] << 16) | (pIn[2] << 8) | pIn[3];
-    etc1_uint32 low = (pIn[4] << 24) | (pIn[5] << 16) | (pIn[6] << 8) | pIn[7];
-    int r1, r2, g1, g2, b1, b2;
+    *pLow = (pIn[4] << 24) | (pIn[5] << 16) | (pIn[6] << 8) | pIn[7];
     if (high & 2) {
         // differential
         int rBase = high >> 27;
         int gBase = high >> 19;
         int bBase = high >> 11;
-        r1 = convert5To8(rBase);
-        r2 = convertDiff(rBase, high >> 24);
-        g1 = convert5To8(gBase);
-        g2 = convertDiff(gBase, high >> 16);
-        b1 = convert5To8(bBase);
-        b2 = convertDiff(bBase, high >> 8);
+        pColors[0] = convert5To8(rBase);
+        pColors[1] = convert5To8(gBase);
+        pColors[2] = convert5To8(bBase);
+        pColors[3] = convertDiff(rBase, high >> 24);
+        pColors[4] = convertDiff(gBase, high >> 16);
+        pColors[5] = convertDiff(bBase, high >> 8);
     } else {
         // not differential
-        r1 = convert4To8(high >> 28);
-        r2 = convert4To8(high >> 24);
-        g1 = convert4To8(high >> 20);
-        g2 = convert4To8(high >> 16);
-        b1 = convert4To8(high >> 12);
-        b2 = convert4To8(high >> 8);
+        pColors[0] = convert4To8(high >> 28);
+        pColors[1] = convert4To8(high >> 20);
+        pColors[2] = convert4To8(high >> 12);
+        pColors[3] = convert4To8(high >> 24);
+        pColors[4] = convert4To8(high >> 16);
+        pColors[5] = convert4To8(high >> 8);
+    }
+    *pTableA = kModifierTable + (7 & (high >> 5)) * 4;
+    *pTableB = kModifierTable + (7 & (high >> 2)) * 4;
+    *pFlipped = (high & 1) != 0;
+}
+
+// Build the 8-entry palette of a block. The saturating pack to unsigned
+// bytes performs the same [0, 255] clamp as clamp(), so the vector paths
+// are bit-exact with decode_subblock.
+
+static
+void build_palette(const etc1_byte* pIn, etc1_decoded_palette* pDecoded) {
+    int c[6];
+    const int* tA;
+    const int* tB;
+    bool flipped;
+    read_block_colors(pIn, &pDecoded->low, c, &tA, &tB, &flipped);
+    // flipped: second sub-block holds rows 2..3, otherwise columns 2..3
+    pDecoded->subMask = flipped ? 0xcccc : 0xff00;
+
+#if defined(ETC1_USE_SSE2)
+    __m128i baseA = _mm_setr_epi16(c[0], c[1], c[2], 0, c[0], c[1], c[2], 0);
+    __m128i baseB = _mm_setr_epi16(c[3], c[4], c[5], 0, c[3], c[4], c[5], 0);
+    __m128i a01 = _mm_add_epi16(baseA, _mm_setr_epi16(tA[0], tA[0], tA[0], 0, tA[1], tA[1], tA[1], 0));
+    __m128i a23 = _mm_add_epi16(baseA, _mm_setr_epi16(tA[2], tA[2], tA[2], 0, tA[3], tA[3], tA[3], 0));
+    __m128i b01 = _mm_add_epi16(baseB, _mm_setr_epi16(tB[0], tB[0], tB[0], 0, tB[1], tB[1], tB[1], 0));
+    __m128i b23 = _mm_add_epi16(baseB, _mm_setr_epi16(tB[2], tB[2], tB[2], 0, tB[3], tB[3], tB[3], 0));
+    _mm_storeu_si128((__m128i*) pDecoded->palette, _mm_packus_epi16(a01, a23));
+    _mm_storeu_si128((__m128i*) (pDecoded->palette + 16), _mm_packus_epi16(b01, b23));
+#elif defined(ETC1_USE_NEON)
+    const int16_t la[8] = { (int16_t) c[0], (int16_t) c[1], (int16_t) c[2], 0,
+            (int16_t) c[0], (int16_t) c[1], (int16_t) c[2], 0 };
+    const int16_t lb[8] = { (int16_t) c[3], (int16_t) c[4], (int16_t) c[5], 0,
+            (int16_t) c[3], (int16_t) c[4], (int16_t) c[5], 0 };
+    int16_t ma[16], mb[16];
+    for (int i = 0; i < 4; i++) {
+        ma[i * 4 + 0] = ma[i * 4 + 1] = ma[i * 4 + 2] = (int16_t) tA[i];
+        mb[i * 4 + 0] = mb[i * 4 + 1] = mb[i * 4 + 2] = (int16_t) tB[i];
+        ma[i * 4 + 3] = mb[i * 4 + 3] = 0;
+    }
+    int16x8_t baseA = vld1q_s16(la);
+    int16x8_t baseB = vld1q_s16(lb);
+    uint8x8_t a01 = vqmovun_s16(vaddq_s16(baseA, vld1q_s16(ma)));
+    uint8x8_t a23 = vqmovun_s16(vaddq_s16(baseA, vld1q_s16(ma + 8)));
+    uint8x8_t b01 = vqmovun_s16(vaddq_s16(baseB, vld1q_s16(mb)));
+    uint8x8_t b23 = vqmovun_s16(vaddq_s16(baseB, vld1q_s16(mb + 8)));
+    vst1q_u8(pDecoded->palette, vcombine_u8(a01, a23));
+    vst1q_u8(pDecoded->palette + 16, vcombine_u8(b01, b23));
+#else
+    for (int i = 0; i < 4; i++) {
+        etc1_byte* a = pDecoded->palette + i * 4;
+        etc1_byte* b = pDecoded->palette + 16 + i * 4;
+        a[0] = clamp(c[0] + tA[i]);
+        a[1] = clamp(c[1] + tA[i]);
+        a[2] = clamp(c[2] + tA[i]);
+        a[3] = 0;
+        b[0] = clamp(c[3] + tB[i]);
+        b[1] = clamp(c[4] + tB[i]);
+        b[2] = clamp(c[5] + tB[i]);
+        b[3] = 0;
+    }
+#endif
+}
+
+static
+inline etc1_uint32 palette_index(const etc1_decoded_palette* pDecoded,
+        etc1_uint32 x, etc1_uint32 y) {
+    etc1_uint32 k = y + (x * 4);
+    return (((pDecoded->subMask >> k) & 1) << 2)
+            | ((pDecoded->low >> k) & 1) | ((pDecoded->low >> (k + 15)) & 2);
+}
+
+// Write the xEnd x yEnd top-left pixels of a decoded block to pOut, which is
+// laid out like the output of etc1_decode_image.
+
+static
+void write_decoded_block(const etc1_decoded_palette* pDecoded, etc1_byte* pOut,
+        etc1_uint32 xEnd, etc1_uint32 yEnd, etc1_uint32 pixelSize, etc1_uint32 stride) {
+    if (pixelSize == 3) {
+        for (etc1_uint32 y = 0; y < yEnd; y++) {
+            etc1_byte* p = pOut + stride * y;
+            for (etc1_uint32 x = 0; x < xEnd; x++) {
+                const etc1_byte* c = pDecoded->palette + palette_index(pDecoded, x, y) * 4;
+                *p++ = c[0];
+                *p++ = c[1];
+                *p++ = c[2];
+            }
+        }
+    } else {
+        unsigned short pixels[8];
+        for (int i = 0; i < 8; i++) {
+            const etc1_byte* c = pDecoded->palette + i * 4;
+            pixels[i] = (unsigned short) (((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3));
+        }
+        for (etc1_uint32 y = 0; y < yEnd; y++) {
+            etc1_byte* p = pOut + stride * y;
+            for (etc1_uint32 x = 0; x < xEnd; x++) {
+                etc1_uint32 pixel = pixels[palette_index(pDecoded, x, y)];
+                *p++ = (etc1_byte) pixel;
+                *p++ = (etc1_byte) (pixel >> 8);
+            }
+        }
     }
-    int tableIndexA = 7 & (high >> 5);
-    int tableIndexB = 7 & (high >> 2);
-    const int* tableA = kModifierTable + tableIndexA * 4;
-    const int* tableB = kModifierTable + tableIndexB * 4;
-    bool flipped = (high & 1) != 0;
-    decode_subblock(pOut, r1, g1, b1, tableA, low, false, flipped);
-    decode_subblock(pOut, r2, g2, b2, tableB, low, true, flipped);
+}
+
+// Input is an ETC1 compressed version of the data.
+// Output is a 4 x 4 square of 3-byte pixels in form R, G, B
+
+void etc1_decode_block(const etc1_byte* pIn, etc1_byte* pOut) {
+    etc1_decoded_palette decoded;
+    build_palette(pIn, &decoded);
+    write_decoded_block(&decoded, pOut, 4, 4, 3, 4 * 3);
+}
+
+// Reference decoder, one pixel at a time.
+
+void etc1_decode_block_scalar(const etc1_byte* pIn, etc1_byte* pOut) {
+    etc1_uint32 low;
+    int c[6];
+    const int* tableA;
+    const int* tableB;
+    bool flipped;
+    read_block_colors(pIn, &low, c, &tableA, &tableB, &flipped);
+    decode_subblock(pOut, c[0], c[1], c[2], tableA, low, false, flipped);
+    decode_subblock(pOut, c[3], c[4], c[5], tableB, low, true, flipped);
 }
 
 typedef struct {
@@ -429,9 +565,56 @@ static void etc_encodeBaseColors(etc1_byte* pBaseColors,
     pBaseColors[5] = b2;
 }
 
+// Pick the two adjacent modifier tables whose spread is closest to how far
+// the sub-block pixels are from its base color. Used by ETC1_QUALITY_FAST
+// instead of trying all eight tables.
+
+static
+void etc_choose_table_range(const etc1_byte* pIn, etc1_uint32 inMask,
+        bool flipped, bool second, const etc1_byte* pBaseColors,
+        int* pFirst, int* pLast) {
+    int total = 0;
+    int count = 0;
+    for (int i = 0; i < 16; i++) {
+        int x = i & 3;
+        int y = i >> 2;
+        bool inSecond = flipped ? y >= 2 : x >= 2;
+        if (inSecond != second || !(inMask & (1 << i))) {
+            continue;
+        }
+        const etc1_byte* p = pIn + i * 3;
+        int d = 3 * (p[0] - pBaseColors[0]) + 6 * (p[1] - pBaseColors[1])
+                + (p[2] - pBaseColors[2]);
+        total += d < 0 ? -d : d;
+        count++;
+    }
+    int spread = count ? total / (10 * count) : 0;
+
+    int best = 0;
+    int bestDistance = ~0u >> 1;
+    for (int i = 0; i < 8; i++) {
+        int tableSpread = (kModifierTable[i * 4] + kModifierTable[i * 4 + 1]) >> 1;
+        int distance = tableSpread - spread;
+        distance = distance < 0 ? -distance : distance;
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            best = i;
+        }
+    }
+    int bestSpread = (kModifierTable[best * 4] + kModifierTable[best * 4 + 1]) >> 1;
+    if (best == 7 || (best > 0 && spread < bestSpread)) {
+        *pFirst = best - 1;
+        *pLast = best;
+    } else {
+        *pFirst = best;
+        *pLast = best + 1;
+    }
+}
+
 static
 void etc_encode_block_helper(const etc1_byte* pIn, etc1_uint32 inMask,
-        const etc1_byte* pColors, etc_compressed* pCompressed, bool flipped) {
+        const etc1_byte* pColors, etc_compressed* pCompressed, bool flipped,
+        etc1_quality quality) {
     pCompressed->score = ~0;
     pCompressed->high = (flipped ? 1 : 0);
     pCompressed->low = 0;
@@ -442,8 +625,14 @@ void etc_encode_block_helper(const etc1_byte* pIn, etc1_uint32 inMask,
 
     int originalHigh = pCompressed->high;
 
-    const int* pModifierTable = kModifierTable;
-    for (int i = 0; i < 8; i++, pModifierTable += 4) {
+    int first = 0;
+    int last = 7;
+    if (quality == ETC1_QUALITY_FAST) {
+        etc_choose_table_range(pIn, inMask, flipped, false, pBaseColors,
+                &first, &last);
+    }
+    const int* pModifierTable = kModifierTable + first * 4;
+    for (int i = first; i <= last; i++, pModifierTable += 4) {
         etc_compressed temp;
         temp.score = 0;
         temp.high = originalHigh | (i << 5);
@@ -452,16 +641,21 @@ void etc_encode_block_helper(const etc1_byte* pIn, etc1_uint32 inMask,
                 pBaseColors, pModifierTable);
         take_best(pCompressed, &temp);
     }
-    pModifierTable = kModifierTable;
+
+    if (quality == ETC1_QUALITY_FAST) {
+        etc_choose_table_range(pIn, inMask, flipped, true, pBaseColors + 3,
+                &first, &last);
+    }
+    pModifierTable = kModifierTable + first * 4;
     etc_compressed firstHalf = *pCompressed;
-    for (int i = 0; i < 8; i++, pModifierTable += 4) {
+    for (int i = first; i <= last; i++, pModifierTable += 4) {
         etc_compressed temp;
         temp.score = firstHalf.score;
         temp.high = firstHalf.high | (i << 2);
         temp.low = firstHalf.low;
         etc_encode_subblock_helper(pIn, inMask, &temp, flipped, true,
                 pBaseColors + 3, pModifierTable);
-        if (i == 0) {
+        if (i == first) {
             *pCompressed = temp;
         } else {
             take_best(pCompressed, &temp);
@@ -483,6 +677,11 @@ static void writeBigEndian(etc1_byte* pOut, etc1_uint32 d) {
 
 void etc1_encode_block(const etc1_byte* pIn, etc1_uint32 inMask,
         etc1_byte* pOut) {
+    etc1_encode_block_quality(pIn, inMask, ETC1_QUALITY_NORMAL, pOut);
+}
+
+void etc1_encode_block_quality(const etc1_byte* pIn, etc1_uint32 inMask,
+        etc1_quality quality, etc1_byte* pOut) {
     etc1_byte colors[6];
     etc1_byte flippedColors[6];
     etc_average_colors_subblock(pIn, inMask, colors, false, false);
@@ -491,9 +690,29 @@ void etc1_encode_block(const etc1_byte* pIn, etc1_uint32 inMask,
     etc_average_colors_subblock(pIn, inMask, flippedColors + 3, true, true);
 
     etc_compressed a, b;
-    etc_encode_block_helper(pIn, inMask, colors, &a, false);
-    etc_encode_block_helper(pIn, inMask, flippedColors, &b, true);
+    etc_encode_block_helper(pIn, inMask, colors, &a, false, quality);
+    etc_encode_block_helper(pIn, inMask, flippedColors, &b, true, quality);
     take_best(&a, &b);
+
+    if (quality == ETC1_QUALITY_EXHAUSTIVE) {
+        // The averages are not always the best base colors once they are
+        // quantized. Also try moving each sub-block's base color one 5 bit
+        // step darker or lighter; offset 0/0 is the result above.
+        static const int kOffsets[] = { 0, -8, 8 };
+        for (int f = 0; f < 2; f++) {
+            const etc1_byte* pAverage = f ? flippedColors : colors;
+            for (int i = 1; i < 9; i++) {
+                etc1_byte shifted[6];
+                for (int c = 0; c < 3; c++) {
+                    shifted[c] = clamp(pAverage[c] + kOffsets[i % 3]);
+                    shifted[c + 3] = clamp(pAverage[c + 3] + kOffsets[i / 3]);
+                }
+                etc_encode_block_helper(pIn, inMask, shifted, &b, f != 0,
+                        ETC1_QUALITY_NORMAL);
+                take_best(&a, &b);
+            }
+        }
+    }
     writeBigEndian(pOut, a.high);
     writeBigEndian(pOut + 4, a.low);
 }
@@ -504,16 +723,12 @@ etc1_uint32 etc1_get_encoded_data_size(etc1_uint32 width, etc1_uint32 height) {
     return (((width + 3) & ~3) * ((height + 3) & ~3)) >> 1;
 }
 
-// Encode an entire image.
-// pIn - pointer to the image data. Formatted such that the Red component of
-//       pixel (x,y) is at pIn + pixelSize * x + stride * y + redOffset;
-// pOut - pointer to encoded data. Must be large enough to store entire encoded image.
+// Encode one row of 4 x 4 blocks, the one starting at pixel row y.
 
-int etc1_encode_image(const etc1_byte* pIn, etc1_uint32 width, etc1_uint32 height,
-        etc1_uint32 pixelSize, etc1_uint32 stride, etc1_byte* pOut) {
-    if (pixelSize < 2 || pixelSize > 3) {
-        return -1;
-    }
+static
+void etc_encode_block_row(const etc1_byte* pIn, etc1_uint32 width, etc1_uint32 height,
+        etc1_uint32 pixelSize, etc1_uint32 stride, etc1_uint32 y,
+        etc1_quality quality, etc1_byte* pOut) {
     static const unsigned short kYMask[] = { 0x0, 0xf, 0xff, 0xfff, 0xffff };
     static const unsigned short kXMask[] = { 0x0, 0x1111, 0x3333, 0x7777,
             0xffff };
@@ -521,40 +736,66 @@ int etc1_encode_image(const etc1_byte* pIn, etc1_uint32 width, etc1_uint32 heigh
     etc1_byte encoded[ETC1_ENCODED_BLOCK_SIZE];
 
     etc1_uint32 encodedWidth = (width + 3) & ~3;
-    etc1_uint32 encodedHeight = (height + 3) & ~3;
 
-    for (etc1_uint32 y = 0; y < encodedHeight; y += 4) {
-        etc1_uint32 yEnd = height - y;
-        if (yEnd > 4) {
-            yEnd = 4;
+    etc1_uint32 yEnd = height - y;
+    if (yEnd > 4) {
+        yEnd = 4;
+    }
+    int ymask = kYMask[yEnd];
+    for (etc1_uint32 x = 0; x < encodedWidth; x += 4) {
+        etc1_uint32 xEnd = width - x;
+        if (xEnd > 4) {
+            xEnd = 4;
         }
-        int ymask = kYMask[yEnd];
-        for (etc1_uint32 x = 0; x < encodedWidth; x += 4) {
-            etc1_uint32 xEnd = width - x;
-            if (xEnd > 4) {
-                xEnd = 4;
-            }
-            int mask = ymask & kXMask[xEnd];
-            for (etc1_uint32 cy = 0; cy < yEnd; cy++) {
-                etc1_byte* q = block + (cy * 4) * 3;
-                const etc1_byte* p = pIn + pixelSize * x + stride * (y + cy);
-                if (pixelSize == 3) {
-                    memcpy(q, p, xEnd * 3);
-                } else {
-                    for (etc1_uint32 cx = 0; cx < xEnd; cx++) {
-                        int pixel = (p[1] << 8) | p[0];
-                        *q++ = convert5To8(pixel >> 11);
-                        *q++ = convert6To8(pixel >> 5);
-                        *q++ = convert5To8(pixel);
-                        p += pixelSize;
-                    }
+        int mask = ymask & kXMask[xEnd];
+        for (etc1_uint32 cy = 0; cy < yEnd; cy++) {
+            etc1_byte* q = block + (cy * 4) * 3;
+            const etc1_byte* p = pIn + pixelSize * x + stride * (y + cy);
+            if (pixelSize == 3) {
+                memcpy(q, p, xEnd * 3);
+            } else {
+                for (etc1_uint32 cx = 0; cx < xEnd; cx++) {
+                    int pixel = (p[1] << 8) | p[0];
+                    *q++ = convert5To8(pixel >> 11);
+                    *q++ = convert6To8(pixel >> 5);
+                    *q++ = convert5To8(pixel);
+                    p += pixelSize;
                 }
             }
-            etc1_encode_block(block, mask, encoded);
-            memcpy(pOut, encoded, sizeof(encoded));
-            pOut += sizeof(encoded);
         }
+        etc1_encode_block_quality(block, mask, quality, encoded);
+        memcpy(pOut, encoded, sizeof(encoded));
+        pOut += sizeof(encoded);
+    }
+}
+
+// Encode an entire image.
+// pIn - pointer to the image data. Formatted such that the Red component of
+//       pixel (x,y) is at pIn + pixelSize * x + stride * y + redOffset;
+// pOut - pointer to encoded data. Must be large enough to store entire encoded image.
+
+int etc1_encode_image(const etc1_byte* pIn, etc1_uint32 width, etc1_uint32 height,
+        etc1_uint32 pixelSize, etc1_uint32 stride, etc1_byte* pOut) {
+    return etc1_encode_image_quality(pIn, width, height, pixelSize, stride,
+            pOut, ETC1_QUALITY_NORMAL);
+}
+
+// Rows of blocks are independent, so they are spread over the shared
+// thread pool. Each row writes to its own slice of pOut.
+
+int etc1_encode_image_quality(const etc1_byte* pIn, etc1_uint32 width, etc1_uint32 height,
+        etc1_uint32 pixelSize, etc1_uint32 stride, etc1_byte* pOut,
+        etc1_quality quality) {
+    if (pixelSize < 2 || pixelSize > 3) {
+        return -1;
     }
+    etc1_uint32 encodedHeight = (height + 3) & ~3;
+    etc1_uint32 rowSize = ((width + 3) >> 2) * ETC1_ENCODED_BLOCK_SIZE;
+
+    flakor::ThreadPool::getInstance()->parallelFor(0, encodedHeight >> 2, [=](int row) {
+        etc_encode_block_row(pIn, width, height, pixelSize, stride, row * 4,
+                quality, pOut + row * rowSize);
+    });
     return 0;
 }
 
@@ -571,7 +812,7 @@ int etc1_decode_image(const etc1_byte* pIn, etc1_byte* pOut,
     if (pixelSize < 2 || pixelSize > 3) {
         return -1;
     }
-    etc1_byte block[ETC1_DECODED_BLOCK_SIZE];
+    etc1_decoded_palette decoded;
 
     etc1_uint32 encodedWidth = (width + 3) & ~3;
     etc1_uint32 encodedHeight = (height + 3) & ~3;
@@ -586,24 +827,10 @@ int etc1_decode_image(const etc1_byte* pIn, etc1_byte* pOut,
             if (xEnd > 4) {
                 xEnd = 4;
             }
-            etc1_decode_block(pIn, block);
+            build_palette(pIn, &decoded);
             pIn += ETC1_ENCODED_BLOCK_SIZE;
-            for (etc1_uint32 cy = 0; cy < yEnd; cy++) {
-                const etc1_byte* q = block + (cy * 4) * 3;
-                etc1_byte* p = pOut + pixelSize * x + stride * (y + cy);
-                if (pixelSize == 3) {
-                    memcpy(p, q, xEnd * 3);
-                } else {
-                    for (etc1_uint32 cx = 0; cx < xEnd; cx++) {
-                        etc1_byte r = *q++;
-                        etc1_byte g = *q++;
-                        etc1_byte b = *q++;
-                        etc1_uint32 pixel = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
-                        *p++ = (etc1_byte) pixel;
-                        *p++ = (etc1_byte) (pixel >> 8);
-                    }
-                }
-            }
+            write_decoded_block(&decoded, pOut + pixelSize * x + stride * y,
+                    xEnd, yEnd, pixelSize, stride);
         }
     }
     return 0;
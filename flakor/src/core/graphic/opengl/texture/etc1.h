@@ -30,6 +30,21 @@ typedef unsigned int etc1_uint32;
 extern "C" {
 #endif
 
+// How much effort the encoder spends searching for the best block encoding.
+//
+// ETC1_QUALITY_FAST only tries the two modifier tables that best match the
+// spread of each sub-block, about 4x faster than normal.
+// ETC1_QUALITY_NORMAL tries every modifier table. This is what
+// etc1_encode_block and etc1_encode_image use.
+// ETC1_QUALITY_EXHAUSTIVE also tries base colors one step around the
+// sub-block averages, about 9x slower than normal. Never worse than normal.
+
+typedef enum {
+    ETC1_QUALITY_FAST,
+    ETC1_QUALITY_NORMAL,
+    ETC1_QUALITY_EXHAUSTIVE
+} etc1_quality;
+
 // Encode a block of pixels.
 //
 // pIn is a pointer to a ETC_DECODED_BLOCK_SIZE array of bytes that represent a
@@ -43,6 +58,11 @@ extern "C" {
 
 void etc1_encode_block(const etc1_byte* pIn, etc1_uint32 validPixelMask, etc1_byte* pOut);
 
+// Same as etc1_encode_block with the given search effort.
+
+void etc1_encode_block_quality(const etc1_byte* pIn, etc1_uint32 validPixelMask,
+        etc1_quality quality, etc1_byte* pOut);
+
 // Decode a block of pixels.
 //
 // pIn is an ETC1 compressed version of the data.
@@ -53,6 +73,12 @@ void etc1_encode_block(const etc1_byte* pIn, etc1_uint32 validPixelMask, etc1_by
 
 void etc1_decode_block(const etc1_byte* pIn, etc1_byte* pOut);
 
+// Reference version of etc1_decode_block that decodes one pixel at a time
+// without SIMD. Both produce identical output; this one is kept for
+// verification and benchmarking.
+
+void etc1_decode_block_scalar(const etc1_byte* pIn, etc1_byte* pOut);
+
 // Return the size of the encoded image data (does not include size of PKM header).
 
 etc1_uint32 etc1_get_encoded_data_size(etc1_uint32 width, etc1_uint32 height);
@@ -67,6 +93,14 @@ etc1_uint32 etc1_get_encoded_data_size(etc1_uint32 width, etc1_uint32 height);
 int etc1_encode_image(const etc1_byte* pIn, etc1_uint32 width, etc1_uint32 height,
         etc1_uint32 pixelSize, etc1_uint32 stride, etc1_byte* pOut);
 
+// Same as etc1_encode_image with the given search effort. Rows of blocks are
+// encoded in parallel on the shared thread pool; the output does not depend
+// on the number of threads.
+
+int etc1_encode_image_quality(const etc1_byte* pIn, etc1_uint32 width, etc1_uint32 height,
+        etc1_uint32 pixelSize, etc1_uint32 stride, etc1_byte* pOut,
+        etc1_quality quality);
+
 // Decode an entire image.
 // pIn - pointer to encoded data.
 // pOut - pointer to the image data. Will be written such that
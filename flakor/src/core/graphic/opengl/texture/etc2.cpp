@@ -0,0 +1,854 @@
+/**********************************************************
+ * Copyright (c) 2013-2015 Steve Hsu  All Rights Reserved.
+ *********************************************************/
+
+#include "core/opengl/texture/etc2.h"
+#include "base/lang/ThreadPool.h"
+
+#include <string.h>
+
+/* Block layout, see appendix C.1 of the OpenGL ES 3.0 specification.
+
+ The 64 bit color block is read as two big endian words, high (bits 63..32)
+ and low (bits 31..0). Bit 33 is the diff bit, or the opaque bit for the
+ punch-through format where the diff bit is always taken as set.
+
+ diff bit 0: ETC1 individual mode.
+ diff bit 1: R, G and B are 5 bit bases plus 3 bit signed deltas at
+   bits 63..59/58..56, 55..51/50..48 and 47..43/42..40. If R + dR is
+   outside 0..31 the block is in T mode, else if G + dG is, H mode, else if
+   B + dB is, planar mode. Otherwise ETC1 differential mode.
+
+ T mode:  R1 = 60..59 57..56, G1 = 55..52, B1 = 51..48, R2 = 47..44,
+          G2 = 43..40, B2 = 39..36, distance = 35..34 32
+ H mode:  R1 = 62..59, G1 = 58..56 52, B1 = 51 49..47, R2 = 46..43,
+          G2 = 42..39, B2 = 38..35, distance = 34 32 (C1 >= C2)
+ planar:  RO = 62..57, GO = 56 54..49, BO = 48 44..43 41..39, RH = 38..34 32,
+          GH = 31..25, BH = 24..19, RV = 18..13, GV = 12..6, BV = 5..0
+
+ In every mode but planar, pixel (x, y) has a 2 bit index made of bit
+ (y + 4 * x) of low and bit (y + 4 * x + 16) of low as the msb. In
+ individual/differential mode the index picks a modifier, in T/H mode it
+ picks one of four paint colors directly.
+
+ EAC alpha block: base (8 bits), multiplier (4 bits), table (4 bits) and
+ 16 3-bit indices, pixel (x, y) at bits 45 - 3 * (y + 4 * x) of the
+ remaining 48 bits. alpha = clamp(base + table[index] * multiplier).
+ */
+
+static const int kModifierTable[] = {
+/* 0 */2, 8, -2, -8,
+/* 1 */5, 17, -5, -17,
+/* 2 */9, 29, -9, -29,
+/* 3 */13, 42, -13, -42,
+/* 4 */18, 60, -18, -60,
+/* 5 */24, 80, -24, -80,
+/* 6 */33, 106, -33, -106,
+/* 7 */47, 183, -47, -183 };
+
+static const int kDistanceTable[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+
+static const int kAlphaModifierTable[16][8] = {
+    { -3, -6, -9, -15, 2, 5, 8, 14 },
+    { -3, -7, -10, -13, 2, 6, 9, 12 },
+    { -2, -5, -8, -13, 1, 4, 7, 12 },
+    { -2, -4, -6, -13, 1, 3, 5, 12 },
+    { -3, -6, -8, -12, 2, 5, 7, 11 },
+    { -3, -7, -9, -11, 2, 6, 8, 10 },
+    { -4, -7, -8, -11, 3, 6, 7, 10 },
+    { -3, -5, -8, -11, 2, 4, 7, 10 },
+    { -2, -6, -8, -10, 1, 5, 7, 9 },
+    { -2, -5, -8, -10, 1, 4, 7, 9 },
+    { -2, -4, -8, -10, 1, 3, 7, 9 },
+    { -2, -5, -7, -10, 1, 4, 6, 9 },
+    { -3, -4, -7, -10, 2, 3, 6, 9 },
+    { -1, -2, -3, -10, 0, 1, 2, 9 },
+    { -4, -6, -8, -9, 3, 5, 7, 8 },
+    { -3, -5, -7, -9, 2, 4, 6, 8 } };
+
+static inline etc1_byte clamp(int x) {
+    return (etc1_byte) (x >= 0 ? (x < 255 ? x : 255) : 0);
+}
+
+static inline int convert4To8(int b) {
+    int c = b & 0xf;
+    return (c << 4) | c;
+}
+
+static inline int convert5To8(int b) {
+    int c = b & 0x1f;
+    return (c << 3) | (c >> 2);
+}
+
+static inline int convert6To8(int b) {
+    int c = b & 0x3f;
+    return (c << 2) | (c >> 4);
+}
+
+static inline int convert7To8(int b) {
+    int c = b & 0x7f;
+    return (c << 1) | (c >> 6);
+}
+
+static inline int convert8To5(int b) {
+    int c = b & 0xff;
+    return (c * 31 + 127) / 255;
+}
+
+static inline int signExtend3(int b) {
+    return (b & 4) ? (b | ~7) : (b & 7);
+}
+
+static inline int square(int x) {
+    return x * x;
+}
+
+static etc1_uint32 readBigEndian(const etc1_byte* pIn) {
+    return (pIn[0] << 24) | (pIn[1] << 16) | (pIn[2] << 8) | pIn[3];
+}
+
+static void writeBigEndian(etc1_byte* pOut, etc1_uint32 d) {
+    pOut[0] = (etc1_byte)(d >> 24);
+    pOut[1] = (etc1_byte)(d >> 16);
+    pOut[2] = (etc1_byte)(d >> 8);
+    pOut[3] = (etc1_byte) d;
+}
+
+static inline void setPixel(etc1_byte* pOut, int x, int y, int r, int g, int b, int a) {
+    etc1_byte* q = pOut + 4 * (x + 4 * y);
+    q[0] = clamp(r);
+    q[1] = clamp(g);
+    q[2] = clamp(b);
+    q[3] = (etc1_byte) a;
+}
+
+static inline int pixelIndex(etc1_uint32 low, int x, int y) {
+    int k = y + 4 * x;
+    return ((low >> k) & 1) | ((low >> (k + 15)) & 2);
+}
+
+// ETC1 style individual / differential block. colors holds the two 8 bit
+// base colors.
+
+static void decode_etc1_mode(etc1_uint32 high, etc1_uint32 low, const int* colors,
+        bool punchThrough, bool opaque, etc1_byte* pOut) {
+    const int* tableA = kModifierTable + (7 & (high >> 5)) * 4;
+    const int* tableB = kModifierTable + (7 & (high >> 2)) * 4;
+    bool flipped = (high & 1) != 0;
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            bool second = flipped ? y >= 2 : x >= 2;
+            const int* c = colors + (second ? 3 : 0);
+            const int* table = second ? tableB : tableA;
+            int index = pixelIndex(low, x, y);
+            int modifier = table[index];
+            if (punchThrough && !opaque) {
+                if (index == 2) {
+                    setPixel(pOut, x, y, 0, 0, 0, 0);
+                    continue;
+                }
+                if (index == 0) {
+                    modifier = 0;
+                }
+            }
+            setPixel(pOut, x, y, c[0] + modifier, c[1] + modifier, c[2] + modifier, 255);
+        }
+    }
+}
+
+// T and H mode: every pixel is one of four paint colors.
+
+static void decode_paint_mode(etc1_uint32 low, const int* paint,
+        bool punchThrough, bool opaque, etc1_byte* pOut) {
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            int index = pixelIndex(low, x, y);
+            if (punchThrough && !opaque && index == 2) {
+                setPixel(pOut, x, y, 0, 0, 0, 0);
+            } else {
+                const int* c = paint + index * 3;
+                setPixel(pOut, x, y, c[0], c[1], c[2], 255);
+            }
+        }
+    }
+}
+
+static void decode_t_mode(etc1_uint32 high, etc1_uint32 low,
+        bool punchThrough, bool opaque, etc1_byte* pOut) {
+    int r1 = convert4To8(((high >> 25) & 0xc) | ((high >> 24) & 3));
+    int g1 = convert4To8(high >> 20);
+    int b1 = convert4To8(high >> 16);
+    int r2 = convert4To8(high >> 12);
+    int g2 = convert4To8(high >> 8);
+    int b2 = convert4To8(high >> 4);
+    int d = kDistanceTable[((high >> 1) & 6) | (high & 1)];
+    int paint[12] = {
+        r1, g1, b1,
+        r2 + d, g2 + d, b2 + d,
+        r2, g2, b2,
+        r2 - d, g2 - d, b2 - d };
+    decode_paint_mode(low, paint, punchThrough, opaque, pOut);
+}
+
+static void decode_h_mode(etc1_uint32 high, etc1_uint32 low,
+        bool punchThrough, bool opaque, etc1_byte* pOut) {
+    int r1 = (high >> 27) & 0xf;
+    int g1 = ((high >> 23) & 0xe) | ((high >> 20) & 1);
+    int b1 = ((high >> 16) & 8) | ((high >> 15) & 7);
+    int r2 = (high >> 11) & 0xf;
+    int g2 = (high >> 7) & 0xf;
+    int b2 = (high >> 3) & 0xf;
+    int order = ((r1 << 8) | (g1 << 4) | b1) >= ((r2 << 8) | (g2 << 4) | b2) ? 1 : 0;
+    int d = kDistanceTable[(high & 4) | ((high & 1) << 1) | order];
+    r1 = convert4To8(r1);
+    g1 = convert4To8(g1);
+    b1 = convert4To8(b1);
+    r2 = convert4To8(r2);
+    g2 = convert4To8(g2);
+    b2 = convert4To8(b2);
+    int paint[12] = {
+        r1 + d, g1 + d, b1 + d,
+        r1 - d, g1 - d, b1 - d,
+        r2 + d, g2 + d, b2 + d,
+        r2 - d, g2 - d, b2 - d };
+    decode_paint_mode(low, paint, punchThrough, opaque, pOut);
+}
+
+static void decode_planar_mode(etc1_uint32 high, etc1_uint32 low, etc1_byte* pOut) {
+    int ro = convert6To8(high >> 25);
+    int go = convert7To8(((high >> 18) & 0x40) | ((high >> 17) & 0x3f));
+    int bo = convert6To8(((high >> 11) & 0x20) | ((high >> 8) & 0x18) | ((high >> 7) & 7));
+    int rh = convert6To8(((high >> 1) & 0x3e) | (high & 1));
+    int gh = convert7To8(low >> 25);
+    int bh = convert6To8(low >> 19);
+    int rv = convert6To8(low >> 13);
+    int gv = convert7To8(low >> 6);
+    int bv = convert6To8(low);
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            setPixel(pOut, x, y,
+                    (x * (rh - ro) + y * (rv - ro) + 4 * ro + 2) >> 2,
+                    (x * (gh - go) + y * (gv - go) + 4 * go + 2) >> 2,
+                    (x * (bh - bo) + y * (bv - bo) + 4 * bo + 2) >> 2,
+                    255);
+        }
+    }
+}
+
+static void decode_color_block(const etc1_byte* pIn, bool punchThrough, etc1_byte* pOut) {
+    etc1_uint32 high = readBigEndian(pIn);
+    etc1_uint32 low = readBigEndian(pIn + 4);
+    bool diff = punchThrough || (high & 2) != 0;
+    bool opaque = !punchThrough || (high & 2) != 0;
+    int colors[6];
+
+    if (!diff) {
+        colors[0] = convert4To8(high >> 28);
+        colors[1] = convert4To8(high >> 20);
+        colors[2] = convert4To8(high >> 12);
+        colors[3] = convert4To8(high >> 24);
+        colors[4] = convert4To8(high >> 16);
+        colors[5] = convert4To8(high >> 8);
+        decode_etc1_mode(high, low, colors, punchThrough, opaque, pOut);
+        return;
+    }
+
+    int r = (high >> 27) & 0x1f;
+    int g = (high >> 19) & 0x1f;
+    int b = (high >> 11) & 0x1f;
+    int r2 = r + signExtend3(high >> 24);
+    int g2 = g + signExtend3(high >> 16);
+    int b2 = b + signExtend3(high >> 8);
+    if (r2 < 0 || r2 > 31) {
+        decode_t_mode(high, low, punchThrough, opaque, pOut);
+    } else if (g2 < 0 || g2 > 31) {
+        decode_h_mode(high, low, punchThrough, opaque, pOut);
+    } else if (b2 < 0 || b2 > 31) {
+        decode_planar_mode(high, low, pOut);
+    } else {
+        colors[0] = convert5To8(r);
+        colors[1] = convert5To8(g);
+        colors[2] = convert5To8(b);
+        colors[3] = convert5To8(r2);
+        colors[4] = convert5To8(g2);
+        colors[5] = convert5To8(b2);
+        decode_etc1_mode(high, low, colors, punchThrough, opaque, pOut);
+    }
+}
+
+static void decode_alpha_block(const etc1_byte* pIn, etc1_byte* pOut) {
+    int base = pIn[0];
+    int multiplier = pIn[1] >> 4;
+    const int* table = kAlphaModifierTable[pIn[1] & 0xf];
+    etc1_uint32 high = (pIn[2] << 16) | (pIn[3] << 8) | pIn[4];
+    etc1_uint32 low = (pIn[5] << 16) | (pIn[6] << 8) | pIn[7];
+    for (int i = 0; i < 16; i++) {
+        int shift = 45 - 3 * i;
+        int index = shift >= 24 ? (high >> (shift - 24)) & 7 : (low >> shift) & 7;
+        int x = i >> 2;
+        int y = i & 3;
+        pOut[4 * (x + 4 * y) + 3] = clamp(base + table[index] * multiplier);
+    }
+}
+
+void etc2_decode_block(etc2_format format, const etc1_byte* pIn, etc1_byte* pOut) {
+    switch (format) {
+    case ETC2_FORMAT_RGBA8:
+        decode_color_block(pIn + 8, false, pOut);
+        decode_alpha_block(pIn, pOut);
+        break;
+    case ETC2_FORMAT_RGB8A1:
+        decode_color_block(pIn, true, pOut);
+        break;
+    default:
+        decode_color_block(pIn, false, pOut);
+        break;
+    }
+}
+
+// Error between two RGBA blocks over the valid pixels, weighted like the
+// ETC1 encoder. Alpha is only compared for transparent/opaque.
+
+static etc1_uint32 block_error(const etc1_byte* pIn, etc1_uint32 inMask,
+        const etc1_byte* pDecoded) {
+    etc1_uint32 error = 0;
+    for (int i = 0; i < 16; i++) {
+        if (inMask & (1 << i)) {
+            const etc1_byte* p = pIn + i * 4;
+            const etc1_byte* q = pDecoded + i * 4;
+            error += 3 * square(p[0] - q[0]) + 6 * square(p[1] - q[1]) + square(p[2] - q[2]);
+        }
+    }
+    return error;
+}
+
+// Least squares fit of one channel to O + x * (H - O) / 4 + y * (V - O) / 4
+// over the valid pixels, quantized to `bits` bits. Unless quality is fast,
+// the neighbouring quantized values are tried too.
+
+static void fit_planar_channel(const etc1_byte* pIn, etc1_uint32 inMask, int channel,
+        int bits, etc1_quality quality, int* pO, int* pH, int* pV) {
+    double n = 0, sx = 0, sy = 0, sxx = 0, syy = 0, sxy = 0;
+    double sc = 0, sxc = 0, syc = 0;
+    for (int i = 0; i < 16; i++) {
+        if (inMask & (1 << i)) {
+            double x = i & 3;
+            double y = i >> 2;
+            double c = pIn[i * 4 + channel];
+            n += 1;
+            sx += x;
+            sy += y;
+            sxx += x * x;
+            syy += y * y;
+            sxy += x * y;
+            sc += c;
+            sxc += x * c;
+            syc += y * c;
+        }
+    }
+
+    // solve [n sx sy; sx sxx sxy; sy sxy syy] * [a b c] = [sc sxc syc]
+    double det = n * (sxx * syy - sxy * sxy) - sx * (sx * syy - sxy * sy)
+            + sy * (sx * sxy - sxx * sy);
+    double a, b, c;
+    if (det > 1e-6 || det < -1e-6) {
+        a = (sc * (sxx * syy - sxy * sxy) - sx * (sxc * syy - sxy * syc)
+                + sy * (sxc * sxy - sxx * syc)) / det;
+        b = (n * (sxc * syy - syc * sxy) - sc * (sx * syy - sxy * sy)
+                + sy * (sx * syc - sxc * sy)) / det;
+        c = (n * (sxx * syc - sxy * sxc) - sx * (sx * syc - sxc * sy)
+                + sc * (sx * sxy - sxx * sy)) / det;
+    } else {
+        a = n > 0 ? sc / n : 0;
+        b = 0;
+        c = 0;
+    }
+
+    int maxValue = (1 << bits) - 1;
+    double target[3] = { a, a + 4 * b, a + 4 * c };
+    int quantized[3];
+    for (int k = 0; k < 3; k++) {
+        int q = (int) (target[k] * maxValue / 255.0 + 0.5);
+        quantized[k] = q < 0 ? 0 : (q > maxValue ? maxValue : q);
+    }
+
+    int best[3] = { quantized[0], quantized[1], quantized[2] };
+    if (quality != ETC1_QUALITY_FAST) {
+        int range = quality == ETC1_QUALITY_EXHAUSTIVE ? 2 : 1;
+        etc1_uint32 bestError = ~0u;
+        for (int dO = -range; dO <= range; dO++) {
+            int o = quantized[0] + dO;
+            if (o < 0 || o > maxValue) continue;
+            for (int dH = -range; dH <= range; dH++) {
+                int h = quantized[1] + dH;
+                if (h < 0 || h > maxValue) continue;
+                for (int dV = -range; dV <= range; dV++) {
+                    int v = quantized[2] + dV;
+                    if (v < 0 || v > maxValue) continue;
+                    int o8 = bits == 7 ? convert7To8(o) : convert6To8(o);
+                    int h8 = bits == 7 ? convert7To8(h) : convert6To8(h);
+                    int v8 = bits == 7 ? convert7To8(v) : convert6To8(v);
+                    etc1_uint32 error = 0;
+                    for (int i = 0; i < 16; i++) {
+                        if (inMask & (1 << i)) {
+                            int x = i & 3;
+                            int y = i >> 2;
+                            int decoded = clamp((x * (h8 - o8) + y * (v8 - o8) + 4 * o8 + 2) >> 2);
+                            error += square(decoded - pIn[i * 4 + channel]);
+                        }
+                    }
+                    if (error < bestError) {
+                        bestError = error;
+                        best[0] = o;
+                        best[1] = h;
+                        best[2] = v;
+                    }
+                }
+            }
+        }
+    }
+    *pO = best[0];
+    *pH = best[1];
+    *pV = best[2];
+}
+
+static void encode_planar(const etc1_byte* pIn, etc1_uint32 inMask,
+        etc1_quality quality, etc1_byte* pOut) {
+    int ro, rh, rv, go, gh, gv, bo, bh, bv;
+    fit_planar_channel(pIn, inMask, 0, 6, quality, &ro, &rh, &rv);
+    fit_planar_channel(pIn, inMask, 1, 7, quality, &go, &gh, &gv);
+    fit_planar_channel(pIn, inMask, 2, 6, quality, &bo, &bh, &bv);
+
+    etc1_uint32 high = (ro << 25) | ((go >> 6) << 24) | ((go & 0x3f) << 17)
+            | ((bo >> 5) << 16) | (((bo >> 3) & 3) << 11) | ((bo & 7) << 7)
+            | ((rh >> 1) << 2) | 2 | (rh & 1);
+    etc1_uint32 low = (gh << 25) | (bh << 19) | (rv << 13) | (gv << 6) | bv;
+
+    // The free bits 63, 55, 47..45 and 42 select planar mode: R and G must
+    // stay in range while B + dB must overflow.
+    if (signExtend3(high >> 24) < 0) {
+        high |= 1u << 31;
+    }
+    if (signExtend3(high >> 16) < 0) {
+        high |= 1u << 23;
+    }
+    if (((high >> 11) & 3) + ((high >> 8) & 3) > 3) {
+        high |= 7u << 13;
+    } else {
+        high |= 1u << 10;
+    }
+    writeBigEndian(pOut, high);
+    writeBigEndian(pOut + 4, low);
+}
+
+// Differential mode block for the punch-through format. There is no
+// individual mode there, so the second base color is clamped to the delta
+// range. Transparent pixels take index 2; with any of them present the
+// block is marked non-opaque, which turns modifier index 0 into 0.
+
+static etc1_uint32 encode_punch_through_differential(const etc1_byte* pIn, etc1_uint32 inMask,
+        etc1_uint32 transparentMask, bool flipped, etc1_byte* pOut) {
+    etc1_uint32 opaqueMask = inMask & ~transparentMask;
+    bool opaque = transparentMask == 0;
+    int base5[6];
+    for (int s = 0; s < 2; s++) {
+        int sum[3] = { 0, 0, 0 };
+        int count = 0;
+        for (int i = 0; i < 16; i++) {
+            int x = i & 3;
+            int y = i >> 2;
+            bool second = flipped ? y >= 2 : x >= 2;
+            if (second == (s == 1) && (opaqueMask & (1 << i))) {
+                sum[0] += pIn[i * 4];
+                sum[1] += pIn[i * 4 + 1];
+                sum[2] += pIn[i * 4 + 2];
+                count++;
+            }
+        }
+        for (int c = 0; c < 3; c++) {
+            base5[s * 3 + c] = count ? convert8To5((sum[c] + count / 2) / count) : -1;
+        }
+    }
+    for (int c = 0; c < 3; c++) {
+        // a sub-block without opaque pixels just follows the other one
+        if (base5[c] < 0) {
+            base5[c] = base5[c + 3] < 0 ? 0 : base5[c + 3];
+        }
+        if (base5[c + 3] < 0) {
+            base5[c + 3] = base5[c];
+        }
+        int delta = base5[c + 3] - base5[c];
+        delta = delta < -4 ? -4 : (delta > 3 ? 3 : delta);
+        base5[c + 3] = base5[c] + delta;
+    }
+
+    etc1_uint32 high = (base5[0] << 27) | ((7 & (base5[3] - base5[0])) << 24)
+            | (base5[1] << 19) | ((7 & (base5[4] - base5[1])) << 16)
+            | (base5[2] << 11) | ((7 & (base5[5] - base5[2])) << 8)
+            | (opaque ? 2 : 0) | (flipped ? 1 : 0);
+    etc1_uint32 low = 0;
+    etc1_uint32 totalError = 0;
+
+    for (int s = 0; s < 2; s++) {
+        int r = convert5To8(base5[s * 3]);
+        int g = convert5To8(base5[s * 3 + 1]);
+        int b = convert5To8(base5[s * 3 + 2]);
+        etc1_uint32 bestError = ~0u;
+        int bestTable = 0;
+        etc1_uint32 bestLow = 0;
+        for (int t = 0; t < 8; t++) {
+            const int* table = kModifierTable + t * 4;
+            etc1_uint32 error = 0;
+            etc1_uint32 tableLow = 0;
+            for (int i = 0; i < 16; i++) {
+                int x = i & 3;
+                int y = i >> 2;
+                bool second = flipped ? y >= 2 : x >= 2;
+                if (second != (s == 1)) {
+                    continue;
+                }
+                int bestIndex = 0;
+                if (transparentMask & (1 << i)) {
+                    bestIndex = 2;
+                } else if (opaqueMask & (1 << i)) {
+                    const etc1_byte* p = pIn + i * 4;
+                    etc1_uint32 bestPixelError = ~0u;
+                    for (int index = 0; index < 4; index++) {
+                        int modifier = table[index];
+                        if (!opaque) {
+                            if (index == 2) {
+                                continue;
+                            }
+                            if (index == 0) {
+                                modifier = 0;
+                            }
+                        }
+                        etc1_uint32 pixelError = 3 * square(clamp(r + modifier) - p[0])
+                                + 6 * square(clamp(g + modifier) - p[1])
+                                + square(clamp(b + modifier) - p[2]);
+                        if (pixelError < bestPixelError) {
+                            bestPixelError = pixelError;
+                            bestIndex = index;
+                        }
+                    }
+                    error += bestPixelError;
+                } else if (!opaque) {
+                    // keep don't-care pixels opaque
+                    bestIndex = 1;
+                }
+                int k = y + 4 * x;
+                tableLow |= ((bestIndex & 1) << k) | ((bestIndex >> 1) << (k + 16));
+            }
+            if (error < bestError) {
+                bestError = error;
+                bestTable = t;
+                bestLow = tableLow;
+            }
+        }
+        high |= bestTable << (s ? 2 : 5);
+        low |= bestLow;
+        totalError += bestError;
+    }
+    writeBigEndian(pOut, high);
+    writeBigEndian(pOut + 4, low);
+    return totalError;
+}
+
+static void encode_color_block(const etc1_byte* pIn, etc1_uint32 inMask,
+        bool punchThrough, etc1_quality quality, etc1_byte* pOut) {
+    etc1_byte decoded[ETC2_DECODED_BLOCK_SIZE];
+    etc1_byte candidate[ETC1_ENCODED_BLOCK_SIZE];
+    etc1_uint32 bestError;
+
+    etc1_uint32 transparentMask = 0;
+    if (punchThrough) {
+        for (int i = 0; i < 16; i++) {
+            if ((inMask & (1 << i)) && pIn[i * 4 + 3] < 128) {
+                transparentMask |= 1 << i;
+            }
+        }
+        bestError = encode_punch_through_differential(pIn, inMask, transparentMask, false, pOut);
+        if (encode_punch_through_differential(pIn, inMask, transparentMask, true, candidate) < bestError) {
+            memcpy(pOut, candidate, sizeof(candidate));
+        }
+        if (transparentMask != 0) {
+            return;
+        }
+        decode_color_block(pOut, true, decoded);
+        bestError = block_error(pIn, inMask, decoded);
+    } else {
+        // ETC1 blocks are valid ETC2 blocks: the ETC1 encoder only uses
+        // differential mode when the deltas are in range.
+        etc1_byte rgb[ETC1_DECODED_BLOCK_SIZE];
+        for (int i = 0; i < 16; i++) {
+            rgb[i * 3] = pIn[i * 4];
+            rgb[i * 3 + 1] = pIn[i * 4 + 1];
+            rgb[i * 3 + 2] = pIn[i * 4 + 2];
+        }
+        etc1_encode_block_quality(rgb, inMask, quality, pOut);
+        decode_color_block(pOut, false, decoded);
+        bestError = block_error(pIn, inMask, decoded);
+    }
+
+    // planar mode is good at smooth gradients that ETC1 bands on
+    encode_planar(pIn, inMask, quality, candidate);
+    decode_color_block(candidate, punchThrough, decoded);
+    if (block_error(pIn, inMask, decoded) < bestError) {
+        memcpy(pOut, candidate, sizeof(candidate));
+    }
+}
+
+static void encode_alpha_block(const etc1_byte* pIn, etc1_uint32 inMask,
+        etc1_quality quality, etc1_byte* pOut) {
+    int minAlpha = 255;
+    int maxAlpha = 0;
+    for (int i = 0; i < 16; i++) {
+        if (inMask & (1 << i)) {
+            int a = pIn[i * 4 + 3];
+            minAlpha = a < minAlpha ? a : minAlpha;
+            maxAlpha = a > maxAlpha ? a : maxAlpha;
+        }
+    }
+    if (minAlpha >= maxAlpha) {
+        // flat block, a zero multiplier makes every pixel the base value
+        memset(pOut, 0, 8);
+        pOut[0] = (etc1_byte) (minAlpha > maxAlpha ? 255 : minAlpha);
+        return;
+    }
+
+    int range = quality == ETC1_QUALITY_FAST ? 0 : (quality == ETC1_QUALITY_NORMAL ? 1 : 3);
+    etc1_uint32 bestError = ~0u;
+    int bestBase = 0, bestMultiplier = 1, bestTable = 0;
+    for (int t = 0; t < 16; t++) {
+        const int* table = kAlphaModifierTable[t];
+        int spread = table[7] - table[3];
+        int multiplier = (maxAlpha - minAlpha + spread / 2) / spread;
+        multiplier = multiplier < 1 ? 1 : (multiplier > 15 ? 15 : multiplier);
+        for (int m = multiplier - range; m <= multiplier + range; m++) {
+            if (m < 1 || m > 15) {
+                continue;
+            }
+            int base = (minAlpha + maxAlpha - (table[7] + table[3]) * m + 1) / 2;
+            for (int b = base - range; b <= base + range; b++) {
+                if (b < 0 || b > 255) {
+                    continue;
+                }
+                etc1_uint32 error = 0;
+                for (int i = 0; i < 16 && error < bestError; i++) {
+                    if (!(inMask & (1 << i))) {
+                        continue;
+                    }
+                    int a = pIn[i * 4 + 3];
+                    etc1_uint32 pixelError = ~0u;
+                    for (int index = 0; index < 8; index++) {
+                        etc1_uint32 e = square(clamp(b + table[index] * m) - a);
+                        pixelError = e < pixelError ? e : pixelError;
+                    }
+                    error += pixelError;
+                }
+                if (error < bestError) {
+                    bestError = error;
+                    bestBase = b;
+                    bestMultiplier = m;
+                    bestTable = t;
+                }
+            }
+        }
+    }
+
+    const int* table = kAlphaModifierTable[bestTable];
+    etc1_uint32 high = 0;
+    etc1_uint32 low = 0;
+    for (int i = 0; i < 16; i++) {
+        int x = i >> 2;
+        int y = i & 3;
+        int p = x + 4 * y;
+        int bestIndex = 0;
+        if (inMask & (1 << p)) {
+            int a = pIn[p * 4 + 3];
+            etc1_uint32 pixelError = ~0u;
+            for (int index = 0; index < 8; index++) {
+                etc1_uint32 e = square(clamp(bestBase + table[index] * bestMultiplier) - a);
+                if (e < pixelError) {
+                    pixelError = e;
+                    bestIndex = index;
+                }
+            }
+        }
+        int shift = 45 - 3 * i;
+        if (shift >= 24) {
+            high |= bestIndex << (shift - 24);
+        } else {
+            low |= bestIndex << shift;
+        }
+    }
+    pOut[0] = (etc1_byte) bestBase;
+    pOut[1] = (etc1_byte) ((bestMultiplier << 4) | bestTable);
+    pOut[2] = (etc1_byte) (high >> 16);
+    pOut[3] = (etc1_byte) (high >> 8);
+    pOut[4] = (etc1_byte) high;
+    pOut[5] = (etc1_byte) (low >> 16);
+    pOut[6] = (etc1_byte) (low >> 8);
+    pOut[7] = (etc1_byte) low;
+}
+
+void etc2_encode_block(etc2_format format, const etc1_byte* pIn,
+        etc1_uint32 validPixelMask, etc1_quality quality, etc1_byte* pOut) {
+    switch (format) {
+    case ETC2_FORMAT_RGBA8:
+        encode_alpha_block(pIn, validPixelMask, quality, pOut);
+        encode_color_block(pIn, validPixelMask, false, quality, pOut + 8);
+        break;
+    case ETC2_FORMAT_RGB8A1:
+        encode_color_block(pIn, validPixelMask, true, quality, pOut);
+        break;
+    default:
+        encode_color_block(pIn, validPixelMask, false, quality, pOut);
+        break;
+    }
+}
+
+etc1_uint32 etc2_get_block_size(etc2_format format) {
+    return format == ETC2_FORMAT_RGBA8 ? 16 : 8;
+}
+
+etc1_uint32 etc2_get_encoded_data_size(etc2_format format, etc1_uint32 width, etc1_uint32 height) {
+    return ((width + 3) >> 2) * ((height + 3) >> 2) * etc2_get_block_size(format);
+}
+
+int etc2_encode_image(etc2_format format, const etc1_byte* pIn,
+        etc1_uint32 width, etc1_uint32 height,
+        etc1_uint32 pixelSize, etc1_uint32 stride, etc1_byte* pOut,
+        etc1_quality quality) {
+    if (pixelSize < 3 || pixelSize > 4) {
+        return -1;
+    }
+    static const unsigned short kYMask[] = { 0x0, 0xf, 0xff, 0xfff, 0xffff };
+    static const unsigned short kXMask[] = { 0x0, 0x1111, 0x3333, 0x7777,
+            0xffff };
+    etc1_uint32 blockSize = etc2_get_block_size(format);
+    etc1_uint32 blocksPerRow = (width + 3) >> 2;
+
+    flakor::ThreadPool::getInstance()->parallelFor(0, (height + 3) >> 2, [=](int row) {
+        etc1_byte block[ETC2_DECODED_BLOCK_SIZE];
+        etc1_uint32 y = row * 4;
+        etc1_uint32 yEnd = height - y < 4 ? height - y : 4;
+        etc1_byte* q = pOut + row * blocksPerRow * blockSize;
+        for (etc1_uint32 x = 0; x < width; x += 4, q += blockSize) {
+            etc1_uint32 xEnd = width - x < 4 ? width - x : 4;
+            memset(block, 0xff, sizeof(block));
+            for (etc1_uint32 cy = 0; cy < yEnd; cy++) {
+                const etc1_byte* p = pIn + pixelSize * x + stride * (y + cy);
+                etc1_byte* b = block + cy * 16;
+                for (etc1_uint32 cx = 0; cx < xEnd; cx++, p += pixelSize, b += 4) {
+                    memcpy(b, p, pixelSize);
+                }
+            }
+            etc2_encode_block(format, block, kYMask[yEnd] & kXMask[xEnd], quality, q);
+        }
+    });
+    return 0;
+}
+
+int etc2_decode_image(etc2_format format, const etc1_byte* pIn, etc1_byte* pOut,
+        etc1_uint32 width, etc1_uint32 height,
+        etc1_uint32 pixelSize, etc1_uint32 stride) {
+    if (pixelSize != 4 && !(pixelSize == 3 && format == ETC2_FORMAT_RGB8)) {
+        return -1;
+    }
+    etc1_uint32 blockSize = etc2_get_block_size(format);
+    etc1_uint32 blocksPerRow = (width + 3) >> 2;
+
+    flakor::ThreadPool::getInstance()->parallelFor(0, (height + 3) >> 2, [=](int row) {
+        etc1_byte block[ETC2_DECODED_BLOCK_SIZE];
+        etc1_uint32 y = row * 4;
+        etc1_uint32 yEnd = height - y < 4 ? height - y : 4;
+        const etc1_byte* q = pIn + row * blocksPerRow * blockSize;
+        for (etc1_uint32 x = 0; x < width; x += 4, q += blockSize) {
+            etc1_uint32 xEnd = width - x < 4 ? width - x : 4;
+            etc2_decode_block(format, q, block);
+            for (etc1_uint32 cy = 0; cy < yEnd; cy++) {
+                const etc1_byte* b = block + cy * 16;
+                etc1_byte* p = pOut + pixelSize * x + stride * (y + cy);
+                if (pixelSize == 4) {
+                    memcpy(p, b, xEnd * 4);
+                } else {
+                    for (etc1_uint32 cx = 0; cx < xEnd; cx++, b += 4) {
+                        *p++ = b[0];
+                        *p++ = b[1];
+                        *p++ = b[2];
+                    }
+                }
+            }
+        }
+    });
+    return 0;
+}
+
+static const char kMagic[] = { 'P', 'K', 'M', ' ', '2', '0' };
+
+static const etc1_uint32 ETC2_PKM_FORMAT_OFFSET = 6;
+static const etc1_uint32 ETC2_PKM_ENCODED_WIDTH_OFFSET = 8;
+static const etc1_uint32 ETC2_PKM_ENCODED_HEIGHT_OFFSET = 10;
+static const etc1_uint32 ETC2_PKM_WIDTH_OFFSET = 12;
+static const etc1_uint32 ETC2_PKM_HEIGHT_OFFSET = 14;
+
+// format codes used by etcpack
+static const etc1_uint32 ETC2_PKM_ETC1_RGB = 0;
+static const etc1_uint32 ETC2_PKM_RGB = 1;
+static const etc1_uint32 ETC2_PKM_RGBA_OLD = 2;
+static const etc1_uint32 ETC2_PKM_RGBA = 3;
+static const etc1_uint32 ETC2_PKM_RGBA1 = 4;
+
+static void writeBEUint16(etc1_byte* pOut, etc1_uint32 data) {
+    pOut[0] = (etc1_byte) (data >> 8);
+    pOut[1] = (etc1_byte) data;
+}
+
+static etc1_uint32 readBEUint16(const etc1_byte* pIn) {
+    return (pIn[0] << 8) | pIn[1];
+}
+
+void etc2_pkm_format_header(etc1_byte* pHeader, etc2_format format,
+        etc1_uint32 width, etc1_uint32 height) {
+    memcpy(pHeader, kMagic, sizeof(kMagic));
+    etc1_uint32 code = ETC2_PKM_RGB;
+    if (format == ETC2_FORMAT_RGBA8) {
+        code = ETC2_PKM_RGBA;
+    } else if (format == ETC2_FORMAT_RGB8A1) {
+        code = ETC2_PKM_RGBA1;
+    }
+    writeBEUint16(pHeader + ETC2_PKM_FORMAT_OFFSET, code);
+    writeBEUint16(pHeader + ETC2_PKM_ENCODED_WIDTH_OFFSET, (width + 3) & ~3);
+    writeBEUint16(pHeader + ETC2_PKM_ENCODED_HEIGHT_OFFSET, (height + 3) & ~3);
+    writeBEUint16(pHeader + ETC2_PKM_WIDTH_OFFSET, width);
+    writeBEUint16(pHeader + ETC2_PKM_HEIGHT_OFFSET, height);
+}
+
+etc1_bool etc2_pkm_is_valid(const etc1_byte* pHeader) {
+    if (memcmp(pHeader, kMagic, sizeof(kMagic))) {
+        return false;
+    }
+    etc1_uint32 format = readBEUint16(pHeader + ETC2_PKM_FORMAT_OFFSET);
+    etc1_uint32 encodedWidth = readBEUint16(pHeader + ETC2_PKM_ENCODED_WIDTH_OFFSET);
+    etc1_uint32 encodedHeight = readBEUint16(pHeader + ETC2_PKM_ENCODED_HEIGHT_OFFSET);
+    etc1_uint32 width = readBEUint16(pHeader + ETC2_PKM_WIDTH_OFFSET);
+    etc1_uint32 height = readBEUint16(pHeader + ETC2_PKM_HEIGHT_OFFSET);
+    return format <= ETC2_PKM_RGBA1 &&
+            encodedWidth >= width && encodedWidth - width < 4 &&
+            encodedHeight >= height && encodedHeight - height < 4;
+}
+
+etc2_format etc2_pkm_get_format(const etc1_byte* pHeader) {
+    switch (readBEUint16(pHeader + ETC2_PKM_FORMAT_OFFSET)) {
+    case ETC2_PKM_RGBA_OLD:
+    case ETC2_PKM_RGBA:
+        return ETC2_FORMAT_RGBA8;
+    case ETC2_PKM_RGBA1:
+        return ETC2_FORMAT_RGB8A1;
+    case ETC2_PKM_ETC1_RGB:
+    case ETC2_PKM_RGB:
+    default:
+        return ETC2_FORMAT_RGB8;
+    }
+}
@@ -0,0 +1,106 @@
+/**********************************************************
+ * Copyright (c) 2013-2015 Steve Hsu  All Rights Reserved.
+ *********************************************************/
+
+// ETC2 / EAC texture compression, as defined in appendix C of the
+// OpenGL ES 3.0 specification. Companion to etc1.h, whose types, quality
+// presets and PKM width/height helpers are shared.
+
+#ifndef __etc2_h__
+#define __etc2_h__
+
+#include "core/opengl/texture/etc1.h"
+
+// 4 x 4 square of 4-byte pixels in form R, G, B, A.
+#define ETC2_DECODED_BLOCK_SIZE 64
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ETC2_FORMAT_RGB8 - opaque RGB, 8 bytes per block. Every ETC1 file is a
+// valid ETC2 RGB8 file.
+// ETC2_FORMAT_RGBA8 - 8 byte EAC alpha block followed by an ETC2 RGB8
+// block, 16 bytes per block.
+// ETC2_FORMAT_RGB8A1 - RGB with 1-bit (punch-through) alpha, 8 bytes per
+// block. Transparent pixels decode to 0, 0, 0, 0.
+
+typedef enum {
+    ETC2_FORMAT_RGB8,
+    ETC2_FORMAT_RGBA8,
+    ETC2_FORMAT_RGB8A1
+} etc2_format;
+
+// Size in bytes of one encoded 4 x 4 block.
+
+etc1_uint32 etc2_get_block_size(etc2_format format);
+
+// Return the size of the encoded image data (does not include size of PKM header).
+
+etc1_uint32 etc2_get_encoded_data_size(etc2_format format, etc1_uint32 width, etc1_uint32 height);
+
+// Encode a block of pixels.
+//
+// pIn is a pointer to a ETC2_DECODED_BLOCK_SIZE array of bytes that represent a
+// 4 x 4 square of 4-byte pixels in form R, G, B, A. Byte (4 * (x + 4 * y) is the R
+// value of pixel (x, y). Alpha is ignored for ETC2_FORMAT_RGB8 and thresholded
+// at 128 for ETC2_FORMAT_RGB8A1.
+//
+// validPixelMask is a 16-bit mask where bit (1 << (x + y * 4)) indicates whether
+// the corresponding (x,y) pixel is valid. Invalid pixel color values are ignored when compressing.
+//
+// pOut receives etc2_get_block_size(format) bytes.
+
+void etc2_encode_block(etc2_format format, const etc1_byte* pIn,
+        etc1_uint32 validPixelMask, etc1_quality quality, etc1_byte* pOut);
+
+// Decode a block of pixels.
+//
+// pOut is a pointer to a ETC2_DECODED_BLOCK_SIZE array of bytes laid out like
+// the input of etc2_encode_block. Alpha is 255 for ETC2_FORMAT_RGB8.
+
+void etc2_decode_block(etc2_format format, const etc1_byte* pIn, etc1_byte* pOut);
+
+// Encode an entire image.
+// pIn - pointer to the image data. Formatted such that
+//       pixel (x,y) is at pIn + pixelSize * x + stride * y;
+// pixelSize can be 3 (R, G, B, treated as opaque) or 4 (R, G, B, A).
+// Rows of blocks are encoded in parallel on the shared thread pool.
+// returns non-zero if there is an error.
+
+int etc2_encode_image(etc2_format format, const etc1_byte* pIn,
+        etc1_uint32 width, etc1_uint32 height,
+        etc1_uint32 pixelSize, etc1_uint32 stride, etc1_byte* pOut,
+        etc1_quality quality);
+
+// Decode an entire image.
+// pOut - pointer to the image data. Will be written such that
+//        pixel (x,y) is at pIn + pixelSize * x + stride * y.
+// pixelSize can be 3 (R, G, B) for ETC2_FORMAT_RGB8, and 4 (R, G, B, A) for
+// every format.
+// returns non-zero if there is an error.
+
+int etc2_decode_image(etc2_format format, const etc1_byte* pIn, etc1_byte* pOut,
+        etc1_uint32 width, etc1_uint32 height,
+        etc1_uint32 pixelSize, etc1_uint32 stride);
+
+// Format a version 2.0 PKM header. The header is ETC_PKM_HEADER_SIZE bytes
+// and etc1_pkm_get_width / etc1_pkm_get_height work on it.
+
+void etc2_pkm_format_header(etc1_byte* pHeader, etc2_format format,
+        etc1_uint32 width, etc1_uint32 height);
+
+// Check if a version 2.0 PKM header is correctly formatted and holds one of
+// the formats above.
+
+etc1_bool etc2_pkm_is_valid(const etc1_byte* pHeader);
+
+// Read the format from a valid version 2.0 PKM header
+
+etc2_format etc2_pkm_get_format(const etc1_byte* pHeader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
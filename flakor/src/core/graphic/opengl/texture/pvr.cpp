@@ -19,6 +19,20 @@
 #include <assert.h>
 #include <cstdint>
 #include "core/opengl/texture/pvr.h"
+#include "base/lang/ThreadPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PVRT_USE_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define PVRT_USE_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(__BMI2__)
+#define PVRT_USE_BMI2 1
+#include <immintrin.h>
+#endif
 
 #define PVRT_MIN(a,b)            (((a) < (b)) ? (a) : (b))
 #define PVRT_MAX(a,b)            (((a) > (b)) ? (a) : (b))
@@ -36,6 +50,8 @@
 #define BLK_X_2BPP	(8) // dimensions for the two formats
 #define BLK_X_4BPP	(4)
 
+#define ROWS_PER_TASK	(32) // pixel rows decoded by one thread pool task
+
 #define WRAP_COORD(Val, Size) ((Val) & ((Size)-1))
 
 #define POWER_OF_2(X)   util_number_is_power_2(X)
@@ -119,7 +135,7 @@ int util_number_is_power_2( unsigned  input )
  to 5554 formats
  *************************************************************************/
 static void Unpack5554Colour(const AMTC_BLOCK_STRUCT *pBlock,
-							 int   ABColours[2][4])
+							 short ABColours[2][4])
 {
 	U32 RawBits[2];
     
@@ -284,38 +300,26 @@ static void	UnpackModulations(const AMTC_BLOCK_STRUCT *pBlock,
  @Input			Do2bitMode
  @Input			x
  @Input			y
- @Modified		Result
- @Description	This performs a HW bit accurate interpolation of either the
- A or B colours for a particular pixel.
+ @Modified		ASig
+ @Modified		BSig
+ @Description	This performs a HW bit accurate interpolation of both the
+ A and B colours for a particular pixel.
  
  NOTE: It is assumed that the source colours are in ARGB 5554
- format - This means that some "preparation" of the values will
- be necessary.
+ format, A colour first and B colour second. All eight channels fit in 16 bits at every step, so
+ the SIMD paths interpolate A and B together in one register.
  *************************************************************************/
-static void InterpolateColours(const int ColourP[4],
-                               const int ColourQ[4],
-                               const int ColourR[4],
-                               const int ColourS[4],
+static void InterpolateColours(const short ColourP[2][4],
+                               const short ColourQ[2][4],
+                               const short ColourR[2][4],
+                               const short ColourS[2][4],
                                const int Do2bitMode,
                                const int x,
                                const int y,
-                               int Result[4])
+                               int ASig[4],
+                               int BSig[4])
 {
 	int u, v, uscale;
-	int k;
-    
-	int tmp1, tmp2;
-    
-	int P[4], Q[4], R[4], S[4];
-    
-	// Copy the colours
-	for(k = 0; k < 4; k++)
-	{
-		P[k] = ColourP[k];
-		Q[k] = ColourQ[k];
-		R[k] = ColourR[k];
-		S[k] = ColourS[k];
-	}
     
 	// put the x and y values into the right range
 	v = (y & 0x3) | ((~y & 0x2) << 1);
@@ -339,10 +343,65 @@ static void InterpolateColours(const int ColourP[4],
 		uscale = 4;
 	}
     
-	for(k = 0; k < 4; k++)
+#if defined(PVRT_USE_SSE2)
+	const __m128i P = _mm_loadu_si128((const __m128i *)&ColourP[0][0]);
+	const __m128i Q = _mm_loadu_si128((const __m128i *)&ColourQ[0][0]);
+	const __m128i R = _mm_loadu_si128((const __m128i *)&ColourR[0][0]);
+	const __m128i S = _mm_loadu_si128((const __m128i *)&ColourS[0][0]);
+	const __m128i U = _mm_set1_epi16((short)u);
+	const __m128i V = _mm_set1_epi16((short)v);
+	const __m128i UScale = _mm_set1_epi16((short)uscale);
+    
+	__m128i tmp1 = _mm_add_epi16(_mm_mullo_epi16(P, UScale), _mm_mullo_epi16(U, _mm_sub_epi16(Q, P)));
+	__m128i tmp2 = _mm_add_epi16(_mm_mullo_epi16(R, UScale), _mm_mullo_epi16(U, _mm_sub_epi16(S, R)));
+	__m128i Result = _mm_add_epi16(_mm_slli_epi16(tmp1, 2), _mm_mullo_epi16(V, _mm_sub_epi16(tmp2, tmp1)));
+    
+	/*
+     Lop off the bits to get to 8 bit precision. Alpha keeps one bit
+     more than RGB, so double it first and shift every lane the same.
+     Then convert 5554 to 8888: RGB += RGB >> 5, A += A >> 4, done as
+     (x * 8) >> 8 and (x * 16) >> 8. Everything is non-negative here.
+     */
+	Result = _mm_mullo_epi16(Result, _mm_set_epi16(2, 1, 1, 1, 2, 1, 1, 1));
+	Result = Do2bitMode ? _mm_srli_epi16(Result, 2) : _mm_srli_epi16(Result, 1);
+	Result = _mm_add_epi16(Result, _mm_srli_epi16(_mm_mullo_epi16(Result, _mm_set_epi16(16, 8, 8, 8, 16, 8, 8, 8)), 8));
+    
+	const __m128i Zero = _mm_setzero_si128();
+	_mm_storeu_si128((__m128i *)ASig, _mm_unpacklo_epi16(Result, Zero));
+	_mm_storeu_si128((__m128i *)BSig, _mm_unpackhi_epi16(Result, Zero));
+#elif defined(PVRT_USE_NEON)
+	static const int16_t LopShift2bpp[8] = {-2, -2, -2, -1, -2, -2, -2, -1};
+	static const int16_t LopShift4bpp[8] = {-1, -1, -1,  0, -1, -1, -1,  0};
+	static const int16_t ExpandShift[8]  = {-5, -5, -5, -4, -5, -5, -5, -4};
+    
+	const int16x8_t P = vld1q_s16(&ColourP[0][0]);
+	const int16x8_t Q = vld1q_s16(&ColourQ[0][0]);
+	const int16x8_t R = vld1q_s16(&ColourR[0][0]);
+	const int16x8_t S = vld1q_s16(&ColourS[0][0]);
+	const int16x8_t U = vdupq_n_s16((int16_t)u);
+    
+	int16x8_t tmp1 = vmlaq_s16(vmulq_n_s16(P, (int16_t)uscale), U, vsubq_s16(Q, P));
+	int16x8_t tmp2 = vmlaq_s16(vmulq_n_s16(R, (int16_t)uscale), U, vsubq_s16(S, R));
+	int16x8_t Result = vmlaq_n_s16(vshlq_n_s16(tmp1, 2), vsubq_s16(tmp2, tmp1), (int16_t)v);
+    
+	// Lop off to 8 bit precision, then convert 5554 to 8888
+	Result = vshlq_s16(Result, vld1q_s16(Do2bitMode ? LopShift2bpp : LopShift4bpp));
+	Result = vaddq_s16(Result, vshlq_s16(Result, vld1q_s16(ExpandShift)));
+    
+	vst1q_s32(ASig, vmovl_s16(vget_low_s16(Result)));
+	vst1q_s32(BSig, vmovl_s16(vget_high_s16(Result)));
+#else
+	int k;
+	int tmp1, tmp2;
+	int Result[8];
+    
+	for(k = 0; k < 8; k++)
 	{
-		tmp1 = P[k] * uscale + u * (Q[k] - P[k]);
-		tmp2 = R[k] * uscale + u * (S[k] - R[k]);
+		const int P = ColourP[k >> 2][k & 3], Q = ColourQ[k >> 2][k & 3];
+		const int R = ColourR[k >> 2][k & 3], S = ColourS[k >> 2][k & 3];
+        
+		tmp1 = P * uscale + u * (Q - P);
+		tmp2 = R * uscale + u * (S - R);
         
 		tmp1 = tmp1 * 4 + v * (tmp2 - tmp1);
         
@@ -350,50 +409,36 @@ static void InterpolateColours(const int ColourP[4],
 	}
     
 	// Lop off the appropriate number of bits to get us to 8 bit precision
-	if(Do2bitMode)
+	for(k = 0; k < 8; k++)
 	{
-		// do RGB
-		for(k = 0; k < 3; k++)
-		{
-			Result[k] >>= 2;
-		}
+		if(Do2bitMode)
+			Result[k] >>= ((k & 3) == 3) ? 1 : 2;	// RGB by 2, A by 1
+		else if((k & 3) != 3)
+			Result[k] >>= 1;						// RGB by 1, A is ok
         
-		Result[3] >>= 1;
-	}
-	else
-	{
-		// do RGB  (A is ok)
-		for(k = 0; k < 3; k++)
-		{
-			Result[k] >>= 1;
-		}
-	}
-    
-	// sanity check
-	for(k = 0; k < 4; k++)
-	{
+		// sanity check
 		assert(Result[k] < 256);
 	}
     
-    
 	/*
      Convert from 5554 to 8888
      
      do RGB 5.3 => 8
      */
-	for(k = 0; k < 3; k++)
+	for(k = 0; k < 8; k++)
 	{
-		Result[k] += Result[k] >> 5;
+		Result[k] += Result[k] >> (((k & 3) == 3) ? 4 : 5);
+        
+		// 2nd sanity check
+		assert(Result[k] < 256);
 	}
     
-	Result[3] += Result[3] >> 4;
-    
-	// 2nd sanity check
 	for(k = 0; k < 4; k++)
 	{
-		assert(Result[k] < 256);
+		ASig[k] = Result[k];
+		BSig[k] = Result[k + 4];
 	}
-    
+#endif
 }
 
 /*!***********************************************************************
@@ -469,6 +514,61 @@ static void GetModulationValue(int x,
 	*Mod =ModVal;
 }
 
+/*!***********************************************************************
+ @Function		SpreadBits
+ @Input			Val A 16 bit value
+ @Returns		Val with its bits moved to the even bit positions
+ @Description	Spreads out the bits of one coordinate so that two of them
+ can be interleaved into a Morton (twiddled) index. Uses PDEP
+ where available, else one table lookup per byte.
+ *************************************************************************/
+#if !defined(PVRT_USE_BMI2)
+static const unsigned short MortonTable[256] =
+{
+	0x0000, 0x0001, 0x0004, 0x0005, 0x0010, 0x0011, 0x0014, 0x0015,
+	0x0040, 0x0041, 0x0044, 0x0045, 0x0050, 0x0051, 0x0054, 0x0055,
+	0x0100, 0x0101, 0x0104, 0x0105, 0x0110, 0x0111, 0x0114, 0x0115,
+	0x0140, 0x0141, 0x0144, 0x0145, 0x0150, 0x0151, 0x0154, 0x0155,
+	0x0400, 0x0401, 0x0404, 0x0405, 0x0410, 0x0411, 0x0414, 0x0415,
+	0x0440, 0x0441, 0x0444, 0x0445, 0x0450, 0x0451, 0x0454, 0x0455,
+	0x0500, 0x0501, 0x0504, 0x0505, 0x0510, 0x0511, 0x0514, 0x0515,
+	0x0540, 0x0541, 0x0544, 0x0545, 0x0550, 0x0551, 0x0554, 0x0555,
+	0x1000, 0x1001, 0x1004, 0x1005, 0x1010, 0x1011, 0x1014, 0x1015,
+	0x1040, 0x1041, 0x1044, 0x1045, 0x1050, 0x1051, 0x1054, 0x1055,
+	0x1100, 0x1101, 0x1104, 0x1105, 0x1110, 0x1111, 0x1114, 0x1115,
+	0x1140, 0x1141, 0x1144, 0x1145, 0x1150, 0x1151, 0x1154, 0x1155,
+	0x1400, 0x1401, 0x1404, 0x1405, 0x1410, 0x1411, 0x1414, 0x1415,
+	0x1440, 0x1441, 0x1444, 0x1445, 0x1450, 0x1451, 0x1454, 0x1455,
+	0x1500, 0x1501, 0x1504, 0x1505, 0x1510, 0x1511, 0x1514, 0x1515,
+	0x1540, 0x1541, 0x1544, 0x1545, 0x1550, 0x1551, 0x1554, 0x1555,
+	0x4000, 0x4001, 0x4004, 0x4005, 0x4010, 0x4011, 0x4014, 0x4015,
+	0x4040, 0x4041, 0x4044, 0x4045, 0x4050, 0x4051, 0x4054, 0x4055,
+	0x4100, 0x4101, 0x4104, 0x4105, 0x4110, 0x4111, 0x4114, 0x4115,
+	0x4140, 0x4141, 0x4144, 0x4145, 0x4150, 0x4151, 0x4154, 0x4155,
+	0x4400, 0x4401, 0x4404, 0x4405, 0x4410, 0x4411, 0x4414, 0x4415,
+	0x4440, 0x4441, 0x4444, 0x4445, 0x4450, 0x4451, 0x4454, 0x4455,
+	0x4500, 0x4501, 0x4504, 0x4505, 0x4510, 0x4511, 0x4514, 0x4515,
+	0x4540, 0x4541, 0x4544, 0x4545, 0x4550, 0x4551, 0x4554, 0x4555,
+	0x5000, 0x5001, 0x5004, 0x5005, 0x5010, 0x5011, 0x5014, 0x5015,
+	0x5040, 0x5041, 0x5044, 0x5045, 0x5050, 0x5051, 0x5054, 0x5055,
+	0x5100, 0x5101, 0x5104, 0x5105, 0x5110, 0x5111, 0x5114, 0x5115,
+	0x5140, 0x5141, 0x5144, 0x5145, 0x5150, 0x5151, 0x5154, 0x5155,
+	0x5400, 0x5401, 0x5404, 0x5405, 0x5410, 0x5411, 0x5414, 0x5415,
+	0x5440, 0x5441, 0x5444, 0x5445, 0x5450, 0x5451, 0x5454, 0x5455,
+	0x5500, 0x5501, 0x5504, 0x5505, 0x5510, 0x5511, 0x5514, 0x5515,
+	0x5540, 0x5541, 0x5544, 0x5545, 0x5550, 0x5551, 0x5554, 0x5555,
+};
+#endif
+
+static inline U32 SpreadBits(U32 Val)
+{
+#if defined(PVRT_USE_BMI2)
+	return _pdep_u32(Val, 0x55555555);
+#else
+	return (U32)MortonTable[Val & 0xFF] | ((U32)MortonTable[(Val >> 8) & 0xFF] << 16);
+#endif
+}
+
 /*!***********************************************************************
  @Function		TwiddleUV
  @Input			YSize	Y dimension of the texture in pixels
@@ -486,15 +586,9 @@ static int DisableTwiddlingRoutine = 0;
 
 static U32 TwiddleUV(U32 YSize, U32 XSize, U32 YPos, U32 XPos)
 {
-	U32 Twiddled;
-    
 	U32 MinDimension;
 	U32 MaxValue;
-    
-	U32 SrcBitPos;
-	U32 DstBitPos;
-    
-	int ShiftCount;
+	U32 Mask;
     
 	assert(YPos < YSize);
 	assert(XPos < XSize);
@@ -517,55 +611,40 @@ static U32 TwiddleUV(U32 YSize, U32 XSize, U32 YPos, U32 XPos)
 	if(DisableTwiddlingRoutine)
 		return (YPos* XSize + XPos);
     
-	// Step through all the bits in the "minimum" dimension
-	SrcBitPos = 1;
-	DstBitPos = 1;
-	Twiddled  = 0;
-	ShiftCount = 0;
-    
-	while(SrcBitPos < MinDimension)
-	{
-		if(YPos & SrcBitPos)
-		{
-			Twiddled |= DstBitPos;
-		}
-        
-		if(XPos & SrcBitPos)
-		{
-			Twiddled |= (DstBitPos << 1);
-		}
-        
-        
-		SrcBitPos <<= 1;
-		DstBitPos <<= 2;
-		ShiftCount += 1;
-        
-	}
-    
-	// prepend any unused bits
-	MaxValue >>= ShiftCount;
-    
-	Twiddled |=  (MaxValue << (2*ShiftCount));
+	/*
+     Interleave the bits of the "minimum" dimension, Y in the even bits
+     and X in the odd ones, then prepend the unused high bits of the
+     larger coordinate. MinDimension is a power of 2, so shifting those
+     bits up by log2(MinDimension) is the same as multiplying.
+     */
+	Mask = MinDimension - 1;
+	assert(Mask <= 0xFFFF);
     
-	return Twiddled;
+	return SpreadBits(YPos & Mask) | (SpreadBits(XPos & Mask) << 1) | ((MaxValue & ~Mask) * MinDimension);
 }
 
 /*!***********************************************************************
- @Function		Decompress
+ @Function		DecompressRows
  @Input			pCompressedData The PVRTC texture data to decompress
  @Input			Do2BitMode Signifies whether the data is PVRTC2 or PVRTC4
  @Input			XDim X dimension of the texture
  @Input			YDim Y dimension of the texture
  @Input			AssumeImageTiles Assume the texture data tiles
+ @Input			YStart First pixel row to decompress
+ @Input			YEnd One past the last pixel row to decompress
  @Modified		pResultImage The decompressed texture data
- @Description	Decompresses PVRTC to RGBA 8888
+ @Description	Decompresses rows [YStart, YEnd) of a PVRTC texture to
+ RGBA 8888. Only reads the compressed data and writes its own
+ rows, so several bands can be decompressed at the same time.
  *************************************************************************/
-static void PVRDecompress(AMTC_BLOCK_STRUCT *pCompressedData,
-                       const bool Do2bitMode,
-                       const int XDim,
-                       const int YDim,
-                       const int AssumeImageTiles,
-                       unsigned char* pResultImage)
+static void PVRDecompressRows(const AMTC_BLOCK_STRUCT *pCompressedData,
+                              const bool Do2bitMode,
+                              const int XDim,
+                              const int YDim,
+                              const int AssumeImageTiles,
+                              const int YStart,
+                              const int YEnd,
+                              unsigned char* pResultImage)
 {
 	int x, y;
 	int i, j;
@@ -585,14 +664,14 @@ static void PVRDecompress(AMTC_BLOCK_STRUCT *pCompressedData,
 	unsigned int uPosition;
     
 	// local neighbourhood of blocks
-	AMTC_BLOCK_STRUCT *pBlocks[2][2];
+	const AMTC_BLOCK_STRUCT *pBlocks[2][2];
     
-	AMTC_BLOCK_STRUCT *pPrevious[2][2] = {{NULL, NULL}, {NULL, NULL}};
+	const AMTC_BLOCK_STRUCT *pPrevious[2][2] = {{NULL, NULL}, {NULL, NULL}};
     
-	// Low precision colours extracted from the blocks
+	// Low precision colours extracted from the blocks, A then B
 	struct
 	{
-		int Reps[2][4];
+		short Reps[2][4];
 	}Colours5554[2][2];
     
 	// Interpolated A and B colours for the pixel
@@ -610,28 +689,26 @@ static void PVRDecompress(AMTC_BLOCK_STRUCT *pCompressedData,
 	BlkYDim = PVRT_MAX(2, YDim / BLK_Y_SIZE);
     
 	/*
-     Step through the pixels of the image decompressing each one in turn
-     
-     Note that this is a hideously inefficient way to do this!
+     Step through the pixels of the band decompressing each one in turn.
+     The block neighbourhood is only unpacked again when it changes.
      */
-	for(y = 0; y < YDim; y++)
+	for(y = YStart; y < YEnd; y++)
 	{
+		// map this row to the top neighbourhood of blocks
+		BlkY = (y - BLK_Y_SIZE/2);
+		BlkY = LIMIT_COORD(BlkY, YDim, AssumeImageTiles);
+		BlkY /= BLK_Y_SIZE;
+		BlkYp1 = LIMIT_COORD(BlkY+1, BlkYDim, AssumeImageTiles);
+        
 		for(x = 0; x < XDim; x++)
 		{
 			// map this pixel to the top left neighbourhood of blocks
 			BlkX = (x - XBlockSize/2);
-			BlkY = (y - BLK_Y_SIZE/2);
-            
 			BlkX = LIMIT_COORD(BlkX, XDim, AssumeImageTiles);
-			BlkY = LIMIT_COORD(BlkY, YDim, AssumeImageTiles);
-            
-            
 			BlkX /= XBlockSize;
-			BlkY /= BLK_Y_SIZE;
             
 			// compute the positions of the other 3 blocks
 			BlkXp1 = LIMIT_COORD(BlkX+1, BlkXDim, AssumeImageTiles);
-			BlkYp1 = LIMIT_COORD(BlkY+1, BlkYDim, AssumeImageTiles);
             
 			// Map to block memory locations
 			pBlocks[0][0] = pCompressedData +TwiddleUV(BlkYDim, BlkXDim, BlkY, BlkX);
@@ -671,19 +748,12 @@ static void PVRDecompress(AMTC_BLOCK_STRUCT *pCompressedData,
 			}
             
 			// decompress the pixel.  First compute the interpolated A and B signals
-			InterpolateColours(Colours5554[0][0].Reps[0],
-							   Colours5554[0][1].Reps[0],
-							   Colours5554[1][0].Reps[0],
-							   Colours5554[1][1].Reps[0],
-							   Do2bitMode, x, y,
-							   ASig);
-            
-			InterpolateColours(Colours5554[0][0].Reps[1],
-							   Colours5554[0][1].Reps[1],
-							   Colours5554[1][0].Reps[1],
-							   Colours5554[1][1].Reps[1],
+			InterpolateColours(Colours5554[0][0].Reps,
+							   Colours5554[0][1].Reps,
+							   Colours5554[1][0].Reps,
+							   Colours5554[1][1].Reps,
 							   Do2bitMode, x, y,
-							   BSig);
+							   ASig, BSig);
             
 			GetModulationValue(x,y, Do2bitMode, (const int (*)[16])ModulationVals, (const int (*)[16])ModulationModes,
 							   &Mod, &DoPT);
@@ -708,6 +778,38 @@ static void PVRDecompress(AMTC_BLOCK_STRUCT *pCompressedData,
 	}
 }
 
+/*!***********************************************************************
+ @Function		Decompress
+ @Input			pCompressedData The PVRTC texture data to decompress
+ @Input			Do2BitMode Signifies whether the data is PVRTC2 or PVRTC4
+ @Input			XDim X dimension of the texture
+ @Input			YDim Y dimension of the texture
+ @Input			AssumeImageTiles Assume the texture data tiles
+ @Modified		pResultImage The decompressed texture data
+ @Description	Decompresses PVRTC to RGBA 8888. Bands of ROWS_PER_TASK
+ rows are spread over the shared thread pool.
+ *************************************************************************/
+static void PVRDecompress(AMTC_BLOCK_STRUCT *pCompressedData,
+                       const bool Do2bitMode,
+                       const int XDim,
+                       const int YDim,
+                       const int AssumeImageTiles,
+                       unsigned char* pResultImage)
+{
+	if(YDim <= ROWS_PER_TASK)
+	{
+		PVRDecompressRows(pCompressedData, Do2bitMode, XDim, YDim, AssumeImageTiles, 0, YDim, pResultImage);
+		return;
+	}
+    
+	const int Bands = (YDim + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+	flakor::ThreadPool::getInstance()->parallelFor(0, Bands, [=](int Band) {
+		int YStart = Band * ROWS_PER_TASK;
+		int YEnd = PVRT_MIN(YDim, YStart + ROWS_PER_TASK);
+		PVRDecompressRows(pCompressedData, Do2bitMode, XDim, YDim, AssumeImageTiles, YStart, YEnd, pResultImage);
+	});
+}
+
 /*****************************************************************************
  End of file (pvr.cpp)
  *****************************************************************************/
@@ -23,116 +23,215 @@
  ****************************************************************************/
 
 #include "core/opengl/texture/s3tc.h"
+#include "base/lang/ThreadPool.h"
 
-//Decode S3TC encode block to 4x4 RGB32 pixels
-static void s3tc_decode_block(uint8_t **blockData,
-                       uint32_t *decodeBlockData,
-                       unsigned int stride,
-                       bool oneBitAlphaFlag,
-                       uint64_t alpha,
-                       S3TCDecodeFlag decodeFlag)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define S3TC_USE_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define S3TC_USE_NEON 1
+#include <arm_neon.h>
+#endif
+
+//Images with more block rows than this are decoded in parallel, in bands
+//of this many block rows each
+static const int S3TC_ROWS_PER_TILE = 16;
+
+//Expand r5g6b5 to 0xAABBGGRR with the given alpha (RGBA in memory)
+static inline uint32_t s3tc_expand565(unsigned int color, uint32_t alpha)
+{
+    unsigned int r = (color >> 11) & 0x1f;
+    unsigned int g = (color >> 5) & 0x3f;
+    unsigned int b = color & 0x1f;
+    r = (r << 3) | (r >> 2);
+    g = (g << 2) | (g >> 4);
+    b = (b << 3) | (b >> 2);
+    return alpha | (b << 16) | (g << 8) | r;
+}
+
+//Per channel (2 * a + b) / 3, or (a + b) / 2 when third is false
+static inline uint32_t s3tc_blend(uint32_t a, uint32_t b, bool third, uint32_t alpha)
 {
-    unsigned int colorValue0 = 0 , colorValue1 = 0, initAlpha = (!oneBitAlphaFlag * 255u) << 24;
-    unsigned int rb0 = 0, rb1 = 0, rb2 = 0, rb3 = 0, g0 = 0, g1 = 0, g2 = 0, g3 = 0;
-    
-    uint32_t colors[4], pixelsIndex = 0;
-    
-    /* load the two color values*/
-    memcpy((void *)&colorValue0, *blockData, 2);
-    (*blockData) += 2;
-    
-    memcpy((void *)&colorValue1, *blockData, 2);
-    (*blockData) += 2;
-    
-    /* the channel is r5g6b5 , 16 bits */
-    rb0  = (colorValue0 << 19 | colorValue0 >> 8) & 0xf800f8;
-    rb1  = (colorValue1 << 19 | colorValue1 >> 8) & 0xf800f8;
-    g0   = (colorValue0 << 5) & 0x00fc00;
-    g1   = (colorValue1 << 5) & 0x00fc00;
-    g0  += (g0 >> 6) & 0x000300;
-    g1  += (g1 >> 6) & 0x000300;
-    
-    colors[0] = rb0 + g0 + initAlpha;
-    colors[1] = rb1 + g1 + initAlpha;
-    
-    /* interpolate the other two color values */
-    if (colorValue0 > colorValue1 || oneBitAlphaFlag)
+    uint32_t result = alpha;
+    for (int shift = 0; shift < 24; shift += 8)
     {
-        rb2 = (((2*rb0 + rb1) * 21) >> 6) & 0xff00ff;
-        rb3 = (((2*rb1 + rb0) * 21) >> 6) & 0xff00ff;
-        g2  = (((2*g0 + g1 ) * 21) >> 6) & 0x00ff00;
-        g3  = (((2*g1 + g0 ) * 21) >> 6) & 0x00ff00;
-        colors[3] = rb3 + g3 + initAlpha;
+        unsigned int ca = (a >> shift) & 0xff;
+        unsigned int cb = (b >> shift) & 0xff;
+        unsigned int c = third ? (2 * ca + cb) / 3 : (ca + cb) >> 1;
+        result |= c << shift;
+    }
+    return result;
+}
+
+//Build the 4 entry color palette of a block. DXT3/5 color blocks are
+//always in 4 color mode and carry no alpha of their own.
+static inline void s3tc_decode_palette(const uint8_t *blockData, bool dxt1, uint32_t *colors)
+{
+    unsigned int colorValue0 = blockData[0] | (blockData[1] << 8);
+    unsigned int colorValue1 = blockData[2] | (blockData[3] << 8);
+    uint32_t alpha = dxt1 ? 0xff000000u : 0;
+
+    colors[0] = s3tc_expand565(colorValue0, alpha);
+    colors[1] = s3tc_expand565(colorValue1, alpha);
+
+    if (colorValue0 > colorValue1 || !dxt1)
+    {
+        colors[2] = s3tc_blend(colors[0], colors[1], true, alpha);
+        colors[3] = s3tc_blend(colors[1], colors[0], true, alpha);
     }
     else
     {
-        rb2 = ((rb0+rb1) >> 1) & 0xff00ff;
-        g2  = ((g0 +g1 ) >> 1) & 0x00ff00;
-        colors[3] = 0 ;
+        //3 color mode, index 3 is transparent black
+        colors[2] = s3tc_blend(colors[0], colors[1], false, alpha);
+        colors[3] = 0;
     }
-    colors[2] = rb2 + g2 + initAlpha;
-    
-    /*read the pixelsIndex , 2bits per pixel, 4 bytes */
-    memcpy((void*)&pixelsIndex, *blockData, 4);
-    (*blockData) += 4;
-    
-    if (S3TCDecodeFlag::DXT5 == decodeFlag)
+}
+
+//Fill alphas[16] (already shifted to the top byte) from a DXT3/DXT5 alpha block
+static inline void s3tc_decode_alpha(const uint8_t *alphaData, S3TCDecodeFlag decodeFlag, uint32_t *alphas)
+{
+    if (S3TCDecodeFlag::DXT3 == decodeFlag)
     {
-        //dxt5 use interpolate alpha
-        // 8-Alpha block: derive the other six alphas.
-        // Bit code 000 = alpha0, 001 = alpha1, other are interpolated.
-        
-        unsigned int alphaArray[8];
-        
-        alphaArray[0] = (alpha ) & 0xff ;
-        alphaArray[1] = (alpha >> 8) & 0xff ;
-        
-        if (alphaArray[0] >= alphaArray[1])
-        {
-            alphaArray[2] = (alphaArray[0]*6 + alphaArray[1]*1) / 7;
-            alphaArray[3] = (alphaArray[0]*5 + alphaArray[1]*2) / 7;
-            alphaArray[4] = (alphaArray[0]*4 + alphaArray[1]*3) / 7;
-            alphaArray[5] = (alphaArray[0]*3 + alphaArray[1]*4) / 7;
-            alphaArray[6] = (alphaArray[0]*2 + alphaArray[1]*5) / 7;
-            alphaArray[7] = (alphaArray[0]*1 + alphaArray[1]*6) / 7;
-        }
-        else if (alphaArray[0] < alphaArray[1])
+        //4 bit explicit alpha, low nibble first
+        for (int i = 0; i < 8; ++i)
         {
-            alphaArray[2] = (alphaArray[0]*4 + alphaArray[1]*1) / 5;
-            alphaArray[3] = (alphaArray[0]*3 + alphaArray[1]*2) / 5;
-            alphaArray[4] = (alphaArray[0]*2 + alphaArray[1]*3) / 5;
-            alphaArray[5] = (alphaArray[0]*1 + alphaArray[1]*4) / 5;
-            alphaArray[6] = 0;
-            alphaArray[7] = 255;
+            unsigned int lo = alphaData[i] & 0x0f;
+            unsigned int hi = alphaData[i] >> 4;
+            alphas[2 * i] = (lo * 17) << 24;
+            alphas[2 * i + 1] = (hi * 17) << 24;
         }
-        
-        // read the flowing 48bit indices (16*3)
-        alpha >>= 16;
-        
-        for (int y = 0; y < 4; ++y)
+        return;
+    }
+
+    // 8-Alpha block: derive the other six alphas.
+    // Bit code 000 = alpha0, 001 = alpha1, other are interpolated.
+    unsigned int alphaArray[8];
+    alphaArray[0] = alphaData[0];
+    alphaArray[1] = alphaData[1];
+    if (alphaArray[0] > alphaArray[1])
+    {
+        for (int i = 1; i < 7; ++i)
+            alphaArray[i + 1] = (alphaArray[0] * (7 - i) + alphaArray[1] * i) / 7;
+    }
+    else
+    {
+        for (int i = 1; i < 5; ++i)
+            alphaArray[i + 1] = (alphaArray[0] * (5 - i) + alphaArray[1] * i) / 5;
+        alphaArray[6] = 0;
+        alphaArray[7] = 255;
+    }
+
+    // the following 48 bits are 16 3 bit indices
+    uint64_t bits = 0;
+    for (int i = 7; i >= 2; --i)
+        bits = (bits << 8) | alphaData[i];
+    for (int i = 0; i < 16; ++i, bits >>= 3)
+        alphas[i] = alphaArray[bits & 7] << 24;
+}
+
+//Decode one S3TC block to 4x4 RGBA pixels, stride in pixels
+static void s3tc_decode_block(const uint8_t *blockData,
+                       uint32_t *decodeBlockData,
+                       unsigned int stride,
+                       S3TCDecodeFlag decodeFlag)
+{
+    uint32_t colors[4];
+    uint32_t alphas[16];
+    bool dxt1 = S3TCDecodeFlag::DXT1 == decodeFlag;
+
+    if (!dxt1)
+    {
+        s3tc_decode_alpha(blockData, decodeFlag, alphas);
+        blockData += 8;
+    }
+    s3tc_decode_palette(blockData, dxt1, colors);
+
+    /*read the pixelsIndex , 2bits per pixel, 4 bytes */
+    uint32_t pixelsIndex = blockData[4] | (blockData[5] << 8) | (blockData[6] << 16) | ((uint32_t)blockData[7] << 24);
+
+#if defined(S3TC_USE_SSE2)
+    //select the palette entry per lane with compares instead of a lookup
+    const __m128i c0 = _mm_set1_epi32((int)colors[0]);
+    const __m128i c1 = _mm_set1_epi32((int)colors[1]);
+    const __m128i c2 = _mm_set1_epi32((int)colors[2]);
+    const __m128i c3 = _mm_set1_epi32((int)colors[3]);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i two = _mm_set1_epi32(2);
+    const __m128i three = _mm_set1_epi32(3);
+    for (int y = 0; y < 4; ++y, pixelsIndex >>= 8, decodeBlockData += stride)
+    {
+        __m128i index = _mm_setr_epi32(pixelsIndex & 3, (pixelsIndex >> 2) & 3,
+                                       (pixelsIndex >> 4) & 3, (pixelsIndex >> 6) & 3);
+        __m128i pixels = _mm_and_si128(_mm_cmpeq_epi32(index, zero), c0);
+        pixels = _mm_or_si128(pixels, _mm_and_si128(_mm_cmpeq_epi32(index, one), c1));
+        pixels = _mm_or_si128(pixels, _mm_and_si128(_mm_cmpeq_epi32(index, two), c2));
+        pixels = _mm_or_si128(pixels, _mm_and_si128(_mm_cmpeq_epi32(index, three), c3));
+        if (!dxt1)
+            pixels = _mm_or_si128(pixels, _mm_loadu_si128((const __m128i *)(alphas + y * 4)));
+        _mm_storeu_si128((__m128i *)decodeBlockData, pixels);
+    }
+#elif defined(S3TC_USE_NEON)
+    const uint32x4_t c0 = vdupq_n_u32(colors[0]);
+    const uint32x4_t c1 = vdupq_n_u32(colors[1]);
+    const uint32x4_t c2 = vdupq_n_u32(colors[2]);
+    const uint32x4_t c3 = vdupq_n_u32(colors[3]);
+    const int32x4_t shifts = { 0, -2, -4, -6 };
+    for (int y = 0; y < 4; ++y, pixelsIndex >>= 8, decodeBlockData += stride)
+    {
+        uint32x4_t index = vandq_u32(vshlq_u32(vdupq_n_u32(pixelsIndex & 0xff), shifts), vdupq_n_u32(3));
+        uint32x4_t low = vbslq_u32(vceqq_u32(index, vdupq_n_u32(1)), c1, c0);
+        uint32x4_t high = vbslq_u32(vceqq_u32(index, vdupq_n_u32(3)), c3, c2);
+        uint32x4_t pixels = vbslq_u32(vcgeq_u32(index, vdupq_n_u32(2)), high, low);
+        if (!dxt1)
+            pixels = vorrq_u32(pixels, vld1q_u32(alphas + y * 4));
+        vst1q_u32(decodeBlockData, pixels);
+    }
+#else
+    for (int y = 0; y < 4; ++y, decodeBlockData += stride)
+    {
+        for (int x = 0; x < 4; ++x, pixelsIndex >>= 2)
         {
-            for (int x = 0; x < 4; ++x)
-            {
-                decodeBlockData[x] = (alphaArray[alpha & 5] << 24) + colors[pixelsIndex & 3];
-                pixelsIndex >>= 2;
-                alpha >>= 3;
-            }
-            decodeBlockData += stride;
+            uint32_t pixel = colors[pixelsIndex & 3];
+            decodeBlockData[x] = dxt1 ? pixel : (pixel | alphas[y * 4 + x]);
         }
-    } //if (dxt5 == comFlag)
-    else
-    { //dxt1 dxt3 use explicit alpha
-        for (int y = 0; y < 4; ++y)
+    }
+#endif
+}
+
+//Decode the block rows [blockYBegin, blockYEnd)
+static void s3tc_decode_rows(const uint8_t *encodeData,
+                             uint32_t *decodeData,
+                             const int pixelsWidth,
+                             const int pixelsHeight,
+                             int blockYBegin,
+                             int blockYEnd,
+                             S3TCDecodeFlag decodeFlag)
+{
+    const int blockSize = (S3TCDecodeFlag::DXT1 == decodeFlag) ? 8 : 16;
+    const int blocksPerRow = (pixelsWidth + 3) / 4;
+    uint32_t edgeBlock[16];
+
+    for (int block_y = blockYBegin; block_y < blockYEnd; ++block_y)
+    {
+        const uint8_t *blockData = encodeData + block_y * blocksPerRow * blockSize;
+        const int y = block_y * 4;
+        const int rows = MIN(4, pixelsHeight - y);
+        for (int block_x = 0; block_x < blocksPerRow; ++block_x, blockData += blockSize)
         {
-            for (int x = 0; x < 4; ++x)
+            const int x = block_x * 4;
+            uint32_t *out = decodeData + y * pixelsWidth + x;
+            if (rows == 4 && x + 4 <= pixelsWidth)
             {
-                initAlpha   = (static_cast<int>(alpha) & 0x0f) << 28;
-                initAlpha   += initAlpha >> 4;
-                decodeBlockData[x] = initAlpha + colors[pixelsIndex & 3];
-                pixelsIndex >>= 2;
-                alpha       >>= 4;
+                s3tc_decode_block(blockData, out, pixelsWidth, decodeFlag);
+                continue;
             }
-            decodeBlockData += stride;
+
+            //partial block at the right or bottom edge (small mipmaps)
+            s3tc_decode_block(blockData, edgeBlock, 4, decodeFlag);
+            const int columns = MIN(4, pixelsWidth - x);
+            for (int row = 0; row < rows; ++row)
+                memcpy(out + row * pixelsWidth, edgeBlock + row * 4, columns * sizeof(uint32_t));
         }
     }
 }
@@ -145,38 +244,18 @@ void s3tc_decode(uint8_t *encodeData,             //in_data
                  S3TCDecodeFlag decodeFlag)
 {
     uint32_t *decodeBlockData = (uint32_t *)decodeData;
-    for (int block_y = 0; block_y < pixelsHeight / 4; ++block_y, decodeBlockData += 3 * pixelsWidth)   //stride = 3*width
+    const int blockRows = (pixelsHeight + 3) / 4;
+    if (blockRows <= S3TC_ROWS_PER_TILE)
     {
-        for(int block_x = 0; block_x < pixelsWidth / 4; ++block_x, decodeBlockData += 4)            //skip 4 pixels
-        {
-            uint64_t blockAlpha = 0;
-            
-            switch (decodeFlag)
-            {
-                case S3TCDecodeFlag::DXT1:
-                {
-                    s3tc_decode_block(&encodeData, decodeBlockData, pixelsWidth, 0, 0LL, S3TCDecodeFlag::DXT1);
-                }
-                    break;
-                case S3TCDecodeFlag::DXT3:
-                {
-                    memcpy((void *)&blockAlpha, encodeData, 8);
-                    encodeData += 8;
-                    s3tc_decode_block(&encodeData, decodeBlockData, pixelsWidth, 1, blockAlpha, S3TCDecodeFlag::DXT3);
-                }
-                    break;
-                case S3TCDecodeFlag::DXT5:
-                {
-                    memcpy((void *)&blockAlpha, encodeData, 8);
-                    encodeData += 8;
-                    s3tc_decode_block(&encodeData, decodeBlockData, pixelsWidth, 1, blockAlpha, S3TCDecodeFlag::DXT5);
-                }
-                    break;
-                default:
-                    break;
-            }//switch
-        }//for block_x
-    }//for block_y
-}
+        s3tc_decode_rows(encodeData, decodeBlockData, pixelsWidth, pixelsHeight, 0, blockRows, decodeFlag);
+        return;
+    }
 
+    const int tiles = (blockRows + S3TC_ROWS_PER_TILE - 1) / S3TC_ROWS_PER_TILE;
+    flakor::ThreadPool::getInstance()->parallelFor(0, tiles, [=](int tile) {
+        int begin = tile * S3TC_ROWS_PER_TILE;
+        int end = MIN(blockRows, begin + S3TC_ROWS_PER_TILE);
+        s3tc_decode_rows(encodeData, decodeBlockData, pixelsWidth, pixelsHeight, begin, end, decodeFlag);
+    });
+}
 
@@ -35,7 +35,9 @@ enum class S3TCDecodeFlag
     DXT5 = 5,
 };
 
-//Decode S3TC encode data to RGB32
+//Decode S3TC encode data to RGB32 (RGBA8888 in memory), pixelsWidth * 4 bytes
+//per row. Sizes need not be multiples of 4. Large images are decoded in bands
+//of block rows on the shared thread pool.
  void s3tc_decode(uint8_t *encode_data,
                  uint8_t *decode_data,
                  const int pixelsWidth,
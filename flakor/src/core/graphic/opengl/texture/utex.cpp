@@ -0,0 +1,918 @@
+/**********************************************************
+ * Copyright (c) 2013-2015 Steve Hsu  All Rights Reserved.
+ *********************************************************/
+
+#include "core/opengl/texture/utex.h"
+#include "base/lang/ThreadPool.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <zlib.h>
+
+/* File layout, all numbers little endian.
+
+ 0  "UTEX"
+ 4  uint16 version (1), uint16 flags (UTEX_FLAG_ALPHA)
+ 8  uint32 width, uint32 height of level 0
+ 16 uint32 level count, uint32 reserved (0)
+ 24 level table, per level: uint32 offset from the start of the file,
+    uint32 deflated size
+
+ Inflated, a level of N blocks (row major, 4 x 4 pixels each) is
+
+ color endpoints  4 * N bytes, bytes 0..3 of each ETC1 block
+ color selectors  4 * N bytes, bytes 4..7 of each ETC1 block
+ alpha endpoints  4 * N bytes, only with UTEX_FLAG_ALPHA
+ alpha selectors  4 * N bytes, only with UTEX_FLAG_ALPHA
+
+ Keeping endpoints and selectors apart gives deflate longer matches than
+ interleaved blocks do.
+
+ Endpoint bytes are R5 << 3, G5 << 3, B5 << 3, table << 5 | table << 2 | 2:
+ differential mode, zero delta, same table for both halves, no flip. The
+ alpha slice stores alpha in all three channels and is read from G.
+
+ Transcoding to DXT / ATC uses per channel tables, built once, that give
+ the best pair of endpoints for every (5 bit base, table) combination with
+ the four ETC1S colors mapped to the four interpolated colors in order
+ (-b -> low endpoint, -a -> 1/3, +a -> 2/3, +b -> high endpoint). Alpha
+ works the same way for DXT5 / ATC alpha and EAC blocks.
+ */
+
+namespace {
+
+const uint8_t kMagic[] = { 'U', 'T', 'E', 'X' };
+const int kVersion = 1;
+
+// Modifier by 2 bit selector: +a, +b, -a, -b.
+const int kModifierTable[8][4] = {
+    { 2, 8, -2, -8 },
+    { 5, 17, -5, -17 },
+    { 9, 29, -9, -29 },
+    { 13, 42, -13, -42 },
+    { 18, 60, -18, -60 },
+    { 24, 80, -24, -80 },
+    { 33, 106, -33, -106 },
+    { 47, 183, -47, -183 } };
+
+const int kAlphaModifierTable[16][8] = {
+    { -3, -6, -9, -15, 2, 5, 8, 14 },
+    { -3, -7, -10, -13, 2, 6, 9, 12 },
+    { -2, -5, -8, -13, 1, 4, 7, 12 },
+    { -2, -4, -6, -13, 1, 3, 5, 12 },
+    { -3, -6, -8, -12, 2, 5, 7, 11 },
+    { -3, -7, -9, -11, 2, 6, 8, 10 },
+    { -4, -7, -8, -11, 3, 6, 7, 10 },
+    { -3, -5, -8, -11, 2, 4, 7, 10 },
+    { -2, -6, -8, -10, 1, 5, 7, 9 },
+    { -2, -5, -8, -10, 1, 4, 7, 9 },
+    { -2, -4, -8, -10, 1, 3, 7, 9 },
+    { -2, -5, -7, -10, 1, 4, 6, 9 },
+    { -3, -4, -7, -10, 2, 3, 6, 9 },
+    { -1, -2, -3, -10, 0, 1, 2, 9 },
+    { -4, -6, -8, -9, 3, 5, 7, 8 },
+    { -3, -5, -7, -9, 2, 4, 6, 8 } };
+
+// Rank of each selector (+a, +b, -a, -b) on the line from the low (0) to
+// the high (3) endpoint.
+const int kSelectorRank[4] = { 2, 3, 1, 0 };
+
+// DXT palette order is high, low, 2/3 high, 1/3 high. ATC is high,
+// 2/3 high, 1/3 high, low.
+const int kRankToDxt[4] = { 1, 3, 2, 0 };
+const int kRankToAtc[4] = { 3, 2, 1, 0 };
+
+// Block rows transcoded per thread pool task.
+const int kRowsPerBand = 16;
+
+inline int clamp255(int x)
+{
+    return x >= 0 ? (x < 255 ? x : 255) : 0;
+}
+
+inline int expandBits(int c, int bits)
+{
+    return (c << (8 - bits)) | (c >> (2 * bits - 8));
+}
+
+inline int square(int x)
+{
+    return x * x;
+}
+
+inline uint32_t readLE32(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+inline void writeLE16(uint8_t* p, uint32_t v)
+{
+    p[0] = (uint8_t) v;
+    p[1] = (uint8_t) (v >> 8);
+}
+
+inline void writeLE32(uint8_t* p, uint32_t v)
+{
+    p[0] = (uint8_t) v;
+    p[1] = (uint8_t) (v >> 8);
+    p[2] = (uint8_t) (v >> 16);
+    p[3] = (uint8_t) (v >> 24);
+}
+
+// Table key of one channel of an endpoint: 5 bit base * 8 + table.
+inline int endpointKey(const uint8_t* ep, int channel)
+{
+    return ((ep[channel] >> 3) << 3) | (ep[3] >> 5);
+}
+
+// The four values a channel takes, by selector.
+inline void channelValues(int key, int* values)
+{
+    const int base = expandBits(key >> 3, 5);
+    for (int s = 0; s < 4; s++)
+    {
+        values[s] = clamp255(base + kModifierTable[key & 7][s]);
+    }
+}
+
+// Selector of pixel j = 4 * x + y; sel points at bytes 4..7 of the block.
+inline int selectorAt(const uint8_t* sel, int j)
+{
+    const uint32_t msb = (sel[0] << 8) | sel[1];
+    const uint32_t lsb = (sel[2] << 8) | sel[3];
+    return (((msb >> j) & 1) << 1) | ((lsb >> j) & 1);
+}
+
+struct Endpoints
+{
+    uint8_t high;
+    uint8_t low;
+};
+
+// Best quantized high / low endpoints for the values of each key.
+void fitEndpoints(int highBits, int lowBits, Endpoints* out)
+{
+    for (int key = 0; key < 256; key++)
+    {
+        int values[4];
+        channelValues(key, values);
+        int rankValue[4];
+        for (int s = 0; s < 4; s++)
+        {
+            rankValue[kSelectorRank[s]] = values[s];
+        }
+
+        int bestError = 0x7fffffff;
+        for (int h = 0; h < (1 << highBits); h++)
+        {
+            const int high = expandBits(h, highBits);
+            for (int l = 0; l < (1 << lowBits); l++)
+            {
+                const int low = expandBits(l, lowBits);
+                if (low > high)
+                {
+                    break;
+                }
+                const int error = square(rankValue[0] - low)
+                        + square(rankValue[1] - (high + 2 * low) / 3)
+                        + square(rankValue[2] - (2 * high + low) / 3)
+                        + square(rankValue[3] - high);
+                if (error < bestError)
+                {
+                    bestError = error;
+                    out[key].high = (uint8_t) h;
+                    out[key].low = (uint8_t) l;
+                }
+            }
+        }
+    }
+}
+
+// Per selector 2 bit DXT / ATC index of a column of 4 pixels, indexed by
+// msb nibble | lsb nibble << 4 and laid out as column 0 of the 32 bit
+// index word.
+void buildColumnTable(const int* rankToIndex, uint32_t* out)
+{
+    for (int key = 0; key < 256; key++)
+    {
+        uint32_t bits = 0;
+        for (int y = 0; y < 4; y++)
+        {
+            const int s = (((key >> y) & 1) << 1) | ((key >> (y + 4)) & 1);
+            bits |= rankToIndex[kSelectorRank[s]] << (8 * y);
+        }
+        out[key] = bits;
+    }
+}
+
+struct ColorTables
+{
+    Endpoints rb[256];      // 5 bit red / blue, DXT and ATC
+    Endpoints dxtGreen[256]; // 6 bit high and low
+    Endpoints atcGreen[256]; // 5 bit high (555 color), 6 bit low
+    uint32_t dxtColumns[256];
+    uint32_t atcColumns[256];
+
+    ColorTables()
+    {
+        fitEndpoints(5, 5, rb);
+        fitEndpoints(6, 6, dxtGreen);
+        fitEndpoints(5, 6, atcGreen);
+        buildColumnTable(kRankToDxt, dxtColumns);
+        buildColumnTable(kRankToAtc, atcColumns);
+    }
+};
+
+const ColorTables& colorTables()
+{
+    static const ColorTables tables;
+    return tables;
+}
+
+struct AlphaEntry
+{
+    // DXT5 / ATC interpolated alpha, alpha0 >= alpha1
+    uint8_t alpha0;
+    uint8_t alpha1;
+    uint8_t index[4];
+    // EAC
+    uint8_t eacBase;
+    uint8_t eacMultiplierTable;
+    uint8_t eacIndex[4];
+};
+
+void fitAlpha(int key, AlphaEntry& entry)
+{
+    int values[4];
+    channelValues(key, values);
+    int minAlpha = 255, maxAlpha = 0;
+    for (int s = 0; s < 4; s++)
+    {
+        minAlpha = values[s] < minAlpha ? values[s] : minAlpha;
+        maxAlpha = values[s] > maxAlpha ? values[s] : maxAlpha;
+    }
+
+    memset(&entry, 0, sizeof(entry));
+    entry.alpha0 = (uint8_t) maxAlpha;
+    entry.alpha1 = (uint8_t) minAlpha;
+    entry.eacBase = (uint8_t) minAlpha;
+    if (minAlpha == maxAlpha)
+    {
+        // flat, index 0 everywhere and a zero EAC multiplier
+        return;
+    }
+
+    // 8 alpha mode, the extremes are exact
+    int levels[8];
+    levels[0] = maxAlpha;
+    levels[1] = minAlpha;
+    for (int i = 1; i < 7; i++)
+    {
+        levels[i + 1] = (maxAlpha * (7 - i) + minAlpha * i) / 7;
+    }
+    for (int s = 0; s < 4; s++)
+    {
+        int bestError = 0x7fffffff;
+        for (int i = 0; i < 8; i++)
+        {
+            const int error = square(levels[i] - values[s]);
+            if (error < bestError)
+            {
+                bestError = error;
+                entry.index[s] = (uint8_t) i;
+            }
+        }
+    }
+
+    int bestError = 0x7fffffff;
+    for (int t = 0; t < 16; t++)
+    {
+        const int* table = kAlphaModifierTable[t];
+        const int spread = table[7] - table[3];
+        int multiplier = (maxAlpha - minAlpha + spread / 2) / spread;
+        multiplier = multiplier < 1 ? 1 : (multiplier > 15 ? 15 : multiplier);
+        for (int m = multiplier - 1; m <= multiplier + 1; m++)
+        {
+            if (m < 1 || m > 15)
+            {
+                continue;
+            }
+            const int center = (minAlpha + maxAlpha - (table[7] + table[3]) * m + 1) / 2;
+            for (int b = center - 2; b <= center + 2; b++)
+            {
+                if (b < 0 || b > 255)
+                {
+                    continue;
+                }
+                int error = 0;
+                uint8_t index[4];
+                for (int s = 0; s < 4; s++)
+                {
+                    int valueError = 0x7fffffff;
+                    for (int i = 0; i < 8; i++)
+                    {
+                        const int e = square(clamp255(b + table[i] * m) - values[s]);
+                        if (e < valueError)
+                        {
+                            valueError = e;
+                            index[s] = (uint8_t) i;
+                        }
+                    }
+                    error += valueError;
+                }
+                if (error < bestError)
+                {
+                    bestError = error;
+                    entry.eacBase = (uint8_t) b;
+                    entry.eacMultiplierTable = (uint8_t) ((m << 4) | t);
+                    memcpy(entry.eacIndex, index, 4);
+                }
+            }
+        }
+    }
+}
+
+struct AlphaTables
+{
+    AlphaEntry entries[256];
+
+    AlphaTables()
+    {
+        for (int key = 0; key < 256; key++)
+        {
+            fitAlpha(key, entries[key]);
+        }
+    }
+};
+
+const AlphaTables& alphaTables()
+{
+    static const AlphaTables tables;
+    return tables;
+}
+
+// Transcoders for one block. ep / sel point at the 4 endpoint and 4
+// selector bytes of the block in their planes.
+
+void writeDxtColor(const uint8_t* ep, const uint8_t* sel, uint8_t* out)
+{
+    const ColorTables& tables = colorTables();
+    const Endpoints& r = tables.rb[endpointKey(ep, 0)];
+    const Endpoints& g = tables.dxtGreen[endpointKey(ep, 1)];
+    const Endpoints& b = tables.rb[endpointKey(ep, 2)];
+    const uint32_t color0 = (r.high << 11) | (g.high << 5) | b.high;
+    const uint32_t color1 = (r.low << 11) | (g.low << 5) | b.low;
+
+    // equal endpoints would select 3 color mode, index 0 is the color then
+    uint32_t bits = 0;
+    if (color0 != color1)
+    {
+        const uint32_t msb = (sel[0] << 8) | sel[1];
+        const uint32_t lsb = (sel[2] << 8) | sel[3];
+        for (int x = 0; x < 4; x++)
+        {
+            const int key = ((msb >> (4 * x)) & 0xf) | (((lsb >> (4 * x)) & 0xf) << 4);
+            bits |= tables.dxtColumns[key] << (2 * x);
+        }
+    }
+    writeLE16(out, color0);
+    writeLE16(out + 2, color1);
+    writeLE32(out + 4, bits);
+}
+
+void writeAtcColor(const uint8_t* ep, const uint8_t* sel, uint8_t* out)
+{
+    const ColorTables& tables = colorTables();
+    const Endpoints& r = tables.rb[endpointKey(ep, 0)];
+    const Endpoints& g = tables.atcGreen[endpointKey(ep, 1)];
+    const Endpoints& b = tables.rb[endpointKey(ep, 2)];
+
+    uint32_t bits = 0;
+    const uint32_t msb = (sel[0] << 8) | sel[1];
+    const uint32_t lsb = (sel[2] << 8) | sel[3];
+    for (int x = 0; x < 4; x++)
+    {
+        const int key = ((msb >> (4 * x)) & 0xf) | (((lsb >> (4 * x)) & 0xf) << 4);
+        bits |= tables.atcColumns[key] << (2 * x);
+    }
+    // color0 is 555 with the mode bit (15) clear
+    writeLE16(out, (r.high << 10) | (g.high << 5) | b.high);
+    writeLE16(out + 2, (r.low << 11) | (g.low << 5) | b.low);
+    writeLE32(out + 4, bits);
+}
+
+// DXT5 and ATC interpolated alpha share the block layout.
+void writeInterpolatedAlpha(const uint8_t* ep, const uint8_t* sel, uint8_t* out)
+{
+    const AlphaEntry& entry = alphaTables().entries[endpointKey(ep, 1)];
+    uint64_t bits = 0;
+    for (int j = 0; j < 16; j++)
+    {
+        const int p = 4 * (j & 3) + (j >> 2);
+        bits |= (uint64_t) entry.index[selectorAt(sel, j)] << (3 * p);
+    }
+    out[0] = entry.alpha0;
+    out[1] = entry.alpha1;
+    for (int i = 0; i < 6; i++)
+    {
+        out[2 + i] = (uint8_t) (bits >> (8 * i));
+    }
+}
+
+void writeEacAlpha(const uint8_t* ep, const uint8_t* sel, uint8_t* out)
+{
+    const AlphaEntry& entry = alphaTables().entries[endpointKey(ep, 1)];
+    uint64_t bits = 0;
+    for (int j = 0; j < 16; j++)
+    {
+        bits |= (uint64_t) entry.eacIndex[selectorAt(sel, j)] << (45 - 3 * j);
+    }
+    out[0] = entry.eacBase;
+    out[1] = entry.eacMultiplierTable;
+    for (int i = 0; i < 6; i++)
+    {
+        out[2 + i] = (uint8_t) (bits >> (40 - 8 * i));
+    }
+}
+
+// Decode one block to pixels, clipped to xEnd x yEnd.
+void writePixels(const uint8_t* ep, const uint8_t* sel,
+        const uint8_t* alphaEp, const uint8_t* alphaSel,
+        utex_target target, uint8_t* out, uint32_t stride,
+        uint32_t xEnd, uint32_t yEnd)
+{
+    int r[4], g[4], b[4], a[4] = { 255, 255, 255, 255 };
+    channelValues(endpointKey(ep, 0), r);
+    channelValues(endpointKey(ep, 1), g);
+    channelValues(endpointKey(ep, 2), b);
+    if (alphaEp)
+    {
+        channelValues(endpointKey(alphaEp, 1), a);
+    }
+
+    for (uint32_t y = 0; y < yEnd; y++)
+    {
+        uint8_t* q = out + stride * y;
+        for (uint32_t x = 0; x < xEnd; x++)
+        {
+            const int j = 4 * x + y;
+            const int s = selectorAt(sel, j);
+            if (target == UTEX_TARGET_RGB565)
+            {
+                const uint32_t pixel = ((r[s] >> 3) << 11) | ((g[s] >> 2) << 5) | (b[s] >> 3);
+                *q++ = (uint8_t) pixel;
+                *q++ = (uint8_t) (pixel >> 8);
+            }
+            else
+            {
+                *q++ = (uint8_t) r[s];
+                *q++ = (uint8_t) g[s];
+                *q++ = (uint8_t) b[s];
+                *q++ = (uint8_t) (alphaSel ? a[selectorAt(alphaSel, j)] : 255);
+            }
+        }
+    }
+}
+
+void transcodeRows(const uint8_t* pSlice, int hasAlpha,
+        uint32_t width, uint32_t height, utex_target target,
+        uint8_t* pOut, uint32_t stride, uint32_t rowBegin, uint32_t rowEnd)
+{
+    const uint32_t blocksPerRow = (width + 3) >> 2;
+    const uint32_t blocks = blocksPerRow * ((height + 3) >> 2);
+    const uint8_t* colorEp = pSlice;
+    const uint8_t* colorSel = pSlice + 4 * blocks;
+    const uint8_t* alphaEp = hasAlpha ? pSlice + 8 * blocks : NULL;
+    const uint8_t* alphaSel = hasAlpha ? pSlice + 12 * blocks : NULL;
+    const uint32_t blockSize = utex_get_transcoded_size(target, 4, 4);
+
+    for (uint32_t row = rowBegin; row < rowEnd; row++)
+    {
+        for (uint32_t col = 0; col < blocksPerRow; col++)
+        {
+            const uint32_t i = row * blocksPerRow + col;
+            const uint8_t* ep = colorEp + 4 * i;
+            const uint8_t* sel = colorSel + 4 * i;
+            uint8_t* out = pOut + blockSize * i;
+            switch (target)
+            {
+            case UTEX_TARGET_ETC1:
+                memcpy(out, ep, 4);
+                memcpy(out + 4, sel, 4);
+                break;
+            case UTEX_TARGET_ETC2_RGBA8:
+                if (alphaEp)
+                {
+                    writeEacAlpha(alphaEp + 4 * i, alphaSel + 4 * i, out);
+                }
+                else
+                {
+                    // opaque, flat 255
+                    memset(out, 0, 8);
+                    out[0] = 255;
+                }
+                memcpy(out + 8, ep, 4);
+                memcpy(out + 12, sel, 4);
+                break;
+            case UTEX_TARGET_DXT1:
+                writeDxtColor(ep, sel, out);
+                break;
+            case UTEX_TARGET_DXT5:
+            case UTEX_TARGET_ATC_RGBA_INTERPOLATED:
+                if (alphaEp)
+                {
+                    writeInterpolatedAlpha(alphaEp + 4 * i, alphaSel + 4 * i, out);
+                }
+                else
+                {
+                    memset(out, 0, 8);
+                    out[0] = out[1] = 255;
+                }
+                if (target == UTEX_TARGET_DXT5)
+                {
+                    writeDxtColor(ep, sel, out + 8);
+                }
+                else
+                {
+                    writeAtcColor(ep, sel, out + 8);
+                }
+                break;
+            case UTEX_TARGET_ATC_RGB:
+                writeAtcColor(ep, sel, out);
+                break;
+            default:
+            {
+                const uint32_t pixelSize = target == UTEX_TARGET_RGB565 ? 2 : 4;
+                const uint32_t x = 4 * col;
+                const uint32_t y = 4 * row;
+                writePixels(ep, sel,
+                        alphaEp ? alphaEp + 4 * i : NULL, alphaSel ? alphaSel + 4 * i : NULL,
+                        target, pOut + pixelSize * x + stride * y, stride,
+                        width - x < 4 ? width - x : 4, height - y < 4 ? height - y : 4);
+                break;
+            }
+            }
+        }
+    }
+}
+
+// ETC1S encoder, search over the table and a few bases around the mean.
+// channels are compared starting at pIn[first], count of them.
+
+void encodeBlock(const uint8_t* pIn, uint32_t validMask, int first, int count, uint8_t* pOut)
+{
+    int sum[3] = { 0, 0, 0 };
+    int n = 0;
+    for (int p = 0; p < 16; p++)
+    {
+        if (validMask & (1 << p))
+        {
+            for (int c = 0; c < count; c++)
+            {
+                sum[c] += pIn[4 * p + first + c];
+            }
+            n++;
+        }
+    }
+    int center[3];
+    for (int c = 0; c < count; c++)
+    {
+        center[c] = n ? ((sum[c] / n) * 31 + 127) / 255 : 0;
+    }
+
+    // alpha is cheap to search wider, clamping at 0 / 255 moves its best base
+    const int range = count == 1 ? 4 : 1;
+    int bestError = 0x7fffffff;
+    int bestBase[3] = { 0, 0, 0 };
+    int bestTable = 0;
+    for (int d = -range; d <= range; d++)
+    {
+        int base[3];
+        int expanded[3];
+        for (int c = 0; c < count; c++)
+        {
+            base[c] = center[c] + d;
+            base[c] = base[c] < 0 ? 0 : (base[c] > 31 ? 31 : base[c]);
+            expanded[c] = expandBits(base[c], 5);
+        }
+        for (int t = 0; t < 8; t++)
+        {
+            int error = 0;
+            for (int p = 0; p < 16 && error < bestError; p++)
+            {
+                if (!(validMask & (1 << p)))
+                {
+                    continue;
+                }
+                int pixelError = 0x7fffffff;
+                for (int s = 0; s < 4; s++)
+                {
+                    int e = 0;
+                    for (int c = 0; c < count; c++)
+                    {
+                        e += square(clamp255(expanded[c] + kModifierTable[t][s]) - pIn[4 * p + first + c]);
+                    }
+                    pixelError = e < pixelError ? e : pixelError;
+                }
+                error += pixelError;
+            }
+            if (error < bestError)
+            {
+                bestError = error;
+                bestTable = t;
+                memcpy(bestBase, base, sizeof(base));
+            }
+        }
+    }
+
+    int expanded[3];
+    for (int c = 0; c < 3; c++)
+    {
+        const int b = c < count ? bestBase[c] : bestBase[0];
+        expanded[c] = expandBits(b, 5);
+        pOut[c] = (uint8_t) (b << 3);
+    }
+    pOut[3] = (uint8_t) ((bestTable << 5) | (bestTable << 2) | 2);
+
+    uint32_t msb = 0, lsb = 0;
+    for (int p = 0; p < 16; p++)
+    {
+        if (!(validMask & (1 << p)))
+        {
+            continue;
+        }
+        int bestSelector = 0;
+        int pixelError = 0x7fffffff;
+        for (int s = 0; s < 4; s++)
+        {
+            int e = 0;
+            for (int c = 0; c < count; c++)
+            {
+                e += square(clamp255(expanded[c] + kModifierTable[bestTable][s]) - pIn[4 * p + first + c]);
+            }
+            if (e < pixelError)
+            {
+                pixelError = e;
+                bestSelector = s;
+            }
+        }
+        const int j = 4 * (p & 3) + (p >> 2);
+        msb |= (bestSelector >> 1) << j;
+        lsb |= (bestSelector & 1) << j;
+    }
+    pOut[4] = (uint8_t) (msb >> 8);
+    pOut[5] = (uint8_t) msb;
+    pOut[6] = (uint8_t) (lsb >> 8);
+    pOut[7] = (uint8_t) lsb;
+}
+
+void encodeSlice(const uint8_t* pIn, uint32_t width, uint32_t height,
+        uint32_t stride, int hasAlpha, uint8_t* pOut)
+{
+    const uint32_t blocksPerRow = (width + 3) >> 2;
+    const uint32_t blockRows = (height + 3) >> 2;
+    const uint32_t blocks = blocksPerRow * blockRows;
+
+    flakor::ThreadPool::getInstance()->parallelFor(0, (int) blockRows, [=](int row) {
+        uint8_t block[64];
+        uint8_t encoded[8];
+        const uint32_t y = 4 * row;
+        const uint32_t yEnd = height - y < 4 ? height - y : 4;
+        for (uint32_t col = 0; col < blocksPerRow; col++) {
+            const uint32_t x = 4 * col;
+            const uint32_t xEnd = width - x < 4 ? width - x : 4;
+            uint32_t mask = 0;
+            memset(block, 0, sizeof(block));
+            for (uint32_t cy = 0; cy < yEnd; cy++) {
+                memcpy(block + 16 * cy, pIn + 4 * x + stride * (y + cy), 4 * xEnd);
+                mask |= ((1u << xEnd) - 1) << (4 * cy);
+            }
+            const uint32_t i = row * blocksPerRow + col;
+            encodeBlock(block, mask, 0, 3, encoded);
+            memcpy(pOut + 4 * i, encoded, 4);
+            memcpy(pOut + 4 * (blocks + i), encoded + 4, 4);
+            if (hasAlpha) {
+                encodeBlock(block, mask, 3, 1, encoded);
+                memcpy(pOut + 4 * (2 * blocks + i), encoded, 4);
+                memcpy(pOut + 4 * (3 * blocks + i), encoded + 4, 4);
+            }
+        }
+    });
+}
+
+// 2 x 2 box filter, odd edges repeat the last row / column.
+void downsample(const uint8_t* pIn, uint32_t width, uint32_t height, uint32_t stride,
+        uint8_t* pOut, uint32_t outWidth, uint32_t outHeight)
+{
+    for (uint32_t y = 0; y < outHeight; y++)
+    {
+        const uint8_t* row0 = pIn + stride * (2 * y < height ? 2 * y : height - 1);
+        const uint8_t* row1 = pIn + stride * (2 * y + 1 < height ? 2 * y + 1 : height - 1);
+        for (uint32_t x = 0; x < outWidth; x++)
+        {
+            const uint32_t x0 = 4 * (2 * x < width ? 2 * x : width - 1);
+            const uint32_t x1 = 4 * (2 * x + 1 < width ? 2 * x + 1 : width - 1);
+            for (int c = 0; c < 4; c++)
+            {
+                pOut[4 * (x + outWidth * y) + c] =
+                        (uint8_t) ((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+            }
+        }
+    }
+}
+
+} // namespace
+
+int utex_header_is_valid(const uint8_t* pData, uint32_t dataLen)
+{
+    if (dataLen < UTEX_HEADER_SIZE || memcmp(pData, kMagic, sizeof(kMagic)) != 0)
+    {
+        return 0;
+    }
+    const uint32_t levels = utex_header_get_levels(pData);
+    if ((pData[4] | (pData[5] << 8)) != kVersion
+            || utex_header_get_width(pData) == 0 || utex_header_get_height(pData) == 0
+            || levels == 0 || levels > UTEX_MAX_LEVELS
+            || dataLen < UTEX_HEADER_SIZE + levels * UTEX_LEVEL_ENTRY_SIZE)
+    {
+        return 0;
+    }
+    for (uint32_t i = 0; i < levels; i++)
+    {
+        const uint8_t* entry = pData + UTEX_HEADER_SIZE + i * UTEX_LEVEL_ENTRY_SIZE;
+        const uint32_t offset = readLE32(entry);
+        const uint32_t size = readLE32(entry + 4);
+        if (offset > dataLen || size > dataLen - offset)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+uint32_t utex_header_get_width(const uint8_t* pHeader)
+{
+    return readLE32(pHeader + 8);
+}
+
+uint32_t utex_header_get_height(const uint8_t* pHeader)
+{
+    return readLE32(pHeader + 12);
+}
+
+uint32_t utex_header_get_levels(const uint8_t* pHeader)
+{
+    return readLE32(pHeader + 16);
+}
+
+uint32_t utex_header_get_flags(const uint8_t* pHeader)
+{
+    return pHeader[6] | (pHeader[7] << 8);
+}
+
+uint32_t utex_get_slice_size(uint32_t width, uint32_t height, int hasAlpha)
+{
+    return ((width + 3) >> 2) * ((height + 3) >> 2) * (hasAlpha ? 16 : 8);
+}
+
+uint32_t utex_get_transcoded_size(utex_target target, uint32_t width, uint32_t height)
+{
+    const uint32_t blocks = ((width + 3) >> 2) * ((height + 3) >> 2);
+    switch (target)
+    {
+    case UTEX_TARGET_ETC1:
+    case UTEX_TARGET_DXT1:
+    case UTEX_TARGET_ATC_RGB:
+        return blocks * 8;
+    case UTEX_TARGET_ETC2_RGBA8:
+    case UTEX_TARGET_DXT5:
+    case UTEX_TARGET_ATC_RGBA_INTERPOLATED:
+        return blocks * 16;
+    case UTEX_TARGET_RGB565:
+        return width * height * 2;
+    default:
+        return width * height * 4;
+    }
+}
+
+int utex_inflate_level(const uint8_t* pData, uint32_t dataLen, uint32_t level, uint8_t* pOut)
+{
+    if (!utex_header_is_valid(pData, dataLen) || level >= utex_header_get_levels(pData))
+    {
+        return -1;
+    }
+    uint32_t width = utex_header_get_width(pData) >> level;
+    uint32_t height = utex_header_get_height(pData) >> level;
+    width = width ? width : 1;
+    height = height ? height : 1;
+    const uLongf expected = utex_get_slice_size(width, height,
+            utex_header_get_flags(pData) & UTEX_FLAG_ALPHA);
+
+    const uint8_t* entry = pData + UTEX_HEADER_SIZE + level * UTEX_LEVEL_ENTRY_SIZE;
+    uLongf outLen = expected;
+    if (uncompress(pOut, &outLen, pData + readLE32(entry), readLE32(entry + 4)) != Z_OK
+            || outLen != expected)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+int utex_transcode_level(const uint8_t* pSlice, int hasAlpha,
+        uint32_t width, uint32_t height, utex_target target,
+        uint8_t* pOut, uint32_t stride)
+{
+    if (target == UTEX_TARGET_ETC1 && hasAlpha)
+    {
+        return -1;
+    }
+    const int blockRows = (int) ((height + 3) >> 2);
+    if (blockRows <= kRowsPerBand)
+    {
+        transcodeRows(pSlice, hasAlpha, width, height, target, pOut, stride, 0, blockRows);
+        return 0;
+    }
+
+    // build the lookup tables up front rather than inside the first task
+    colorTables();
+    if (hasAlpha)
+    {
+        alphaTables();
+    }
+    const int bands = (blockRows + kRowsPerBand - 1) / kRowsPerBand;
+    flakor::ThreadPool::getInstance()->parallelFor(0, bands, [=](int band) {
+        const int begin = band * kRowsPerBand;
+        const int end = begin + kRowsPerBand < blockRows ? begin + kRowsPerBand : blockRows;
+        transcodeRows(pSlice, hasAlpha, width, height, target, pOut, stride, begin, end);
+    });
+    return 0;
+}
+
+uint32_t utex_encode_image(const uint8_t* pIn, uint32_t width, uint32_t height,
+        uint32_t stride, int hasAlpha, int generateMipmaps, uint8_t** ppOut)
+{
+    if (!pIn || !ppOut || width == 0 || height == 0)
+    {
+        return 0;
+    }
+
+    uint32_t levels = 1;
+    if (generateMipmaps)
+    {
+        while (levels < UTEX_MAX_LEVELS && ((width >> levels) || (height >> levels)))
+        {
+            levels++;
+        }
+    }
+
+    std::vector<uint8_t> file(UTEX_HEADER_SIZE + levels * UTEX_LEVEL_ENTRY_SIZE);
+    memcpy(&file[0], kMagic, sizeof(kMagic));
+    writeLE16(&file[4], kVersion);
+    writeLE16(&file[6], hasAlpha ? UTEX_FLAG_ALPHA : 0);
+    writeLE32(&file[8], width);
+    writeLE32(&file[12], height);
+    writeLE32(&file[16], levels);
+
+    std::vector<uint8_t> current;
+    std::vector<uint8_t> next;
+    const uint8_t* pixels = pIn;
+    uint32_t w = width, h = height;
+    for (uint32_t level = 0; level < levels; level++)
+    {
+        std::vector<uint8_t> slice(utex_get_slice_size(w, h, hasAlpha));
+        encodeSlice(pixels, w, h, stride, hasAlpha, &slice[0]);
+
+        uLongf packedLen = compressBound(slice.size());
+        const size_t offset = file.size();
+        file.resize(offset + packedLen);
+        if (compress2(&file[offset], &packedLen, &slice[0], slice.size(), Z_BEST_COMPRESSION) != Z_OK)
+        {
+            return 0;
+        }
+        file.resize(offset + packedLen);
+        writeLE32(&file[UTEX_HEADER_SIZE + level * UTEX_LEVEL_ENTRY_SIZE], (uint32_t) offset);
+        writeLE32(&file[UTEX_HEADER_SIZE + level * UTEX_LEVEL_ENTRY_SIZE + 4], (uint32_t) packedLen);
+
+        if (level + 1 < levels)
+        {
+            const uint32_t nw = w > 1 ? w >> 1 : 1;
+            const uint32_t nh = h > 1 ? h >> 1 : 1;
+            next.resize(nw * nh * 4);
+            downsample(pixels, w, h, stride, &next[0], nw, nh);
+            current.swap(next);
+            pixels = &current[0];
+            stride = nw * 4;
+            w = nw;
+            h = nh;
+        }
+    }
+
+    *ppOut = static_cast<uint8_t*>(malloc(file.size()));
+    if (!*ppOut)
+    {
+        return 0;
+    }
+    memcpy(*ppOut, &file[0], file.size());
+    return (uint32_t) file.size();
+}
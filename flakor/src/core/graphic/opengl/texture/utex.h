@@ -0,0 +1,109 @@
+/**********************************************************
+ * Copyright (c) 2013-2015 Steve Hsu  All Rights Reserved.
+ *********************************************************/
+
+// Universal texture (.utex): one compressed intermediate that is transcoded
+// at load time into whichever block format the GPU supports, so a game
+// ships a single copy of each texture instead of one per vendor format.
+//
+// The intermediate is ETC1S: ETC1 differential blocks restricted to one
+// base color (zero delta), one intensity table for both sub-blocks and no
+// flip. Such a block is a valid ETC1 / ETC2 block as is, and its four
+// colors lie on a line parallel to the gray axis, which maps well onto the
+// endpoint + interpolation scheme of DXT and ATC. Textures with alpha carry
+// a second ETC1S slice holding alpha as gray. Each mip level is stored as
+// planes (endpoints, then selectors) and deflated with zlib.
+
+#ifndef __utex_h__
+#define __utex_h__
+
+#include <stdint.h>
+
+// Size of the fixed part of the file header, followed by the level table.
+#define UTEX_HEADER_SIZE 24
+
+// Each level table entry is the offset and the deflated size of a level.
+#define UTEX_LEVEL_ENTRY_SIZE 8
+
+// Same as Image::MIPMAP_MAX.
+#define UTEX_MAX_LEVELS 16
+
+// Header flag: the file has an alpha slice.
+#define UTEX_FLAG_ALPHA 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// UTEX_TARGET_ETC1 - ETC1 (and ETC2 RGB8) blocks, 8 bytes, opaque only.
+// UTEX_TARGET_ETC2_RGBA8 - EAC alpha + ETC2 RGB8 blocks, 16 bytes.
+// UTEX_TARGET_DXT1 - 8 bytes, always in 4 color mode.
+// UTEX_TARGET_DXT5 - DXT5 alpha + DXT1 color blocks, 16 bytes.
+// UTEX_TARGET_ATC_RGB - 8 bytes.
+// UTEX_TARGET_ATC_RGBA_INTERPOLATED - ATC interpolated alpha, 16 bytes.
+// UTEX_TARGET_RGB565 - uncompressed GL_UNSIGNED_SHORT_5_6_5.
+// UTEX_TARGET_RGBA8888 - uncompressed R, G, B, A bytes.
+
+typedef enum {
+    UTEX_TARGET_ETC1,
+    UTEX_TARGET_ETC2_RGBA8,
+    UTEX_TARGET_DXT1,
+    UTEX_TARGET_DXT5,
+    UTEX_TARGET_ATC_RGB,
+    UTEX_TARGET_ATC_RGBA_INTERPOLATED,
+    UTEX_TARGET_RGB565,
+    UTEX_TARGET_RGBA8888
+} utex_target;
+
+// Check if data starts with a valid .utex header whose level table fits in
+// dataLen bytes.
+
+int utex_header_is_valid(const uint8_t* pData, uint32_t dataLen);
+
+// Read the image size, the number of levels and the flags from a valid header.
+
+uint32_t utex_header_get_width(const uint8_t* pHeader);
+uint32_t utex_header_get_height(const uint8_t* pHeader);
+uint32_t utex_header_get_levels(const uint8_t* pHeader);
+uint32_t utex_header_get_flags(const uint8_t* pHeader);
+
+// Size in bytes of the inflated ETC1S data of one level.
+
+uint32_t utex_get_slice_size(uint32_t width, uint32_t height, int hasAlpha);
+
+// Size in bytes of one level once transcoded to target.
+
+uint32_t utex_get_transcoded_size(utex_target target, uint32_t width, uint32_t height);
+
+// Inflate a level of the file into pOut, which must hold
+// utex_get_slice_size bytes for the level.
+// returns non-zero if there is an error.
+
+int utex_inflate_level(const uint8_t* pData, uint32_t dataLen, uint32_t level, uint8_t* pOut);
+
+// Transcode one inflated level.
+// pOut receives utex_get_transcoded_size bytes for block targets. For
+// UTEX_TARGET_RGB565 and UTEX_TARGET_RGBA8888, pixel (x,y) is written at
+// pOut + pixelSize * x + stride * y.
+// Rows of blocks are transcoded in parallel on the shared thread pool.
+// returns non-zero if there is an error.
+
+int utex_transcode_level(const uint8_t* pSlice, int hasAlpha,
+        uint32_t width, uint32_t height, utex_target target,
+        uint8_t* pOut, uint32_t stride);
+
+// Encode an image into a complete .utex file.
+// pIn - R, G, B, A pixels, pixel (x,y) at pIn + 4 * x + stride * y.
+// hasAlpha - store an alpha slice, otherwise alpha is ignored.
+// generateMipmaps - also store the box filtered mip chain down to 1 x 1.
+// *ppOut receives a malloc'ed buffer the caller frees.
+// returns the size of the file, 0 if there is an error.
+
+uint32_t utex_encode_image(const uint8_t* pIn, uint32_t width, uint32_t height,
+        uint32_t stride, int hasAlpha, int generateMipmaps, uint8_t** ppOut);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
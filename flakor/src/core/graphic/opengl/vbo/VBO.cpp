@@ -1,8 +1,11 @@
 #include "targetMacros.h"
 #include "core/opengl/vbo/VBO.h"
 #include "core/opengl/GLProgram.h"
+#include "core/opengl/GLUploader.h"
 
+#include <memory>
 #include <stdlib.h>
+#include <vector>
 
 FLAKOR_NS_BEGIN
 
@@ -18,6 +21,7 @@ usage(GL_STATIC_DRAW),
 autoDispose(true),
 dirty(true),
 dispose(false),
+uploading(false),
 count(0),
 VBOAttributes(NULL)
 {
@@ -168,6 +172,11 @@ void VBO::updateData(int index,int size,float data[])
 void VBO::onBufferData()
 {
 	int size = sizePerVertex*vertexNumber*sizeof(float);
+	if(uploading)
+	{
+		//the uploader owns the buffer until it is done
+		return;
+	}
 	if(!isLoaded())
 	{
 		glGenBuffers(1,&bufferID);
@@ -184,6 +193,53 @@ void VBO::onBufferData()
 	}
 }
 
+bool VBO::uploadAsync()
+{
+	if(isLoaded() || uploading)
+	{
+		return false;
+	}
+
+	//a copy, updateData may write bufferData while the uploader reads
+	int size = sizePerVertex*vertexNumber*sizeof(float);
+	std::shared_ptr<std::vector<float> > data = std::make_shared<std::vector<float> >(bufferData, bufferData + sizePerVertex*vertexNumber);
+	std::shared_ptr<GLuint> buffer = std::make_shared<GLuint>(0);
+	GLenum bufferUsage = usage;
+	uploading = true;
+	dirty = false;
+	retain();
+	bool posted = GLUploader::getInstance()->post([data, buffer, size, bufferUsage]() {
+		glGenBuffers(1, buffer.get());
+		glBindBuffer(GL_ARRAY_BUFFER, *buffer);
+		glBufferData(GL_ARRAY_BUFFER, size, &(*data)[0], bufferUsage);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}, [this, buffer](bool uploaded) {
+		uploading = false;
+		if(uploaded)
+		{
+			bufferID = *buffer;
+		}
+		else
+		{
+			//lost with the context, onBufferData loads it again
+			dirty = true;
+		}
+		release();
+	});
+	if(!posted)
+	{
+		uploading = false;
+		dirty = true;
+		release();
+	}
+	return posted;
+}
+
+bool VBO::isUploading() const
+{
+	return uploading;
+}
+
 void VBO::enableAndPointer()
 {
 	int i;
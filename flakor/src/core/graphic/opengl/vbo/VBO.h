@@ -145,6 +145,15 @@ class VBO : Object
 
 		void bind();
 		virtual void onBufferData();
+		/**
+		 * 在GLUploader线程上创建并载入显卡
+		 * Creates the buffer on the GLUploader thread. Until that is done
+		 * onBufferData does nothing and the VBO can't be drawn.
+		 * @return false if the uploader isn't running or the VBO is loaded
+		 */
+		bool uploadAsync();
+		/** 正在GLUploader线程上载入 */
+		bool isUploading() const;
 		void enableAndPointer();
 
 	protected:
@@ -158,6 +167,8 @@ class VBO : Object
 		bool dirty;
         //
         bool dispose;
+        //GLUploader线程正在创建buffer
+        bool uploading;
 
         //实际的bufferdata。存到gpu就清空
 		float *bufferData;
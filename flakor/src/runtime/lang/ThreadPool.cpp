@@ -0,0 +1,152 @@
+/**********************************************************
+ * Copyright (c) 2013-2015 Steve Hsu  All Rights Reserved.
+ *********************************************************/
+
+#include "base/lang/ThreadPool.h"
+
+#include <atomic>
+#include <memory>
+
+FLAKOR_NS_BEGIN
+
+ThreadPool* ThreadPool::s_sharedThreadPool = nullptr;
+
+ThreadPool* ThreadPool::getInstance()
+{
+	static std::mutex instanceMutex;
+	std::lock_guard<std::mutex> lock(instanceMutex);
+	if (s_sharedThreadPool == nullptr)
+	{
+		s_sharedThreadPool = new ThreadPool();
+	}
+	return s_sharedThreadPool;
+}
+
+void ThreadPool::destroyInstance()
+{
+	delete s_sharedThreadPool;
+	s_sharedThreadPool = nullptr;
+}
+
+ThreadPool::ThreadPool(int threadCount)
+: _stop(false)
+{
+	if (threadCount <= 0)
+	{
+		threadCount = (int)std::thread::hardware_concurrency() - 1;
+		if (threadCount < 1)
+			threadCount = 1;
+	}
+
+	for (int i = 0; i < threadCount; ++i)
+	{
+		_workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stop = true;
+	}
+	_condition.notify_all();
+	for (size_t i = 0; i < _workers.size(); ++i)
+	{
+		_workers[i].join();
+	}
+}
+
+int ThreadPool::getThreadCount() const
+{
+	return (int)_workers.size();
+}
+
+void ThreadPool::enqueue(const Task& task)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_tasks.push_back(task);
+	}
+	_condition.notify_one();
+}
+
+void ThreadPool::workerLoop()
+{
+	for (;;)
+	{
+		Task task;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_condition.wait(lock, [this] { return _stop || !_tasks.empty(); });
+			if (_tasks.empty())
+				return;
+			task = std::move(_tasks.front());
+			_tasks.pop_front();
+		}
+		task();
+	}
+}
+
+namespace {
+
+// Shared between the caller of parallelFor and the helper tasks. Helpers
+// can start after the loop is already done, so this outlives the call.
+struct ParallelForState
+{
+	std::function<void(int)> fn;
+	std::atomic<int> next;
+	std::atomic<int> remaining;
+	int end;
+	std::mutex mutex;
+	std::condition_variable done;
+
+	void run()
+	{
+		int finished = 0;
+		for (int i = next++; i < end; i = next++)
+		{
+			fn(i);
+			++finished;
+		}
+		if (finished > 0 && (remaining -= finished) == 0)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			done.notify_all();
+		}
+	}
+};
+
+}
+
+void ThreadPool::parallelFor(int begin, int end, const std::function<void(int)>& fn)
+{
+	int count = end - begin;
+	if (count <= 0)
+		return;
+	if (count == 1 || _workers.empty())
+	{
+		for (int i = begin; i < end; ++i)
+			fn(i);
+		return;
+	}
+
+	std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>();
+	state->fn = fn;
+	state->next = begin;
+	state->remaining = count;
+	state->end = end;
+
+	int helpers = count - 1 < (int)_workers.size() ? count - 1 : (int)_workers.size();
+	for (int i = 0; i < helpers; ++i)
+	{
+		enqueue([state] { state->run(); });
+	}
+
+	state->run();
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->done.wait(lock, [&state] { return state->remaining == 0; });
+}
+
+FLAKOR_NS_END
@@ -0,0 +1,77 @@
+/**********************************************************
+ * Copyright (c) 2013-2015 Steve Hsu  All Rights Reserved.
+ *********************************************************/
+
+#ifndef RUNTIME_LANG_THREADPOOL_H
+#define RUNTIME_LANG_THREADPOOL_H
+
+#include "targetMacros.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+FLAKOR_NS_BEGIN
+
+/**
+ * Fixed set of worker threads fed from one FIFO queue.
+ *
+ * Used for CPU heavy work that can be split up, such as texture
+ * encoding and decoding. Tasks must not touch GL, the workers have no
+ * context.
+ */
+class ThreadPool
+{
+public:
+	typedef std::function<void()> Task;
+
+	/** returns the shared pool, created on first use */
+	static ThreadPool* getInstance();
+
+	/** joins and deletes the shared pool */
+	static void destroyInstance();
+
+	/**
+	 * @param threadCount number of workers, 0 means one less than the
+	 *        number of cores (at least one)
+	 */
+	explicit ThreadPool(int threadCount = 0);
+
+	/** finishes the queued tasks and joins the workers */
+	~ThreadPool();
+
+	int getThreadCount() const;
+
+	/** runs task on a worker at some later point */
+	void enqueue(const Task& task);
+
+	/**
+	 * Calls fn(i) for every i in [begin, end) and returns when all calls
+	 * have finished. The calling thread takes part in the work, so this is
+	 * safe to call from inside a task and never slower than a plain loop
+	 * when the workers are busy.
+	 */
+	void parallelFor(int begin, int end, const std::function<void(int)>& fn);
+
+protected:
+	void workerLoop();
+
+	std::vector<std::thread> _workers;
+	std::deque<Task> _tasks;
+	std::mutex _mutex;
+	std::condition_variable _condition;
+	bool _stop;
+
+private:
+	ThreadPool(const ThreadPool&);
+	ThreadPool& operator=(const ThreadPool&);
+
+	static ThreadPool* s_sharedThreadPool;
+};
+
+FLAKOR_NS_END
+
+#endif
@@ -0,0 +1,327 @@
+/**********************************************************
+ * Copyright (c) 2013-2015 Steve Hsu  All Rights Reserved.
+ *********************************************************/
+
+#include "tool/utility/PngWriter.h"
+#include "base/lang/ThreadPool.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+FLAKOR_NS_BEGIN
+
+namespace
+{
+	static const unsigned char PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+	// filtered bytes per row group, enough to keep deflate efficient and
+	// few enough groups that the checksum and stitching cost nothing
+	static const size_t GROUP_BYTES = 256 * 1024;
+
+	enum
+	{
+		FILTER_NONE,
+		FILTER_SUB,
+		FILTER_UP,
+		FILTER_AVERAGE,
+		FILTER_PAETH,
+		FILTER_COUNT
+	};
+
+	struct Group
+	{
+		int firstRow;
+		int rows;
+		std::vector<unsigned char> deflated;
+		uLong adler;
+		size_t filteredBytes;
+		bool ok;
+	};
+
+	static inline void putUInt32(unsigned char* out, uint32_t v)
+	{
+		out[0] = (unsigned char)(v >> 24);
+		out[1] = (unsigned char)(v >> 16);
+		out[2] = (unsigned char)(v >> 8);
+		out[3] = (unsigned char)v;
+	}
+
+	// source row y as outComponents bytes a pixel
+	static void readRow(const unsigned char* pixels, int width, int y, int components, int outComponents,
+			unsigned char* out)
+	{
+		const unsigned char* in = pixels + (size_t)y * width * components;
+		if (components == outComponents)
+		{
+			memcpy(out, in, (size_t)width * components);
+			return;
+		}
+		for (int x = 0; x < width; ++x, in += components, out += outComponents)
+		{
+			out[0] = in[0];
+			out[1] = in[1];
+			out[2] = in[2];
+			if (outComponents == 4)
+				out[3] = 255;
+		}
+	}
+
+	static inline unsigned char paeth(int a, int b, int c)
+	{
+		int p = a + b - c;
+		int pa = abs(p - a);
+		int pb = abs(p - b);
+		int pc = abs(p - c);
+		if (pa <= pb && pa <= pc)
+			return (unsigned char)a;
+		return (unsigned char)(pb <= pc ? b : c);
+	}
+
+	// writes filter type then the filtered row, bpp bytes a pixel
+	static void filterRow(int type, const unsigned char* row, const unsigned char* prev, size_t length, int bpp,
+			unsigned char* out)
+	{
+		out[0] = (unsigned char)type;
+		++out;
+		size_t i = 0;
+		switch (type)
+		{
+			case FILTER_NONE:
+				memcpy(out, row, length);
+				break;
+			case FILTER_SUB:
+				for (; i < (size_t)bpp; ++i)
+					out[i] = row[i];
+				for (; i < length; ++i)
+					out[i] = (unsigned char)(row[i] - row[i - bpp]);
+				break;
+			case FILTER_UP:
+				for (; i < length; ++i)
+					out[i] = (unsigned char)(row[i] - prev[i]);
+				break;
+			case FILTER_AVERAGE:
+				for (; i < (size_t)bpp; ++i)
+					out[i] = (unsigned char)(row[i] - (prev[i] >> 1));
+				for (; i < length; ++i)
+					out[i] = (unsigned char)(row[i] - ((row[i - bpp] + prev[i]) >> 1));
+				break;
+			case FILTER_PAETH:
+				for (; i < (size_t)bpp; ++i)
+					out[i] = (unsigned char)(row[i] - prev[i]);
+				for (; i < length; ++i)
+					out[i] = (unsigned char)(row[i] - paeth(row[i - bpp], prev[i], prev[i - bpp]));
+				break;
+		}
+	}
+
+	// the usual heuristic: the filter whose output, read as signed bytes, is
+	// smallest. Gives up once the sum passes limit, that filter lost anyway.
+	static unsigned long filterCost(const unsigned char* filtered, size_t length, unsigned long limit)
+	{
+		unsigned long sum = 0;
+		for (size_t i = 0; i < length; ++i)
+		{
+			sum += filtered[i] < 128 ? filtered[i] : 256 - filtered[i];
+			if ((i & 255) == 255 && sum >= limit)
+				return sum;
+		}
+		return sum;
+	}
+
+	static void encodeGroup(const unsigned char* pixels, int width, int components, int outComponents,
+			bool fast, bool last, Group* group)
+	{
+		group->ok = false;
+		size_t length = (size_t)width * outComponents;
+		size_t stride = length + 1;
+		group->filteredBytes = stride * group->rows;
+
+		std::vector<unsigned char> filtered(group->filteredBytes);
+		std::vector<unsigned char> lines(length * 2, 0);
+		unsigned char* prev = &lines[0];
+		unsigned char* row = &lines[length];
+		std::vector<unsigned char> trial(fast ? 0 : stride);
+
+		// the row above the group is filtered against too
+		if (group->firstRow > 0)
+			readRow(pixels, width, group->firstRow - 1, components, outComponents, prev);
+
+		for (int y = 0; y < group->rows; ++y)
+		{
+			readRow(pixels, width, group->firstRow + y, components, outComponents, row);
+			unsigned char* out = &filtered[y * stride];
+			if (fast)
+			{
+				filterRow(FILTER_UP, row, prev, length, outComponents, out);
+			}
+			else
+			{
+				// keep the best filtered row in out, try the others in trial
+				filterRow(FILTER_NONE, row, prev, length, outComponents, out);
+				unsigned long best = filterCost(out + 1, length, (unsigned long)-1);
+				unsigned char* candidate = &trial[0];
+				for (int type = FILTER_SUB; type < FILTER_COUNT; ++type)
+				{
+					filterRow(type, row, prev, length, outComponents, candidate);
+					unsigned long cost = filterCost(candidate + 1, length, best);
+					if (cost < best)
+					{
+						best = cost;
+						unsigned char* swap = out;
+						out = candidate;
+						candidate = swap;
+					}
+				}
+				if (out != &filtered[y * stride])
+					memcpy(&filtered[y * stride], out, stride);
+			}
+			unsigned char* swap = prev;
+			prev = row;
+			row = swap;
+		}
+
+		group->adler = adler32(adler32(0L, Z_NULL, 0), &filtered[0], (uInt)filtered.size());
+
+		z_stream stream;
+		memset(&stream, 0, sizeof(stream));
+		// raw deflate, the zlib header and checksum are written once for the whole image
+		if (deflateInit2(&stream, fast ? 1 : 6, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+			return;
+		// a sync flush adds an empty stored block of 5 bytes
+		group->deflated.resize(deflateBound(&stream, (uLong)filtered.size()) + 16);
+		stream.next_in = &filtered[0];
+		stream.avail_in = (uInt)filtered.size();
+		stream.next_out = &group->deflated[0];
+		stream.avail_out = (uInt)group->deflated.size();
+		// groups before the last end on a byte boundary without a final block,
+		// so they can be put one after another
+		int status = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+		bool done = last ? status == Z_STREAM_END : (status == Z_OK && stream.avail_in == 0);
+		group->deflated.resize(group->deflated.size() - stream.avail_out);
+		deflateEnd(&stream);
+		group->ok = done;
+	}
+
+	static void appendChunk(std::vector<unsigned char>* out, const char* type, const unsigned char* data, size_t length,
+			const unsigned char* data2 = nullptr, size_t length2 = 0)
+	{
+		unsigned char header[8];
+		putUInt32(header, (uint32_t)(length + length2));
+		memcpy(header + 4, type, 4);
+		out->insert(out->end(), header, header + 8);
+		if (length > 0)
+			out->insert(out->end(), data, data + length);
+		if (length2 > 0)
+			out->insert(out->end(), data2, data2 + length2);
+
+		uLong crc = crc32(0L, Z_NULL, 0);
+		crc = crc32(crc, header + 4, 4);
+		if (length > 0)
+			crc = crc32(crc, data, (uInt)length);
+		if (length2 > 0)
+			crc = crc32(crc, data2, (uInt)length2);
+		unsigned char footer[4];
+		putUInt32(footer, (uint32_t)crc);
+		out->insert(out->end(), footer, footer + 4);
+	}
+}
+
+namespace PngWriter
+{
+	bool encode(const unsigned char* pixels, int width, int height, int components, int outComponents,
+			bool fast, std::vector<unsigned char>* out)
+	{
+		if (pixels == nullptr || width <= 0 || height <= 0 || out == nullptr
+				|| (components != 3 && components != 4) || (outComponents != 3 && outComponents != 4))
+		{
+			return false;
+		}
+
+		size_t stride = (size_t)width * outComponents + 1;
+		int rowsPerGroup = (int)(GROUP_BYTES / stride);
+		if (rowsPerGroup < 1)
+			rowsPerGroup = 1;
+		int groupCount = (height + rowsPerGroup - 1) / rowsPerGroup;
+
+		std::vector<Group> groups(groupCount);
+		for (int i = 0; i < groupCount; ++i)
+		{
+			groups[i].firstRow = i * rowsPerGroup;
+			groups[i].rows = height - groups[i].firstRow < rowsPerGroup ? height - groups[i].firstRow : rowsPerGroup;
+		}
+		ThreadPool::getInstance()->parallelFor(0, groupCount, [&](int i) {
+			encodeGroup(pixels, width, components, outComponents, fast, i == groupCount - 1, &groups[i]);
+		});
+
+		uLong adler = adler32(0L, Z_NULL, 0);
+		for (int i = 0; i < groupCount; ++i)
+		{
+			if (!groups[i].ok)
+				return false;
+			adler = adler32_combine(adler, groups[i].adler, (z_off_t)groups[i].filteredBytes);
+		}
+
+		out->clear();
+		out->insert(out->end(), PNG_SIGNATURE, PNG_SIGNATURE + sizeof(PNG_SIGNATURE));
+
+		unsigned char ihdr[13];
+		putUInt32(ihdr, width);
+		putUInt32(ihdr + 4, height);
+		ihdr[8] = 8;
+		ihdr[9] = outComponents == 4 ? 6 : 2;
+		ihdr[10] = 0;
+		ihdr[11] = 0;
+		ihdr[12] = 0;
+		appendChunk(out, "IHDR", ihdr, sizeof(ihdr));
+
+		// one IDAT a group, the zlib header goes in front of the first and
+		// the checksum after the last
+		unsigned char zlibHeader[2] = { 0x78, (unsigned char)(fast ? 0x01 : 0x9c) };
+		unsigned char zlibFooter[4];
+		putUInt32(zlibFooter, (uint32_t)adler);
+		for (int i = 0; i < groupCount; ++i)
+		{
+			const std::vector<unsigned char>& deflated = groups[i].deflated;
+			if (i == 0 && groupCount == 1)
+			{
+				std::vector<unsigned char> data(zlibHeader, zlibHeader + 2);
+				data.insert(data.end(), deflated.begin(), deflated.end());
+				appendChunk(out, "IDAT", &data[0], data.size(), zlibFooter, sizeof(zlibFooter));
+			}
+			else if (i == 0)
+			{
+				appendChunk(out, "IDAT", zlibHeader, sizeof(zlibHeader), &deflated[0], deflated.size());
+			}
+			else if (i == groupCount - 1)
+			{
+				appendChunk(out, "IDAT", &deflated[0], deflated.size(), zlibFooter, sizeof(zlibFooter));
+			}
+			else
+			{
+				appendChunk(out, "IDAT", &deflated[0], deflated.size());
+			}
+		}
+		appendChunk(out, "IEND", nullptr, 0);
+		return true;
+	}
+
+	bool writeFile(const std::string& path, const unsigned char* pixels, int width, int height,
+			int components, int outComponents, bool fast)
+	{
+		std::vector<unsigned char> png;
+		if (!encode(pixels, width, height, components, outComponents, fast, &png))
+			return false;
+
+		FILE* fp = fopen(path.c_str(), "wb");
+		if (fp == nullptr)
+			return false;
+		bool ok = fwrite(&png[0], 1, png.size(), fp) == png.size();
+		ok &= fclose(fp) == 0;
+		return ok;
+	}
+}
+
+FLAKOR_NS_END
@@ -0,0 +1,46 @@
+/**********************************************************
+ * Copyright (c) 2013-2015 Steve Hsu  All Rights Reserved.
+ *********************************************************/
+
+#ifndef TOOL_UTILITY_PNGWRITER_H
+#define TOOL_UTILITY_PNGWRITER_H
+
+#include "targetMacros.h"
+
+#include <string>
+#include <vector>
+
+FLAKOR_NS_BEGIN
+
+/**
+ * PNG encoder that compresses on every core.
+ *
+ * The image is cut into groups of rows. Each group is filtered and
+ * deflated on its own on the ThreadPool, ending on a byte boundary, and
+ * the pieces are stitched into one zlib stream with the checksums
+ * combined. The result is a plain PNG any decoder reads. Deflate can't
+ * match against an earlier group, the files come out 5-10% bigger than
+ * with one stream.
+ */
+namespace PngWriter
+{
+	/**
+	 * Encodes width x height pixels to out.
+	 * @param components  bytes per source pixel, 3 (RGB) or 4 (RGBA)
+	 * @param outComponents  3 or 4, 3 drops the alpha of an RGBA source
+	 * @param fast  zlib level 1 and the Up filter on every row, several
+	 *              times faster for a somewhat bigger file, for captures
+	 *              that are saved every frame. Otherwise level 6 with the
+	 *              filter picked per row.
+	 */
+	bool encode(const unsigned char* pixels, int width, int height, int components, int outComponents,
+			bool fast, std::vector<unsigned char>* out);
+
+	/** encode() to a file */
+	bool writeFile(const std::string& path, const unsigned char* pixels, int width, int height,
+			int components, int outComponents, bool fast);
+}
+
+FLAKOR_NS_END
+
+#endif
@@ -0,0 +1,232 @@
+/**********************************************************
+ * Copyright (c) 2013-2015 Steve Hsu  All Rights Reserved.
+ *********************************************************/
+
+#include "tool/utility/RectPacker.h"
+
+#include <climits>
+
+FLAKOR_NS_BEGIN
+
+RectPacker::RectPacker(int width, int height, bool allowRotation)
+: _width(0)
+, _height(0)
+, _allowRotation(allowRotation)
+, _usedArea(0)
+{
+	reset(width, height);
+}
+
+void RectPacker::reset(int width, int height)
+{
+	_width = width;
+	_height = height;
+	_usedArea = 0;
+	_free.clear();
+	if (width > 0 && height > 0)
+	{
+		Box page = { 0, 0, width, height };
+		_free.push_back(page);
+	}
+}
+
+bool RectPacker::insert(int width, int height, Slot* slot)
+{
+	if (width <= 0 || height <= 0)
+	{
+		return false;
+	}
+
+	// best short side fit: the least left over on the shorter side, then on the longer
+	int bestShort = INT_MAX;
+	int bestLong = INT_MAX;
+	Slot best = { 0, 0, 0, 0, false };
+	for (size_t i = 0; i < _free.size(); ++i)
+	{
+		const Box& free = _free[i];
+		for (int turn = 0; turn < (_allowRotation ? 2 : 1); ++turn)
+		{
+			int w = turn ? height : width;
+			int h = turn ? width : height;
+			if (w > free.width || h > free.height)
+			{
+				continue;
+			}
+			int leftX = free.width - w;
+			int leftY = free.height - h;
+			int shortSide = leftX < leftY ? leftX : leftY;
+			int longSide = leftX < leftY ? leftY : leftX;
+			if (shortSide < bestShort || (shortSide == bestShort && longSide < bestLong))
+			{
+				bestShort = shortSide;
+				bestLong = longSide;
+				best.x = free.x;
+				best.y = free.y;
+				best.width = w;
+				best.height = h;
+				best.rotated = turn != 0;
+			}
+		}
+	}
+	if (bestShort == INT_MAX)
+	{
+		return false;
+	}
+
+	Box used = { best.x, best.y, best.width, best.height };
+	place(used);
+	_usedArea += (size_t)best.width * best.height;
+	*slot = best;
+	return true;
+}
+
+void RectPacker::remove(const Slot& slot)
+{
+	_usedArea -= (size_t)slot.width * slot.height;
+	if (_usedArea == 0)
+	{
+		reset(_width, _height);
+		return;
+	}
+
+	Box box = { slot.x, slot.y, slot.width, slot.height };
+	_free.push_back(box);
+	// each merge may open another, the free list is short
+	while (mergeFree(_free.size() - 1))
+	{
+	}
+	pruneFree();
+}
+
+float RectPacker::getOccupancy() const
+{
+	if (_width <= 0 || _height <= 0)
+	{
+		return 0.0f;
+	}
+	return (float)((double)_usedArea / ((double)_width * _height));
+}
+
+void RectPacker::place(const Box& used)
+{
+	size_t count = _free.size();
+	for (size_t i = 0; i < count; )
+	{
+		Box free = _free[i];
+		if (used.x >= free.x + free.width || used.x + used.width <= free.x
+			|| used.y >= free.y + free.height || used.y + used.height <= free.y)
+		{
+			++i;
+			continue;
+		}
+
+		// what is left of free on each side of used, as large as it goes
+		if (used.x > free.x)
+		{
+			Box left = { free.x, free.y, used.x - free.x, free.height };
+			_free.push_back(left);
+		}
+		if (used.x + used.width < free.x + free.width)
+		{
+			Box right = { used.x + used.width, free.y, free.x + free.width - used.x - used.width, free.height };
+			_free.push_back(right);
+		}
+		if (used.y > free.y)
+		{
+			Box top = { free.x, free.y, free.width, used.y - free.y };
+			_free.push_back(top);
+		}
+		if (used.y + used.height < free.y + free.height)
+		{
+			Box bottom = { free.x, used.y + used.height, free.width, free.y + free.height - used.y - used.height };
+			_free.push_back(bottom);
+		}
+
+		_free[i] = _free[count - 1];
+		_free[count - 1] = _free.back();
+		_free.pop_back();
+		--count;
+	}
+	pruneFree();
+}
+
+void RectPacker::pruneFree()
+{
+	for (size_t i = 0; i < _free.size(); ++i)
+	{
+		for (size_t j = i + 1; j < _free.size(); )
+		{
+			const Box& a = _free[i];
+			const Box& b = _free[j];
+			if (b.x >= a.x && b.y >= a.y && b.x + b.width <= a.x + a.width && b.y + b.height <= a.y + a.height)
+			{
+				_free.erase(_free.begin() + j);
+				continue;
+			}
+			if (a.x >= b.x && a.y >= b.y && a.x + a.width <= b.x + b.width && a.y + a.height <= b.y + b.height)
+			{
+				_free.erase(_free.begin() + i);
+				j = i + 1;
+				if (i >= _free.size())
+				{
+					break;
+				}
+				continue;
+			}
+			++j;
+		}
+	}
+}
+
+bool RectPacker::mergeFree(size_t index)
+{
+	Box& box = _free[index];
+	for (size_t i = 0; i < _free.size(); ++i)
+	{
+		if (i == index)
+		{
+			continue;
+		}
+		const Box& other = _free[i];
+		bool merged = false;
+		if (other.x == box.x && other.width == box.width)
+		{
+			if (other.y + other.height == box.y)
+			{
+				box.y = other.y;
+				box.height += other.height;
+				merged = true;
+			}
+			else if (box.y + box.height == other.y)
+			{
+				box.height += other.height;
+				merged = true;
+			}
+		}
+		else if (other.y == box.y && other.height == box.height)
+		{
+			if (other.x + other.width == box.x)
+			{
+				box.x = other.x;
+				box.width += other.width;
+				merged = true;
+			}
+			else if (box.x + box.width == other.x)
+			{
+				box.width += other.width;
+				merged = true;
+			}
+		}
+		if (merged)
+		{
+			// the merged box stays last, where the caller looks for it
+			Box grown = box;
+			_free.erase(_free.begin() + i);
+			_free.back() = grown;
+			return true;
+		}
+	}
+	return false;
+}
+
+FLAKOR_NS_END
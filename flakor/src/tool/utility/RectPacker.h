@@ -0,0 +1,93 @@
+/**********************************************************
+ * Copyright (c) 2013-2015 Steve Hsu  All Rights Reserved.
+ *********************************************************/
+
+#ifndef TOOL_UTILITY_RECTPACKER_H
+#define TOOL_UTILITY_RECTPACKER_H
+
+#include "targetMacros.h"
+
+#include <stddef.h>
+#include <vector>
+
+FLAKOR_NS_BEGIN
+
+/**
+ * Packs rectangles into one page with MaxRects, best short side fit.
+ *
+ * The free space is kept as the largest rectangles that fit in it, which
+ * may overlap; each insert takes the free rectangle leaving the smallest
+ * gap on its shorter side, and may turn the rectangle by 90 degrees to
+ * get there. Sorting the rectangles by their longer side before
+ * inserting packs tightest.
+ *
+ * remove gives a rectangle back and merges it with free neighbours that
+ * share a whole edge, and an emptied page is whole again. Space split up
+ * by many removes is otherwise only won back by packing again from reset.
+ */
+class RectPacker
+{
+public:
+	/** where an inserted rectangle went */
+	struct Slot
+	{
+		int x;
+		int y;
+		/** size on the page, width and height swapped if rotated */
+		int width;
+		int height;
+		bool rotated;
+	};
+
+	RectPacker(int width = 0, int height = 0, bool allowRotation = true);
+
+	/** empties the page, with a new size */
+	void reset(int width, int height);
+
+	/**
+	 * finds room for width x height
+	 * @return false if the page has none, slot is untouched then
+	 */
+	bool insert(int width, int height, Slot* slot);
+
+	/** frees a slot insert returned */
+	void remove(const Slot& slot);
+
+	int getWidth() const { return _width; }
+	int getHeight() const { return _height; }
+
+	/** area of the slots in use */
+	size_t getUsedArea() const { return _usedArea; }
+
+	/** used area over the page area, 0 to 1 */
+	float getOccupancy() const;
+
+	/** free rectangles kept, a measure of how split up the free space is */
+	int getFreeRectCount() const { return (int)_free.size(); }
+
+protected:
+	struct Box
+	{
+		int x;
+		int y;
+		int width;
+		int height;
+	};
+
+	// splits the free rectangles used overlaps
+	void place(const Box& used);
+	// drops the free rectangles inside others
+	void pruneFree();
+	// grows free rectangle index with neighbours sharing a whole edge
+	bool mergeFree(size_t index);
+
+	int _width;
+	int _height;
+	bool _allowRotation;
+	size_t _usedArea;
+	std::vector<Box> _free;
+};
+
+FLAKOR_NS_END
+
+#endif
@@ -0,0 +1,1197 @@
+/**********************************************************
+ * Copyright (c) 2013-2015 Steve Hsu  All Rights Reserved.
+ *********************************************************/
+
+#include "tool/utility/TexUtils.h"
+#include "base/lang/ThreadPool.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mutex>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXUTILS_USE_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define TEXUTILS_USE_NEON 1
+#include <arm_neon.h>
+#endif
+
+FLAKOR_NS_BEGIN
+
+namespace
+{
+	// Every conversion goes through RGBA8888: the source is expanded to it
+	// (unless it already is) a chunk at a time, then packed into the
+	// target. Both steps have SSE2 / NEON kernels with scalar tails, so all
+	// pairs are vectorized without a kernel per pair.
+
+	// pixels per chunk when expanding, a multiple of 16 that stays in L1
+	static const int CHUNK_PIXELS = 256;
+
+	// 4x4 ordered dither thresholds, 0..15
+	static const unsigned char BAYER4[4][4] =
+	{
+		{ 0, 8, 2, 10 },
+		{ 12, 4, 14, 6 },
+		{ 3, 11, 1, 9 },
+		{ 15, 7, 13, 5 },
+	};
+
+	static bool s_ditherEnabled = false;
+
+	static inline unsigned char addSaturate(unsigned char c, unsigned char offset)
+	{
+		unsigned v = (unsigned) c + offset;
+		return (unsigned char) (v > 255 ? 255 : v);
+	}
+
+	static inline int luminance(int r, int g, int b)
+	{
+		return (r * 77 + g * 150 + b * 29 + 128) >> 8;
+	}
+
+	// Fills dither with the RGBA byte offsets of 4 pixels in pattern row y,
+	// scaled to the step of each channel of format. Returns false for the
+	// formats that aren't dithered. Alpha is never dithered.
+	static bool getDitherRow(PixelFormat format, int y, unsigned char dither[16])
+	{
+		int shifts[3];
+		switch (format)
+		{
+			case PixelFormat::RGB565:
+				shifts[0] = 1; shifts[1] = 2; shifts[2] = 1;
+				break;
+			case PixelFormat::RGBA4444:
+				shifts[0] = 0; shifts[1] = 0; shifts[2] = 0;
+				break;
+			case PixelFormat::RGB5A1:
+				shifts[0] = 1; shifts[1] = 1; shifts[2] = 1;
+				break;
+			default:
+				return false;
+		}
+		for (int x = 0; x < 4; ++x)
+		{
+			for (int c = 0; c < 3; ++c)
+				dither[x * 4 + c] = (unsigned char) (BAYER4[y & 3][x] >> shifts[c]);
+			dither[x * 4 + 3] = 0;
+		}
+		return true;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// expand to RGBA8888
+
+	static void expandI8(const unsigned char* in, unsigned char* out, int width)
+	{
+		int i = 0;
+#if defined(TEXUTILS_USE_SSE2)
+		const __m128i alpha = _mm_set1_epi32((int) 0xFF000000);
+		for (; i + 16 <= width; i += 16)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*) (in + i));
+			__m128i lo = _mm_unpacklo_epi8(v, v);
+			__m128i hi = _mm_unpackhi_epi8(v, v);
+			__m128i* dst = (__m128i*) (out + i * 4);
+			_mm_storeu_si128(dst, _mm_or_si128(_mm_unpacklo_epi16(lo, lo), alpha));
+			_mm_storeu_si128(dst + 1, _mm_or_si128(_mm_unpackhi_epi16(lo, lo), alpha));
+			_mm_storeu_si128(dst + 2, _mm_or_si128(_mm_unpacklo_epi16(hi, hi), alpha));
+			_mm_storeu_si128(dst + 3, _mm_or_si128(_mm_unpackhi_epi16(hi, hi), alpha));
+		}
+#elif defined(TEXUTILS_USE_NEON)
+		for (; i + 16 <= width; i += 16)
+		{
+			uint8x16x4_t px;
+			px.val[0] = px.val[1] = px.val[2] = vld1q_u8(in + i);
+			px.val[3] = vdupq_n_u8(255);
+			vst4q_u8(out + i * 4, px);
+		}
+#endif
+		for (; i < width; ++i)
+		{
+			unsigned char* p = out + i * 4;
+			p[0] = p[1] = p[2] = in[i];
+			p[3] = 255;
+		}
+	}
+
+	static void expandAI88(const unsigned char* in, unsigned char* out, int width)
+	{
+		int i = 0;
+#if defined(TEXUTILS_USE_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i lowByte = _mm_set1_epi32(0xFF);
+		const __m128i highByte = _mm_set1_epi32(0xFF00);
+		for (; i + 8 <= width; i += 8)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*) (in + i * 2));
+			__m128i* dst = (__m128i*) (out + i * 4);
+			for (int half = 0; half < 2; ++half)
+			{
+				// i | a << 8 per lane, to i | i << 8 | i << 16 | a << 24
+				__m128i w = half ? _mm_unpackhi_epi16(v, zero) : _mm_unpacklo_epi16(v, zero);
+				__m128i l = _mm_and_si128(w, lowByte);
+				__m128i rgb = _mm_or_si128(l, _mm_or_si128(_mm_slli_epi32(l, 8), _mm_slli_epi32(l, 16)));
+				_mm_storeu_si128(dst + half, _mm_or_si128(rgb, _mm_slli_epi32(_mm_and_si128(w, highByte), 16)));
+			}
+		}
+#elif defined(TEXUTILS_USE_NEON)
+		for (; i + 16 <= width; i += 16)
+		{
+			uint8x16x2_t v = vld2q_u8(in + i * 2);
+			uint8x16x4_t px;
+			px.val[0] = px.val[1] = px.val[2] = v.val[0];
+			px.val[3] = v.val[1];
+			vst4q_u8(out + i * 4, px);
+		}
+#endif
+		for (; i < width; ++i)
+		{
+			unsigned char* p = out + i * 4;
+			p[0] = p[1] = p[2] = in[i * 2];
+			p[3] = in[i * 2 + 1];
+		}
+	}
+
+	static void expandRGB888(const unsigned char* in, unsigned char* out, int width)
+	{
+		int i = 0;
+#if defined(TEXUTILS_USE_NEON)
+		for (; i + 16 <= width; i += 16)
+		{
+			uint8x16x3_t v = vld3q_u8(in + i * 3);
+			uint8x16x4_t px;
+			px.val[0] = v.val[0];
+			px.val[1] = v.val[1];
+			px.val[2] = v.val[2];
+			px.val[3] = vdupq_n_u8(255);
+			vst4q_u8(out + i * 4, px);
+		}
+#elif defined(TEXUTILS_USE_SSE2)
+		// SSE2 has no byte shuffle, whole word loads are as fast here.
+		// The last pixel is left to the byte loop so no load reads past in.
+		for (; i + 1 < width; ++i)
+		{
+			uint32_t v;
+			memcpy(&v, in + i * 3, 4);
+			v |= 0xFF000000;
+			memcpy(out + i * 4, &v, 4);
+		}
+#endif
+		for (; i < width; ++i)
+		{
+			unsigned char* p = out + i * 4;
+			p[0] = in[i * 3];
+			p[1] = in[i * 3 + 1];
+			p[2] = in[i * 3 + 2];
+			p[3] = 255;
+		}
+	}
+
+	static void expandToRGBA8888(const unsigned char* in, unsigned char* out, int width, PixelFormat format)
+	{
+		switch (format)
+		{
+			case PixelFormat::I8:
+				expandI8(in, out, width);
+				break;
+			case PixelFormat::AI88:
+				expandAI88(in, out, width);
+				break;
+			case PixelFormat::RGB888:
+				expandRGB888(in, out, width);
+				break;
+			default:
+				memcpy(out, in, (size_t) width * 4);
+				break;
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// pack from RGBA8888
+
+#if defined(TEXUTILS_USE_SSE2)
+	// 16 bit values in 32 bit lanes to 16 bit lanes, packs_epi32 saturates
+	// signed values so the lanes are sign extended first
+	static inline __m128i pack32To16(__m128i a, __m128i b)
+	{
+		a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+		b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+		return _mm_packs_epi32(a, b);
+	}
+
+	static inline __m128i packRGB565(__m128i px)
+	{
+		__m128i r = _mm_slli_epi32(_mm_and_si128(px, _mm_set1_epi32(0xF8)), 8);
+		__m128i g = _mm_and_si128(_mm_srli_epi32(px, 5), _mm_set1_epi32(0x7E0));
+		__m128i b = _mm_and_si128(_mm_srli_epi32(px, 19), _mm_set1_epi32(0x1F));
+		return _mm_or_si128(r, _mm_or_si128(g, b));
+	}
+
+	static inline __m128i packRGBA4444(__m128i px)
+	{
+		__m128i r = _mm_slli_epi32(_mm_and_si128(px, _mm_set1_epi32(0xF0)), 8);
+		__m128i g = _mm_and_si128(_mm_srli_epi32(px, 4), _mm_set1_epi32(0xF00));
+		__m128i b = _mm_and_si128(_mm_srli_epi32(px, 16), _mm_set1_epi32(0xF0));
+		__m128i a = _mm_srli_epi32(px, 28);
+		return _mm_or_si128(_mm_or_si128(r, g), _mm_or_si128(b, a));
+	}
+
+	static inline __m128i packRGB5A1(__m128i px)
+	{
+		__m128i r = _mm_slli_epi32(_mm_and_si128(px, _mm_set1_epi32(0xF8)), 8);
+		__m128i g = _mm_and_si128(_mm_srli_epi32(px, 5), _mm_set1_epi32(0x7C0));
+		__m128i b = _mm_and_si128(_mm_srli_epi32(px, 18), _mm_set1_epi32(0x3E));
+		__m128i a = _mm_srli_epi32(px, 31);
+		return _mm_or_si128(_mm_or_si128(r, g), _mm_or_si128(b, a));
+	}
+
+	// luminance of 8 pixels in 16 bit lanes
+	static inline __m128i luminance8(__m128i px0, __m128i px1)
+	{
+		const __m128i mask = _mm_set1_epi32(0xFF);
+		__m128i r = _mm_packs_epi32(_mm_and_si128(px0, mask), _mm_and_si128(px1, mask));
+		__m128i g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(px0, 8), mask), _mm_and_si128(_mm_srli_epi32(px1, 8), mask));
+		__m128i b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(px0, 16), mask), _mm_and_si128(_mm_srli_epi32(px1, 16), mask));
+		// at most 255 * 256 + 128, fits unsigned 16 bit lanes
+		__m128i sum = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(77)), _mm_mullo_epi16(g, _mm_set1_epi16(150)));
+		sum = _mm_add_epi16(sum, _mm_mullo_epi16(b, _mm_set1_epi16(29)));
+		return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(128)), 8);
+	}
+#endif
+
+	static void packFromRGBA8888(const unsigned char* in, unsigned char* out, int width,
+			PixelFormat format, const unsigned char* dither)
+	{
+		int i = 0;
+#if defined(TEXUTILS_USE_SSE2)
+		const __m128i offsets = dither ? _mm_loadu_si128((const __m128i*) dither) : _mm_setzero_si128();
+		const __m128i* src = (const __m128i*) in;
+		switch (format)
+		{
+			case PixelFormat::RGB565:
+			case PixelFormat::RGBA4444:
+			case PixelFormat::RGB5A1:
+				for (; i + 8 <= width; i += 8, src += 2)
+				{
+					__m128i px0 = _mm_adds_epu8(_mm_loadu_si128(src), offsets);
+					__m128i px1 = _mm_adds_epu8(_mm_loadu_si128(src + 1), offsets);
+					__m128i v;
+					if (format == PixelFormat::RGB565)
+						v = pack32To16(packRGB565(px0), packRGB565(px1));
+					else if (format == PixelFormat::RGBA4444)
+						v = pack32To16(packRGBA4444(px0), packRGBA4444(px1));
+					else
+						v = pack32To16(packRGB5A1(px0), packRGB5A1(px1));
+					_mm_storeu_si128((__m128i*) (out + i * 2), v);
+				}
+				break;
+			case PixelFormat::A8:
+				for (; i + 16 <= width; i += 16, src += 4)
+				{
+					__m128i a0 = _mm_packs_epi32(_mm_srli_epi32(_mm_loadu_si128(src), 24), _mm_srli_epi32(_mm_loadu_si128(src + 1), 24));
+					__m128i a1 = _mm_packs_epi32(_mm_srli_epi32(_mm_loadu_si128(src + 2), 24), _mm_srli_epi32(_mm_loadu_si128(src + 3), 24));
+					_mm_storeu_si128((__m128i*) (out + i), _mm_packus_epi16(a0, a1));
+				}
+				break;
+			case PixelFormat::I8:
+				for (; i + 16 <= width; i += 16, src += 4)
+				{
+					__m128i l0 = luminance8(_mm_loadu_si128(src), _mm_loadu_si128(src + 1));
+					__m128i l1 = luminance8(_mm_loadu_si128(src + 2), _mm_loadu_si128(src + 3));
+					_mm_storeu_si128((__m128i*) (out + i), _mm_packus_epi16(l0, l1));
+				}
+				break;
+			case PixelFormat::AI88:
+				for (; i + 8 <= width; i += 8, src += 2)
+				{
+					__m128i px0 = _mm_loadu_si128(src);
+					__m128i px1 = _mm_loadu_si128(src + 1);
+					__m128i a = _mm_packs_epi32(_mm_srli_epi32(px0, 24), _mm_srli_epi32(px1, 24));
+					__m128i v = _mm_or_si128(luminance8(px0, px1), _mm_slli_epi16(a, 8));
+					_mm_storeu_si128((__m128i*) (out + i * 2), v);
+				}
+				break;
+			default:
+				break;
+		}
+#elif defined(TEXUTILS_USE_NEON)
+		uint8x16_t offsets[3];
+		for (int c = 0; c < 3; ++c)
+		{
+			unsigned char lanes[16];
+			for (int x = 0; x < 16; ++x)
+				lanes[x] = dither ? dither[(x & 3) * 4 + c] : 0;
+			offsets[c] = vld1q_u8(lanes);
+		}
+		for (; i + 16 <= width; i += 16)
+		{
+			uint8x16x4_t px = vld4q_u8(in + i * 4);
+			if (dither)
+			{
+				px.val[0] = vqaddq_u8(px.val[0], offsets[0]);
+				px.val[1] = vqaddq_u8(px.val[1], offsets[1]);
+				px.val[2] = vqaddq_u8(px.val[2], offsets[2]);
+			}
+			switch (format)
+			{
+				case PixelFormat::RGB565:
+				case PixelFormat::RGBA4444:
+				case PixelFormat::RGB5A1:
+					for (int half = 0; half < 2; ++half)
+					{
+						uint8x8_t r = half ? vget_high_u8(px.val[0]) : vget_low_u8(px.val[0]);
+						uint8x8_t g = half ? vget_high_u8(px.val[1]) : vget_low_u8(px.val[1]);
+						uint8x8_t b = half ? vget_high_u8(px.val[2]) : vget_low_u8(px.val[2]);
+						uint8x8_t a = half ? vget_high_u8(px.val[3]) : vget_low_u8(px.val[3]);
+						// shift right and insert keeps the top bits of each field
+						uint16x8_t v = vshll_n_u8(r, 8);
+						if (format == PixelFormat::RGB565)
+						{
+							v = vsriq_n_u16(v, vshll_n_u8(g, 8), 5);
+							v = vsriq_n_u16(v, vshll_n_u8(b, 8), 11);
+						}
+						else if (format == PixelFormat::RGBA4444)
+						{
+							v = vsriq_n_u16(v, vshll_n_u8(g, 8), 4);
+							v = vsriq_n_u16(v, vshll_n_u8(b, 8), 8);
+							v = vsriq_n_u16(v, vshll_n_u8(a, 8), 12);
+						}
+						else
+						{
+							v = vsriq_n_u16(v, vshll_n_u8(g, 8), 5);
+							v = vsriq_n_u16(v, vshll_n_u8(b, 8), 10);
+							v = vsriq_n_u16(v, vshll_n_u8(a, 8), 15);
+						}
+						vst1q_u16((uint16_t*) (out + (i + half * 8) * 2), v);
+					}
+					break;
+				case PixelFormat::A8:
+					vst1q_u8(out + i, px.val[3]);
+					break;
+				case PixelFormat::RGB888:
+				{
+					uint8x16x3_t rgb;
+					rgb.val[0] = px.val[0];
+					rgb.val[1] = px.val[1];
+					rgb.val[2] = px.val[2];
+					vst3q_u8(out + i * 3, rgb);
+					break;
+				}
+				case PixelFormat::I8:
+				case PixelFormat::AI88:
+				{
+					uint8x16_t l;
+					uint16x8_t lo = vmull_u8(vget_low_u8(px.val[0]), vdup_n_u8(77));
+					lo = vmlal_u8(lo, vget_low_u8(px.val[1]), vdup_n_u8(150));
+					lo = vmlal_u8(lo, vget_low_u8(px.val[2]), vdup_n_u8(29));
+					uint16x8_t hi = vmull_u8(vget_high_u8(px.val[0]), vdup_n_u8(77));
+					hi = vmlal_u8(hi, vget_high_u8(px.val[1]), vdup_n_u8(150));
+					hi = vmlal_u8(hi, vget_high_u8(px.val[2]), vdup_n_u8(29));
+					l = vcombine_u8(vrshrn_n_u16(lo, 8), vrshrn_n_u16(hi, 8));
+					if (format == PixelFormat::I8)
+					{
+						vst1q_u8(out + i, l);
+					}
+					else
+					{
+						uint8x16x2_t la;
+						la.val[0] = l;
+						la.val[1] = px.val[3];
+						vst2q_u8(out + i * 2, la);
+					}
+					break;
+				}
+				default:
+					break;
+			}
+		}
+#endif
+		// scalar, also the tail of the vector loops, which always stop on a
+		// multiple of 4 pixels so the dither pattern lines up
+		for (; i < width; ++i)
+		{
+			const unsigned char* p = in + i * 4;
+			int r = p[0], g = p[1], b = p[2], a = p[3];
+			if (dither)
+			{
+				const unsigned char* d = dither + (i & 3) * 4;
+				r = addSaturate((unsigned char) r, d[0]);
+				g = addSaturate((unsigned char) g, d[1]);
+				b = addSaturate((unsigned char) b, d[2]);
+			}
+			uint16_t v;
+			switch (format)
+			{
+				case PixelFormat::RGB888:
+					out[i * 3] = (unsigned char) r;
+					out[i * 3 + 1] = (unsigned char) g;
+					out[i * 3 + 2] = (unsigned char) b;
+					break;
+				case PixelFormat::A8:
+					out[i] = (unsigned char) a;
+					break;
+				case PixelFormat::I8:
+					out[i] = (unsigned char) luminance(r, g, b);
+					break;
+				case PixelFormat::AI88:
+					out[i * 2] = (unsigned char) luminance(r, g, b);
+					out[i * 2 + 1] = (unsigned char) a;
+					break;
+				// the 16 bit formats are stored as native endian shorts, as GL reads them
+				case PixelFormat::RGB565:
+					v = (uint16_t) (((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3));
+					memcpy(out + i * 2, &v, 2);
+					break;
+				case PixelFormat::RGBA4444:
+					v = (uint16_t) (((r & 0xF0) << 8) | ((g & 0xF0) << 4) | (b & 0xF0) | (a >> 4));
+					memcpy(out + i * 2, &v, 2);
+					break;
+				case PixelFormat::RGB5A1:
+					v = (uint16_t) (((r & 0xF8) << 8) | ((g & 0xF8) << 3) | ((b & 0xF8) >> 2) | (a >> 7));
+					memcpy(out + i * 2, &v, 2);
+					break;
+				default:
+					break;
+			}
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// linear light premultiply
+
+	// sRGB to 16 bit linear, and 12 bit linear (the top bits of the 16) back
+	// to sRGB, each entry taken at the middle of its bucket
+	struct LinearTables
+	{
+		uint16_t toLinear[256];
+		unsigned char toSrgb[4096];
+
+		LinearTables()
+		{
+			for (int i = 0; i < 256; ++i)
+			{
+				double c = i / 255.0;
+				double l = c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+				toLinear[i] = (uint16_t) (l * 65535.0 + 0.5);
+			}
+			for (int i = 0; i < 4096; ++i)
+			{
+				double l = (i + 0.5) / 4096.0;
+				double c = l <= 0.0031308 ? l * 12.92 : 1.055 * pow(l, 1.0 / 2.4) - 0.055;
+				toSrgb[i] = (unsigned char) (c * 255.0 + 0.5);
+			}
+		}
+	};
+
+	static const LinearTables& getLinearTables()
+	{
+		static LinearTables tables;
+		return tables;
+	}
+
+	// a gather per channel, no gain from SIMD here, but opaque pixels are
+	// still skipped
+	static void premultiplyRowLinear(unsigned char* rgba, int width)
+	{
+		const LinearTables& tables = getLinearTables();
+		for (int i = 0; i < width; ++i, rgba += 4)
+		{
+			unsigned a = rgba[3];
+			if (a == 255)
+				continue;
+			for (int c = 0; c < 3; ++c)
+				rgba[c] = tables.toSrgb[(tables.toLinear[rgba[c]] * a / 255) >> 4];
+		}
+	}
+
+	static bool isConvertibleSource(PixelFormat format)
+	{
+		return format == PixelFormat::I8 || format == PixelFormat::AI88
+			|| format == PixelFormat::RGB888 || format == PixelFormat::RGBA8888;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// mipmaps
+
+	// Kaiser windowed sinc, three lobes a side and alpha 4, as NVTT does
+	static const double KAISER_WIDTH = 3.0;
+	static const double KAISER_ALPHA = 4.0;
+	// output rows per parallelFor step
+	static const int MIP_BAND_ROWS = 16;
+
+	static int getMipChannels(PixelFormat format)
+	{
+		switch (format)
+		{
+			case PixelFormat::BGRA8888:
+			case PixelFormat::RGBA8888:
+				return 4;
+			case PixelFormat::RGB888:
+				return 3;
+			case PixelFormat::AI88:
+				return 2;
+			case PixelFormat::A8:
+			case PixelFormat::I8:
+				return 1;
+			default:
+				return 0;
+		}
+	}
+
+	// leading channels that hold sRGB color, alpha after them is linear
+	static int getMipColorChannels(PixelFormat format)
+	{
+		switch (format)
+		{
+			case PixelFormat::BGRA8888:
+			case PixelFormat::RGBA8888:
+			case PixelFormat::RGB888:
+				return 3;
+			case PixelFormat::AI88:
+			case PixelFormat::I8:
+				return 1;
+			default:
+				return 0;
+		}
+	}
+
+	static double besselI0(double x)
+	{
+		double sum = 1.0;
+		double term = 1.0;
+		for (int k = 1; k < 32 && term > sum * 1e-12; ++k)
+		{
+			double f = x / (2.0 * k);
+			term *= f * f;
+			sum += term;
+		}
+		return sum;
+	}
+
+	// t in output pixels from the center
+	static double kaiserWeight(double t)
+	{
+		double x = t / KAISER_WIDTH;
+		if (x <= -1.0 || x >= 1.0)
+			return 0.0;
+		double sinc = t == 0.0 ? 1.0 : sin(M_PI * t) / (M_PI * t);
+		return sinc * besselI0(KAISER_ALPHA * sqrt(1.0 - x * x)) / besselI0(KAISER_ALPHA);
+	}
+
+	// the source pixels, and their weights, that make each output pixel
+	// along one axis. Pixels past the edge are clamped to it.
+	struct MipTaps
+	{
+		std::vector<int> first;
+		std::vector<int> count;
+		std::vector<int> offset;
+		std::vector<float> weights;
+		int maxCount;
+	};
+
+	static void makeMipTaps(int srcSize, int dstSize, TexUtils::MipmapFilter filter, MipTaps* taps)
+	{
+		double scale = (double) srcSize / dstSize;
+		taps->first.resize(dstSize);
+		taps->count.resize(dstSize);
+		taps->offset.resize(dstSize);
+		taps->weights.clear();
+		taps->maxCount = 0;
+
+		std::vector<double> local;
+		for (int i = 0; i < dstSize; ++i)
+		{
+			// box: the area the output pixel covers, kaiser: its support
+			double center = (i + 0.5) * scale;
+			double radius = filter == TexUtils::MipmapFilter::BOX ? scale * 0.5 : KAISER_WIDTH * scale;
+			double begin = center - radius;
+			double end = center + radius;
+			int lo = (int) floor(begin);
+			int hi = (int) ceil(end) - 1;
+			int first = lo < 0 ? 0 : lo;
+			int last = hi > srcSize - 1 ? srcSize - 1 : hi;
+
+			local.assign(last - first + 1, 0.0);
+			double sum = 0.0;
+			for (int j = lo; j <= hi; ++j)
+			{
+				double w = filter == TexUtils::MipmapFilter::BOX
+						? (end < j + 1.0 ? end : j + 1.0) - (begin > j ? begin : j)
+						: kaiserWeight((j + 0.5 - center) / scale);
+				int k = (j < first ? first : (j > last ? last : j)) - first;
+				local[k] += w;
+				sum += w;
+			}
+
+			taps->first[i] = first;
+			taps->count[i] = (int) local.size();
+			taps->offset[i] = (int) taps->weights.size();
+			for (size_t k = 0; k < local.size(); ++k)
+				taps->weights.push_back((float) (local[k] / sum));
+			if ((int) local.size() > taps->maxCount)
+				taps->maxCount = (int) local.size();
+		}
+	}
+
+	// out += in * weight
+	static void addScaledRow(float* out, const float* in, float weight, int count)
+	{
+		int i = 0;
+#if defined(TEXUTILS_USE_SSE2)
+		__m128 w = _mm_set1_ps(weight);
+		for (; i + 4 <= count; i += 4)
+			_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(in + i), w)));
+#elif defined(TEXUTILS_USE_NEON)
+		float32x4_t w = vdupq_n_f32(weight);
+		for (; i + 4 <= count; i += 4)
+			vst1q_f32(out + i, vmlaq_f32(vld1q_f32(out + i), vld1q_f32(in + i), w));
+#endif
+		for (; i < count; ++i)
+			out[i] += in[i] * weight;
+	}
+
+	// Resamples one source row across, into dstWidth pixels of floats.
+	// toFloat holds the value of each byte per channel, linear or not.
+	static void filterMipRow(const unsigned char* in, int srcWidth, int channels, const float* toFloat,
+			const MipTaps& taps, int dstWidth, float* line, float* out)
+	{
+		for (int x = 0; x < srcWidth; ++x)
+			for (int c = 0; c < channels; ++c)
+				line[x * channels + c] = toFloat[c * 256 + in[x * channels + c]];
+
+		int x = 0;
+#if defined(TEXUTILS_USE_SSE2)
+		// a pixel a register
+		for (; channels == 4 && x < dstWidth; ++x)
+		{
+			const float* w = &taps.weights[taps.offset[x]];
+			const float* p = line + taps.first[x] * 4;
+			__m128 acc = _mm_setzero_ps();
+			for (int k = 0; k < taps.count[x]; ++k)
+				acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(p + k * 4), _mm_set1_ps(w[k])));
+			_mm_storeu_ps(out + x * 4, acc);
+		}
+#elif defined(TEXUTILS_USE_NEON)
+		for (; channels == 4 && x < dstWidth; ++x)
+		{
+			const float* w = &taps.weights[taps.offset[x]];
+			const float* p = line + taps.first[x] * 4;
+			float32x4_t acc = vdupq_n_f32(0.0f);
+			for (int k = 0; k < taps.count[x]; ++k)
+				acc = vmlaq_n_f32(acc, vld1q_f32(p + k * 4), w[k]);
+			vst1q_f32(out + x * 4, acc);
+		}
+#endif
+		for (; x < dstWidth; ++x)
+		{
+			const float* w = &taps.weights[taps.offset[x]];
+			const float* p = line + taps.first[x] * channels;
+			int count = taps.count[x];
+			float acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (int k = 0; k < count; ++k, p += channels)
+				for (int c = 0; c < channels; ++c)
+					acc[c] += w[k] * p[c];
+			for (int c = 0; c < channels; ++c)
+				out[x * channels + c] = acc[c];
+		}
+	}
+
+	static void storeMipRow(const float* in, unsigned char* out, int width, int channels, int colorChannels,
+			bool gammaCorrect, const LinearTables& tables)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			for (int c = 0; c < channels; ++c, ++in, ++out)
+			{
+				// kaiser lobes can overshoot, clamp
+				if (gammaCorrect && c < colorChannels)
+				{
+					int l = (int) (*in * 4096.0f);
+					*out = tables.toSrgb[l < 0 ? 0 : (l > 4095 ? 4095 : l)];
+				}
+				else
+				{
+					int v = (int) (*in * 255.0f + 0.5f);
+					*out = (unsigned char) (v < 0 ? 0 : (v > 255 ? 255 : v));
+				}
+			}
+		}
+	}
+
+	// 2x2 box of an exactly halved level, rounded like (a + b + c + d + 2) / 4
+	static void halveRow(const unsigned char* row0, const unsigned char* row1, unsigned char* out,
+			int dstWidth, int channels)
+	{
+		int x = 0;
+		if (channels == 4)
+		{
+#if defined(TEXUTILS_USE_SSE2)
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i two = _mm_set1_epi16(2);
+			for (; x + 4 <= dstWidth; x += 4)
+			{
+				__m128i a0 = _mm_loadu_si128((const __m128i*) (row0 + x * 8));
+				__m128i a1 = _mm_loadu_si128((const __m128i*) (row0 + x * 8 + 16));
+				__m128i b0 = _mm_loadu_si128((const __m128i*) (row1 + x * 8));
+				__m128i b1 = _mm_loadu_si128((const __m128i*) (row1 + x * 8 + 16));
+				// column sums of two source pixels a register
+				__m128i s01 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+				__m128i s23 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+				__m128i s45 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+				__m128i s67 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+				// the second pixel onto the first
+				s01 = _mm_add_epi16(s01, _mm_srli_si128(s01, 8));
+				s23 = _mm_add_epi16(s23, _mm_srli_si128(s23, 8));
+				s45 = _mm_add_epi16(s45, _mm_srli_si128(s45, 8));
+				s67 = _mm_add_epi16(s67, _mm_srli_si128(s67, 8));
+				__m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(s01, s23), two), 2);
+				__m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(s45, s67), two), 2);
+				_mm_storeu_si128((__m128i*) (out + x * 4), _mm_packus_epi16(lo, hi));
+			}
+#elif defined(TEXUTILS_USE_NEON)
+			for (; x + 8 <= dstWidth; x += 8)
+			{
+				uint8x16x4_t a = vld4q_u8(row0 + x * 8);
+				uint8x16x4_t b = vld4q_u8(row1 + x * 8);
+				uint8x8x4_t o;
+				o.val[0] = vrshrn_n_u16(vpadalq_u8(vpaddlq_u8(a.val[0]), b.val[0]), 2);
+				o.val[1] = vrshrn_n_u16(vpadalq_u8(vpaddlq_u8(a.val[1]), b.val[1]), 2);
+				o.val[2] = vrshrn_n_u16(vpadalq_u8(vpaddlq_u8(a.val[2]), b.val[2]), 2);
+				o.val[3] = vrshrn_n_u16(vpadalq_u8(vpaddlq_u8(a.val[3]), b.val[3]), 2);
+				vst4_u8(out + x * 4, o);
+			}
+#endif
+		}
+		for (; x < dstWidth; ++x)
+		{
+			const unsigned char* p0 = row0 + x * 2 * channels;
+			const unsigned char* p1 = row1 + x * 2 * channels;
+			for (int c = 0; c < channels; ++c)
+				out[x * channels + c] = (unsigned char) ((p0[c] + p0[c + channels] + p1[c] + p1[c + channels] + 2) >> 2);
+		}
+	}
+
+	static void buildMipLevel(const unsigned char* src, int srcWidth, int srcHeight, unsigned char* dst,
+			int dstWidth, int dstHeight, int channels, int colorChannels, TexUtils::MipmapFilter filter, bool gammaCorrect)
+	{
+		size_t srcStride = (size_t) srcWidth * channels;
+		size_t dstStride = (size_t) dstWidth * channels;
+		int bands = (dstHeight + MIP_BAND_ROWS - 1) / MIP_BAND_ROWS;
+
+		// the common case, POT levels and the even levels of NPOT ones
+		if (filter == TexUtils::MipmapFilter::BOX && !gammaCorrect && srcWidth == dstWidth * 2 && srcHeight == dstHeight * 2)
+		{
+			ThreadPool::getInstance()->parallelFor(0, bands, [&](int band) {
+				int end = (band + 1) * MIP_BAND_ROWS < dstHeight ? (band + 1) * MIP_BAND_ROWS : dstHeight;
+				for (int y = band * MIP_BAND_ROWS; y < end; ++y)
+				{
+					const unsigned char* row0 = src + y * 2 * srcStride;
+					halveRow(row0, row0 + srcStride, dst + y * dstStride, dstWidth, channels);
+				}
+			});
+			return;
+		}
+
+		// separable: rows are resampled across, then those rows down
+		MipTaps xTaps;
+		MipTaps yTaps;
+		makeMipTaps(srcWidth, dstWidth, filter, &xTaps);
+		makeMipTaps(srcHeight, dstHeight, filter, &yTaps);
+
+		const LinearTables& tables = getLinearTables();
+		float toFloat[4 * 256];
+		for (int c = 0; c < 4; ++c)
+			for (int i = 0; i < 256; ++i)
+				toFloat[c * 256 + i] = gammaCorrect && c < colorChannels ? tables.toLinear[i] / 65535.0f : i / 255.0f;
+
+		ThreadPool::getInstance()->parallelFor(0, bands, [&](int band) {
+			// across resampled source rows, a ring big enough for any output
+			// row's taps. Rows only move down, so a slot is reused once no
+			// output row needs it anymore.
+			int rowFloats = (int) dstStride;
+			int ringSize = yTaps.maxCount + 1;
+			std::vector<float> ring((size_t) ringSize * rowFloats);
+			std::vector<int> ringRow(ringSize, -1);
+			std::vector<float> line(srcStride);
+			std::vector<float> sum(rowFloats);
+
+			int end = (band + 1) * MIP_BAND_ROWS < dstHeight ? (band + 1) * MIP_BAND_ROWS : dstHeight;
+			for (int y = band * MIP_BAND_ROWS; y < end; ++y)
+			{
+				std::fill(sum.begin(), sum.end(), 0.0f);
+				const float* w = &yTaps.weights[yTaps.offset[y]];
+				for (int k = 0; k < yTaps.count[y]; ++k)
+				{
+					int sy = yTaps.first[y] + k;
+					int slot = sy % ringSize;
+					float* row = &ring[(size_t) slot * rowFloats];
+					if (ringRow[slot] != sy)
+					{
+						filterMipRow(src + sy * srcStride, srcWidth, channels, toFloat, xTaps, dstWidth, &line[0], row);
+						ringRow[slot] = sy;
+					}
+					addScaledRow(&sum[0], row, w[k], rowFloats);
+				}
+				storeMipRow(&sum[0], dst + y * dstStride, dstWidth, channels, colorChannels, gammaCorrect, tables);
+			}
+		});
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	// pixel buffer pool
+
+	// keeps a few large blocks, enough for a loading screen's worth of atlases
+	static const size_t POOL_MAX_BLOCKS = 4;
+	static const size_t POOL_MAX_BYTES = 32 * 1024 * 1024;
+	// capacity is stored in front of the pixels, padded to keep them 16 byte aligned
+	static const size_t POOL_HEADER_SIZE = 16;
+
+	struct PixelPool
+	{
+		std::mutex mutex;
+		std::vector<unsigned char*> blocks;
+		size_t bytes;
+
+		PixelPool() : bytes(0) {}
+	};
+
+	static PixelPool& getPixelPool()
+	{
+		static PixelPool pool;
+		return pool;
+	}
+
+	static inline size_t getBlockCapacity(unsigned char* block)
+	{
+		size_t capacity;
+		memcpy(&capacity, block, sizeof(capacity));
+		return capacity;
+	}
+}
+
+namespace TexUtils
+{
+
+PixelFormat getConvertedFormat(PixelFormat originFormat, PixelFormat format)
+{
+	if (format == PixelFormat::AUTO || format == PixelFormat::NONE || format == originFormat)
+	{
+		return originFormat;
+	}
+	if (!isConvertibleSource(originFormat) || getBytesPerPixel(format) == 0 || format == PixelFormat::BGRA8888)
+	{
+		return originFormat;
+	}
+	// alpha can't be made up
+	if (format == PixelFormat::A8 && (originFormat == PixelFormat::I8 || originFormat == PixelFormat::RGB888))
+	{
+		return originFormat;
+	}
+	return format;
+}
+
+int getBytesPerPixel(PixelFormat format)
+{
+	switch (format)
+	{
+		case PixelFormat::BGRA8888:
+		case PixelFormat::RGBA8888:
+			return 4;
+		case PixelFormat::RGB888:
+			return 3;
+		case PixelFormat::RGB565:
+		case PixelFormat::AI88:
+		case PixelFormat::RGBA4444:
+		case PixelFormat::RGB5A1:
+			return 2;
+		case PixelFormat::A8:
+		case PixelFormat::I8:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+void convertRow(const unsigned char* in, unsigned char* out, int width,
+		PixelFormat originFormat, PixelFormat format, int y)
+{
+	unsigned char ditherRow[16];
+	const unsigned char* dither = nullptr;
+	if (y >= 0 && s_ditherEnabled && getDitherRow(format, y, ditherRow))
+	{
+		dither = ditherRow;
+	}
+
+	if (originFormat == format)
+	{
+		memcpy(out, in, (size_t) width * getBytesPerPixel(format));
+	}
+	else if (originFormat == PixelFormat::RGBA8888)
+	{
+		packFromRGBA8888(in, out, width, format, dither);
+	}
+	else if (format == PixelFormat::RGBA8888)
+	{
+		expandToRGBA8888(in, out, width, originFormat);
+	}
+	else
+	{
+		// chunks are a multiple of 4 pixels, the dither pattern carries on
+		unsigned char rgba[CHUNK_PIXELS * 4];
+		int inSize = getBytesPerPixel(originFormat);
+		int outSize = getBytesPerPixel(format);
+		for (int x = 0; x < width; x += CHUNK_PIXELS)
+		{
+			int count = width - x < CHUNK_PIXELS ? width - x : CHUNK_PIXELS;
+			expandToRGBA8888(in + x * inSize, rgba, count, originFormat);
+			packFromRGBA8888(rgba, out + x * outSize, count, format, dither);
+		}
+	}
+}
+
+void premultiplyRow(unsigned char* rgba, int width, bool linear)
+{
+	if (linear)
+	{
+		premultiplyRowLinear(rgba, width);
+		return;
+	}
+
+	int i = 0;
+#if defined(TEXUTILS_USE_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi16(1);
+	const __m128i alphaMask = _mm_set1_epi32((int) 0xFF000000);
+	// per 16 bit lane of two unpacked pixels: colors take a + 1, alpha
+	// takes 256 so it comes out unchanged
+	const __m128i colorLanes = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+	const __m128i alphaLanes = _mm_set_epi16(256, 0, 0, 0, 256, 0, 0, 0);
+	for (; i + 16 <= width; i += 16)
+	{
+		__m128i* p = (__m128i*) (rgba + i * 4);
+		__m128i px[4];
+		for (int k = 0; k < 4; ++k)
+			px[k] = _mm_loadu_si128(p + k);
+		__m128i all = _mm_and_si128(_mm_and_si128(px[0], px[1]), _mm_and_si128(px[2], px[3]));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(all, alphaMask), alphaMask)) == 0xFFFF)
+			continue;
+		for (int k = 0; k < 4; ++k)
+		{
+			__m128i lo = _mm_unpacklo_epi8(px[k], zero);
+			__m128i hi = _mm_unpackhi_epi8(px[k], zero);
+			__m128i aLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+			__m128i aHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+			aLo = _mm_or_si128(_mm_and_si128(_mm_add_epi16(aLo, one), colorLanes), alphaLanes);
+			aHi = _mm_or_si128(_mm_and_si128(_mm_add_epi16(aHi, one), colorLanes), alphaLanes);
+			// at most 255 * 256, the low 16 bits of the product are exact
+			lo = _mm_srli_epi16(_mm_mullo_epi16(lo, aLo), 8);
+			hi = _mm_srli_epi16(_mm_mullo_epi16(hi, aHi), 8);
+			_mm_storeu_si128(p + k, _mm_packus_epi16(lo, hi));
+		}
+	}
+#elif defined(TEXUTILS_USE_NEON)
+	for (; i + 16 <= width; i += 16)
+	{
+		uint8x16x4_t px = vld4q_u8(rgba + i * 4);
+		uint8x8_t opaque = vand_u8(vget_low_u8(px.val[3]), vget_high_u8(px.val[3]));
+		if (vget_lane_u64(vreinterpret_u64_u8(opaque), 0) == ~(uint64_t) 0)
+			continue;
+		uint16x8_t aLo = vaddw_u8(vdupq_n_u16(1), vget_low_u8(px.val[3]));
+		uint16x8_t aHi = vaddw_u8(vdupq_n_u16(1), vget_high_u8(px.val[3]));
+		for (int c = 0; c < 3; ++c)
+		{
+			uint16x8_t lo = vmulq_u16(vmovl_u8(vget_low_u8(px.val[c])), aLo);
+			uint16x8_t hi = vmulq_u16(vmovl_u8(vget_high_u8(px.val[c])), aHi);
+			px.val[c] = vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8));
+		}
+		vst4q_u8(rgba + i * 4, px);
+	}
+#endif
+	for (; i < width; ++i)
+	{
+		unsigned char* p = rgba + i * 4;
+		unsigned a = p[3];
+		if (a == 255)
+			continue;
+		p[0] = (unsigned char) ((p[0] * (a + 1)) >> 8);
+		p[1] = (unsigned char) ((p[1] * (a + 1)) >> 8);
+		p[2] = (unsigned char) ((p[2] * (a + 1)) >> 8);
+	}
+}
+
+PixelFormat convertDataToFormat(const unsigned char* data, ssize_t dataLen,
+		PixelFormat originFormat, PixelFormat format,
+		unsigned char** outData, ssize_t* outDataLen, int width)
+{
+	format = getConvertedFormat(originFormat, format);
+	if (format == originFormat)
+	{
+		*outData = const_cast<unsigned char*>(data);
+		*outDataLen = dataLen;
+		return originFormat;
+	}
+
+	int inSize = getBytesPerPixel(originFormat);
+	int outSize = getBytesPerPixel(format);
+	ssize_t pixels = dataLen / inSize;
+	*outDataLen = pixels * outSize;
+	*outData = static_cast<unsigned char*>(malloc(*outDataLen));
+	if (*outData == nullptr)
+	{
+		*outData = const_cast<unsigned char*>(data);
+		*outDataLen = dataLen;
+		return originFormat;
+	}
+	if (width <= 0)
+	{
+		// no rows to dither along, convert it as one long row
+		convertRow(data, *outData, (int) pixels, originFormat, format);
+		return format;
+	}
+	for (ssize_t y = 0; y < pixels / width; ++y)
+	{
+		convertRow(data + y * width * inSize, *outData + y * width * outSize, width, originFormat, format, (int) y);
+	}
+	return format;
+}
+
+unsigned char* allocPixels(size_t size)
+{
+	PixelPool& pool = getPixelPool();
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		// smallest pooled block that fits without wasting more than half of it
+		size_t best = pool.blocks.size();
+		for (size_t i = 0; i < pool.blocks.size(); ++i)
+		{
+			size_t capacity = getBlockCapacity(pool.blocks[i]);
+			if (capacity >= size && capacity / 2 <= size
+				&& (best == pool.blocks.size() || capacity < getBlockCapacity(pool.blocks[best])))
+			{
+				best = i;
+			}
+		}
+		if (best != pool.blocks.size())
+		{
+			unsigned char* block = pool.blocks[best];
+			pool.blocks.erase(pool.blocks.begin() + best);
+			pool.bytes -= getBlockCapacity(block);
+			return block + POOL_HEADER_SIZE;
+		}
+	}
+
+	// round up to whole pages so slightly different sizes share blocks
+	size_t capacity = (size + 4095) & ~(size_t) 4095;
+	unsigned char* block = static_cast<unsigned char*>(malloc(capacity + POOL_HEADER_SIZE));
+	if (block == nullptr)
+	{
+		return nullptr;
+	}
+	memcpy(block, &capacity, sizeof(capacity));
+	return block + POOL_HEADER_SIZE;
+}
+
+void freePixels(unsigned char* data)
+{
+	if (data == nullptr)
+	{
+		return;
+	}
+	unsigned char* block = data - POOL_HEADER_SIZE;
+	size_t capacity = getBlockCapacity(block);
+
+	PixelPool& pool = getPixelPool();
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		if (pool.blocks.size() < POOL_MAX_BLOCKS && pool.bytes + capacity <= POOL_MAX_BYTES)
+		{
+			pool.blocks.push_back(block);
+			pool.bytes += capacity;
+			return;
+		}
+	}
+	free(block);
+}
+
+void setDitherEnabled(bool enabled)
+{
+	s_ditherEnabled = enabled;
+}
+
+bool isDitherEnabled()
+{
+	return s_ditherEnabled;
+}
+
+int getMipmapCount(int width, int height)
+{
+	int size = width > height ? width : height;
+	int count = 1;
+	while (size > 1)
+	{
+		size >>= 1;
+		++count;
+	}
+	return count;
+}
+
+size_t getMipmapChainSize(int width, int height, PixelFormat format, int count)
+{
+	int channels = getMipChannels(format);
+	size_t size = 0;
+	for (int i = 1; i < count; ++i)
+	{
+		width = width > 1 ? width >> 1 : 1;
+		height = height > 1 ? height >> 1 : 1;
+		size += (size_t) width * height * channels;
+	}
+	return size;
+}
+
+bool buildMipmaps(const unsigned char* data, int width, int height, PixelFormat format, int count,
+		MipmapFilter filter, bool gammaCorrect, unsigned char* out)
+{
+	int channels = getMipChannels(format);
+	if (channels == 0 || data == nullptr || out == nullptr || width <= 0 || height <= 0)
+	{
+		return false;
+	}
+
+	// each level from the one above, it's a quarter of the work of going
+	// from level 0 every time
+	const unsigned char* src = data;
+	for (int i = 1; i < count; ++i)
+	{
+		int levelWidth = width > 1 ? width >> 1 : 1;
+		int levelHeight = height > 1 ? height >> 1 : 1;
+		buildMipLevel(src, width, height, out, levelWidth, levelHeight, channels, getMipColorChannels(format),
+				filter, gammaCorrect);
+		src = out;
+		out += (size_t) levelWidth * levelHeight * channels;
+		width = levelWidth;
+		height = levelHeight;
+	}
+	return true;
+}
+
+void purgePixelPool()
+{
+	PixelPool& pool = getPixelPool();
+	std::lock_guard<std::mutex> lock(pool.mutex);
+	for (size_t i = 0; i < pool.blocks.size(); ++i)
+	{
+		free(pool.blocks[i]);
+	}
+	pool.blocks.clear();
+	pool.bytes = 0;
+}
+
+}
+
+FLAKOR_NS_END
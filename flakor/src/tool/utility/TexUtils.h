@@ -0,0 +1,127 @@
+/**********************************************************
+ * Copyright (c) 2013-2015 Steve Hsu  All Rights Reserved.
+ *********************************************************/
+
+#ifndef TOOL_UTILITY_TEXUTILS_H
+#define TOOL_UTILITY_TEXUTILS_H
+
+#include "targetMacros.h"
+#include "core/opengl/texture/Texture2D.h"
+
+#include <stddef.h>
+
+FLAKOR_NS_BEGIN
+
+/**
+ * Pixel format conversion and mipmap building for uncompressed textures.
+ *
+ * Everything works on rows so decoders can convert a row while it is
+ * still in cache, convertDataToFormat is the whole image version used by
+ * Texture2D.
+ */
+namespace TexUtils
+{
+	/**
+	 * Format that converting from originFormat to format gives: format
+	 * itself if the pair is supported, originFormat for AUTO, NONE and
+	 * pairs that aren't (such as anything to A8 from a format without
+	 * alpha).
+	 */
+	PixelFormat getConvertedFormat(PixelFormat originFormat, PixelFormat format);
+
+	/** bytes per pixel of an uncompressed format, 0 for the others */
+	int getBytesPerPixel(PixelFormat format);
+
+	/**
+	 * Converts width pixels from in to out. The pair must be one that
+	 * getConvertedFormat accepts, or the same format on both sides (then
+	 * it is a copy). in and out must not overlap. Runs on SSE2 / NEON
+	 * where available, except RGB888 output on SSE2.
+	 * @param y  row of the image, picks the dither pattern row; -1 never
+	 *           dithers
+	 */
+	void convertRow(const unsigned char* in, unsigned char* out, int width,
+			PixelFormat originFormat, PixelFormat format, int y = -1);
+
+	/**
+	 * Premultiplies width RGBA8888 pixels in place, c * (a + 1) >> 8 like
+	 * FK_RGB_PREMULTIPLY_ALPHA. Runs 16 pixels a step on SSE2 / NEON and
+	 * skips opaque runs.
+	 * @param linear  premultiply in linear light instead: colors are taken
+	 *                out of sRGB, scaled and put back through lookup
+	 *                tables, which keeps soft edges from going dark
+	 */
+	void premultiplyRow(unsigned char* rgba, int width, bool linear = false);
+
+	/**
+	 * Converts a whole image. Returns the format the data ended up in; if
+	 * that is originFormat, *outData is data itself and nothing was
+	 * allocated, otherwise *outData is a new buffer the caller frees with
+	 * free(). width is the row length in pixels, without it the data is
+	 * converted as one row and never dithered.
+	 */
+	PixelFormat convertDataToFormat(const unsigned char* data, ssize_t dataLen,
+			PixelFormat originFormat, PixelFormat format,
+			unsigned char** outData, ssize_t* outDataLen, int width = 0);
+
+	/**
+	 * Dithers conversions to RGB565, RGBA4444 and RGB5A1 with a 4x4
+	 * ordered pattern, which hides the banding of gradients. Alpha is not
+	 * dithered. Off by default.
+	 */
+	void setDitherEnabled(bool enabled);
+	bool isDitherEnabled();
+
+	enum class MipmapFilter
+	{
+		/** average of the area a pixel covers, cheap and soft */
+		BOX,
+		/** Kaiser windowed sinc, three source pixels a side: sharper levels,
+		 *  a few times the cost of BOX */
+		KAISER
+	};
+
+	/** levels of a full mipmap chain for width x height, down to 1x1 */
+	int getMipmapCount(int width, int height);
+
+	/**
+	 * bytes buildMipmaps writes for levels 1 to count - 1 of a width x
+	 * height image, 0 for the formats it doesn't build
+	 */
+	size_t getMipmapChainSize(int width, int height, PixelFormat format, int count);
+
+	/**
+	 * Builds levels 1 to count - 1 of an image of any size, POT or not,
+	 * into out, one after the other with tight rows. Level n is
+	 * max(1, width >> n) x max(1, height >> n) as GL expects; odd sizes
+	 * are resampled, not just dropping the last row or column. Works on
+	 * the 8 bit per channel formats (RGBA8888, BGRA8888, RGB888, AI88, A8,
+	 * I8). Rows are split across the ThreadPool; exact halvings with BOX
+	 * run on SSE2 / NEON integer kernels, the rest on a float separable
+	 * filter.
+	 * @param gammaCorrect  average colors in linear light instead of on
+	 *                      the sRGB values, which keeps fine bright detail
+	 *                      from going dark in the small levels. Alpha is
+	 *                      always averaged as is.
+	 */
+	bool buildMipmaps(const unsigned char* data, int width, int height, PixelFormat format, int count,
+			MipmapFilter filter, bool gammaCorrect, unsigned char* out);
+
+	/**
+	 * Pixel buffer for a decoded image. Freed buffers are kept for the
+	 * next decode of a similar size, so loading a run of textures doesn't
+	 * page fault a fresh allocation for each one. Only freePixels may
+	 * release the result. Thread safe.
+	 */
+	unsigned char* allocPixels(size_t size);
+
+	/** gives a buffer from allocPixels back to the pool, nullptr is ignored */
+	void freePixels(unsigned char* data);
+
+	/** frees the buffers the pool holds, for memory warnings */
+	void purgePixelPool();
+}
+
+FLAKOR_NS_END
+
+#endif
@@ -7,15 +7,18 @@ bool TestScene::init()
     LOGD("testscene init");
 
 	TestScene* s = this;
-	Image* image = dynamic_cast<Image*>(ResourceManager::thisManager()->createResource("asset://flakor_test.png",ResourceManager::IMAGE_NAME));
-	image->setCallback([=](Resource*){
-		Texture2D* tex = new Texture2D();
-		tex->initWithImage(image);
+	//decoded on a worker, uploaded in the frame loop within its budget
+	TextureManager::getInstance()->loadTextureAsync("asset://flakor_test.png", [=](Texture2D* tex){
+		if (tex == nullptr)
+		{
+			return;
+		}
     	Sprite *sprite = Sprite::createWithTexture(tex); 
     	sprite->setPosition(PointMake(200,500));
 	    s->addChild(sprite, 1);
+	    //the sprite holds the texture now, give back the cache's reference
+	    TextureManager::getInstance()->unloadTexture(tex);
 	});
-	image->load(true);
 	
     
     Sprite *logo = Sprite::create("asset://flakor_logo.png");
@@ -3,15 +3,18 @@
 bool TestScene::init()
 {
 	TestScene* s = this;
-	Image* image = dynamic_cast<Image*>(ResourceManager::thisManager()->createResource("bundle://flakor_test.png",ResourceManager::IMAGE_NAME));
-	image->setCallback([=](Resource*){
-		Texture2D* tex = new Texture2D();
-		tex->initWithImage(image);
+	//decoded on a worker, uploaded in the frame loop within its budget
+	TextureManager::getInstance()->loadTextureAsync("bundle://flakor_test.png", [=](Texture2D* tex){
+		if (tex == nullptr)
+		{
+			return;
+		}
     	Sprite *sprite = Sprite::createWithTexture(tex);
     	sprite->setPosition(PointMake(0,5));
 	    s->addChild(sprite, 1);
+	    //the sprite holds the texture now, give back the cache's reference
+	    TextureManager::getInstance()->unloadTexture(tex);
 	});
-	image->load(true);
 	
     
     Sprite *logo = Sprite::create("bundle://flakor_logo.png");
@@ -0,0 +1,385 @@
+#include "core/opengl/texture/astc.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+// Decodes ASTC blocks built bit by bit from the specification and checks
+// every texel against the value the specification gives: a void extent
+// block, a single partition RGBA block with four weight levels, a dual
+// plane block and a two partition block, whose texels are assigned with
+// the partition hash of the specification, written out again here. A
+// reserved block mode must decode to the error color. Then a large image
+// is decoded with astc_decode_image and checked against astc_decode_block
+// one block at a time, and its throughput is printed in MPixels/s.
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 128 bits, bit 0 is bit 0 of byte 0
+struct Block
+{
+	uint8_t bytes[ASTC_ENCODED_BLOCK_SIZE];
+
+	Block() { memset(bytes, 0, sizeof(bytes)); }
+
+	void write(int start, int count, uint32_t value)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			int bit = start + i;
+			if ((value >> i) & 1)
+				bytes[bit >> 3] |= (uint8_t) (1 << (bit & 7));
+			else
+				bytes[bit >> 3] &= (uint8_t) ~(1 << (bit & 7));
+		}
+	}
+
+	// weights are read from bit 127 down
+	void writeWeight(int index, int bits, uint32_t value)
+	{
+		for (int i = 0; i < bits; i++)
+			write(127 - (index * bits + i), 1, (value >> i) & 1);
+	}
+};
+
+// LDR interpolation of one channel of 8 bit endpoints, as UNORM8
+static uint8_t interpolate(int c0, int c1, int weight)
+{
+	int c = (c0 * 257 * (64 - weight) + c1 * 257 * weight + 32) >> 6;
+	return (uint8_t) (c >> 8);
+}
+
+static uint32_t hash52(uint32_t inp)
+{
+	inp ^= inp >> 15;
+	inp *= 0xEEDE0891;
+	inp ^= inp >> 5;
+	inp += inp << 16;
+	inp ^= inp >> 7;
+	inp ^= inp >> 3;
+	inp ^= inp << 6;
+	inp ^= inp >> 17;
+	return inp;
+}
+
+static int selectPartition(int seed, int x, int y, int z, int partitionCount, int smallBlock)
+{
+	if (smallBlock)
+	{
+		x <<= 1;
+		y <<= 1;
+		z <<= 1;
+	}
+	seed += (partitionCount - 1) * 1024;
+	uint32_t rnum = hash52(seed);
+	uint8_t seed1 = rnum & 0xF;
+	uint8_t seed2 = (rnum >> 4) & 0xF;
+	uint8_t seed3 = (rnum >> 8) & 0xF;
+	uint8_t seed4 = (rnum >> 12) & 0xF;
+	uint8_t seed5 = (rnum >> 16) & 0xF;
+	uint8_t seed6 = (rnum >> 20) & 0xF;
+	uint8_t seed7 = (rnum >> 24) & 0xF;
+	uint8_t seed8 = (rnum >> 28) & 0xF;
+	uint8_t seed9 = (rnum >> 18) & 0xF;
+	uint8_t seed10 = (rnum >> 22) & 0xF;
+	uint8_t seed11 = (rnum >> 26) & 0xF;
+	uint8_t seed12 = ((rnum >> 30) | (rnum << 2)) & 0xF;
+
+	seed1 *= seed1; seed2 *= seed2; seed3 *= seed3; seed4 *= seed4;
+	seed5 *= seed5; seed6 *= seed6; seed7 *= seed7; seed8 *= seed8;
+	seed9 *= seed9; seed10 *= seed10; seed11 *= seed11; seed12 *= seed12;
+
+	int sh1, sh2, sh3;
+	if (seed & 1)
+	{
+		sh1 = (seed & 2 ? 4 : 5);
+		sh2 = (partitionCount == 3 ? 6 : 5);
+	}
+	else
+	{
+		sh1 = (partitionCount == 3 ? 6 : 5);
+		sh2 = (seed & 2 ? 4 : 5);
+	}
+	sh3 = (seed & 0x10) ? sh1 : sh2;
+
+	seed1 >>= sh1; seed2 >>= sh2; seed3 >>= sh1; seed4 >>= sh2;
+	seed5 >>= sh1; seed6 >>= sh2; seed7 >>= sh1; seed8 >>= sh2;
+	seed9 >>= sh3; seed10 >>= sh3; seed11 >>= sh3; seed12 >>= sh3;
+
+	int a = seed1 * x + seed2 * y + seed11 * z + (rnum >> 14);
+	int b = seed3 * x + seed4 * y + seed12 * z + (rnum >> 10);
+	int c = seed5 * x + seed6 * y + seed9 * z + (rnum >> 6);
+	int d = seed7 * x + seed8 * y + seed10 * z + (rnum >> 2);
+
+	a &= 0x3F; b &= 0x3F; c &= 0x3F; d &= 0x3F;
+	if (partitionCount < 4)
+		d = 0;
+	if (partitionCount < 3)
+		c = 0;
+
+	if (a >= b && a >= c && a >= d)
+		return 0;
+	else if (b >= c && b >= d)
+		return 1;
+	else if (c >= d)
+		return 2;
+	return 3;
+}
+
+static bool check(const char* name, const Block& block, int blockWidth, int blockHeight,
+		const std::vector<uint8_t>& expected, int expectedResult)
+{
+	std::vector<uint8_t> actual(blockWidth * blockHeight * 4);
+	int result = astc_decode_block(block.bytes, blockWidth, blockHeight, &actual[0]);
+	bool same = (result != 0) == (expectedResult != 0) && actual == expected;
+	printf("%-16s %2dx%-2d  %s\n", name, blockWidth, blockHeight, same ? "ok" : "MISMATCH");
+	if (!same)
+	{
+		for (size_t i = 0; i < actual.size(); i += 4)
+		{
+			if (memcmp(&actual[i], &expected[i], 4) != 0)
+			{
+				printf("  texel %d: %d %d %d %d, expected %d %d %d %d\n", (int) (i / 4),
+						actual[i], actual[i + 1], actual[i + 2], actual[i + 3],
+						expected[i], expected[i + 1], expected[i + 2], expected[i + 3]);
+				break;
+			}
+		}
+	}
+	return same;
+}
+
+// one constant color, the extent coordinates all ones (no extent)
+static bool testVoidExtent(int blockWidth, int blockHeight)
+{
+	static const uint16_t color[4] = { 0x1212, 0x8080, 0xFEFE, 0x4040 };
+	Block block;
+	block.write(0, 9, 0x1FC);
+	block.write(9, 1, 0);   // LDR
+	block.write(10, 2, 3);
+	for (int i = 0; i < 4; i++)
+		block.write(12 + 13 * i, 13, 0x1FFF);
+	for (int i = 0; i < 4; i++)
+		block.write(64 + 16 * i, 16, color[i]);
+
+	std::vector<uint8_t> expected(blockWidth * blockHeight * 4);
+	for (size_t i = 0; i < expected.size(); i++)
+		expected[i] = (uint8_t) (color[i % 4] >> 8);
+	return check("void extent", block, blockWidth, blockHeight, expected, 0);
+}
+
+// 4x4 grid of 2 bit weights (0, 21, 43, 64), CEM 12 (LDR RGBA direct), 8 bit endpoints
+static bool testSinglePartition()
+{
+	static const int e0[4] = { 20, 40, 60, 0 };
+	static const int e1[4] = { 220, 180, 100, 255 };
+	static const int weightValues[4] = { 0, 21, 43, 64 };
+	Block block;
+	// R = 100 (2 bit weights), W = B + 4, H = A + 2 with A = 2, B = 0
+	block.write(0, 11, 0x042);
+	block.write(11, 2, 0);   // one partition
+	block.write(13, 4, 12);
+	for (int c = 0; c < 4; c++)
+	{
+		block.write(17 + 16 * c, 8, e0[c]);
+		block.write(25 + 16 * c, 8, e1[c]);
+	}
+	for (int i = 0; i < 16; i++)
+		block.writeWeight(i, 2, (i + i / 4) % 4);
+
+	std::vector<uint8_t> expected(4 * 4 * 4);
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < 4; c++)
+			expected[i * 4 + c] = interpolate(e0[c], e1[c], weightValues[(i + i / 4) % 4]);
+	return check("single partition", block, 4, 4, expected, 0);
+}
+
+// 2x2 grid of 3 bit weights for two planes, the second plane for green
+static bool testDualPlane(int blockWidth, int blockHeight)
+{
+	static const int e0[4] = { 10, 20, 30, 40 };
+	static const int e1[4] = { 250, 230, 210, 200 };
+	const int ccs = 1;
+	Block block;
+	// R = 111 (3 bit weights), W = B + 2, H = A + 2 with A = B = 0, dual plane
+	block.write(0, 11, 0x51F);
+	block.write(11, 2, 0);
+	block.write(13, 4, 12);
+	for (int c = 0; c < 4; c++)
+	{
+		block.write(17 + 16 * c, 8, e0[c]);
+		block.write(25 + 16 * c, 8, e1[c]);
+	}
+	// weights interleaved, plane 1 all 2 (18), plane 2 all 7 (64)
+	for (int i = 0; i < 4; i++)
+	{
+		block.writeWeight(2 * i, 3, 2);
+		block.writeWeight(2 * i + 1, 3, 7);
+	}
+	// the component selector sits right below the 24 weight bits
+	block.write(128 - 24 - 2, 2, ccs);
+
+	std::vector<uint8_t> expected(blockWidth * blockHeight * 4);
+	for (int i = 0; i < blockWidth * blockHeight; i++)
+		for (int c = 0; c < 4; c++)
+			expected[i * 4 + c] = interpolate(e0[c], e1[c], c == ccs ? 64 : 18);
+	return check("dual plane", block, blockWidth, blockHeight, expected, 0);
+}
+
+// two partitions of CEM 0 (LDR luminance direct), 4x4 grid of 2 bit weights
+static bool testTwoPartitions(int seed)
+{
+	static const int l0[2] = { 16, 200 };
+	static const int l1[2] = { 120, 40 };
+	static const int weightValues[4] = { 0, 21, 43, 64 };
+	Block block;
+	block.write(0, 11, 0x042);
+	block.write(11, 2, 1);   // two partitions
+	block.write(13, 10, seed);
+	block.write(23, 2, 0);   // one CEM for all partitions
+	block.write(25, 4, 0);
+	for (int p = 0; p < 2; p++)
+	{
+		block.write(29 + 16 * p, 8, l0[p]);
+		block.write(37 + 16 * p, 8, l1[p]);
+	}
+	for (int i = 0; i < 16; i++)
+		block.writeWeight(i, 2, (3 * i + 1) % 4);
+
+	std::vector<uint8_t> expected(4 * 4 * 4);
+	int used[2] = { 0, 0 };
+	for (int y = 0; y < 4; y++)
+	{
+		for (int x = 0; x < 4; x++)
+		{
+			int i = y * 4 + x;
+			// 16 texels is a small block
+			int p = selectPartition(seed, x, y, 0, 2, 1);
+			used[p]++;
+			uint8_t l = interpolate(l0[p], l1[p], weightValues[(3 * i + 1) % 4]);
+			expected[i * 4 + 0] = l;
+			expected[i * 4 + 1] = l;
+			expected[i * 4 + 2] = l;
+			expected[i * 4 + 3] = 255;
+		}
+	}
+	if (used[0] == 0 || used[1] == 0)
+	{
+		printf("two partitions   seed %d puts every texel in one partition, BAD seed\n", seed);
+		return false;
+	}
+	char name[32];
+	snprintf(name, sizeof(name), "partitions %d", seed);
+	return check(name, block, 4, 4, expected, 0);
+}
+
+// block mode 0 is reserved
+static bool testErrorBlock()
+{
+	Block block;
+	std::vector<uint8_t> expected(4 * 4 * 4);
+	for (size_t i = 0; i < expected.size(); i += 4)
+	{
+		expected[i + 0] = 255;
+		expected[i + 1] = 0;
+		expected[i + 2] = 255;
+		expected[i + 3] = 255;
+	}
+	return check("reserved mode", block, 4, 4, expected, 1);
+}
+
+// the blocks above tiled over an image, decoded whole and block by block
+static bool testImage(uint32_t width, uint32_t height, int rounds)
+{
+	const int blockWidth = 4;
+	const int blockHeight = 4;
+	uint32_t blocksWide = (width + blockWidth - 1) / blockWidth;
+	uint32_t blocksHigh = (height + blockHeight - 1) / blockHeight;
+	std::vector<uint8_t> data(astc_get_encoded_data_size(blockWidth, blockHeight, width, height));
+
+	// a void extent, a dual plane and a partitioned block, with random endpoints
+	Block blocks[3];
+	blocks[0].write(0, 12, 0xDFC);
+	for (int i = 0; i < 4; i++)
+		blocks[0].write(12 + 13 * i, 13, 0x1FFF);
+	blocks[1].write(0, 11, 0x51F);
+	blocks[1].write(13, 4, 12);
+	blocks[2].write(0, 11, 0x042);
+	blocks[2].write(11, 2, 1);
+	for (size_t i = 0; i < data.size(); i += ASTC_ENCODED_BLOCK_SIZE)
+	{
+		Block block = blocks[rand() % 3];
+		if (block.bytes[0] == 0xFC)
+		{
+			block.write(64, 32, (uint32_t) rand());
+			block.write(96, 32, (uint32_t) rand());
+		}
+		else
+		{
+			block.write(block.bytes[1] & 0x08 ? 13 : 17, 32, (uint32_t) rand());
+			block.write(128 - 32, 32, (uint32_t) rand());
+		}
+		memcpy(&data[i], block.bytes, ASTC_ENCODED_BLOCK_SIZE);
+	}
+
+	uint32_t stride = width * 4;
+	std::vector<uint8_t> expected((size_t) stride * height);
+	uint8_t texels[ASTC_MAX_BLOCK_DIM * ASTC_MAX_BLOCK_DIM * 4];
+	double start = now();
+	for (int r = 0; r < rounds; r++)
+	{
+		const uint8_t* in = &data[0];
+		for (uint32_t by = 0; by < blocksHigh; by++)
+		{
+			for (uint32_t bx = 0; bx < blocksWide; bx++, in += ASTC_ENCODED_BLOCK_SIZE)
+			{
+				astc_decode_block(in, blockWidth, blockHeight, texels);
+				for (int y = 0; y < blockHeight && by * blockHeight + y < height; y++)
+				{
+					int columns = width - bx * blockWidth < (uint32_t) blockWidth ? width - bx * blockWidth : blockWidth;
+					memcpy(&expected[(by * blockHeight + y) * stride + bx * blockWidth * 4],
+							&texels[y * blockWidth * 4], columns * 4);
+				}
+			}
+		}
+	}
+	double blockTime = now() - start;
+
+	std::vector<uint8_t> actual((size_t) stride * height);
+	start = now();
+	for (int r = 0; r < rounds; r++)
+		astc_decode_image(&data[0], &actual[0], width, height, blockWidth, blockHeight, stride);
+	double imageTime = now() - start;
+
+	bool same = actual == expected;
+	double pixels = (double) width * height * rounds / 1e6;
+	printf("image %4ux%-4u  blocks %8.1f MPixels/s  image %8.1f MPixels/s  %s\n", width, height,
+			pixels / blockTime, pixels / imageTime, same ? "identical" : "MISMATCH");
+	return same;
+}
+
+int main(int argc, char** argv)
+{
+	srand(1);
+	bool ok = true;
+	ok = testVoidExtent(4, 4) && ok;
+	ok = testVoidExtent(12, 12) && ok;
+	ok = testSinglePartition() && ok;
+	ok = testDualPlane(4, 4) && ok;
+	ok = testDualPlane(8, 6) && ok;
+	ok = testTwoPartitions(5) && ok;
+	ok = testTwoPartitions(361) && ok;
+	ok = testTwoPartitions(1023) && ok;
+	ok = testErrorBlock() && ok;
+	ok = testImage(1024, 1024, 4) && ok;
+	ok = testImage(1023, 577, 4) && ok;
+	return ok ? 0 : 1;
+}
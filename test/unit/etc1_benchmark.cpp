@@ -0,0 +1,175 @@
+#include "core/opengl/texture/etc1.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Decodes random ETC1 data with etc1_decode_image and with the per-pixel
+// reference decoder, checks that both give the same bytes and prints the
+// throughput of each in MPixels/s. Then encodes a test image with each
+// quality preset and prints speed and PSNR.
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void decodeReference(const etc1_byte* in, etc1_byte* out,
+		etc1_uint32 width, etc1_uint32 height, etc1_uint32 pixelSize, etc1_uint32 stride)
+{
+	etc1_byte block[ETC1_DECODED_BLOCK_SIZE];
+	for (etc1_uint32 y = 0; y < height; y += 4)
+	{
+		etc1_uint32 yEnd = height - y < 4 ? height - y : 4;
+		for (etc1_uint32 x = 0; x < width; x += 4)
+		{
+			etc1_uint32 xEnd = width - x < 4 ? width - x : 4;
+			etc1_decode_block_scalar(in, block);
+			in += ETC1_ENCODED_BLOCK_SIZE;
+			for (etc1_uint32 cy = 0; cy < yEnd; cy++)
+			{
+				const etc1_byte* q = block + cy * 4 * 3;
+				etc1_byte* p = out + pixelSize * x + stride * (y + cy);
+				for (etc1_uint32 cx = 0; cx < xEnd; cx++, q += 3)
+				{
+					if (pixelSize == 3)
+					{
+						*p++ = q[0];
+						*p++ = q[1];
+						*p++ = q[2];
+					}
+					else
+					{
+						etc1_uint32 pixel = ((q[0] >> 3) << 11) | ((q[1] >> 2) << 5) | (q[2] >> 3);
+						*p++ = (etc1_byte) pixel;
+						*p++ = (etc1_byte) (pixel >> 8);
+					}
+				}
+			}
+		}
+	}
+}
+
+static bool run(etc1_uint32 width, etc1_uint32 height, etc1_uint32 pixelSize, int rounds)
+{
+	etc1_uint32 size = etc1_get_encoded_data_size(width, height);
+	etc1_uint32 stride = width * pixelSize;
+	etc1_byte* in = (etc1_byte*) malloc(size);
+	etc1_byte* fast = (etc1_byte*) malloc(stride * height);
+	etc1_byte* slow = (etc1_byte*) malloc(stride * height);
+
+	for (etc1_uint32 i = 0; i < size; i++)
+		in[i] = (etc1_byte) rand();
+
+	double start = now();
+	for (int i = 0; i < rounds; i++)
+		decodeReference(in, slow, width, height, pixelSize, stride);
+	double slowTime = now() - start;
+
+	start = now();
+	for (int i = 0; i < rounds; i++)
+		etc1_decode_image(in, fast, width, height, pixelSize, stride);
+	double fastTime = now() - start;
+
+	bool same = memcmp(fast, slow, stride * height) == 0;
+	double pixels = (double) width * height * rounds / 1e6;
+	printf("%ux%u %s: reference %.1f MPixels/s, decoder %.1f MPixels/s, %s\n",
+			width, height, pixelSize == 3 ? "RGB888" : "RGB565",
+			pixels / slowTime, pixels / fastTime, same ? "identical" : "MISMATCH");
+
+	free(in);
+	free(fast);
+	free(slow);
+	return same;
+}
+
+static double psnr(const etc1_byte* a, const etc1_byte* b, etc1_uint32 size)
+{
+	double sum = 0;
+	for (etc1_uint32 i = 0; i < size; i++)
+	{
+		double d = (double) a[i] - b[i];
+		sum += d * d;
+	}
+	return sum == 0 ? 99.0 : 10.0 * log10(255.0 * 255.0 * size / sum);
+}
+
+static bool runEncode(etc1_uint32 width, etc1_uint32 height)
+{
+	static const char* kNames[] = { "fast", "normal", "exhaustive" };
+	etc1_uint32 stride = width * 3;
+	etc1_uint32 size = etc1_get_encoded_data_size(width, height);
+	etc1_byte* image = (etc1_byte*) malloc(stride * height);
+	etc1_byte* decoded = (etc1_byte*) malloc(stride * height);
+	etc1_byte* encoded = (etc1_byte*) malloc(size);
+	etc1_byte* serial = (etc1_byte*) malloc(size);
+
+	// gradients with some noise, closer to real textures than pure noise
+	for (etc1_uint32 y = 0; y < height; y++)
+	{
+		for (etc1_uint32 x = 0; x < width; x++)
+		{
+			etc1_byte* p = image + y * stride + x * 3;
+			p[0] = (etc1_byte) (x * 255 / width + rand() % 16);
+			p[1] = (etc1_byte) (y * 255 / height + rand() % 16);
+			p[2] = (etc1_byte) (((x ^ y) & 0x7f) + rand() % 16);
+		}
+	}
+
+	// the serial single-block path must match the threaded image encoder
+	etc1_byte* q = serial;
+	for (etc1_uint32 y = 0; y < height; y += 4)
+	{
+		for (etc1_uint32 x = 0; x < width; x += 4, q += ETC1_ENCODED_BLOCK_SIZE)
+		{
+			etc1_byte block[ETC1_DECODED_BLOCK_SIZE] = { 0 };
+			etc1_uint32 mask = 0;
+			for (etc1_uint32 cy = 0; cy < 4 && y + cy < height; cy++)
+				for (etc1_uint32 cx = 0; cx < 4 && x + cx < width; cx++)
+				{
+					memcpy(block + (cy * 4 + cx) * 3, image + (y + cy) * stride + (x + cx) * 3, 3);
+					mask |= 1 << (cx + cy * 4);
+				}
+			etc1_encode_block(block, mask, q);
+		}
+	}
+
+	bool ok = true;
+	for (int quality = ETC1_QUALITY_FAST; quality <= ETC1_QUALITY_EXHAUSTIVE; quality++)
+	{
+		double start = now();
+		etc1_encode_image_quality(image, width, height, 3, stride, encoded, (etc1_quality) quality);
+		double time = now() - start;
+		etc1_decode_image(encoded, decoded, width, height, 3, stride);
+		printf("%ux%u encode %s: %.2f MPixels/s, PSNR %.2f dB\n", width, height, kNames[quality],
+				(double) width * height / 1e6 / time, psnr(image, decoded, stride * height));
+		if (quality == ETC1_QUALITY_NORMAL && memcmp(encoded, serial, size) != 0)
+		{
+			printf("threaded encode differs from etc1_encode_block\n");
+			ok = false;
+		}
+	}
+
+	free(image);
+	free(decoded);
+	free(encoded);
+	free(serial);
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	int rounds = argc > 1 ? atoi(argv[1]) : 20;
+	bool ok = true;
+	ok &= run(1024, 1024, 3, rounds);
+	ok &= run(1024, 1024, 2, rounds);
+	ok &= run(1023, 509, 3, 1);
+	ok &= run(1023, 509, 2, 1);
+	ok &= runEncode(512, 512);
+	ok &= runEncode(255, 129);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,489 @@
+#include "core/opengl/texture/etc2.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Decodes ETC2 blocks built bit by bit from appendix C of the OpenGL ES
+// 3.0 specification and checks every pixel against the value the
+// specification gives: an individual and a flipped differential block,
+// a T block, H blocks in both color orders, a planar block, punch-through
+// blocks whose index 2 pixels are transparent, and an EAC alpha block
+// with each of the 16 multipliers. The mode bits that are not part of a
+// T, H or planar block are set so that the right channel overflows. Then
+// images are encoded in each format and quality with etc2_encode_image,
+// decoded with etc2_decode_image, and the PSNR has to stay above a floor.
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 64 bits, bit 63 is the top bit of byte 0
+struct Block
+{
+	uint64_t bits;
+
+	Block() : bits(0) {}
+
+	void write(int lsb, int count, uint32_t value)
+	{
+		uint64_t mask = ((1ull << count) - 1) << lsb;
+		bits = (bits & ~mask) | (((uint64_t) value << lsb) & mask);
+	}
+
+	// indices[x + 4 * y], lsb at bit y + 4 * x, msb 16 bits higher
+	void writeIndices(const int* indices)
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			int k = (i >> 2) + 4 * (i & 3);
+			write(k, 1, indices[i] & 1);
+			write(k + 16, 1, indices[i] >> 1);
+		}
+	}
+
+	void store(etc1_byte* out) const
+	{
+		for (int i = 0; i < 8; i++)
+			out[i] = (etc1_byte) (bits >> (56 - 8 * i));
+	}
+};
+
+static const int kIndices[16] = { 0, 1, 2, 3, 3, 2, 1, 0, 1, 3, 0, 2, 2, 0, 3, 1 };
+
+// the intensity modifiers for index 0 (+a) and 1 (+b), 2 and 3 are -a, -b
+static const int kIntensity[8][2] =
+{
+	{ 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 }
+};
+
+static const int kAlphaTable[16][8] =
+{
+	{ -3, -6, -9, -15, 2, 5, 8, 14 },
+	{ -3, -7, -10, -13, 2, 6, 9, 12 },
+	{ -2, -5, -8, -13, 1, 4, 7, 12 },
+	{ -2, -4, -6, -13, 1, 3, 5, 12 },
+	{ -3, -6, -8, -12, 2, 5, 7, 11 },
+	{ -3, -7, -9, -11, 2, 6, 8, 10 },
+	{ -4, -7, -8, -11, 3, 6, 7, 10 },
+	{ -3, -5, -8, -11, 2, 4, 7, 10 },
+	{ -2, -6, -8, -10, 1, 5, 7, 9 },
+	{ -2, -5, -8, -10, 1, 4, 7, 9 },
+	{ -2, -4, -8, -10, 1, 3, 7, 9 },
+	{ -2, -5, -7, -10, 1, 4, 6, 9 },
+	{ -3, -4, -7, -10, 2, 3, 6, 9 },
+	{ -1, -2, -3, -10, 0, 1, 2, 9 },
+	{ -4, -6, -8, -9, 3, 5, 7, 8 },
+	{ -3, -5, -7, -9, 2, 4, 6, 8 }
+};
+
+static int clamp255(int value)
+{
+	return value < 0 ? 0 : value > 255 ? 255 : value;
+}
+
+static void setPixel(etc1_byte* out, int i, int r, int g, int b, int a)
+{
+	out[i * 4] = (etc1_byte) clamp255(r);
+	out[i * 4 + 1] = (etc1_byte) clamp255(g);
+	out[i * 4 + 2] = (etc1_byte) clamp255(b);
+	out[i * 4 + 3] = (etc1_byte) a;
+}
+
+// individual and differential blocks: the base color of the sub-block
+// plus its modifier. Punch-through without the opaque bit has no +a and
+// makes index 2 transparent.
+static void expectSubBlocks(const int* base1, int table1, const int* base2, int table2, bool flip,
+		bool transparent, etc1_byte* expected)
+{
+	for (int i = 0; i < 16; i++)
+	{
+		int x = i & 3;
+		int y = i >> 2;
+		bool second = flip ? y >= 2 : x >= 2;
+		const int* base = second ? base2 : base1;
+		int index = kIndices[i];
+		int modifier = kIntensity[second ? table2 : table1][index & 1] * (index >= 2 ? -1 : 1);
+		if (transparent && index == 0)
+			modifier = 0;
+		if (transparent && index == 2)
+			setPixel(expected, i, 0, 0, 0, 0);
+		else
+			setPixel(expected, i, base[0] + modifier, base[1] + modifier, base[2] + modifier, 255);
+	}
+}
+
+// T and H blocks: the index picks one of the four paint colors
+static void expectPaint(const int (*paint)[3], bool transparent, etc1_byte* expected)
+{
+	for (int i = 0; i < 16; i++)
+	{
+		const int* c = paint[kIndices[i]];
+		if (transparent && kIndices[i] == 2)
+			setPixel(expected, i, 0, 0, 0, 0);
+		else
+			setPixel(expected, i, c[0], c[1], c[2], 255);
+	}
+}
+
+static bool check(const char* name, etc2_format format, const etc1_byte* block, const etc1_byte* expected)
+{
+	etc1_byte actual[ETC2_DECODED_BLOCK_SIZE];
+	etc2_decode_block(format, block, actual);
+	bool same = memcmp(actual, expected, sizeof(actual)) == 0;
+	printf("%-24s %s\n", name, same ? "ok" : "MISMATCH");
+	for (int i = 0; i < 16 && !same; i++)
+	{
+		const etc1_byte* a = actual + i * 4;
+		const etc1_byte* e = expected + i * 4;
+		if (memcmp(a, e, 4) != 0)
+		{
+			printf("  pixel %d,%d: %d %d %d %d, expected %d %d %d %d\n", i & 3, i >> 2,
+					a[0], a[1], a[2], a[3], e[0], e[1], e[2], e[3]);
+			break;
+		}
+	}
+	return same;
+}
+
+// R 8 G 4 B 12 and R 2 G 15 B 0, 4 bits each, tables 3 and 6
+static Block individualBlock()
+{
+	Block block;
+	block.write(60, 4, 0x8);
+	block.write(56, 4, 0x2);
+	block.write(52, 4, 0x4);
+	block.write(48, 4, 0xf);
+	block.write(44, 4, 0xc);
+	block.write(40, 4, 0x0);
+	block.write(37, 3, 3);
+	block.write(34, 3, 6);
+	block.writeIndices(kIndices);
+	return block;
+}
+
+// R 20 G 10 B 31, 5 bits each, deltas -4 +3 0, tables 0 and 7, flipped.
+// opaque is the diff bit, punch-through reads every block as differential
+static Block differentialBlock(bool opaque)
+{
+	Block block;
+	block.write(59, 5, 20);
+	block.write(56, 3, 4);
+	block.write(51, 5, 10);
+	block.write(48, 3, 3);
+	block.write(43, 5, 31);
+	block.write(40, 3, 0);
+	block.write(37, 3, 0);
+	block.write(34, 3, 7);
+	block.write(33, 1, opaque ? 1 : 0);
+	block.write(32, 1, 1);
+	block.writeIndices(kIndices);
+	return block;
+}
+
+// R1 is split around the dR field; bits 63..61 and 58 make R + dR
+// overflow: R = hi, dR = lo - 4 when hi + lo < 4, else R = 28 + hi, dR = lo
+static Block tBlock(int r1, int g1, int b1, int r2, int g2, int b2, int distance, bool opaque)
+{
+	Block block;
+	bool low = (r1 >> 2) + (r1 & 3) < 4;
+	block.write(61, 3, low ? 0 : 7);
+	block.write(59, 2, r1 >> 2);
+	block.write(58, 1, low ? 1 : 0);
+	block.write(56, 2, r1 & 3);
+	block.write(52, 4, g1);
+	block.write(48, 4, b1);
+	block.write(44, 4, r2);
+	block.write(40, 4, g2);
+	block.write(36, 4, b2);
+	block.write(34, 2, distance >> 1);
+	block.write(33, 1, opaque ? 1 : 0);
+	block.write(32, 1, distance & 1);
+	block.writeIndices(kIndices);
+	return block;
+}
+
+// bit 63 keeps R + dR in range, bits 55..53 and 50 make G + dG overflow.
+// The lowest bit of the distance index is the order of the two colors.
+static Block hBlock(int r1, int g1, int b1, int r2, int g2, int b2, int distance)
+{
+	Block block;
+	int g = (g1 & 1) * 2 + (b1 >> 3);
+	bool low = g + ((b1 >> 1) & 3) < 4;
+	block.write(63, 1, r1 < 8 ? 1 : 0);
+	block.write(59, 4, r1);
+	block.write(56, 3, g1 >> 1);
+	block.write(53, 3, low ? 0 : 7);
+	block.write(52, 1, g1 & 1);
+	block.write(51, 1, b1 >> 3);
+	block.write(50, 1, low ? 1 : 0);
+	block.write(47, 3, b1 & 7);
+	block.write(43, 4, r2);
+	block.write(39, 4, g2);
+	block.write(35, 4, b2);
+	block.write(34, 1, distance >> 2);
+	block.write(33, 1, 1);
+	block.write(32, 1, (distance >> 1) & 1);
+	block.writeIndices(kIndices);
+	return block;
+}
+
+// 6, 7 and 6 bits per channel. Bits 63 and 55 keep R + dR and G + dG in
+// range, bits 47..45 and 42 make B + dB overflow.
+static Block planarBlock(const int* o, const int* h, const int* v)
+{
+	Block block;
+	int hi = (o[2] >> 3) & 3;
+	bool low = hi + ((o[2] >> 1) & 3) < 4;
+	block.write(63, 1, (o[0] >> 2) < 8 ? 1 : 0);
+	block.write(57, 6, o[0]);
+	block.write(56, 1, o[1] >> 6);
+	block.write(55, 1, ((o[1] >> 2) & 15) < 8 ? 1 : 0);
+	block.write(49, 6, o[1] & 63);
+	block.write(48, 1, o[2] >> 5);
+	block.write(45, 3, low ? 0 : 7);
+	block.write(43, 2, hi);
+	block.write(42, 1, low ? 1 : 0);
+	block.write(39, 3, o[2] & 7);
+	block.write(34, 5, h[0] >> 1);
+	block.write(33, 1, 1);
+	block.write(32, 1, h[0] & 1);
+	block.write(25, 7, h[1]);
+	block.write(19, 6, h[2]);
+	block.write(13, 6, v[0]);
+	block.write(6, 7, v[1]);
+	block.write(0, 6, v[2]);
+	return block;
+}
+
+static bool testIndividual()
+{
+	static const int base1[3] = { 136, 68, 204 };
+	static const int base2[3] = { 34, 255, 0 };
+	etc1_byte in[8];
+	etc1_byte expected[ETC2_DECODED_BLOCK_SIZE];
+	individualBlock().store(in);
+	expectSubBlocks(base1, 3, base2, 6, false, false, expected);
+	return check("individual", ETC2_FORMAT_RGB8, in, expected);
+}
+
+static bool testDifferential()
+{
+	static const int base1[3] = { 165, 82, 255 };
+	static const int base2[3] = { 132, 107, 255 };
+	etc1_byte in[8];
+	etc1_byte expected[ETC2_DECODED_BLOCK_SIZE];
+	differentialBlock(true).store(in);
+	expectSubBlocks(base1, 0, base2, 7, true, false, expected);
+	return check("differential, flipped", ETC2_FORMAT_RGB8, in, expected);
+}
+
+// distance 5 is 32, the last paint color clamps
+static const int kTPaint[4][3] = { { 187, 51, 238 }, { 134, 185, 49 }, { 102, 153, 17 }, { 70, 121, 0 } };
+
+static bool testT()
+{
+	etc1_byte in[8];
+	etc1_byte expected[ETC2_DECODED_BLOCK_SIZE];
+	tBlock(0xb, 0x3, 0xe, 0x6, 0x9, 0x1, 5, true).store(in);
+	expectPaint(kTPaint, false, expected);
+	return check("T", ETC2_FORMAT_RGB8, in, expected);
+}
+
+static bool testH()
+{
+	// 0x4a6 < 0xc27: order 0, distance 4 is 23
+	static const int paint[4][3] = { { 91, 193, 125 }, { 45, 147, 79 }, { 227, 57, 142 }, { 181, 11, 96 } };
+	// the same colors swapped: order 1, distance 5 is 32
+	static const int swapped[4][3] = { { 236, 66, 151 }, { 172, 2, 87 }, { 100, 202, 134 }, { 36, 138, 70 } };
+	etc1_byte in[8];
+	etc1_byte expected[ETC2_DECODED_BLOCK_SIZE];
+	hBlock(0x4, 0xa, 0x6, 0xc, 0x2, 0x7, 4).store(in);
+	expectPaint(paint, false, expected);
+	bool ok = check("H", ETC2_FORMAT_RGB8, in, expected);
+	hBlock(0xc, 0x2, 0x7, 0x4, 0xa, 0x6, 4).store(in);
+	expectPaint(swapped, false, expected);
+	return check("H, colors swapped", ETC2_FORMAT_RGB8, in, expected) && ok;
+}
+
+static bool testPlanar()
+{
+	static const int o[3] = { 63, 0, 21 };
+	static const int h[3] = { 0, 127, 42 };
+	static const int v[3] = { 32, 64, 10 };
+	// the same widened to 8 bits
+	static const int o8[3] = { 255, 0, 85 };
+	static const int h8[3] = { 0, 255, 170 };
+	static const int v8[3] = { 130, 129, 40 };
+	etc1_byte in[8];
+	etc1_byte expected[ETC2_DECODED_BLOCK_SIZE];
+	planarBlock(o, h, v).store(in);
+	for (int i = 0; i < 16; i++)
+	{
+		int x = i & 3;
+		int y = i >> 2;
+		int c[3];
+		for (int k = 0; k < 3; k++)
+			c[k] = (x * (h8[k] - o8[k]) + y * (v8[k] - o8[k]) + 4 * o8[k] + 2) >> 2;
+		setPixel(expected, i, c[0], c[1], c[2], 255);
+	}
+	return check("planar", ETC2_FORMAT_RGB8, in, expected);
+}
+
+static bool testPunchThrough()
+{
+	static const int base1[3] = { 165, 82, 255 };
+	static const int base2[3] = { 132, 107, 255 };
+	etc1_byte in[8];
+	etc1_byte expected[ETC2_DECODED_BLOCK_SIZE];
+	differentialBlock(true).store(in);
+	expectSubBlocks(base1, 0, base2, 7, true, false, expected);
+	bool ok = check("punch-through, opaque", ETC2_FORMAT_RGB8A1, in, expected);
+	differentialBlock(false).store(in);
+	expectSubBlocks(base1, 0, base2, 7, true, true, expected);
+	ok = check("punch-through", ETC2_FORMAT_RGB8A1, in, expected) && ok;
+	tBlock(0xb, 0x3, 0xe, 0x6, 0x9, 0x1, 5, false).store(in);
+	expectPaint(kTPaint, true, expected);
+	return check("punch-through T", ETC2_FORMAT_RGB8A1, in, expected) && ok;
+}
+
+// the alpha block in front of the individual color block
+static bool testEAC(int multiplier)
+{
+	static const int base1[3] = { 136, 68, 204 };
+	static const int base2[3] = { 34, 255, 0 };
+	int table = 15 - multiplier;
+	int base = (multiplier * 97 + 30) & 255;
+	etc1_byte in[16];
+	etc1_byte expected[ETC2_DECODED_BLOCK_SIZE];
+	in[0] = (etc1_byte) base;
+	in[1] = (etc1_byte) (multiplier << 4 | table);
+	// pixel (x, y) is the 3 bits at 45 - 3 * (y + 4 * x)
+	uint64_t indices = 0;
+	int alphas[16];
+	for (int i = 0; i < 16; i++)
+	{
+		int index = (i * 3 + multiplier) & 7;
+		indices |= (uint64_t) index << (45 - 3 * i);
+		alphas[(i >> 2) + 4 * (i & 3)] = clamp255(base + kAlphaTable[table][index] * multiplier);
+	}
+	for (int i = 0; i < 6; i++)
+		in[2 + i] = (etc1_byte) (indices >> (40 - 8 * i));
+	individualBlock().store(in + 8);
+	expectSubBlocks(base1, 3, base2, 6, false, false, expected);
+	for (int i = 0; i < 16; i++)
+		expected[i * 4 + 3] = (etc1_byte) alphas[i];
+	char name[32];
+	snprintf(name, sizeof(name), "EAC multiplier %d", multiplier);
+	return check(name, ETC2_FORMAT_RGBA8, in, expected);
+}
+
+// over RGB, and alpha where the format has it; for punch-through the
+// transparent pixels have to match exactly and only the others count
+static double psnr(etc2_format format, const etc1_byte* a, const etc1_byte* b, etc1_uint32 pixels, etc1_uint32* alphaErrors)
+{
+	double sum = 0;
+	double count = 0;
+	*alphaErrors = 0;
+	for (etc1_uint32 i = 0; i < pixels; i++, a += 4, b += 4)
+	{
+		if (format == ETC2_FORMAT_RGB8A1)
+		{
+			bool transparent = a[3] < 128;
+			if (transparent != (b[3] == 0))
+				(*alphaErrors)++;
+			if (transparent)
+				continue;
+		}
+		int channels = format == ETC2_FORMAT_RGBA8 ? 4 : 3;
+		for (int c = 0; c < channels; c++)
+		{
+			double d = (double) a[c] - b[c];
+			sum += d * d;
+		}
+		count += channels;
+	}
+	return sum == 0 ? 99.0 : 10.0 * log10(255.0 * 255.0 * count / sum);
+}
+
+static bool runEncode(etc2_format format, etc1_uint32 width, etc1_uint32 height, double floor)
+{
+	static const char* kFormats[] = { "RGB8", "RGBA8", "RGB8A1" };
+	static const char* kQualities[] = { "fast", "normal", "exhaustive" };
+	etc1_uint32 stride = width * 4;
+	etc1_byte* image = (etc1_byte*) malloc(stride * height);
+	etc1_byte* decoded = (etc1_byte*) malloc(stride * height);
+	etc1_byte* encoded = (etc1_byte*) malloc(etc2_get_encoded_data_size(format, width, height));
+
+	// gradients with some noise, kept below 256, a smooth alpha ramp and a
+	// hard edged disc
+	for (etc1_uint32 y = 0; y < height; y++)
+	{
+		for (etc1_uint32 x = 0; x < width; x++)
+		{
+			etc1_byte* p = image + y * stride + x * 4;
+			p[0] = (etc1_byte) (x * 240 / width + rand() % 16);
+			p[1] = (etc1_byte) (y * 240 / height + rand() % 16);
+			p[2] = (etc1_byte) (((x ^ y) & 0x7f) + rand() % 16);
+			if (format == ETC2_FORMAT_RGB8A1)
+			{
+				int dx = (int) x - (int) width / 2;
+				int dy = (int) y - (int) height / 2;
+				p[3] = dx * dx + dy * dy < (int) (width * height / 8) ? 255 : 0;
+			}
+			else
+			{
+				p[3] = (etc1_byte) ((x + y) * 255 / (width + height));
+			}
+		}
+	}
+
+	bool ok = true;
+	for (int quality = ETC1_QUALITY_FAST; quality <= ETC1_QUALITY_EXHAUSTIVE; quality++)
+	{
+		double start = now();
+		int encodeResult = etc2_encode_image(format, image, width, height, 4, stride, encoded, (etc1_quality) quality);
+		double time = now() - start;
+		int decodeResult = etc2_decode_image(format, encoded, decoded, width, height, 4, stride);
+		etc1_uint32 alphaErrors;
+		double value = psnr(format, image, decoded, width * height, &alphaErrors);
+		bool good = encodeResult == 0 && decodeResult == 0 && alphaErrors == 0 && value >= floor;
+		printf("%ux%u %s encode %s: %.2f MPixels/s, PSNR %.2f dB, %s\n", width, height, kFormats[format],
+				kQualities[quality], (double) width * height / 1e6 / time, value, good ? "ok" : "BAD");
+		if (alphaErrors != 0)
+			printf("  %u pixels with the wrong transparency\n", alphaErrors);
+		ok = good && ok;
+	}
+
+	free(image);
+	free(decoded);
+	free(encoded);
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	srand(1);
+	bool ok = true;
+	ok &= testIndividual();
+	ok &= testDifferential();
+	ok &= testT();
+	ok &= testH();
+	ok &= testPlanar();
+	ok &= testPunchThrough();
+	for (int multiplier = 0; multiplier < 16; multiplier++)
+		ok &= testEAC(multiplier);
+	ok &= runEncode(ETC2_FORMAT_RGB8, 512, 512, 30.0);
+	ok &= runEncode(ETC2_FORMAT_RGBA8, 512, 512, 30.0);
+	ok &= runEncode(ETC2_FORMAT_RGB8A1, 512, 512, 30.0);
+	ok &= runEncode(ETC2_FORMAT_RGB8, 255, 129, 30.0);
+	ok &= runEncode(ETC2_FORMAT_RGBA8, 255, 129, 30.0);
+	ok &= runEncode(ETC2_FORMAT_RGB8A1, 255, 129, 30.0);
+	return ok ? 0 : 1;
+}
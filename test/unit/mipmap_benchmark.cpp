@@ -0,0 +1,239 @@
+#include "tool/utility/TexUtils.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+using namespace flakor;
+
+// Builds mipmap chains with TexUtils::buildMipmaps. A POT RGBA image is
+// checked against a per-pixel 2x2 reference, byte for byte. NPOT levels
+// in every format are checked against an exact area average of the level
+// above, within one step. Kaiser must keep flat images flat, and the gamma
+// correct mode must average a black and white checker to the sRGB value of
+// half the light. The throughput of each is printed in MPixels/s of level
+// 0.
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static const char* name(PixelFormat format)
+{
+	switch (format)
+	{
+		case PixelFormat::RGBA8888: return "RGBA8888";
+		case PixelFormat::RGB888: return "RGB888";
+		case PixelFormat::AI88: return "AI88";
+		case PixelFormat::A8: return "A8";
+		default: return "?";
+	}
+}
+
+// Noise on top of gradients, like a photo.
+static std::vector<unsigned char> makeImage(int width, int height, int channels)
+{
+	std::vector<unsigned char> pixels((size_t) width * height * channels);
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++)
+			for (int c = 0; c < channels; c++)
+				pixels[((size_t) y * width + x) * channels + c] =
+						(unsigned char) ((x * (c + 1) + y * 3) / 4 + (rand() & 31));
+	return pixels;
+}
+
+static void halveReference(const unsigned char* in, int width, int height, int channels, unsigned char* out)
+{
+	int w = width / 2;
+	int h = height / 2;
+	for (int y = 0; y < h; y++)
+		for (int x = 0; x < w; x++)
+			for (int c = 0; c < channels; c++)
+			{
+				const unsigned char* p = in + ((size_t) y * 2 * width + x * 2) * channels + c;
+				int sum = p[0] + p[channels] + p[(size_t) width * channels] + p[(size_t) width * channels + channels];
+				out[((size_t) y * w + x) * channels + c] = (unsigned char) ((sum + 2) >> 2);
+			}
+}
+
+static double overlap(double begin, double end, int j)
+{
+	double lo = begin > j ? begin : j;
+	double hi = end < j + 1 ? end : j + 1;
+	return hi > lo ? hi - lo : 0.0;
+}
+
+// the largest difference from an exact area average of the level above
+static int compareArea(const unsigned char* in, int width, int height, const unsigned char* out,
+		int w, int h, int channels)
+{
+	double sx = (double) width / w;
+	double sy = (double) height / h;
+	int worst = 0;
+	for (int y = 0; y < h; y++)
+		for (int x = 0; x < w; x++)
+			for (int c = 0; c < channels; c++)
+			{
+				double sum = 0.0;
+				double area = 0.0;
+				for (int j = (int) (y * sy); j < height && j < (y + 1) * sy; j++)
+					for (int i = (int) (x * sx); i < width && i < (x + 1) * sx; i++)
+					{
+						double a = overlap(y * sy, (y + 1) * sy, j) * overlap(x * sx, (x + 1) * sx, i);
+						sum += a * in[((size_t) j * width + i) * channels + c];
+						area += a;
+					}
+				int expected = (int) (sum / area + 0.5);
+				int diff = abs(expected - out[((size_t) y * w + x) * channels + c]);
+				if (diff > worst)
+					worst = diff;
+			}
+	return worst;
+}
+
+static bool runPOT(int size, int rounds)
+{
+	int count = TexUtils::getMipmapCount(size, size);
+	std::vector<unsigned char> pixels = makeImage(size, size, 4);
+	std::vector<unsigned char> chain(TexUtils::getMipmapChainSize(size, size, PixelFormat::RGBA8888, count));
+	std::vector<unsigned char> expected(chain.size());
+
+	double start = now();
+	for (int r = 0; r < rounds; r++)
+	{
+		const unsigned char* in = &pixels[0];
+		unsigned char* out = &expected[0];
+		for (int s = size; s > 1; s /= 2)
+		{
+			halveReference(in, s, s, 4, out);
+			in = out;
+			out += (size_t) (s / 2) * (s / 2) * 4;
+		}
+	}
+	double referenceTime = now() - start;
+
+	start = now();
+	bool ok = true;
+	for (int r = 0; r < rounds; r++)
+		ok &= TexUtils::buildMipmaps(&pixels[0], size, size, PixelFormat::RGBA8888, count,
+				TexUtils::MipmapFilter::BOX, false, &chain[0]);
+	double time = now() - start;
+
+	ok &= chain == expected;
+	double mpixels = (double) size * size * rounds / 1e6;
+	printf("%dx%d RGBA8888 box, %d levels: reference %7.1f MPixels/s, buildMipmaps %7.1f MPixels/s%s\n",
+			size, size, count, mpixels / referenceTime, mpixels / time, ok ? "" : "  MISMATCH");
+	return ok;
+}
+
+static bool runNPOT(int width, int height, PixelFormat format, int channels, TexUtils::MipmapFilter filter,
+		int rounds)
+{
+	bool box = filter == TexUtils::MipmapFilter::BOX;
+	int count = TexUtils::getMipmapCount(width, height);
+	std::vector<unsigned char> pixels = makeImage(width, height, channels);
+	std::vector<unsigned char> chain(TexUtils::getMipmapChainSize(width, height, format, count));
+
+	double start = now();
+	bool ok = true;
+	for (int r = 0; r < rounds; r++)
+		ok &= TexUtils::buildMipmaps(&pixels[0], width, height, format, count, filter, false, &chain[0]);
+	double time = now() - start;
+
+	// the chain ends in 1x1 and each level comes from the one above
+	const unsigned char* in = &pixels[0];
+	const unsigned char* out = &chain[0];
+	int w = width;
+	int h = height;
+	int worst = 0;
+	for (int i = 1; i < count; i++)
+	{
+		int lw = w > 1 ? w / 2 : 1;
+		int lh = h > 1 ? h / 2 : 1;
+		if (box)
+		{
+			int diff = compareArea(in, w, h, out, lw, lh, channels);
+			worst = diff > worst ? diff : worst;
+		}
+		in = out;
+		out += (size_t) lw * lh * channels;
+		w = lw;
+		h = lh;
+	}
+	ok &= w == 1 && h == 1 && out == &chain[0] + chain.size();
+	ok &= worst <= 1;
+
+	double mpixels = (double) width * height * rounds / 1e6;
+	printf("%dx%d %-8s %-6s %2d levels: buildMipmaps %7.1f MPixels/s%s\n", width, height, name(format),
+			box ? "box" : "kaiser", count, mpixels / time, ok ? "" : "  MISMATCH");
+	return ok;
+}
+
+// flat stays flat, the kaiser weights sum to one at every size
+static bool runFlat()
+{
+	int width = 999;
+	int height = 333;
+	int count = TexUtils::getMipmapCount(width, height);
+	std::vector<unsigned char> pixels((size_t) width * height * 4, 77);
+	std::vector<unsigned char> chain(TexUtils::getMipmapChainSize(width, height, PixelFormat::RGBA8888, count));
+	bool ok = true;
+	for (int gamma = 0; gamma < 2; gamma++)
+	{
+		TexUtils::buildMipmaps(&pixels[0], width, height, PixelFormat::RGBA8888, count,
+				TexUtils::MipmapFilter::KAISER, gamma != 0, &chain[0]);
+		for (size_t i = 0; i < chain.size(); i++)
+			ok &= abs(chain[i] - 77) <= 1;
+	}
+	printf("flat image kaiser%s\n", ok ? " stays flat" : "  NOT FLAT");
+	return ok;
+}
+
+// a one pixel checker of black and white is half the light: 188 in sRGB
+// when filtered in linear light, 128 (too dark) when not
+static bool runGamma()
+{
+	int size = 64;
+	std::vector<unsigned char> pixels((size_t) size * size * 4);
+	for (int y = 0; y < size; y++)
+		for (int x = 0; x < size; x++)
+		{
+			unsigned char* p = &pixels[((size_t) y * size + x) * 4];
+			p[0] = p[1] = p[2] = ((x + y) & 1) ? 255 : 0;
+			p[3] = ((x + y) & 1) ? 255 : 0;
+		}
+	std::vector<unsigned char> chain(TexUtils::getMipmapChainSize(size, size, PixelFormat::RGBA8888, 2));
+	bool ok = true;
+	for (int gamma = 0; gamma < 2; gamma++)
+	{
+		TexUtils::buildMipmaps(&pixels[0], size, size, PixelFormat::RGBA8888, 2, TexUtils::MipmapFilter::BOX,
+				gamma != 0, &chain[0]);
+		int color = gamma ? 188 : 128;
+		for (size_t i = 0; i < chain.size(); i += 4)
+			ok &= abs(chain[i] - color) <= 1 && abs(chain[i + 3] - 128) <= 1;
+	}
+	printf("checker averages%s\n", ok ? " to half the light in linear mode" : "  WRONG");
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	int rounds = argc > 1 ? atoi(argv[1]) : 5;
+
+	bool ok = true;
+	ok &= runPOT(2048, rounds);
+	ok &= runNPOT(1366, 768, PixelFormat::RGBA8888, 4, TexUtils::MipmapFilter::BOX, rounds);
+	ok &= runNPOT(1366, 768, PixelFormat::RGBA8888, 4, TexUtils::MipmapFilter::KAISER, rounds);
+	ok &= runNPOT(1001, 77, PixelFormat::RGB888, 3, TexUtils::MipmapFilter::BOX, 1);
+	ok &= runNPOT(3, 513, PixelFormat::AI88, 2, TexUtils::MipmapFilter::BOX, 1);
+	ok &= runNPOT(257, 255, PixelFormat::A8, 1, TexUtils::MipmapFilter::BOX, 1);
+	ok &= runFlat();
+	ok &= runGamma();
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,192 @@
+#include "tool/utility/PngWriter.h"
+
+#include <png.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+using namespace flakor;
+
+// Encodes screenshot like images with PngWriter, in both modes, and with
+// libpng on one thread the way Image::saveImageToPNG did before. Every
+// PngWriter file is decoded again with libpng and compared to the source
+// pixels. Prints MPixels/s and file size of each.
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// A game frame: gradient sky, flat UI panels, noisy terrain.
+static std::vector<unsigned char> makeImage(int width, int height, int components)
+{
+	std::vector<unsigned char> pixels((size_t) width * height * components);
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++)
+		{
+			unsigned char* p = &pixels[((size_t) y * width + x) * components];
+			bool panel = (x % 480) < 200 && (y % 270) < 60;
+			for (int c = 0; c < components; c++)
+			{
+				if (c == 3)
+					p[c] = panel ? 200 : 255;
+				else if (panel)
+					p[c] = (unsigned char) (40 + c * 30);
+				else if (y < height / 2)
+					p[c] = (unsigned char) (y * 255 / height + c * 20 + x / 64);
+				else
+					p[c] = (unsigned char) ((x * 7 + y * 3) / (c + 2) + (rand() & 15));
+			}
+		}
+	return pixels;
+}
+
+struct MemoryWriter
+{
+	std::vector<unsigned char>* out;
+};
+
+static void writeData(png_structp png, png_bytep data, png_size_t length)
+{
+	MemoryWriter* writer = (MemoryWriter*) png_get_io_ptr(png);
+	writer->out->insert(writer->out->end(), data, data + length);
+}
+
+static void flushData(png_structp)
+{
+}
+
+static bool referenceEncode(const std::vector<unsigned char>& pixels, int width, int height, int components,
+		std::vector<unsigned char>* out)
+{
+	png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+	png_infop info = png_create_info_struct(png);
+	if (setjmp(png_jmpbuf(png)))
+	{
+		png_destroy_write_struct(&png, &info);
+		return false;
+	}
+	MemoryWriter writer = { out };
+	png_set_write_fn(png, &writer, writeData, flushData);
+	png_set_IHDR(png, info, width, height, 8, components == 4 ? PNG_COLOR_TYPE_RGB_ALPHA : PNG_COLOR_TYPE_RGB,
+			PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+	png_write_info(png, info);
+	std::vector<png_bytep> rows(height);
+	for (int y = 0; y < height; y++)
+		rows[y] = (png_bytep) &pixels[(size_t) y * width * components];
+	png_write_image(png, &rows[0]);
+	png_write_end(png, info);
+	png_destroy_write_struct(&png, &info);
+	return true;
+}
+
+struct MemoryReader
+{
+	const unsigned char* data;
+	size_t size;
+	size_t offset;
+};
+
+static void readData(png_structp png, png_bytep data, png_size_t length)
+{
+	MemoryReader* reader = (MemoryReader*) png_get_io_ptr(png);
+	if (reader->offset + length > reader->size)
+		png_error(png, "read past the end");
+	memcpy(data, reader->data + reader->offset, length);
+	reader->offset += length;
+}
+
+static bool decode(const std::vector<unsigned char>& file, int width, int height, int components,
+		std::vector<unsigned char>* pixels)
+{
+	png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+	png_infop info = png_create_info_struct(png);
+	if (setjmp(png_jmpbuf(png)))
+	{
+		png_destroy_read_struct(&png, &info, nullptr);
+		return false;
+	}
+	MemoryReader reader = { &file[0], file.size(), 0 };
+	png_set_read_fn(png, &reader, readData);
+	png_read_info(png, info);
+	bool ok = (int) png_get_image_width(png, info) == width && (int) png_get_image_height(png, info) == height
+			&& png_get_channels(png, info) == components;
+	if (ok)
+	{
+		pixels->resize((size_t) width * height * components);
+		std::vector<png_bytep> rows(height);
+		for (int y = 0; y < height; y++)
+			rows[y] = &(*pixels)[(size_t) y * width * components];
+		png_read_image(png, &rows[0]);
+		png_read_end(png, info);
+	}
+	png_destroy_read_struct(&png, &info, nullptr);
+	return ok;
+}
+
+// what the decoded file must hold, alpha dropped for an RGB file
+static std::vector<unsigned char> expected(const std::vector<unsigned char>& pixels, int width, int height,
+		int components, int outComponents)
+{
+	if (components == outComponents)
+		return pixels;
+	std::vector<unsigned char> out((size_t) width * height * outComponents);
+	for (size_t i = 0; i < (size_t) width * height; i++)
+		memcpy(&out[i * outComponents], &pixels[i * components], outComponents);
+	return out;
+}
+
+static bool run(int width, int height, int components, int outComponents, int rounds)
+{
+	std::vector<unsigned char> pixels = makeImage(width, height, components);
+	std::vector<unsigned char> want = expected(pixels, width, height, components, outComponents);
+	double mpixels = (double) width * height * rounds / 1e6;
+
+	std::vector<unsigned char> file;
+	double start = now();
+	for (int i = 0; i < rounds; i++)
+	{
+		file.clear();
+		referenceEncode(want, width, height, outComponents, &file);
+	}
+	double referenceTime = now() - start;
+	printf("%dx%d %d->%d libpng            %7.1f MPixels/s %8.1f KB\n", width, height, components, outComponents,
+			mpixels / referenceTime, file.size() / 1024.0);
+
+	bool ok = true;
+	for (int fast = 0; fast < 2; fast++)
+	{
+		start = now();
+		bool encoded = true;
+		for (int i = 0; i < rounds; i++)
+			encoded &= PngWriter::encode(&pixels[0], width, height, components, outComponents, fast != 0, &file);
+		double time = now() - start;
+
+		std::vector<unsigned char> decoded;
+		bool same = encoded && decode(file, width, height, outComponents, &decoded) && decoded == want;
+		printf("%dx%d %d->%d PngWriter %-7s %7.1f MPixels/s %8.1f KB%s\n", width, height, components,
+				outComponents, fast ? "fast" : "", mpixels / time, file.size() / 1024.0, same ? "" : "  MISMATCH");
+		ok &= same;
+	}
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	int rounds = argc > 1 ? atoi(argv[1]) : 5;
+
+	bool ok = true;
+	ok &= run(1920, 1080, 4, 3, rounds);
+	ok &= run(1920, 1080, 4, 4, rounds);
+	ok &= run(2048, 1536, 3, 3, rounds);
+
+	// one group, one row, groups of one row
+	ok &= run(17, 3, 4, 4, 1);
+	ok &= run(1, 1, 3, 3, 1);
+	ok &= run(100000, 2, 4, 3, 1);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,159 @@
+#include "tool/utility/RectPacker.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+
+using namespace flakor;
+
+// Packs sprite sized rectangles into 1024x1024 pages with RectPacker.
+// Every slot must lie inside the page, overlap no other and keep its
+// size, turned or not. Sorted input must fill a page past 90%. Removing
+// every other rectangle and inserting them again must fit them all, and
+// removing everything must give the whole page back. Inserts per second
+// are printed for each run.
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+struct Item
+{
+	int width;
+	int height;
+	RectPacker::Slot slot;
+	bool placed;
+};
+
+// icons, glyphs and a few larger sprites
+static std::vector<Item> makeItems(int count)
+{
+	std::vector<Item> items(count);
+	for (int i = 0; i < count; i++)
+	{
+		int large = (rand() % 10) == 0;
+		items[i].width = 8 + rand() % (large ? 120 : 40);
+		items[i].height = 8 + rand() % (large ? 120 : 40);
+		items[i].placed = false;
+	}
+	return items;
+}
+
+static bool longerSideFirst(const Item& a, const Item& b)
+{
+	int la = std::max(a.width, a.height);
+	int lb = std::max(b.width, b.height);
+	return la != lb ? la > lb : a.width * a.height > b.width * b.height;
+}
+
+// inside the page, no overlaps, the size it asked for
+static bool check(const std::vector<Item>& items, int size)
+{
+	std::vector<unsigned char> owner((size_t) size * size, 0);
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		if (!items[i].placed)
+			continue;
+		const RectPacker::Slot& s = items[i].slot;
+		int w = s.rotated ? items[i].height : items[i].width;
+		int h = s.rotated ? items[i].width : items[i].height;
+		if (s.width != w || s.height != h || s.x < 0 || s.y < 0 || s.x + s.width > size || s.y + s.height > size)
+			return false;
+		for (int y = s.y; y < s.y + s.height; y++)
+			for (int x = s.x; x < s.x + s.width; x++)
+			{
+				if (owner[(size_t) y * size + x])
+					return false;
+				owner[(size_t) y * size + x] = 1;
+			}
+	}
+	return true;
+}
+
+static int insertAll(RectPacker& packer, std::vector<Item>& items)
+{
+	int placed = 0;
+	for (size_t i = 0; i < items.size(); i++)
+		if (!items[i].placed && packer.insert(items[i].width, items[i].height, &items[i].slot))
+		{
+			items[i].placed = true;
+			placed++;
+		}
+	return placed;
+}
+
+static bool runFill(int size, bool sorted)
+{
+	std::vector<Item> items = makeItems(3000);
+	if (sorted)
+		std::sort(items.begin(), items.end(), longerSideFirst);
+
+	RectPacker packer(size, size);
+	double start = now();
+	int placed = insertAll(packer, items);
+	double time = now() - start;
+
+	bool ok = check(items, size);
+	if (sorted)
+		ok &= packer.getOccupancy() > 0.9f;
+	printf("%dx%d %-8s %4d placed, occupancy %5.1f%%, %6.0f inserts/s%s\n", size, size,
+			sorted ? "sorted" : "unsorted", placed, packer.getOccupancy() * 100.0f, items.size() / time,
+			ok ? "" : "  BAD");
+	return ok;
+}
+
+static bool runChurn(int size)
+{
+	std::vector<Item> items = makeItems(3000);
+	std::sort(items.begin(), items.end(), longerSideFirst);
+	RectPacker packer(size, size);
+	insertAll(packer, items);
+	float full = packer.getOccupancy();
+
+	int removed = 0;
+	for (size_t i = 0; i < items.size(); i += 2)
+		if (items[i].placed)
+		{
+			packer.remove(items[i].slot);
+			items[i].placed = false;
+			removed++;
+		}
+	int freeRects = packer.getFreeRectCount();
+
+	// the ones just removed fit again, in the same order
+	int reinserted = 0;
+	for (size_t i = 0; i < items.size(); i += 2)
+		if (packer.insert(items[i].width, items[i].height, &items[i].slot))
+		{
+			items[i].placed = true;
+			reinserted++;
+		}
+	bool ok = check(items, size) && reinserted >= removed;
+
+	for (size_t i = 0; i < items.size(); i++)
+		if (items[i].placed)
+			packer.remove(items[i].slot);
+	ok &= packer.getUsedArea() == 0;
+	RectPacker::Slot slot;
+	ok &= packer.insert(size, size, &slot) && slot.x == 0 && slot.y == 0;
+
+	printf("%dx%d churn: full %5.1f%%, %d removed (%d free rects), %d inserted again%s\n", size, size,
+			full * 100.0f, removed, freeRects, reinserted, ok ? "" : "  BAD");
+	return ok;
+}
+
+int main()
+{
+	srand(7);
+	bool ok = true;
+	ok &= runFill(1024, false);
+	ok &= runFill(1024, true);
+	ok &= runFill(512, true);
+	ok &= runChurn(1024);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,304 @@
+#include "core/opengl/texture/s3tc.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+// Decodes DXT1 blocks in four and three color mode, a DXT3 block and DXT5
+// blocks in both alpha modes, built by hand, and checks every pixel
+// against the values the S3TC specification gives: 565 endpoints expanded
+// by bit replication, the interpolated colors and alphas rounded down,
+// 3 bit alpha indices that cross byte boundaries. A 5x3 level checks that
+// the edge blocks are clipped and nothing is written past the image.
+// Then random images are decoded with s3tc_decode, in bands on the thread
+// pool when they are large, and with the per-pixel reference decoder
+// below, and the throughput of each is printed in MPixels/s. Build with
+// -mno-sse2 (or without NEON) to check the scalar block decoder as well.
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static const char* flagName(S3TCDecodeFlag flag)
+{
+	return flag == S3TCDecodeFlag::DXT1 ? "DXT1" : flag == S3TCDecodeFlag::DXT3 ? "DXT3" : "DXT5";
+}
+
+static int replicate(int value, int bits)
+{
+	int result = 0;
+	for (int shift = 8 - bits; shift > -bits; shift -= bits)
+		result |= shift >= 0 ? value << shift : value >> -shift;
+	return result & 255;
+}
+
+// RGBA of one pixel, straight from the specification
+static void referencePixel(const uint8_t* data, int width, int x, int y, S3TCDecodeFlag flag, uint8_t* out)
+{
+	int blockSize = flag == S3TCDecodeFlag::DXT1 ? 8 : 16;
+	const uint8_t* block = data + ((y / 4) * ((width + 3) / 4) + x / 4) * blockSize;
+	int texel = (y & 3) * 4 + (x & 3);
+
+	int alpha = 255;
+	if (flag == S3TCDecodeFlag::DXT3)
+	{
+		alpha = ((block[texel / 2] >> (texel & 1) * 4) & 15) * 17;
+	}
+	else if (flag == S3TCDecodeFlag::DXT5)
+	{
+		int a0 = block[0];
+		int a1 = block[1];
+		int bit = 16 + texel * 3;
+		int code = 0;
+		for (int i = 0; i < 3; i++, bit++)
+			code |= ((block[bit / 8] >> (bit & 7)) & 1) << i;
+		if (code == 0)
+			alpha = a0;
+		else if (code == 1)
+			alpha = a1;
+		else if (a0 > a1)
+			alpha = ((8 - code) * a0 + (code - 1) * a1) / 7;
+		else if (code < 6)
+			alpha = ((6 - code) * a0 + (code - 1) * a1) / 5;
+		else
+			alpha = code == 6 ? 0 : 255;
+	}
+	if (flag != S3TCDecodeFlag::DXT1)
+		block += 8;
+
+	int c0 = block[0] | block[1] << 8;
+	int c1 = block[2] | block[3] << 8;
+	int code = (block[4 + texel / 4] >> (texel & 3) * 2) & 3;
+	// the 5 and 6 bit channels widened by repeating their top bits
+	int rgb0[3] = { replicate(c0 >> 11, 5), replicate((c0 >> 5) & 63, 6), replicate(c0 & 31, 5) };
+	int rgb1[3] = { replicate(c1 >> 11, 5), replicate((c1 >> 5) & 63, 6), replicate(c1 & 31, 5) };
+
+	bool fourColors = c0 > c1 || flag != S3TCDecodeFlag::DXT1;
+	for (int i = 0; i < 3; i++)
+	{
+		if (code == 0)
+			out[i] = rgb0[i];
+		else if (code == 1)
+			out[i] = rgb1[i];
+		else if (fourColors)
+			out[i] = code == 2 ? (2 * rgb0[i] + rgb1[i]) / 3 : (rgb0[i] + 2 * rgb1[i]) / 3;
+		else
+			out[i] = code == 2 ? (rgb0[i] + rgb1[i]) / 2 : 0;
+	}
+	out[3] = !fourColors && code == 3 ? 0 : alpha;
+}
+
+// the 16 2 bit color indices, or the 16 3 bit alpha indices, of a block
+static void writeIndices(uint8_t* out, const int* indices, int bits)
+{
+	uint64_t packed = 0;
+	for (int i = 0; i < 16; i++)
+		packed |= (uint64_t) indices[i] << (i * bits);
+	for (int i = 0; i < bits * 2; i++)
+		out[i] = (uint8_t) (packed >> (i * 8));
+}
+
+static void writeColors(uint8_t* out, int c0, int c1, const int* indices)
+{
+	out[0] = c0 & 0xff;
+	out[1] = c0 >> 8;
+	out[2] = c1 & 0xff;
+	out[3] = c1 >> 8;
+	writeIndices(out + 4, indices, 2);
+}
+
+static bool check(const char* name, const uint8_t* block, S3TCDecodeFlag flag, const uint8_t* expected)
+{
+	uint8_t actual[64];
+	s3tc_decode(const_cast<uint8_t*>(block), actual, 4, 4, flag);
+	bool same = memcmp(actual, expected, sizeof(actual)) == 0;
+	printf("%-22s %s\n", name, same ? "ok" : "MISMATCH");
+	for (int i = 0; i < 64 && !same; i += 4)
+	{
+		if (memcmp(&actual[i], &expected[i], 4) != 0)
+		{
+			printf("  pixel %d: %d %d %d %d, expected %d %d %d %d\n", i / 4,
+					actual[i], actual[i + 1], actual[i + 2], actual[i + 3],
+					expected[i], expected[i + 1], expected[i + 2], expected[i + 3]);
+			break;
+		}
+	}
+	return same;
+}
+
+// every pixel takes the palette entry (and alpha) its index picks
+static void expand(const int (*palette)[4], const int* indices, const int* alphas, uint8_t* expected)
+{
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 4; c++)
+			expected[i * 4 + c] = palette[indices[i]][c];
+		if (alphas)
+			expected[i * 4 + 3] = alphas[i];
+	}
+}
+
+static const int colorIndices[16] = { 0, 1, 2, 3, 3, 2, 1, 0, 1, 1, 2, 2, 0, 3, 0, 3 };
+
+// 16,32,8 expands to 132,130,66 and 1,1,1 to 8,4,8; the thirds round down
+static const int color0 = 16 << 11 | 32 << 5 | 8;
+static const int color1 = 1 << 11 | 1 << 5 | 1;
+
+static bool testDXT1FourColors()
+{
+	static const int palette[4][4] =
+	{
+		{ 132, 130, 66, 255 }, { 8, 4, 8, 255 }, { 90, 88, 46, 255 }, { 49, 46, 27, 255 }
+	};
+	uint8_t block[8];
+	writeColors(block, color0, color1, colorIndices);
+	uint8_t expected[64];
+	expand(palette, colorIndices, NULL, expected);
+	return check("DXT1 four colors", block, S3TCDecodeFlag::DXT1, expected);
+}
+
+static bool testDXT1ThreeColors()
+{
+	// color0 <= color1: the halfway color, index 3 is transparent black
+	static const int palette[4][4] =
+	{
+		{ 8, 4, 8, 255 }, { 132, 130, 66, 255 }, { 70, 67, 37, 255 }, { 0, 0, 0, 0 }
+	};
+	uint8_t block[8];
+	writeColors(block, color1, color0, colorIndices);
+	uint8_t expected[64];
+	expand(palette, colorIndices, NULL, expected);
+	return check("DXT1 three colors", block, S3TCDecodeFlag::DXT1, expected);
+}
+
+static bool testDXT3()
+{
+	// color0 <= color1 still has four colors, the alphas are 4 bit
+	static const int palette[4][4] =
+	{
+		{ 8, 4, 8, 0 }, { 132, 130, 66, 0 }, { 49, 46, 27, 0 }, { 90, 88, 46, 0 }
+	};
+	uint8_t block[16];
+	int alphas[16];
+	for (int i = 0; i < 16; i++)
+	{
+		block[i / 2] = i & 1 ? (block[i / 2] | (15 - i) << 4) : 15 - i;
+		alphas[i] = (15 - i) * 17;
+	}
+	writeColors(block + 8, color1, color0, colorIndices);
+	uint8_t expected[64];
+	expand(palette, colorIndices, alphas, expected);
+	return check("DXT3", block, S3TCDecodeFlag::DXT3, expected);
+}
+
+static bool testDXT5(const char* name, int alpha0, int alpha1, const int* alphaPalette)
+{
+	static const int palette[4][4] =
+	{
+		{ 255, 0, 0, 0 }, { 0, 0, 255, 0 }, { 170, 0, 85, 0 }, { 85, 0, 170, 0 }
+	};
+	// every code, twice, so the indices cross all three byte boundaries
+	int alphaIndices[16];
+	int alphas[16];
+	for (int i = 0; i < 16; i++)
+	{
+		alphaIndices[i] = (i * 3 + 1) & 7;
+		alphas[i] = alphaPalette[alphaIndices[i]];
+	}
+	uint8_t block[16];
+	block[0] = alpha0;
+	block[1] = alpha1;
+	writeIndices(block + 2, alphaIndices, 3);
+	writeColors(block + 8, 31 << 11, 31, colorIndices);
+	uint8_t expected[64];
+	expand(palette, colorIndices, alphas, expected);
+	return check(name, block, S3TCDecodeFlag::DXT5, expected);
+}
+
+// a four and a three color block side by side, clipped to 5x3
+static bool testEdge()
+{
+	const int width = 5;
+	const int height = 3;
+	uint8_t blocks[16];
+	writeColors(blocks, color0, color1, colorIndices);
+	writeColors(blocks + 8, color1, color0, colorIndices);
+
+	uint8_t whole[2][64];
+	s3tc_decode(blocks, whole[0], 4, 4, S3TCDecodeFlag::DXT1);
+	s3tc_decode(blocks + 8, whole[1], 4, 4, S3TCDecodeFlag::DXT1);
+
+	// guard bytes after the level have to stay as they are
+	std::vector<uint8_t> actual(width * height * 4 + 64, 0xcd);
+	s3tc_decode(blocks, &actual[0], width, height, S3TCDecodeFlag::DXT1);
+	bool same = true;
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+			same = same && memcmp(&actual[(y * width + x) * 4], &whole[x / 4][(y * 4 + (x & 3)) * 4], 4) == 0;
+	}
+	for (size_t i = width * height * 4; i < actual.size(); i++)
+		same = same && actual[i] == 0xcd;
+	printf("%-22s %s\n", "DXT1 5x3 level", same ? "ok" : "MISMATCH");
+	return same;
+}
+
+static bool run(int width, int height, S3TCDecodeFlag flag, int rounds)
+{
+	int blockSize = flag == S3TCDecodeFlag::DXT1 ? 8 : 16;
+	std::vector<uint8_t> data((size_t) ((width + 3) / 4) * ((height + 3) / 4) * blockSize);
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = (uint8_t) rand();
+
+	std::vector<uint8_t> expected((size_t) width * height * 4);
+	double start = now();
+	for (int r = 0; r < rounds; r++)
+	{
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+				referencePixel(&data[0], width, x, y, flag, &expected[((size_t) y * width + x) * 4]);
+		}
+	}
+	double referenceTime = now() - start;
+
+	std::vector<uint8_t> actual((size_t) width * height * 4);
+	start = now();
+	for (int r = 0; r < rounds; r++)
+		s3tc_decode(&data[0], &actual[0], width, height, flag);
+	double decodeTime = now() - start;
+
+	bool same = actual == expected;
+	double pixels = (double) width * height * rounds / 1e6;
+	printf("%s %4dx%-4d  reference %8.1f MPixels/s  s3tc_decode %8.1f MPixels/s  %s\n", flagName(flag),
+			width, height, pixels / referenceTime, pixels / decodeTime, same ? "identical" : "MISMATCH");
+	return same;
+}
+
+int main(int argc, char** argv)
+{
+	int rounds = argc > 1 ? atoi(argv[1]) : 10;
+	static const int alphas7[8] = { 200, 60, 180, 160, 140, 120, 100, 80 };
+	static const int alphas5[8] = { 40, 240, 80, 120, 160, 200, 0, 255 };
+	srand(1);
+	bool ok = true;
+	ok &= testDXT1FourColors();
+	ok &= testDXT1ThreeColors();
+	ok &= testDXT3();
+	ok &= testDXT5("DXT5 alpha0 > alpha1", 200, 60, alphas7);
+	ok &= testDXT5("DXT5 alpha0 <= alpha1", 40, 240, alphas5);
+	ok &= testEdge();
+	ok &= run(1024, 1024, S3TCDecodeFlag::DXT1, rounds);
+	ok &= run(1024, 1024, S3TCDecodeFlag::DXT3, rounds);
+	ok &= run(1024, 1024, S3TCDecodeFlag::DXT5, rounds);
+	ok &= run(1023, 509, S3TCDecodeFlag::DXT1, 1);
+	ok &= run(1023, 509, S3TCDecodeFlag::DXT5, 1);
+	ok &= run(13, 7, S3TCDecodeFlag::DXT3, 1);
+	return ok ? 0 : 1;
+}
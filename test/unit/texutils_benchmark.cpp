@@ -0,0 +1,323 @@
+#include "tool/utility/TexUtils.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+using namespace flakor;
+
+// Converts a 2048x2048 image between every pair of uncompressed formats
+// with TexUtils::convertRow and with a per-pixel reference, checks that
+// both give the same bytes and prints the throughput of each in
+// MPixels/s. The 16 bit targets are run again with dithering on.
+// Premultiply is checked the same way, on random alpha and on a sprite
+// like image that is mostly opaque, and the linear light mode is compared
+// with an exact computation.
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static const unsigned char kBayer[4][4] =
+{
+	{ 0, 8, 2, 10 },
+	{ 12, 4, 14, 6 },
+	{ 3, 11, 1, 9 },
+	{ 15, 7, 13, 5 },
+};
+
+static int bytesPerPixel(PixelFormat format)
+{
+	return TexUtils::getBytesPerPixel(format);
+}
+
+static void readPixel(const unsigned char* p, PixelFormat format, int* c)
+{
+	switch (format)
+	{
+		case PixelFormat::I8:
+			c[0] = c[1] = c[2] = p[0];
+			c[3] = 255;
+			break;
+		case PixelFormat::AI88:
+			c[0] = c[1] = c[2] = p[0];
+			c[3] = p[1];
+			break;
+		case PixelFormat::RGB888:
+			c[0] = p[0];
+			c[1] = p[1];
+			c[2] = p[2];
+			c[3] = 255;
+			break;
+		default:
+			c[0] = p[0];
+			c[1] = p[1];
+			c[2] = p[2];
+			c[3] = p[3];
+			break;
+	}
+}
+
+static void writePixel(unsigned char* p, PixelFormat format, const int* c)
+{
+	int l = (c[0] * 77 + c[1] * 150 + c[2] * 29 + 128) >> 8;
+	uint16_t v = 0;
+	switch (format)
+	{
+		case PixelFormat::RGBA8888:
+			p[0] = c[0];
+			p[1] = c[1];
+			p[2] = c[2];
+			p[3] = c[3];
+			return;
+		case PixelFormat::RGB888:
+			p[0] = c[0];
+			p[1] = c[1];
+			p[2] = c[2];
+			return;
+		case PixelFormat::A8:
+			p[0] = c[3];
+			return;
+		case PixelFormat::I8:
+			p[0] = l;
+			return;
+		case PixelFormat::AI88:
+			p[0] = l;
+			p[1] = c[3];
+			return;
+		case PixelFormat::RGB565:
+			v = ((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3);
+			break;
+		case PixelFormat::RGBA4444:
+			v = ((c[0] >> 4) << 12) | ((c[1] >> 4) << 8) | ((c[2] >> 4) << 4) | (c[3] >> 4);
+			break;
+		case PixelFormat::RGB5A1:
+			v = ((c[0] >> 3) << 11) | ((c[1] >> 3) << 6) | ((c[2] >> 3) << 1) | (c[3] >> 7);
+			break;
+		default:
+			return;
+	}
+	memcpy(p, &v, 2);
+}
+
+static void convertReference(const unsigned char* in, unsigned char* out, int width, int height,
+		PixelFormat from, PixelFormat to, bool dither)
+{
+	// bits per color channel of the 16 bit targets
+	int bits[3] = { 8, 8, 8 };
+	if (to == PixelFormat::RGB565)
+	{
+		bits[0] = 5; bits[1] = 6; bits[2] = 5;
+	}
+	else if (to == PixelFormat::RGBA4444)
+	{
+		bits[0] = bits[1] = bits[2] = 4;
+	}
+	else if (to == PixelFormat::RGB5A1)
+	{
+		bits[0] = bits[1] = bits[2] = 5;
+	}
+	bool dithered = dither && bits[0] < 8;
+
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			int c[4];
+			readPixel(in, from, c);
+			if (dithered)
+			{
+				for (int i = 0; i < 3; i++)
+				{
+					// threshold scaled to the channel's step of 256 >> bits
+					c[i] += kBayer[y & 3][x & 3] >> (bits[i] - 4);
+					if (c[i] > 255)
+						c[i] = 255;
+				}
+			}
+			writePixel(out, to, c);
+			in += bytesPerPixel(from);
+			out += bytesPerPixel(to);
+		}
+	}
+}
+
+static const char* name(PixelFormat format)
+{
+	switch (format)
+	{
+		case PixelFormat::RGBA8888: return "RGBA8888";
+		case PixelFormat::RGB888: return "RGB888";
+		case PixelFormat::RGB565: return "RGB565";
+		case PixelFormat::A8: return "A8";
+		case PixelFormat::I8: return "I8";
+		case PixelFormat::AI88: return "AI88";
+		case PixelFormat::RGBA4444: return "RGBA4444";
+		case PixelFormat::RGB5A1: return "RGB5A1";
+		default: return "?";
+	}
+}
+
+static bool run(int width, int height, PixelFormat from, PixelFormat to, bool dither, int rounds)
+{
+	if (TexUtils::getConvertedFormat(from, to) != to || from == to)
+		return true;
+	if (dither && to != PixelFormat::RGB565 && to != PixelFormat::RGBA4444 && to != PixelFormat::RGB5A1)
+		return true;
+
+	size_t inSize = (size_t) width * height * bytesPerPixel(from);
+	size_t outSize = (size_t) width * height * bytesPerPixel(to);
+	unsigned char* in = (unsigned char*) malloc(inSize);
+	unsigned char* out = (unsigned char*) malloc(outSize);
+	unsigned char* expected = (unsigned char*) malloc(outSize);
+	for (size_t i = 0; i < inSize; i++)
+		in[i] = (unsigned char) rand();
+
+	TexUtils::setDitherEnabled(dither);
+	double start = now();
+	for (int i = 0; i < rounds; i++)
+		convertReference(in, expected, width, height, from, to, dither);
+	double referenceTime = now() - start;
+
+	start = now();
+	for (int i = 0; i < rounds; i++)
+	{
+		for (int y = 0; y < height; y++)
+		{
+			TexUtils::convertRow(in + (size_t) y * width * bytesPerPixel(from),
+					out + (size_t) y * width * bytesPerPixel(to), width, from, to, y);
+		}
+	}
+	double time = now() - start;
+
+	bool ok = memcmp(out, expected, outSize) == 0;
+	double pixels = (double) width * height * rounds / 1e6;
+	printf("%-8s -> %-8s%s reference %7.1f MPixels/s, convertRow %7.1f MPixels/s%s\n",
+			name(from), name(to), dither ? " dithered" : "         ",
+			pixels / referenceTime, pixels / time, ok ? "" : "  MISMATCH");
+
+	free(in);
+	free(out);
+	free(expected);
+	return ok;
+}
+
+static double srgbToLinear(int c)
+{
+	double v = c / 255.0;
+	return v <= 0.04045 ? v / 12.92 : pow((v + 0.055) / 1.055, 2.4);
+}
+
+static int linearToSrgb(double l)
+{
+	double v = l <= 0.0031308 ? l * 12.92 : 1.055 * pow(l, 1.0 / 2.4) - 0.055;
+	return (int) (v * 255.0 + 0.5);
+}
+
+static bool runPremultiply(int width, int height, bool sprite, int rounds)
+{
+	size_t size = (size_t) width * height * 4;
+	unsigned char* image = (unsigned char*) malloc(size);
+	unsigned char* expected = (unsigned char*) malloc(size);
+	unsigned char* out = (unsigned char*) malloc(size);
+	for (size_t i = 0; i < size; i++)
+		image[i] = (unsigned char) rand();
+	if (sprite)
+	{
+		// opaque except a soft border and a few transparent holes
+		for (int y = 0; y < height; y++)
+			for (int x = 0; x < width; x++)
+			{
+				int edge = x < y ? x : y;
+				unsigned char* p = image + ((size_t) y * width + x) * 4;
+				p[3] = edge < 8 ? (unsigned char) (edge * 32) : ((x / 64 + y / 64) % 7 == 0 ? 0 : 255);
+			}
+	}
+
+	// in place over and over, alpha doesn't change so neither does the work
+	memcpy(expected, image, size);
+	double start = now();
+	for (int i = 0; i < rounds; i++)
+	{
+		for (size_t j = 0; j < size; j += 4)
+		{
+			unsigned a = expected[j + 3];
+			for (int c = 0; c < 3; c++)
+				expected[j + c] = (unsigned char) ((expected[j + c] * (a + 1)) >> 8);
+		}
+	}
+	double referenceTime = now() - start;
+
+	memcpy(out, image, size);
+	start = now();
+	for (int i = 0; i < rounds; i++)
+		TexUtils::premultiplyRow(out, width * height);
+	double time = now() - start;
+	bool ok = memcmp(out, expected, size) == 0;
+
+	memcpy(out, image, size);
+	start = now();
+	for (int i = 0; i < rounds; i++)
+		TexUtils::premultiplyRow(out, width * height, true);
+	double linearTime = now() - start;
+
+	// one pass for the error check
+	memcpy(out, image, size);
+	TexUtils::premultiplyRow(out, width * height, true);
+
+	int maxError = 0;
+	for (size_t j = 0; j < size; j += 4)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			int exact = image[j + 3] == 255 ? image[j + c]
+					: linearToSrgb(srgbToLinear(image[j + c]) * image[j + 3] / 255.0);
+			int error = abs(exact - out[j + c]);
+			maxError = error > maxError ? error : maxError;
+		}
+	}
+	// the 12 bit linear tables lose a little in the darkest values
+	ok &= maxError <= 2;
+
+	double pixels = (double) width * height * rounds / 1e6;
+	printf("premultiply %dx%d %-6s reference %7.1f MPixels/s, premultiplyRow %7.1f MPixels/s%s, "
+			"linear %7.1f MPixels/s (max error %d)\n",
+			width, height, sprite ? "sprite" : "random", pixels / referenceTime, pixels / time,
+			ok ? "" : "  MISMATCH", pixels / linearTime, maxError);
+
+	free(image);
+	free(expected);
+	free(out);
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	int rounds = argc > 1 ? atoi(argv[1]) : 5;
+	static const PixelFormat kFormats[] = { PixelFormat::RGBA8888, PixelFormat::RGB888, PixelFormat::RGB565,
+			PixelFormat::A8, PixelFormat::I8, PixelFormat::AI88, PixelFormat::RGBA4444, PixelFormat::RGB5A1 };
+	static const int kCount = sizeof(kFormats) / sizeof(kFormats[0]);
+
+	bool ok = true;
+	for (int dither = 0; dither < 2; dither++)
+		for (int i = 0; i < kCount; i++)
+			for (int j = 0; j < kCount; j++)
+				ok &= run(2048, 2048, kFormats[i], kFormats[j], dither != 0, rounds);
+
+	// odd sizes exercise the scalar tails
+	for (int dither = 0; dither < 2; dither++)
+		for (int i = 0; i < kCount; i++)
+			for (int j = 0; j < kCount; j++)
+				ok &= run(1023, 7, kFormats[i], kFormats[j], dither != 0, 1);
+
+	ok &= runPremultiply(2048, 2048, false, rounds);
+	ok &= runPremultiply(2048, 2048, true, rounds);
+	ok &= runPremultiply(1023, 7, false, 1);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,261 @@
+#include "core/opengl/texture/TGAlib.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+using namespace flakor;
+
+// Encodes large RLE TGAs (flat areas, noise, runs across row ends, both
+// origins) and loads them with tgaLoadBuffer and with the loader it
+// replaced, which copied runs one pixel at a time and flipped the image
+// afterwards. Checks that both give the same pixels and prints the
+// throughput of each in MPixels/s. Uncompressed files are checked too.
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static const size_t kHeaderSize = 18;
+
+static bool referenceLoadRLE(unsigned char* buffer, unsigned long bufSize, tImageTGA* info)
+{
+	unsigned int mode, total, i, index = 0;
+	unsigned char aux[4], runlength = 0;
+	unsigned int skip = 0, flag = 0;
+	size_t step = kHeaderSize;
+
+	mode = info->pixelDepth / 8;
+	total = info->height * info->width;
+
+	for (i = 0; i < total; i++)
+	{
+		if (runlength != 0)
+		{
+			runlength--;
+			skip = (flag != 0);
+		}
+		else
+		{
+			if (step + 1 > bufSize)
+				break;
+			runlength = buffer[step++];
+			flag = runlength & 0x80;
+			if (flag)
+				runlength -= 128;
+			skip = 0;
+		}
+
+		if (!skip)
+		{
+			if (step + mode > bufSize)
+				break;
+			memcpy(aux, buffer + step, mode);
+			step += mode;
+			if (mode >= 3)
+			{
+				unsigned char tmp = aux[0];
+				aux[0] = aux[2];
+				aux[2] = tmp;
+			}
+		}
+
+		memcpy(&info->imageData[index], aux, mode);
+		index += mode;
+	}
+	return true;
+}
+
+static bool referenceLoadRaw(unsigned char* buffer, unsigned long bufSize, tImageTGA* info)
+{
+	int mode = info->pixelDepth / 8;
+	int total = info->height * info->width * mode;
+	if (kHeaderSize + total > bufSize)
+		return false;
+	memcpy(info->imageData, buffer + kHeaderSize, total);
+	if (mode >= 3)
+	{
+		for (int i = 0; i < total; i += mode)
+		{
+			unsigned char aux = info->imageData[i];
+			info->imageData[i] = info->imageData[i + 2];
+			info->imageData[i + 2] = aux;
+		}
+	}
+	return true;
+}
+
+static void referenceFlip(tImageTGA* info)
+{
+	int mode = info->pixelDepth / 8;
+	int rowbytes = info->width * mode;
+	unsigned char* row = (unsigned char*) malloc(rowbytes);
+	for (int y = 0; y < info->height / 2; y++)
+	{
+		memcpy(row, &info->imageData[y * rowbytes], rowbytes);
+		memcpy(&info->imageData[y * rowbytes], &info->imageData[(info->height - (y + 1)) * rowbytes], rowbytes);
+		memcpy(&info->imageData[(info->height - (y + 1)) * rowbytes], row, rowbytes);
+	}
+	free(row);
+	info->flipped = 0;
+}
+
+static tImageTGA* referenceLoad(unsigned char* buffer, long size)
+{
+	tImageTGA* info = (tImageTGA*) malloc(sizeof(tImageTGA));
+	tgaLoadHeader(buffer, size, info);
+	info->imageData = (unsigned char*) malloc((size_t) info->width * info->height * (info->pixelDepth / 8));
+	bool ok = info->type == 10 ? referenceLoadRLE(buffer, size, info) : referenceLoadRaw(buffer, size, info);
+	info->status = ok ? TGA_OK : TGA_ERROR_READING_FILE;
+	if (info->flipped)
+		referenceFlip(info);
+	return info;
+}
+
+// Pixels of a UI like image: flat bands and boxes, some noise, gradients.
+static std::vector<unsigned char> makeImage(int width, int height, int mode)
+{
+	std::vector<unsigned char> pixels((size_t) width * height * mode);
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++)
+		{
+			unsigned char* p = &pixels[((size_t) y * width + x) * mode];
+			int area = (x / 256 + y / 128) % 4;
+			for (int c = 0; c < mode; c++)
+			{
+				if (area == 0)
+					p[c] = (unsigned char) (y / 128 * 40 + c);
+				else if (area == 1)
+					p[c] = (unsigned char) rand();
+				else if (area == 2)
+					p[c] = (unsigned char) (x / 8 + c);
+				else
+					p[c] = (unsigned char) (c * 60);
+			}
+		}
+	return pixels;
+}
+
+// RLE packets over the whole image, not cut at row ends
+static std::vector<unsigned char> encode(const std::vector<unsigned char>& pixels, int width, int height,
+		int mode, bool rle, bool topDown)
+{
+	std::vector<unsigned char> file(kHeaderSize, 0);
+	// the loader reads RLE as type 10 whatever the depth
+	file[2] = rle ? 10 : (mode == 1 ? 3 : 2);
+	file[12] = width & 0xff;
+	file[13] = width >> 8;
+	file[14] = height & 0xff;
+	file[15] = height >> 8;
+	file[16] = mode * 8;
+	file[17] = topDown ? 0x20 : 0;
+
+	size_t total = (size_t) width * height;
+	if (!rle)
+	{
+		file.insert(file.end(), pixels.begin(), pixels.end());
+		return file;
+	}
+	size_t i = 0;
+	while (i < total)
+	{
+		size_t run = 1;
+		while (i + run < total && run < 128
+				&& memcmp(&pixels[(i + run) * mode], &pixels[i * mode], mode) == 0)
+			run++;
+		if (run > 1)
+		{
+			file.push_back((unsigned char) (0x80 | (run - 1)));
+			file.insert(file.end(), &pixels[i * mode], &pixels[i * mode] + mode);
+			i += run;
+			continue;
+		}
+		size_t count = 1;
+		while (i + count < total && count < 128
+				&& (i + count + 1 >= total
+					|| memcmp(&pixels[(i + count + 1) * mode], &pixels[(i + count) * mode], mode) != 0))
+			count++;
+		file.push_back((unsigned char) (count - 1));
+		file.insert(file.end(), &pixels[i * mode], &pixels[(i + count) * mode]);
+		i += count;
+	}
+	return file;
+}
+
+static bool run(int width, int height, int mode, bool rle, bool topDown, int rounds)
+{
+	std::vector<unsigned char> pixels = makeImage(width, height, mode);
+	std::vector<unsigned char> file = encode(pixels, width, height, mode, rle, topDown);
+
+	double start = now();
+	tImageTGA* expected = nullptr;
+	for (int i = 0; i < rounds; i++)
+	{
+		tgaDestroy(expected);
+		expected = referenceLoad(&file[0], file.size());
+	}
+	double referenceTime = now() - start;
+
+	start = now();
+	tImageTGA* info = nullptr;
+	for (int i = 0; i < rounds; i++)
+	{
+		tgaDestroy(info);
+		info = tgaLoadBuffer(&file[0], file.size());
+	}
+	double time = now() - start;
+
+	size_t size = (size_t) width * height * mode;
+	bool ok = info->status == TGA_OK && expected->status == TGA_OK
+			&& memcmp(info->imageData, expected->imageData, size) == 0;
+
+	double mpixels = (double) width * height * rounds / 1e6;
+	printf("%dx%d %d bit %-3s %-9s %6.1f MB, reference %7.1f MPixels/s, tgaLoadBuffer %7.1f MPixels/s%s\n",
+			width, height, mode * 8, rle ? "RLE" : "raw", topDown ? "top down" : "bottom up",
+			file.size() / 1e6, mpixels / referenceTime, mpixels / time, ok ? "" : "  MISMATCH");
+
+	tgaDestroy(expected);
+	tgaDestroy(info);
+	return ok;
+}
+
+// cut short files must fail instead of reading past the end
+static bool runTruncated()
+{
+	std::vector<unsigned char> pixels = makeImage(300, 200, 4);
+	std::vector<unsigned char> file = encode(pixels, 300, 200, 4, true, false);
+	bool ok = true;
+	for (size_t cut = kHeaderSize; cut < file.size(); cut += file.size() / 97)
+	{
+		std::vector<unsigned char> part(file.begin(), file.begin() + cut);
+		tImageTGA* info = tgaLoadBuffer(&part[0], part.size());
+		ok &= info->status == TGA_ERROR_READING_FILE;
+		tgaDestroy(info);
+	}
+	printf("truncated RLE files%s\n", ok ? " rejected" : "  NOT REJECTED");
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	int rounds = argc > 1 ? atoi(argv[1]) : 5;
+	static const int kModes[] = { 4, 3, 1 };
+
+	bool ok = true;
+	for (int m = 0; m < 3; m++)
+		for (int topDown = 0; topDown < 2; topDown++)
+			ok &= run(4096, 4096, kModes[m], true, topDown != 0, rounds);
+	for (int topDown = 0; topDown < 2; topDown++)
+		ok &= run(4096, 4096, 4, false, topDown != 0, rounds);
+
+	// odd sizes, packets run on across row ends
+	ok &= run(1021, 7, 4, true, true, 1);
+	ok &= run(3, 1001, 3, true, false, 1);
+	ok &= runTruncated();
+	return ok ? 0 : 1;
+}
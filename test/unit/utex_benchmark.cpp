@@ -0,0 +1,145 @@
+#include "core/opengl/texture/utex.h"
+#include "core/opengl/texture/etc1.h"
+#include "core/opengl/texture/etc2.h"
+#include "core/opengl/texture/s3tc.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Encodes a test image to .utex, then inflates and transcodes level 0 to
+// every target and prints the throughput of each in MPixels/s. Block
+// targets are decoded back with the repo decoders and compared with the
+// RGBA8888 transcode: ETC1 / ETC2 color must match it exactly, DXT must
+// stay close (PSNR).
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double psnr(const uint8_t* a, const uint8_t* b, uint32_t pixels, int channel, int channels)
+{
+	double sum = 0;
+	for (uint32_t i = 0; i < pixels; i++)
+		for (int c = channel; c < channel + channels; c++)
+		{
+			double d = (double) a[4 * i + c] - b[4 * i + c];
+			sum += d * d;
+		}
+	return sum == 0 ? 99.0 : 10.0 * log10(255.0 * 255.0 * pixels * channels / sum);
+}
+
+static bool run(uint32_t width, uint32_t height, bool hasAlpha, int rounds)
+{
+	static const char* kNames[] = { "ETC1", "ETC2_RGBA8", "DXT1", "DXT5", "ATC_RGB",
+			"ATC_RGBA_INTERPOLATED", "RGB565", "RGBA8888" };
+	uint32_t stride = width * 4;
+	uint8_t* image = (uint8_t*) malloc(stride * height);
+
+	// gradients with some noise, closer to real textures than pure noise
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			uint8_t* p = image + y * stride + x * 4;
+			p[0] = (uint8_t) (x * 255 / width + rand() % 16);
+			p[1] = (uint8_t) (y * 255 / height + rand() % 16);
+			p[2] = (uint8_t) (((x ^ y) & 0x7f) + rand() % 16);
+			p[3] = (uint8_t) (hasAlpha ? ((x / 64 + y / 64) & 1 ? 255 : (x + y) & 0xff) : 255);
+		}
+	}
+
+	uint8_t* file = NULL;
+	double start = now();
+	uint32_t fileSize = utex_encode_image(image, width, height, stride, hasAlpha, 1, &file);
+	double encodeTime = now() - start;
+	if (fileSize == 0 || !utex_header_is_valid(file, fileSize))
+	{
+		printf("%ux%u encode failed\n", width, height);
+		free(image);
+		return false;
+	}
+	printf("%ux%u %s: %u levels, %u bytes (%.2f bpp incl. mipmaps), encode %.2f MPixels/s\n",
+			width, height, hasAlpha ? "RGBA" : "RGB", utex_header_get_levels(file), fileSize,
+			8.0 * fileSize / (width * height), (double) width * height / 1e6 / encodeTime);
+
+	uint32_t sliceSize = utex_get_slice_size(width, height, hasAlpha);
+	uint8_t* slice = (uint8_t*) malloc(sliceSize);
+	start = now();
+	for (int i = 0; i < rounds; i++)
+		utex_inflate_level(file, fileSize, 0, slice);
+	double inflateTime = now() - start;
+	double pixels = (double) width * height * rounds / 1e6;
+	printf("  inflate: %.1f MPixels/s\n", pixels / inflateTime);
+
+	uint8_t* reference = (uint8_t*) malloc(stride * height);
+	utex_transcode_level(slice, hasAlpha, width, height, UTEX_TARGET_RGBA8888, reference, stride);
+
+	uint8_t* out = (uint8_t*) malloc(utex_get_transcoded_size(UTEX_TARGET_RGBA8888, width, height));
+	uint8_t* decoded = (uint8_t*) malloc(stride * height);
+	bool ok = true;
+	for (int target = UTEX_TARGET_ETC1; target <= UTEX_TARGET_RGBA8888; target++)
+	{
+		if (target == UTEX_TARGET_ETC1 && hasAlpha)
+			continue;
+		utex_target t = (utex_target) target;
+		uint32_t outStride = width * (t == UTEX_TARGET_RGB565 ? 2 : 4);
+
+		start = now();
+		for (int i = 0; i < rounds; i++)
+			utex_transcode_level(slice, hasAlpha, width, height, t, out, outStride);
+		double time = now() - start;
+		printf("  %-22s %.1f MPixels/s", kNames[target], pixels / time);
+
+		switch (t)
+		{
+			case UTEX_TARGET_ETC1:
+			case UTEX_TARGET_ETC2_RGBA8:
+				etc2_decode_image(t == UTEX_TARGET_ETC1 ? ETC2_FORMAT_RGB8 : ETC2_FORMAT_RGBA8,
+						out, decoded, width, height, 4, stride);
+				if (psnr(reference, decoded, width * height, 0, 3) != 99.0)
+				{
+					printf(", color MISMATCH");
+					ok = false;
+				}
+				if (hasAlpha)
+					printf(", alpha PSNR %.2f dB", psnr(reference, decoded, width * height, 3, 1));
+				break;
+			case UTEX_TARGET_DXT1:
+			case UTEX_TARGET_DXT5:
+				s3tc_decode(out, decoded, width, height,
+						t == UTEX_TARGET_DXT1 ? S3TCDecodeFlag::DXT1 : S3TCDecodeFlag::DXT5);
+				printf(", color PSNR %.2f dB", psnr(reference, decoded, width * height, 0, 3));
+				if (hasAlpha && t == UTEX_TARGET_DXT5)
+					printf(", alpha PSNR %.2f dB", psnr(reference, decoded, width * height, 3, 1));
+				break;
+			default:
+				break;
+		}
+		printf("\n");
+	}
+	printf("  source PSNR %.2f dB\n", psnr(image, reference, width * height, 0, hasAlpha ? 4 : 3));
+
+	free(image);
+	free(file);
+	free(slice);
+	free(reference);
+	free(out);
+	free(decoded);
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	int rounds = argc > 1 ? atoi(argv[1]) : 20;
+	bool ok = true;
+	ok &= run(1024, 1024, false, rounds);
+	ok &= run(1024, 1024, true, rounds);
+	ok &= run(1023, 509, true, 1);
+	return ok ? 0 : 1;
+}